@@ -0,0 +1,616 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Benchmark of the shadow/actuator pipeline on the host: the real
+ * shadow_client.c, parser, serializer, lock table, journal and device.c,
+ * fed by a mock broker on a virtual clock (see port/include/FreeRTOS.h).
+ *
+ * For every scenario it reports the host CPU time per incoming message, the
+ * CPU time of the simulated timer service task, heap allocations, NVS writes,
+ * publishes and the virtual time from a delta to the actuator edge it asks
+ * for. That virtual delay is set by the coalescing logic alone: tasks never
+ * run or preempt each other here, so it says nothing about scheduling. The
+ * unlock latency on the device is the LatencySpanUnlock span of
+ * latency_probe.h.
+ *
+ * The exit status is 1 if the pipeline misbehaves: an allocation after init,
+ * an unlock request that never reached the actuator or was held back past
+ * #appconfigLATENCY_UNLOCK_BUDGET_MS of virtual time, a stale or unversioned
+ * delta that opened anything, or a compartment or power lock still
+ * held once everything has settled.
+ */
+
+#define _GNU_SOURCE /* memmem */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+
+#include "esp_system.h"
+
+#include "aws_clientcredential.h"
+
+#include "app_config.h"
+#include "device.h"
+#include "latency_probe.h"
+#include "lock_state.h"
+#include "shadow_client.h"
+
+#include "host_sim.h"
+
+/*-----------------------------------------------------------*/
+
+#define BENCH_SHADOW_TOPIC(sfx)      "$aws/things/" clientcredentialIOT_THING_NAME "/shadow" sfx
+
+#define BENCH_MAX_SAMPLES            (100000U)
+#define BENCH_MAX_RESPONSES          (64U)
+
+/**
+ * @brief Broker round trip for /update and /get responses.
+ */
+#define BENCH_BROKER_RTT_MS          (40U)
+
+/**
+ * @brief Long enough for every compartment to close and every timer to go
+ * quiet after a scenario.
+ */
+#define BENCH_SETTLE_MS              (appconfigLOCK_OPEN_HOLD_MS + appconfigSHADOW_DELTA_COALESCE_MS + 1000U)
+
+typedef struct BenchSamples
+{
+    uint64_t *pullValues;
+    size_t xCount;
+} BenchSamples_t;
+
+typedef struct BenchResponse
+{
+    uint64_t ullDueUs;
+    bool xGet;
+    char cToken[16];
+} BenchResponse_t;
+
+typedef struct BenchResult
+{
+    const char *pcName;
+    size_t xMessages;
+    BenchSamples_t xCpuNs;
+    BenchSamples_t xUnlockUs;
+    uint64_t ullTimerCpuNs;
+    SimCounters_t xCounters;
+    uint32_t ulActuations;
+} BenchResult_t;
+
+/*-----------------------------------------------------------*/
+
+static const gpio_num_t xLockGpios[appconfigLOCK_COUNT] = appconfigLOCK_GPIOS;
+
+/**
+ * @brief Virtual time of the first delta asking to open a closed
+ * compartment, 0 when no request is outstanding.
+ */
+static uint64_t ullRequestedAtUs[appconfigLOCK_COUNT];
+
+static BenchResult_t *pxCurrent = NULL;
+
+/* Static, since every heap allocation counts against the code under test;
+ * scenarios run one after the other and share them. */
+static uint64_t ullCpuSamples[BENCH_MAX_SAMPLES];
+static uint64_t ullUnlockSamples[BENCH_MAX_SAMPLES];
+
+static uint32_t ulShadowVersion = 1U;
+static uint32_t ulDeltaVersion = 0U; /**< Version of the last sent delta. */
+static uint32_t ulDesiredOpen = 0U;
+
+static BenchResponse_t xResponses[BENCH_MAX_RESPONSES];
+static size_t xResponseCount = 0U;
+
+static bool xAutoRespond = true;
+static bool xFailed = false;
+
+/*-----------------------------------------------------------*/
+
+static void prvSampleAdd(BenchSamples_t *pxSamples, uint64_t ullValue) {
+    if (pxSamples->xCount < BENCH_MAX_SAMPLES) {
+        pxSamples->pullValues[pxSamples->xCount++] = ullValue;
+    }
+}
+
+static int prvCompare(const void *pvA, const void *pvB) {
+    uint64_t ullA = *(const uint64_t *) pvA;
+    uint64_t ullB = *(const uint64_t *) pvB;
+
+    return (ullA > ullB) - (ullA < ullB);
+}
+
+static uint64_t prvPercentile(BenchSamples_t *pxSamples, uint32_t ulPercent) {
+    size_t xRank;
+
+    if (pxSamples->xCount == 0U) {
+        return 0U;
+    }
+
+    qsort(pxSamples->pullValues, pxSamples->xCount, sizeof(uint64_t), prvCompare);
+    xRank = ((pxSamples->xCount * ulPercent) + 99U) / 100U;
+
+    return pxSamples->pullValues[(xRank > 0U) ? (xRank - 1U) : 0U];
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvGpioHook(int lGpio, uint32_t ulLevel, uint64_t ullAtUs) {
+    uint32_t i;
+
+    for (i = 0; i < appconfigLOCK_COUNT; i++) {
+        if ((xLockGpios[i] == lGpio) && (ulLevel != 0U)) {
+            if (pxCurrent != NULL) {
+                pxCurrent->ulActuations++;
+
+                if (ullRequestedAtUs[i] != 0U) {
+                    prvSampleAdd(&pxCurrent->xUnlockUs, ullAtUs - ullRequestedAtUs[i]);
+                }
+            }
+
+            ullRequestedAtUs[i] = 0U;
+        }
+    }
+}
+
+/**
+ * @brief Answer /update and /get like the broker would, one round trip later.
+ */
+static void prvPublishHook(const char *pcTopic,
+                           size_t xTopicLength,
+                           const char *pcPayload,
+                           size_t xPayloadLength) {
+    static const char cTokenKey[] = "\"clientToken\":\"";
+    BenchResponse_t *pxResponse;
+    const char *pcToken;
+    bool xGet = (xTopicLength == (sizeof(BENCH_SHADOW_TOPIC("/get")) - 1U)) &&
+                (memcmp(pcTopic, BENCH_SHADOW_TOPIC("/get"), xTopicLength) == 0);
+    bool xUpdate = (xTopicLength == (sizeof(BENCH_SHADOW_TOPIC("/update")) - 1U)) &&
+                   (memcmp(pcTopic, BENCH_SHADOW_TOPIC("/update"), xTopicLength) == 0);
+    size_t i;
+
+    if (!xAutoRespond || !(xGet || xUpdate) || (xResponseCount == BENCH_MAX_RESPONSES)) {
+        return;
+    }
+
+    pxResponse = &xResponses[xResponseCount];
+    pxResponse->ullDueUs = ullSimNowUs() + (BENCH_BROKER_RTT_MS * 1000U);
+    pxResponse->xGet = xGet;
+    pxResponse->cToken[0] = '\0';
+
+    pcToken = memmem(pcPayload, xPayloadLength, cTokenKey, sizeof(cTokenKey) - 1U);
+
+    if (pcToken != NULL) {
+        pcToken += sizeof(cTokenKey) - 1U;
+
+        for (i = 0; (i < (sizeof(pxResponse->cToken) - 1U)) && (pcToken[i] != '"'); i++) {
+            pxResponse->cToken[i] = pcToken[i];
+        }
+
+        pxResponse->cToken[i] = '\0';
+    }
+
+    if (xUpdate) {
+        ulShadowVersion++;
+    }
+
+    xResponseCount++;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t prvLocksArray(char *pcOut, size_t xLength, uint32_t ulMask) {
+    size_t xUsed = 0U;
+    uint32_t i;
+
+    xUsed += (size_t) snprintf(&pcOut[xUsed], xLength - xUsed, "[");
+
+    for (i = 0; i < appconfigLOCK_COUNT; i++) {
+        xUsed += (size_t) snprintf(&pcOut[xUsed], xLength - xUsed, "%s%u",
+                                   (i > 0U) ? "," : "", (unsigned) ((ulMask >> i) & 1U));
+    }
+
+    xUsed += (size_t) snprintf(&pcOut[xUsed], xLength - xUsed, "]");
+
+    return xUsed;
+}
+
+static uint64_t prvDeliver(const char *pcTopic, const char *pcPayload) {
+    uint64_t ullCpuNs = ullSimBrokerDeliver(pcTopic, pcPayload, strlen(pcPayload));
+
+    pxCurrent->xMessages++;
+    prvSampleAdd(&pxCurrent->xCpuNs, ullCpuNs);
+
+    return ullCpuNs;
+}
+
+static void prvDeliverResponse(const BenchResponse_t *pxResponse) {
+    char cLocks[64];
+    char cDocument[1024];
+
+    (void) prvLocksArray(cLocks, sizeof(cLocks), ulDesiredOpen);
+
+    if (pxResponse->xGet) {
+        /* The app has not asked for anything the box did not do: no delta. */
+        (void) snprintf(cDocument, sizeof(cDocument),
+                        "{\"state\":{\"desired\":{\"lockState\":0,\"locks\":%s},"
+                        "\"reported\":{\"lockState\":0,\"locks\":%s}},"
+                        "\"metadata\":{\"desired\":{\"lockState\":{\"timestamp\":1600000000}},"
+                        "\"reported\":{\"lockState\":{\"timestamp\":1600000000}}},"
+                        "\"version\":%u,\"timestamp\":1600000000,\"clientToken\":\"%s\"}",
+                        cLocks, cLocks, (unsigned) ulShadowVersion, pxResponse->cToken);
+        (void) prvDeliver(BENCH_SHADOW_TOPIC("/get/accepted"), cDocument);
+    } else {
+        (void) snprintf(cDocument, sizeof(cDocument),
+                        "{\"state\":{\"reported\":{\"lockState\":0}},"
+                        "\"metadata\":{\"reported\":{\"lockState\":{\"timestamp\":1600000000}}},"
+                        "\"version\":%u,\"timestamp\":1600000000,\"clientToken\":\"%s\"}",
+                        (unsigned) ulShadowVersion, pxResponse->cToken);
+        (void) prvDeliver(BENCH_SHADOW_TOPIC("/update/accepted"), cDocument);
+    }
+}
+
+/**
+ * @brief Move virtual time forward in 1 ms steps, delivering broker
+ * responses as they fall due and charging the simulated timer task.
+ */
+static void prvAdvance(uint32_t ulMs) {
+    uint64_t ullStartNs;
+    uint32_t ulStep;
+    size_t i;
+
+    for (ulStep = 0; ulStep < ulMs; ulStep++) {
+        ullStartNs = xSimCounters.ullTimerTaskNs;
+        vSimAdvanceMs(1U);
+        pxCurrent->ullTimerCpuNs += xSimCounters.ullTimerTaskNs - ullStartNs;
+
+        for (i = 0; i < xResponseCount;) {
+            if (xResponses[i].ullDueUs <= ullSimNowUs()) {
+                BenchResponse_t xResponse = xResponses[i];
+
+                xResponses[i] = xResponses[--xResponseCount];
+                prvDeliverResponse(&xResponse);
+            } else {
+                i++;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Deliver an /update/delta document, with "version":ulVersion
+ * unless xVersioned is false.
+ */
+static void prvDeliverDelta(uint32_t ulOpenMask, bool xVersioned, uint32_t ulVersion) {
+    char cLocks[64];
+    char cVersion[24] = "";
+    char cDocument[512];
+
+    if (xVersioned) {
+        (void) snprintf(cVersion, sizeof(cVersion), "\"version\":%u,", (unsigned) ulVersion);
+    }
+
+    (void) prvLocksArray(cLocks, sizeof(cLocks), ulOpenMask);
+    (void) snprintf(cDocument, sizeof(cDocument),
+                    "{%s\"timestamp\":1600000000,"
+                    "\"state\":{\"lockState\":%u,\"locks\":%s},"
+                    "\"metadata\":{\"lockState\":{\"timestamp\":1600000000},"
+                    "\"locks\":[{\"timestamp\":1600000000}]},"
+                    "\"clientToken\":\"app-%u\"}",
+                    cVersion, (unsigned) (ulOpenMask & 1U), cLocks,
+                    (unsigned) ulVersion);
+
+    (void) prvDeliver(BENCH_SHADOW_TOPIC("/update/delta"), cDocument);
+}
+
+/**
+ * @brief Publish a desired state change as AWS IoT does on /update/delta.
+ */
+static void prvSendDelta(uint32_t ulOpenMask) {
+    uint32_t i;
+
+    for (i = 0; i < appconfigLOCK_COUNT; i++) {
+        if (((ulOpenMask >> i) & 1U) == 0U) {
+            /* Withdrawn before it was acted on; not owed an unlock. */
+            ullRequestedAtUs[i] = 0U;
+        } else if ((ulSimGpioLevel(xLockGpios[i]) == 0U) && (ullRequestedAtUs[i] == 0U)) {
+            ullRequestedAtUs[i] = ullSimNowUs();
+        }
+    }
+
+    ulDesiredOpen = ulOpenMask;
+    ulShadowVersion++;
+    ulDeltaVersion = ulShadowVersion;
+
+    prvDeliverDelta(ulOpenMask, true, ulShadowVersion);
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvBegin(BenchResult_t *pxResult, const char *pcName) {
+    (void) memset(pxResult, 0x00, sizeof(*pxResult));
+    pxResult->pcName = pcName;
+    pxResult->xCpuNs.pullValues = ullCpuSamples;
+    pxResult->xUnlockUs.pullValues = ullUnlockSamples;
+    pxResult->xCounters = xSimCounters;
+    pxCurrent = pxResult;
+}
+
+static void prvEnd(BenchResult_t *pxResult) {
+    SimCounters_t xStart = pxResult->xCounters;
+    uint32_t i;
+
+    prvAdvance(BENCH_SETTLE_MS);
+
+    pxResult->xCounters.ullAllocations = xSimCounters.ullAllocations - xStart.ullAllocations;
+    pxResult->xCounters.ullNvsWrites = xSimCounters.ullNvsWrites - xStart.ullNvsWrites;
+    pxResult->xCounters.ullNvsBytes = xSimCounters.ullNvsBytes - xStart.ullNvsBytes;
+    pxResult->xCounters.ullPublishes = xSimCounters.ullPublishes - xStart.ullPublishes;
+    pxResult->xCounters.ullLogRecords = xSimCounters.ullLogRecords - xStart.ullLogRecords;
+
+    if (pxResult->xCounters.ullAllocations != 0U) {
+        fprintf(stderr, "%s: %" PRIu64 " heap allocation(s) after init\n",
+                pxResult->pcName, pxResult->xCounters.ullAllocations);
+        xFailed = true;
+    }
+
+    for (i = 0; i < appconfigLOCK_COUNT; i++) {
+        if (ullRequestedAtUs[i] != 0U) {
+            fprintf(stderr, "%s: compartment %u was asked to open but never was\n", pxResult->pcName, (unsigned) i);
+            ullRequestedAtUs[i] = 0U;
+            xFailed = true;
+        }
+
+        if (eLockStateGet(i) != LockStateClosed) {
+            fprintf(stderr, "%s: compartment %u did not close\n", pxResult->pcName, (unsigned) i);
+            xFailed = true;
+        }
+    }
+
+    if (prvPercentile(&pxResult->xUnlockUs, 100U) > ((uint64_t) appconfigLATENCY_UNLOCK_BUDGET_MS * 1000U)) {
+        fprintf(stderr, "%s: an unlock was held back %" PRIu64 " us of virtual time, over the %u ms budget\n",
+                pxResult->pcName, prvPercentile(&pxResult->xUnlockUs, 100U),
+                (unsigned) appconfigLATENCY_UNLOCK_BUDGET_MS);
+        xFailed = true;
+    }
+
+    if (ulSimPowerLocksHeld() != 0U) {
+        fprintf(stderr, "%s: %u power lock(s) still held\n", pxResult->pcName, (unsigned) ulSimPowerLocksHeld());
+        xFailed = true;
+    }
+
+    pxCurrent = NULL;
+}
+
+static void prvPrintHeader(void) {
+    printf("%-10s %8s %9s %9s %9s %10s %7s %6s %7s %5s %6s %9s %9s %9s\n",
+           "scenario", "msgs", "cpu p50", "cpu p99", "cpu max", "timer cpu",
+           "allocs", "nvs", "nvs B", "pubs", "opens", "delay50", "delay99", "delaymax");
+    printf("%-10s %8s %9s %9s %9s %10s %7s %6s %7s %5s %6s %9s %9s %9s\n",
+           "", "", "ns", "ns", "ns", "us", "", "writes", "", "", "", "ms", "ms", "ms");
+}
+
+static void prvPrint(BenchResult_t *pxResult) {
+    printf("%-10s %8zu %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %10" PRIu64 " %7" PRIu64 " %6" PRIu64
+           " %7" PRIu64 " %5" PRIu64 " %6u %9.1f %9.1f %9.1f\n",
+           pxResult->pcName,
+           pxResult->xMessages,
+           prvPercentile(&pxResult->xCpuNs, 50U),
+           prvPercentile(&pxResult->xCpuNs, 99U),
+           prvPercentile(&pxResult->xCpuNs, 100U),
+           pxResult->ullTimerCpuNs / 1000U,
+           pxResult->xCounters.ullAllocations,
+           pxResult->xCounters.ullNvsWrites,
+           pxResult->xCounters.ullNvsBytes,
+           pxResult->xCounters.ullPublishes,
+           (unsigned) pxResult->ulActuations,
+           (double) prvPercentile(&pxResult->xUnlockUs, 50U) / 1000.0,
+           (double) prvPercentile(&pxResult->xUnlockUs, 99U) / 1000.0,
+           (double) prvPercentile(&pxResult->xUnlockUs, 100U) / 1000.0);
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief One delta at a time, each opening every compartment after the
+ * previous ones have closed again.
+ */
+static void prvScenarioUnlock(uint32_t ulCount) {
+    BenchResult_t xResult;
+    uint32_t i;
+
+    prvBegin(&xResult, "unlock");
+
+    for (i = 0; i < ulCount; i++) {
+        prvSendDelta(LOCK_STATE_ALL_MASK);
+        prvAdvance(BENCH_SETTLE_MS);
+    }
+
+    prvEnd(&xResult);
+    prvPrint(&xResult);
+}
+
+/**
+ * @brief A burst of deltas, one every ulIntervalMs, each with a random
+ * desired state, as an app retrying or several users tapping at once.
+ */
+static void prvScenarioStorm(uint32_t ulCount, uint32_t ulIntervalMs) {
+    BenchResult_t xResult;
+    uint32_t i;
+
+    prvBegin(&xResult, "storm");
+
+    for (i = 0; i < ulCount; i++) {
+        prvSendDelta(esp_random() & LOCK_STATE_ALL_MASK);
+        prvAdvance(ulIntervalMs);
+    }
+
+    prvEnd(&xResult);
+    prvPrint(&xResult);
+}
+
+/**
+ * @brief Fail the scenario if anything was opened, for deltas that must be
+ * ignored.
+ */
+static void prvExpectNoOpens(const BenchResult_t *pxResult) {
+    if (pxResult->ulActuations != 0U) {
+        fprintf(stderr, "%s: %u compartment(s) opened by deltas that should be ignored\n",
+                pxResult->pcName, (unsigned) pxResult->ulActuations);
+        xFailed = true;
+    }
+}
+
+/**
+ * @brief Deltas older than the last one applied, e.g. delivered out of
+ * order after a reconnect, each asking to open every compartment.
+ */
+static void prvScenarioStale(uint32_t ulCount) {
+    BenchResult_t xResult;
+    uint32_t i;
+
+    prvBegin(&xResult, "stale");
+
+    for (i = 0; i < ulCount; i++) {
+        prvDeliverDelta(LOCK_STATE_ALL_MASK, true, ulDeltaVersion - 1U - (i % ulDeltaVersion));
+        prvAdvance(1U);
+    }
+
+    prvEnd(&xResult);
+    prvExpectNoOpens(&xResult);
+    prvPrint(&xResult);
+}
+
+/**
+ * @brief Deltas without a version, which cannot be ordered and so are not
+ * acted on, each asking to open every compartment.
+ */
+static void prvScenarioNoVersion(uint32_t ulCount) {
+    BenchResult_t xResult;
+    uint32_t i;
+
+    prvBegin(&xResult, "noversion");
+
+    for (i = 0; i < ulCount; i++) {
+        prvDeliverDelta(LOCK_STATE_ALL_MASK, false, 0U);
+        prvAdvance(1U);
+    }
+
+    prvEnd(&xResult);
+    prvExpectNoOpens(&xResult);
+    prvPrint(&xResult);
+}
+
+/**
+ * @brief Session drops while compartments are opened locally, then comes
+ * back: journal writes, the history burst and the resync.
+ */
+static void prvScenarioOffline(uint32_t ulCount) {
+    BenchResult_t xResult;
+    uint32_t i;
+
+    prvBegin(&xResult, "offline");
+
+    vSimBrokerSetSession(false);
+
+    for (i = 0; i < ulCount; i++) {
+        (void) xLockStateRequestOpen(1UL << (i % appconfigLOCK_COUNT));
+        prvAdvance(BENCH_SETTLE_MS);
+    }
+
+    vSimBrokerSetSession(true);
+
+    prvEnd(&xResult);
+    prvPrint(&xResult);
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvUsage(const char *pcProgram) {
+    fprintf(stderr,
+            "usage: %s [-v] [-n deltas] [-i interval_ms]\n"
+            "  -n  deltas in the storm (default 2000)\n"
+            "  -i  virtual time between storm deltas (default 1 ms)\n"
+            "  -v  print the IotLog lines\n",
+            pcProgram);
+}
+
+int main(int argc, char **argv) {
+    uint32_t ulStormCount = 2000U;
+    uint32_t ulStormIntervalMs = 1U;
+    BenchResult_t xInit;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-v") == 0)) {
+            vSimSetVerbose(true);
+        } else if ((strcmp(argv[i], "-n") == 0) && ((i + 1) < argc)) {
+            ulStormCount = (uint32_t) strtoul(argv[++i], NULL, 10);
+        } else if ((strcmp(argv[i], "-i") == 0) && ((i + 1) < argc)) {
+            ulStormIntervalMs = (uint32_t) strtoul(argv[++i], NULL, 10);
+        } else {
+            prvUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    vSimGpioSetHook(prvGpioHook);
+    vSimBrokerSetPublishHook(prvPublishHook);
+
+    /* The order of controller.c. */
+    prvBegin(&xInit, "init");
+
+    if ((xShadowClientInit() != pdPASS) ||
+        (eDeviceInit() != ESP_OK) ||
+        (xLatencyProbeInit() != pdPASS)) {
+        fprintf(stderr, "init failed\n");
+        return 1;
+    }
+
+    (void) RunDeviceShadowClient(true, clientcredentialIOT_THING_NAME, NULL, NULL, NULL);
+    vSimBrokerSetSession(true);
+
+    printf("%u compartment(s), coalescing window %u ms, unlock budget %u ms, hold %u ms, broker round trip %u ms\n\n",
+           (unsigned) appconfigLOCK_COUNT,
+           (unsigned) appconfigSHADOW_DELTA_COALESCE_MS,
+           (unsigned) appconfigLATENCY_UNLOCK_BUDGET_MS,
+           (unsigned) appconfigLOCK_OPEN_HOLD_MS,
+           (unsigned) BENCH_BROKER_RTT_MS);
+    prvPrintHeader();
+
+    prvEnd(&xInit);
+    prvPrint(&xInit);
+
+    prvScenarioUnlock(20U);
+    prvScenarioStorm(ulStormCount, ulStormIntervalMs);
+    prvScenarioStale(1000U);
+    prvScenarioNoVersion(100U);
+    prvScenarioOffline(appconfigJOURNAL_BATCH_ENTRIES * 2U);
+
+    return xFailed ? 1 : 0;
+}
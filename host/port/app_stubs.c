@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The application modules around the shadow/actuator pipeline, reduced to
+ * what the pipeline observes of them.
+ */
+
+#include <stdlib.h>
+
+#include "FreeRTOS.h"
+#include "timers.h"
+
+#include "app_log.h"
+#include "app_network.h"
+#include "boot.h"
+#include "display_service.h"
+#include "flash_writer.h"
+#include "i2c_bus.h"
+#include "power_manager.h"
+#include "ota_client.h"
+#include "task_profiler.h"
+
+#include "host_sim.h"
+
+/*-----------------------------------------------------------*/
+
+static uint32_t ulBootDoneMs[BootPhaseCount];
+static uint32_t ulBootDoneMask = 0U;
+
+static uint32_t ulPowerLocks[PowerLockCount];
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xAppLogInit(void) {
+    return pdPASS;
+}
+
+void vAppLogRecord(uint8_t ucLevel,
+                   const char *pcModule,
+                   const char *pcFormat,
+                   uint32_t ulArg0,
+                   uint32_t ulArg1,
+                   uint32_t ulArg2,
+                   uint32_t ulArg3) {
+    /* The cost on the device is the copy into the queue; nothing to format. */
+    (void) ucLevel;
+    (void) pcModule;
+    (void) pcFormat;
+    (void) ulArg0;
+    (void) ulArg1;
+    (void) ulArg2;
+    (void) ulArg3;
+
+    xSimCounters.ullLogRecords++;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xBootInit(void) {
+    return pdPASS;
+}
+
+void vBootMark(BootPhase_t ePhase) {
+    if ((ulBootDoneMask & (1UL << ePhase)) == 0U) {
+        ulBootDoneMask |= (1UL << ePhase);
+        ulBootDoneMs[ePhase] = (uint32_t) (ullSimNowUs() / 1000U);
+    }
+}
+
+BaseType_t xBootWait(BootPhase_t ePhase, TickType_t xTicksToWait) {
+    (void) xTicksToWait;
+
+    return ((ulBootDoneMask & (1UL << ePhase)) != 0U) ? pdTRUE : pdFALSE;
+}
+
+uint32_t ulBootPhaseDoneMs(BootPhase_t ePhase) {
+    return ulBootDoneMs[ePhase];
+}
+
+void vBootProvisionKeys(void) {
+    vBootMark(BootPhaseKeys);
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xDisplayServiceInit(void) {
+    return pdPASS;
+}
+
+BaseType_t xDisplaySetText(DisplayRegion_t eRegion, const char *pcText) {
+    (void) eRegion;
+    (void) pcText;
+
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xI2cBusInit(void) {
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xPowerManagerInit(void) {
+    return pdPASS;
+}
+
+void vPowerLockAcquire(PowerLock_t eLock) {
+    ulPowerLocks[eLock]++;
+}
+
+void vPowerLockRelease(PowerLock_t eLock) {
+    configASSERT(ulPowerLocks[eLock] > 0U);
+    ulPowerLocks[eLock]--;
+}
+
+void vPowerManagerNetworkUp(void) {
+}
+
+uint32_t ulSimPowerLocksHeld(void) {
+    uint32_t ulHeld = 0U;
+    size_t i;
+
+    for (i = 0; i < PowerLockCount; i++) {
+        ulHeld += ulPowerLocks[i];
+    }
+
+    return ulHeld;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xFlashWriterInit(void) {
+    return pdPASS;
+}
+
+/* Tasks are not run, so the writes become pended calls: they still happen
+ * after the caller returns, as on the device. */
+BaseType_t xFlashWriterPend(FlashWriterFunction_t xFunction, void *pvParameter1, uint32_t ulParameter2) {
+    return xTimerPendFunctionCall(xFunction, pvParameter1, ulParameter2, 0U);
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTaskProfilerInit(void) {
+    return pdPASS;
+}
+
+bool xTaskProfilerHandlePublish(const MQTTPublishInfo_t *pxPublishInfo) {
+    (void) pxPublishInfo;
+
+    return false;
+}
+
+bool xOtaClientHandlePublish(const MQTTPublishInfo_t *pxPublishInfo) {
+    (void) pxPublishInfo;
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+int network_initialize(appMqttContext_t *pContext) {
+    (void) pContext;
+
+    return EXIT_SUCCESS;
+}
+
+appNetworkSetting_t getNetworkSetting() {
+    appNetworkSetting_t xSetting = { 0 };
+
+    return xSetting;
+}
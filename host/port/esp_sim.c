@@ -0,0 +1,378 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+
+#include "esp_event.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "driver/gpio.h"
+#include "m5stickc.h"
+#include "iot_demo_logging.h"
+
+#include "host_sim.h"
+
+/*-----------------------------------------------------------*/
+
+#define SIM_NVS_NAMESPACES    (8U)
+#define SIM_NVS_ENTRIES       (32U)
+#define SIM_NVS_NAME_LENGTH   (16U)
+#define SIM_NVS_BLOB_LENGTH   (256U)
+
+typedef struct SimNvsEntry
+{
+    uint32_t ulNamespace;
+    char cKey[SIM_NVS_NAME_LENGTH];
+    uint8_t ucData[SIM_NVS_BLOB_LENGTH];
+    size_t xLength;
+    bool xUsed;
+} SimNvsEntry_t;
+
+SimCounters_t xSimCounters;
+
+static bool xVerbose = false;
+
+static uint32_t ulRandomState = 0x2545F491U;
+
+static uint32_t ulGpioLevels[GPIO_NUM_MAX];
+static SimGpioHook_t xGpioHook = NULL;
+
+static char cNamespaces[SIM_NVS_NAMESPACES][SIM_NVS_NAME_LENGTH];
+static SimNvsEntry_t xNvsEntries[SIM_NVS_ENTRIES];
+
+/*-----------------------------------------------------------*/
+
+void vSimSetVerbose(bool xEnable) {
+    xVerbose = xEnable;
+}
+
+void vSimLog(int lLevel, const char *pcFormat, ...) {
+    static const char *const pcLevels[] = { "", "ERROR", "WARN", "INFO", "DEBUG" };
+    va_list xArgs;
+
+    xSimCounters.ullIotLogLines++;
+
+    if (xVerbose) {
+        fprintf(stderr, "[%8.3f ms] [%s] ", (double) ullSimNowUs() / 1000.0, pcLevels[lLevel]);
+        va_start(xArgs, pcFormat);
+        vfprintf(stderr, pcFormat, xArgs);
+        va_end(xArgs);
+        fputc('\n', stderr);
+    }
+}
+
+uint64_t ullSimCpuNs(void) {
+    struct timespec xNow;
+
+    (void) clock_gettime(CLOCK_THREAD_CPUTIME_ID, &xNow);
+
+    return ((uint64_t) xNow.tv_sec * 1000000000U) + (uint64_t) xNow.tv_nsec;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Linked with --wrap, so only calls from the code under test are counted. */
+void *__real_malloc(size_t xSize);
+void *__real_calloc(size_t xCount, size_t xSize);
+void *__real_realloc(void *pv, size_t xSize);
+
+void *__wrap_malloc(size_t xSize) {
+    xSimCounters.ullAllocations++;
+    xSimCounters.ullAllocatedBytes += xSize;
+
+    return __real_malloc(xSize);
+}
+
+void *__wrap_calloc(size_t xCount, size_t xSize) {
+    xSimCounters.ullAllocations++;
+    xSimCounters.ullAllocatedBytes += xCount * xSize;
+
+    return __real_calloc(xCount, xSize);
+}
+
+void *__wrap_realloc(void *pv, size_t xSize) {
+    xSimCounters.ullAllocations++;
+    xSimCounters.ullAllocatedBytes += xSize;
+
+    return __real_realloc(pv, xSize);
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t esp_random(void) {
+    /* xorshift32 */
+    ulRandomState ^= ulRandomState << 13;
+    ulRandomState ^= ulRandomState >> 17;
+    ulRandomState ^= ulRandomState << 5;
+
+    return ulRandomState;
+}
+
+int64_t esp_timer_get_time(void) {
+    return (int64_t) ullSimNowUs();
+}
+
+esp_err_t esp_event_handler_register_with(esp_event_loop_handle_t event_loop,
+                                          esp_event_base_t event_base,
+                                          int32_t event_id,
+                                          esp_event_handler_t event_handler,
+                                          void *event_handler_arg) {
+    (void) event_loop;
+    (void) event_base;
+    (void) event_id;
+    (void) event_handler;
+    (void) event_handler_arg;
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+void vSimGpioSetHook(SimGpioHook_t xHook) {
+    xGpioHook = xHook;
+}
+
+uint32_t ulSimGpioLevel(int lGpio) {
+    return ((lGpio >= 0) && (lGpio < GPIO_NUM_MAX)) ? ulGpioLevels[lGpio] : 0U;
+}
+
+esp_err_t gpio_config(const gpio_config_t *pGPIOConfig) {
+    return ((pGPIOConfig->pin_bit_mask >> GPIO_NUM_MAX) == 0U) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    if ((gpio_num < 0) || (gpio_num >= GPIO_NUM_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSimCounters.ullGpioWrites++;
+
+    if ((ulGpioLevels[gpio_num] != level) && (xGpioHook != NULL)) {
+        xGpioHook(gpio_num, level, ullSimNowUs());
+    }
+
+    ulGpioLevels[gpio_num] = level;
+
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    return (int) ulSimGpioLevel(gpio_num);
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags) {
+    (void) intr_alloc_flags;
+
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args) {
+    (void) gpio_num;
+    (void) isr_handler;
+    (void) args;
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+esp_event_loop_handle_t m5stickc_event_loop = NULL;
+
+uint8_t TFT_FONT_ROTATE;
+uint8_t TFT_TEXT_WRAP;
+uint8_t TFT_FONT_TRANSPARENT;
+uint8_t TFT_FONT_FORCEFIXED;
+uint8_t TFT_GRAY_SCALE;
+uint16_t TFT_FONT_BACKGROUND;
+uint16_t TFT_FONT_FOREGROUND;
+
+esp_err_t M5StickCInit(m5stickc_config_t *config) {
+    (void) config;
+
+    return ESP_OK;
+}
+
+esp_err_t M5StickCDisplayOn(void) {
+    return ESP_OK;
+}
+
+esp_err_t M5StickCLedSet(uint8_t state) {
+    return gpio_set_level(M5STICKC_LED_GPIO, state);
+}
+
+/*-----------------------------------------------------------*/
+
+static SimNvsEntry_t *prvNvsFind(nvs_handle handle, const char *key) {
+    size_t i;
+
+    for (i = 0; i < SIM_NVS_ENTRIES; i++) {
+        if (xNvsEntries[i].xUsed &&
+            (xNvsEntries[i].ulNamespace == (handle >> 1)) &&
+            (strncmp(xNvsEntries[i].cKey, key, SIM_NVS_NAME_LENGTH) == 0)) {
+            return &xNvsEntries[i];
+        }
+    }
+
+    return NULL;
+}
+
+static esp_err_t prvNvsWrite(nvs_handle handle, const char *key, const void *value, size_t length) {
+    SimNvsEntry_t *pxEntry = prvNvsFind(handle, key);
+    size_t i;
+
+    if ((handle & 1U) == 0U) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (length > SIM_NVS_BLOB_LENGTH) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    for (i = 0; (pxEntry == NULL) && (i < SIM_NVS_ENTRIES); i++) {
+        if (!xNvsEntries[i].xUsed) {
+            pxEntry = &xNvsEntries[i];
+            pxEntry->xUsed = true;
+            pxEntry->ulNamespace = handle >> 1;
+            (void) strncpy(pxEntry->cKey, key, SIM_NVS_NAME_LENGTH - 1U);
+        }
+    }
+
+    if (pxEntry == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    (void) memcpy(pxEntry->ucData, value, length);
+    pxEntry->xLength = length;
+
+    xSimCounters.ullNvsWrites++;
+    xSimCounters.ullNvsBytes += length;
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_init_partition(const char *partition_label) {
+    (void) partition_label;
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_open_from_partition(const char *part_name,
+                                  const char *name,
+                                  nvs_open_mode open_mode,
+                                  nvs_handle *out_handle) {
+    uint32_t i;
+
+    /* Namespaces are told apart by name only. */
+    (void) part_name;
+
+    for (i = 0; i < SIM_NVS_NAMESPACES; i++) {
+        if (strncmp(cNamespaces[i], name, SIM_NVS_NAME_LENGTH) == 0) {
+            break;
+        }
+
+        if (cNamespaces[i][0] == '\0') {
+            if (open_mode == NVS_READONLY) {
+                return ESP_ERR_NVS_NOT_FOUND;
+            }
+
+            (void) strncpy(cNamespaces[i], name, SIM_NVS_NAME_LENGTH - 1U);
+            break;
+        }
+    }
+
+    if (i == SIM_NVS_NAMESPACES) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* The low bit records whether writes are allowed. */
+    *out_handle = (i << 1) | ((open_mode == NVS_READWRITE) ? 1U : 0U);
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode open_mode, nvs_handle *out_handle) {
+    return nvs_open_from_partition("nvs", name, open_mode, out_handle);
+}
+
+void nvs_close(nvs_handle handle) {
+    (void) handle;
+}
+
+esp_err_t nvs_commit(nvs_handle handle) {
+    (void) handle;
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle handle, const char *key, void *out_value, size_t *length) {
+    SimNvsEntry_t *pxEntry = prvNvsFind(handle, key);
+
+    if (pxEntry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    if (out_value != NULL) {
+        if (*length < pxEntry->xLength) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        (void) memcpy(out_value, pxEntry->ucData, pxEntry->xLength);
+    }
+
+    *length = pxEntry->xLength;
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle handle, const char *key, const void *value, size_t length) {
+    return prvNvsWrite(handle, key, value, length);
+}
+
+esp_err_t nvs_get_u16(nvs_handle handle, const char *key, uint16_t *out_value) {
+    size_t xLength = sizeof(*out_value);
+
+    return nvs_get_blob(handle, key, out_value, &xLength);
+}
+
+esp_err_t nvs_set_u16(nvs_handle handle, const char *key, uint16_t value) {
+    return prvNvsWrite(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_erase_key(nvs_handle handle, const char *key) {
+    SimNvsEntry_t *pxEntry = prvNvsFind(handle, key);
+
+    if (pxEntry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    pxEntry->xUsed = false;
+    xSimCounters.ullNvsWrites++;
+
+    return ESP_OK;
+}
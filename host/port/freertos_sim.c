@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "semphr.h"
+
+#include "host_sim.h"
+
+/*-----------------------------------------------------------*/
+
+#define SIM_PENDED_CALLS    (64U)
+
+typedef struct SimPendedCall
+{
+    PendedFunction_t xFunction;
+    void *pvParameter1;
+    uint32_t ulParameter2;
+} SimPendedCall_t;
+
+static uint64_t ullNowUs = 0U;
+
+/**
+ * @brief Every timer ever created, in creation order, which breaks ties
+ * between timers due at the same time.
+ */
+static StaticTimer_t *pxTimers = NULL;
+
+/**
+ * @brief The timer command queue, as far as pended calls go.
+ */
+static SimPendedCall_t xPended[SIM_PENDED_CALLS];
+static size_t xPendedHead = 0U;
+static size_t xPendedCount = 0U;
+
+static struct SimTask
+{
+    int lUnused;
+} xTask;
+
+static uint32_t ulNotifyValue = 0U;
+static bool xNotifyPending = false;
+
+/*-----------------------------------------------------------*/
+
+void vSimAssertFailed(const char *pcFile, int lLine) {
+    fprintf(stderr, "assertion failed at %s:%d\n", pcFile, lLine);
+    abort();
+}
+
+void *pvPortMalloc(size_t xSize) {
+    return malloc(xSize);
+}
+
+void vPortFree(void *pv) {
+    free(pv);
+}
+
+uint64_t ullSimNowUs(void) {
+    return ullNowUs;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t) (ullNowUs / (1000U * portTICK_PERIOD_MS));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return NULL;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction) {
+    (void) xTaskToNotify;
+
+    switch (eAction) {
+        case eSetBits:
+            ulNotifyValue |= ulValue;
+            break;
+
+        case eIncrement:
+            ulNotifyValue++;
+            break;
+
+        case eSetValueWithOverwrite:
+            ulNotifyValue = ulValue;
+            break;
+
+        case eSetValueWithoutOverwrite:
+            if (xNotifyPending) {
+                return pdFAIL;
+            }
+
+            ulNotifyValue = ulValue;
+            break;
+
+        default:
+            break;
+    }
+
+    xNotifyPending = true;
+
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry,
+                           uint32_t ulBitsToClearOnExit,
+                           uint32_t *pulNotificationValue,
+                           TickType_t xTicksToWait) {
+    (void) xTicksToWait;
+
+    if (!xNotifyPending) {
+        ulNotifyValue &= ~ulBitsToClearOnEntry;
+        return pdFALSE;
+    }
+
+    if (pulNotificationValue != NULL) {
+        *pulNotificationValue = ulNotifyValue;
+    }
+
+    ulNotifyValue &= ~ulBitsToClearOnExit;
+    xNotifyPending = false;
+
+    return pdTRUE;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode,
+                       const char *pcName,
+                       uint32_t ulStackDepth,
+                       void *pvParameters,
+                       UBaseType_t uxPriority,
+                       TaskHandle_t *pxCreatedTask) {
+    (void) pxTaskCode;
+    (void) pcName;
+    (void) ulStackDepth;
+    (void) pvParameters;
+    (void) uxPriority;
+
+    if (pxCreatedTask != NULL) {
+        *pxCreatedTask = &xTask;
+    }
+
+    return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t pxTaskCode,
+                               const char *pcName,
+                               uint32_t ulStackDepth,
+                               void *pvParameters,
+                               UBaseType_t uxPriority,
+                               StackType_t *pxStack,
+                               StaticTask_t *pxTcb) {
+    (void) pxStack;
+    (void) pxTcb;
+    (void) xTaskCreate(pxTaskCode, pcName, ulStackDepth, pvParameters, uxPriority, NULL);
+
+    return &xTask;
+}
+
+/*-----------------------------------------------------------*/
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *pxMutexBuffer) {
+    pxMutexBuffer->uxCount = 1U;
+
+    return pxMutexBuffer;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    StaticSemaphore_t *pxMutex = pvPortMalloc(sizeof(*pxMutex));
+
+    return (pxMutex != NULL) ? xSemaphoreCreateMutexStatic(pxMutex) : NULL;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xTicksToWait) {
+    if (xSemaphore->uxCount == 0U) {
+        configASSERT(xTicksToWait == 0U);
+        return pdFALSE;
+    }
+
+    xSemaphore->uxCount--;
+
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore) {
+    configASSERT(xSemaphore->uxCount == 0U);
+    xSemaphore->uxCount++;
+
+    return pdTRUE;
+}
+
+/*-----------------------------------------------------------*/
+
+TimerHandle_t xTimerCreateStatic(const char *pcTimerName,
+                                 TickType_t xTimerPeriod,
+                                 UBaseType_t uxAutoReload,
+                                 void *pvTimerID,
+                                 TimerCallbackFunction_t pxCallbackFunction,
+                                 StaticTimer_t *pxTimerBuffer) {
+    StaticTimer_t **ppxLast = &pxTimers;
+
+    configASSERT(xTimerPeriod > 0U);
+
+    pxTimerBuffer->pcName = pcTimerName;
+    pxTimerBuffer->xPeriod = xTimerPeriod;
+    pxTimerBuffer->uxAutoReload = uxAutoReload;
+    pxTimerBuffer->pvTimerID = pvTimerID;
+    pxTimerBuffer->pxCallback = pxCallbackFunction;
+    pxTimerBuffer->xActive = false;
+    pxTimerBuffer->ullExpiryUs = 0U;
+    pxTimerBuffer->pxNext = NULL;
+
+    while (*ppxLast != NULL) {
+        ppxLast = &(*ppxLast)->pxNext;
+    }
+
+    *ppxLast = pxTimerBuffer;
+
+    return pxTimerBuffer;
+}
+
+TimerHandle_t xTimerCreate(const char *pcTimerName,
+                           TickType_t xTimerPeriod,
+                           UBaseType_t uxAutoReload,
+                           void *pvTimerID,
+                           TimerCallbackFunction_t pxCallbackFunction) {
+    StaticTimer_t *pxTimer = pvPortMalloc(sizeof(*pxTimer));
+
+    if (pxTimer == NULL) {
+        return NULL;
+    }
+
+    return xTimerCreateStatic(pcTimerName, xTimerPeriod, uxAutoReload, pvTimerID, pxCallbackFunction, pxTimer);
+}
+
+static uint64_t prvTicksToUs(TickType_t xTicks) {
+    return (uint64_t) xTicks * portTICK_PERIOD_MS * 1000U;
+}
+
+BaseType_t xTimerStart(TimerHandle_t xTimer, TickType_t xTicksToWait) {
+    (void) xTicksToWait;
+
+    xTimer->xActive = true;
+    xTimer->ullExpiryUs = ullNowUs + prvTicksToUs(xTimer->xPeriod);
+
+    return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t xTimer, TickType_t xTicksToWait) {
+    return xTimerStart(xTimer, xTicksToWait);
+}
+
+BaseType_t xTimerStop(TimerHandle_t xTimer, TickType_t xTicksToWait) {
+    (void) xTicksToWait;
+
+    xTimer->xActive = false;
+
+    return pdPASS;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t xTimer, TickType_t xNewPeriod, TickType_t xTicksToWait) {
+    configASSERT(xNewPeriod > 0U);
+    xTimer->xPeriod = xNewPeriod;
+
+    /* Like the kernel, this also starts a dormant timer. */
+    return xTimerStart(xTimer, xTicksToWait);
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t xTimer) {
+    return xTimer->xActive ? pdTRUE : pdFALSE;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t xTimer) {
+    return xTimer->pvTimerID;
+}
+
+TaskHandle_t xTimerGetTimerDaemonTaskHandle(void) {
+    return NULL;
+}
+
+BaseType_t xTimerPendFunctionCall(PendedFunction_t xFunctionToPend,
+                                  void *pvParameter1,
+                                  uint32_t ulParameter2,
+                                  TickType_t xTicksToWait) {
+    SimPendedCall_t *pxCall;
+
+    (void) xTicksToWait;
+
+    if (xPendedCount == SIM_PENDED_CALLS) {
+        return pdFAIL;
+    }
+
+    pxCall = &xPended[(xPendedHead + xPendedCount) % SIM_PENDED_CALLS];
+    pxCall->xFunction = xFunctionToPend;
+    pxCall->pvParameter1 = pvParameter1;
+    pxCall->ulParameter2 = ulParameter2;
+    xPendedCount++;
+
+    return pdPASS;
+}
+
+BaseType_t xTimerPendFunctionCallFromISR(PendedFunction_t xFunctionToPend,
+                                         void *pvParameter1,
+                                         uint32_t ulParameter2,
+                                         BaseType_t *pxHigherPriorityTaskWoken) {
+    if (pxHigherPriorityTaskWoken != NULL) {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+
+    return xTimerPendFunctionCall(xFunctionToPend, pvParameter1, ulParameter2, 0U);
+}
+
+/*-----------------------------------------------------------*/
+
+void vSimRunPending(void) {
+    SimPendedCall_t xCall;
+    uint64_t ullStartNs;
+
+    while (xPendedCount > 0U) {
+        xCall = xPended[xPendedHead];
+        xPendedHead = (xPendedHead + 1U) % SIM_PENDED_CALLS;
+        xPendedCount--;
+
+        xSimCounters.ullPendedCalls++;
+        ullStartNs = ullSimCpuNs();
+        xCall.xFunction(xCall.pvParameter1, xCall.ulParameter2);
+        xSimCounters.ullTimerTaskNs += ullSimCpuNs() - ullStartNs;
+    }
+}
+
+void vSimAdvanceMs(uint32_t ulMs) {
+    uint64_t ullTargetUs = ullNowUs + ((uint64_t) ulMs * 1000U);
+    StaticTimer_t *pxDue;
+    StaticTimer_t *pxTimer;
+    uint64_t ullStartNs;
+
+    for (;;) {
+        vSimRunPending();
+
+        pxDue = NULL;
+
+        for (pxTimer = pxTimers; pxTimer != NULL; pxTimer = pxTimer->pxNext) {
+            if (pxTimer->xActive &&
+                (pxTimer->ullExpiryUs <= ullTargetUs) &&
+                ((pxDue == NULL) || (pxTimer->ullExpiryUs < pxDue->ullExpiryUs))) {
+                pxDue = pxTimer;
+            }
+        }
+
+        if (pxDue == NULL) {
+            break;
+        }
+
+        if (pxDue->ullExpiryUs > ullNowUs) {
+            ullNowUs = pxDue->ullExpiryUs;
+        }
+
+        if (pxDue->uxAutoReload != pdFALSE) {
+            pxDue->ullExpiryUs += prvTicksToUs(pxDue->xPeriod);
+        } else {
+            pxDue->xActive = false;
+        }
+
+        xSimCounters.ullTimerCallbacks++;
+        ullStartNs = ullSimCpuNs();
+        pxDue->pxCallback(pxDue);
+        xSimCounters.ullTimerTaskNs += ullSimCpuNs() - ullStartNs;
+    }
+
+    ullNowUs = ullTargetUs;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _HOST_FREERTOS_H_
+#define _HOST_FREERTOS_H_
+
+/*
+ * Single-threaded stand-in for the FreeRTOS kernel, just enough for the
+ * shadow/actuator pipeline. There is no scheduler: the benchmark drives the
+ * code directly and advances a virtual clock with vSimAdvanceMs, which runs
+ * the timer callbacks and pended function calls that fall due, in order, as
+ * the timer service task would. Ticks are 1 ms.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "esp_err.h"
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+
+#define pdPASS                   (1)
+#define pdFAIL                   (0)
+#define pdTRUE                   (1)
+#define pdFALSE                  (0)
+
+#define portMAX_DELAY            ((TickType_t) 0xffffffffUL)
+#define configTICK_RATE_HZ       (1000U)
+#define portTICK_PERIOD_MS       ((TickType_t) 1000U / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(xTimeInMs) ((TickType_t) (((TickType_t) (xTimeInMs) * (TickType_t) configTICK_RATE_HZ) / (TickType_t) 1000U))
+
+#define configSUPPORT_STATIC_ALLOCATION     (1)
+#define configMINIMAL_STACK_SIZE            (768)
+#define tskIDLE_PRIORITY                    (0U)
+
+#define configASSERT(x)          do { if (!(x)) { vSimAssertFailed(__FILE__, __LINE__); } } while (0)
+
+/* Only one thread, so critical sections have nothing to exclude. */
+typedef struct
+{
+    int lOwner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+#define portENTER_CRITICAL(pxMux)       ((void) (pxMux))
+#define portEXIT_CRITICAL(pxMux)        ((void) (pxMux))
+#define portYIELD_FROM_ISR()
+
+#define IRAM_ATTR
+
+void vSimAssertFailed(const char *pcFile, int lLine);
+
+void *pvPortMalloc(size_t xSize);
+void vPortFree(void *pv);
+
+/**
+ * @brief Virtual time since the start of the run.
+ */
+uint64_t ullSimNowUs(void);
+
+/**
+ * @brief Move the virtual clock forward, running every timer and pended
+ * call that falls due on the way.
+ */
+void vSimAdvanceMs(uint32_t ulMs);
+
+/**
+ * @brief Run the calls pended so far, as the timer service task would once
+ * the calling task blocks.
+ */
+void vSimRunPending(void);
+
+#endif /* ifndef _HOST_FREERTOS_H_ */
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _HOST_CORE_MQTT_H_
+#define _HOST_CORE_MQTT_H_
+
+/* The coreMQTT types seen by the event callback. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MQTT_PACKET_TYPE_PUBLISH    ((uint8_t) 0x30U)
+#define MQTT_PACKET_TYPE_PUBACK     ((uint8_t) 0x40U)
+
+typedef enum MQTTQoS
+{
+    MQTTQoS0 = 0,
+    MQTTQoS1 = 1,
+    MQTTQoS2 = 2
+} MQTTQoS_t;
+
+typedef struct MQTTPublishInfo
+{
+    MQTTQoS_t qos;
+    bool retain;
+    bool dup;
+    const char *pTopicName;
+    uint16_t topicNameLength;
+    const void *pPayload;
+    size_t payloadLength;
+} MQTTPublishInfo_t;
+
+typedef struct MQTTPacketInfo
+{
+    uint8_t type;
+    uint8_t *pRemainingData;
+    size_t remainingLength;
+} MQTTPacketInfo_t;
+
+typedef struct MQTTDeserializedInfo
+{
+    uint16_t packetIdentifier;
+    MQTTPublishInfo_t *pPublishInfo;
+    int deserializationResult;
+} MQTTDeserializedInfo_t;
+
+typedef struct MQTTContext
+{
+    int lUnused;
+} MQTTContext_t;
+
+typedef void (*MQTTEventCallback_t)(MQTTContext_t *pContext,
+                                    MQTTPacketInfo_t *pPacketInfo,
+                                    MQTTDeserializedInfo_t *pDeserializedInfo);
+
+#endif /* ifndef _HOST_CORE_MQTT_H_ */
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _HOST_SIM_H_
+#define _HOST_SIM_H_
+
+/*
+ * Instrumentation of the host port, read by the benchmark. Counters only
+ * ever grow; take the difference around the part being measured.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct SimCounters
+{
+    uint64_t ullAllocations;   /**< malloc/calloc/realloc and pvPortMalloc calls. */
+    uint64_t ullAllocatedBytes;
+    uint64_t ullNvsWrites;     /**< Sets and erases, each a flash write in ESP-IDF. */
+    uint64_t ullNvsBytes;
+    uint64_t ullGpioWrites;
+    uint64_t ullLogRecords;    /**< Records queued to the deferred log task. */
+    uint64_t ullIotLogLines;
+    uint64_t ullPublishes;     /**< Publishes queued to the MQTT agent. */
+    uint64_t ullPublishedBytes;
+    uint64_t ullPendedCalls;   /**< Calls run in the simulated timer task. */
+    uint64_t ullTimerCallbacks;
+    uint64_t ullTimerTaskNs;   /**< CPU time spent in timer callbacks and pended calls. */
+} SimCounters_t;
+
+extern SimCounters_t xSimCounters;
+
+/**
+ * @brief Print every log line to stderr (IotLog* only; AppLog records are
+ * counted, since their string arguments do not survive the 32-bit cast on a
+ * 64-bit host).
+ */
+void vSimSetVerbose(bool xVerbose);
+
+/**
+ * @brief Power locks currently held, all kinds together.
+ */
+uint32_t ulSimPowerLocksHeld(void);
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Called for every level change on an output pin, at the virtual time
+ * it happened.
+ */
+typedef void (*SimGpioHook_t)(int lGpio, uint32_t ulLevel, uint64_t ullAtUs);
+
+void vSimGpioSetHook(SimGpioHook_t xHook);
+uint32_t ulSimGpioLevel(int lGpio);
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Called for every publish queued to the MQTT agent, with the copy
+ * the agent would send.
+ */
+typedef void (*SimPublishHook_t)(const char *pcTopic,
+                                 size_t xTopicLength,
+                                 const char *pcPayload,
+                                 size_t xPayloadLength);
+
+void vSimBrokerSetPublishHook(SimPublishHook_t xHook);
+
+/**
+ * @brief Bring the session up or down, calling the session callback as the
+ * agent task does. Without a session, publishes are refused.
+ */
+void vSimBrokerSetSession(bool xUp);
+
+/**
+ * @brief Hand a PUBLISH to the event callback registered with xMqttAgentRun,
+ * as MQTT_ProcessLoop would. The pended calls it leaves are not run.
+ *
+ * @return Host CPU time spent in the callback, in nanoseconds.
+ */
+uint64_t ullSimBrokerDeliver(const char *pcTopic, const char *pcPayload, size_t xPayloadLength);
+
+/**
+ * @brief Host CPU time in nanoseconds, for timing the code under test.
+ */
+uint64_t ullSimCpuNs(void);
+
+#endif /* ifndef _HOST_SIM_H_ */
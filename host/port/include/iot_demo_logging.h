@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _HOST_IOT_DEMO_LOGGING_H_
+#define _HOST_IOT_DEMO_LOGGING_H_
+
+/* Counted, and printed with shadow_bench -v. */
+void vSimLog(int lLevel, const char *pcFormat, ...) __attribute__((format(printf, 2, 3)));
+
+#define IotLogError(...)    vSimLog(1, __VA_ARGS__)
+#define IotLogWarn(...)     vSimLog(2, __VA_ARGS__)
+#define IotLogInfo(...)     vSimLog(3, __VA_ARGS__)
+#define IotLogDebug(...)    vSimLog(4, __VA_ARGS__)
+
+#endif /* ifndef _HOST_IOT_DEMO_LOGGING_H_ */
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _HOST_M5STICKC_H_
+#define _HOST_M5STICKC_H_
+
+/* The M5StickC BSP calls made by device.c; the display does nothing. */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_event.h"
+#include "driver/gpio.h"
+
+#define M5STICKC_LED_GPIO               GPIO_NUM_10
+#define M5STICKC_LED_DEFAULT_STATE      (1)
+#define M5STICKC_LED_ON                 (0)
+#define M5STICKC_LED_OFF                (1)
+
+#define M5STICKC_DISPLAY_WIDTH          (160)
+#define M5STICKC_DISPLAY_HEIGHT         (80)
+
+#define M5STICKC_BUTTON_A_EVENT_BASE    "m5stickc_button_a"
+#define M5STICKC_BUTTON_B_EVENT_BASE    "m5stickc_button_b"
+
+typedef struct
+{
+    struct
+    {
+        bool enable_lcd_backlight;
+        uint8_t lcd_backlight_level;
+    } power;
+} m5stickc_config_t;
+
+extern esp_event_loop_handle_t m5stickc_event_loop;
+
+esp_err_t M5StickCInit(m5stickc_config_t *config);
+esp_err_t M5StickCDisplayOn(void);
+esp_err_t M5StickCLedSet(uint8_t state);
+
+#define TFT_BLACK                       (0x0000U)
+#define TFT_ORANGE                      (0xFD20U)
+#define DEFAULT_GAMMA_CURVE             (0)
+#define LANDSCAPE_FLIP                  (3)
+#define DEFAULT_FONT                    (0)
+
+extern uint8_t TFT_FONT_ROTATE;
+extern uint8_t TFT_TEXT_WRAP;
+extern uint8_t TFT_FONT_TRANSPARENT;
+extern uint8_t TFT_FONT_FORCEFIXED;
+extern uint8_t TFT_GRAY_SCALE;
+extern uint16_t TFT_FONT_BACKGROUND;
+extern uint16_t TFT_FONT_FOREGROUND;
+
+#define TFT_setGammaCurve(curve)                 ((void) (curve))
+#define TFT_setRotation(rot)                     ((void) (rot))
+#define TFT_setFont(font, file)                  ((void) (font), (void) (file))
+#define TFT_resetclipwin()                       ((void) 0)
+#define TFT_fillScreen(color)                    ((void) (color))
+#define TFT_drawLine(x0, y0, x1, y1, color)      ((void) (x0), (void) (y0), (void) (x1), (void) (y1), (void) (color))
+#define TFT_print(str, x, y)                     ((void) (str), (void) (x), (void) (y))
+
+#endif /* ifndef _HOST_M5STICKC_H_ */
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _HOST_SHADOW_H_
+#define _HOST_SHADOW_H_
+
+/* The part of the AWS IoT Device Shadow library used by shadow_client.c. */
+
+#include <stdint.h>
+
+typedef enum ShadowStatus
+{
+    SHADOW_SUCCESS = 0,
+    SHADOW_FAIL,
+    SHADOW_BAD_PARAMETER
+} ShadowStatus_t;
+
+typedef enum ShadowMessageType
+{
+    ShadowMessageTypeGetAccepted = 0,
+    ShadowMessageTypeGetRejected,
+    ShadowMessageTypeDeleteAccepted,
+    ShadowMessageTypeDeleteRejected,
+    ShadowMessageTypeUpdateAccepted,
+    ShadowMessageTypeUpdateRejected,
+    ShadowMessageTypeUpdateDocuments,
+    ShadowMessageTypeUpdateDelta,
+    ShadowMessageTypeMaxNum
+} ShadowMessageType_t;
+
+#define SHADOW_PREFIX                  "$aws/things/"
+#define SHADOW_PREFIX_LENGTH           ((uint16_t) (sizeof(SHADOW_PREFIX) - 1U))
+
+#define SHADOW_TOPIC(thingName, sfx)   SHADOW_PREFIX thingName "/shadow" sfx
+#define SHADOW_TOPIC_LENGTH(len, sfx)  ((uint16_t) (SHADOW_PREFIX_LENGTH + (len) + sizeof("/shadow" sfx) - 1U))
+
+#define SHADOW_TOPIC_STRING_UPDATE(thingName)             SHADOW_TOPIC(thingName, "/update")
+#define SHADOW_TOPIC_STRING_UPDATE_ACCEPTED(thingName)    SHADOW_TOPIC(thingName, "/update/accepted")
+#define SHADOW_TOPIC_STRING_UPDATE_REJECTED(thingName)    SHADOW_TOPIC(thingName, "/update/rejected")
+#define SHADOW_TOPIC_STRING_UPDATE_DELTA(thingName)       SHADOW_TOPIC(thingName, "/update/delta")
+#define SHADOW_TOPIC_STRING_GET(thingName)                SHADOW_TOPIC(thingName, "/get")
+#define SHADOW_TOPIC_STRING_GET_ACCEPTED(thingName)       SHADOW_TOPIC(thingName, "/get/accepted")
+#define SHADOW_TOPIC_STRING_GET_REJECTED(thingName)       SHADOW_TOPIC(thingName, "/get/rejected")
+
+#define SHADOW_TOPIC_LENGTH_UPDATE(len)                   SHADOW_TOPIC_LENGTH(len, "/update")
+#define SHADOW_TOPIC_LENGTH_UPDATE_ACCEPTED(len)          SHADOW_TOPIC_LENGTH(len, "/update/accepted")
+#define SHADOW_TOPIC_LENGTH_UPDATE_REJECTED(len)          SHADOW_TOPIC_LENGTH(len, "/update/rejected")
+#define SHADOW_TOPIC_LENGTH_UPDATE_DELTA(len)             SHADOW_TOPIC_LENGTH(len, "/update/delta")
+#define SHADOW_TOPIC_LENGTH_GET(len)                      SHADOW_TOPIC_LENGTH(len, "/get")
+#define SHADOW_TOPIC_LENGTH_GET_ACCEPTED(len)             SHADOW_TOPIC_LENGTH(len, "/get/accepted")
+#define SHADOW_TOPIC_LENGTH_GET_REJECTED(len)             SHADOW_TOPIC_LENGTH(len, "/get/rejected")
+
+ShadowStatus_t Shadow_MatchTopic(const char *pTopic,
+                                 uint16_t topicLength,
+                                 ShadowMessageType_t *pMessageType,
+                                 const char **pThingName,
+                                 uint16_t *pThingNameLength);
+
+#endif /* ifndef _HOST_SHADOW_H_ */
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _HOST_TIMERS_H_
+#define _HOST_TIMERS_H_
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef struct SimTimer *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t xTimer);
+typedef void (*PendedFunction_t)(void *pvParameter1, uint32_t ulParameter2);
+
+typedef struct SimTimer
+{
+    const char *pcName;
+    TickType_t xPeriod;
+    UBaseType_t uxAutoReload;
+    void *pvTimerID;
+    TimerCallbackFunction_t pxCallback;
+    bool xActive;
+    uint64_t ullExpiryUs;
+    struct SimTimer *pxNext;
+} StaticTimer_t;
+
+TimerHandle_t xTimerCreate(const char *pcTimerName,
+                           TickType_t xTimerPeriod,
+                           UBaseType_t uxAutoReload,
+                           void *pvTimerID,
+                           TimerCallbackFunction_t pxCallbackFunction);
+
+TimerHandle_t xTimerCreateStatic(const char *pcTimerName,
+                                 TickType_t xTimerPeriod,
+                                 UBaseType_t uxAutoReload,
+                                 void *pvTimerID,
+                                 TimerCallbackFunction_t pxCallbackFunction,
+                                 StaticTimer_t *pxTimerBuffer);
+
+BaseType_t xTimerStart(TimerHandle_t xTimer, TickType_t xTicksToWait);
+BaseType_t xTimerStop(TimerHandle_t xTimer, TickType_t xTicksToWait);
+BaseType_t xTimerReset(TimerHandle_t xTimer, TickType_t xTicksToWait);
+BaseType_t xTimerChangePeriod(TimerHandle_t xTimer, TickType_t xNewPeriod, TickType_t xTicksToWait);
+BaseType_t xTimerIsTimerActive(TimerHandle_t xTimer);
+void *pvTimerGetTimerID(TimerHandle_t xTimer);
+TaskHandle_t xTimerGetTimerDaemonTaskHandle(void);
+
+BaseType_t xTimerPendFunctionCall(PendedFunction_t xFunctionToPend,
+                                  void *pvParameter1,
+                                  uint32_t ulParameter2,
+                                  TickType_t xTicksToWait);
+
+BaseType_t xTimerPendFunctionCallFromISR(PendedFunction_t xFunctionToPend,
+                                         void *pvParameter1,
+                                         uint32_t ulParameter2,
+                                         BaseType_t *pxHigherPriorityTaskWoken);
+
+#endif /* ifndef _HOST_TIMERS_H_ */
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Mock transport: stands in for mqtt_agent.c and the broker behind it.
+ * Publishes are handed to the benchmark instead of a socket, and incoming
+ * PUBLISH packets are fed to the event callback directly.
+ */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+
+#include "shadow.h"
+#include "mqtt_demo_helpers.h"
+
+#include "app_config.h"
+#include "mqtt_agent.h"
+
+#include "host_sim.h"
+
+/*-----------------------------------------------------------*/
+
+static MQTTEventCallback_t xEventCallback = NULL;
+static MqttAgentSessionCallback_t xSessionCallback = NULL;
+static SimPublishHook_t xPublishHook = NULL;
+static bool xSessionUp = false;
+static bool xSyncPending = false;
+
+/*-----------------------------------------------------------*/
+
+static void prvSend(const char *pcTopic, uint16_t usTopicLength, const char *pcPayload, size_t xPayloadLength) {
+    xSimCounters.ullPublishes++;
+    xSimCounters.ullPublishedBytes += xPayloadLength;
+
+    if (xPublishHook != NULL) {
+        xPublishHook(pcTopic, usTopicLength, pcPayload, xPayloadLength);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xMqttAgentInit(void) {
+    return pdPASS;
+}
+
+BaseType_t xMqttAgentRun(MQTTEventCallback_t xCallback) {
+    /* Unlike the real agent this returns; the benchmark plays the loop. */
+    xEventCallback = xCallback;
+
+    return pdPASS;
+}
+
+void vMqttAgentSetNetworkState(bool xConnected) {
+    (void) xConnected;
+}
+
+void vMqttAgentSetSessionCallback(MqttAgentSessionCallback_t xCallback) {
+    xSessionCallback = xCallback;
+}
+
+void vMqttAgentRequestSync(void) {
+    xSyncPending = xSessionUp;
+}
+
+bool xMqttAgentIsConnected(void) {
+    return xSessionUp;
+}
+
+MqttAgentStatus_t eMqttAgentPublish(const char *pcTopic,
+                                    uint16_t usTopicLength,
+                                    const char *pcPayload,
+                                    size_t xPayloadLength,
+                                    TickType_t xTicksToWait) {
+    return eMqttAgentPublishNotify(pcTopic, usTopicLength, pcPayload, xPayloadLength, xTicksToWait, NULL);
+}
+
+MqttAgentStatus_t eMqttAgentPublishNotify(const char *pcTopic,
+                                          uint16_t usTopicLength,
+                                          const char *pcPayload,
+                                          size_t xPayloadLength,
+                                          TickType_t xTicksToWait,
+                                          MqttAgentCompletion_t *pxCompletion) {
+    MqttAgentStatus_t eStatus = MqttAgentSuccess;
+
+    (void) xTicksToWait;
+
+    if ((pcTopic == NULL) || (pcPayload == NULL) || (xPayloadLength > appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH)) {
+        eStatus = MqttAgentBadParameter;
+    } else if (!xSessionUp) {
+        /* The agent sends from its queue; the queue never fills here. */
+        eStatus = MqttAgentDisconnected;
+    } else {
+        prvSend(pcTopic, usTopicLength, pcPayload, xPayloadLength);
+    }
+
+    /* The broker acknowledges every publish at once. */
+    if (pxCompletion != NULL) {
+        pxCompletion->eStatus = eStatus;
+
+        if ((eStatus == MqttAgentSuccess) && (pxCompletion->xNotifyTask != NULL)) {
+            (void) xTaskNotify(pxCompletion->xNotifyTask, pxCompletion->ulNotifyBits, eSetBits);
+        }
+    }
+
+    return eStatus;
+}
+
+MqttAgentStatus_t eMqttAgentSubscribe(const char *pcTopicFilter,
+                                      uint16_t usTopicFilterLength,
+                                      TickType_t xTicksToWait) {
+    (void) usTopicFilterLength;
+    (void) xTicksToWait;
+
+    return (pcTopicFilter != NULL) ? MqttAgentSuccess : MqttAgentBadParameter;
+}
+
+void vHandleOtherIncomingPacket(MQTTPacketInfo_t *pxPacketInfo,
+                                uint16_t usPacketIdentifier) {
+    (void) pxPacketInfo;
+    (void) usPacketIdentifier;
+}
+
+/*-----------------------------------------------------------*/
+
+ShadowStatus_t Shadow_MatchTopic(const char *pTopic,
+                                 uint16_t topicLength,
+                                 ShadowMessageType_t *pMessageType,
+                                 const char **pThingName,
+                                 uint16_t *pThingNameLength) {
+    static const struct
+    {
+        const char *pcSuffix;
+        ShadowMessageType_t eType;
+    } xSuffixes[] = {
+        { "/shadow/get/accepted",    ShadowMessageTypeGetAccepted    },
+        { "/shadow/get/rejected",    ShadowMessageTypeGetRejected    },
+        { "/shadow/delete/accepted", ShadowMessageTypeDeleteAccepted },
+        { "/shadow/delete/rejected", ShadowMessageTypeDeleteRejected },
+        { "/shadow/update/accepted", ShadowMessageTypeUpdateAccepted },
+        { "/shadow/update/rejected", ShadowMessageTypeUpdateRejected },
+        { "/shadow/update/documents", ShadowMessageTypeUpdateDocuments },
+        { "/shadow/update/delta",    ShadowMessageTypeUpdateDelta    }
+    };
+    size_t i;
+
+    if ((pTopic == NULL) || (topicLength <= SHADOW_PREFIX_LENGTH) ||
+        (strncmp(pTopic, SHADOW_PREFIX, SHADOW_PREFIX_LENGTH) != 0)) {
+        return SHADOW_FAIL;
+    }
+
+    for (i = 0; i < (sizeof(xSuffixes) / sizeof(xSuffixes[0])); i++) {
+        size_t xSuffixLength = strlen(xSuffixes[i].pcSuffix);
+
+        if ((topicLength > (SHADOW_PREFIX_LENGTH + xSuffixLength)) &&
+            (memcmp(&pTopic[topicLength - xSuffixLength], xSuffixes[i].pcSuffix, xSuffixLength) == 0)) {
+            *pMessageType = xSuffixes[i].eType;
+            *pThingName = &pTopic[SHADOW_PREFIX_LENGTH];
+            *pThingNameLength = (uint16_t) (topicLength - SHADOW_PREFIX_LENGTH - xSuffixLength);
+            return SHADOW_SUCCESS;
+        }
+    }
+
+    return SHADOW_FAIL;
+}
+
+/*-----------------------------------------------------------*/
+
+void vSimBrokerSetPublishHook(SimPublishHook_t xHook) {
+    xPublishHook = xHook;
+}
+
+void vSimBrokerSetSession(bool xUp) {
+    uint32_t ulPasses;
+
+    if (xUp == xSessionUp) {
+        return;
+    }
+
+    xSessionUp = xUp;
+    xSyncPending = xUp;
+
+    if (xSessionCallback == NULL) {
+        return;
+    }
+
+    if (!xUp) {
+        (void) xSessionCallback(false);
+        return;
+    }
+
+    /* The agent calls again on later passes until the callback is done. */
+    for (ulPasses = 0U; xSyncPending && (ulPasses < 8U); ulPasses++) {
+        xSyncPending = false;
+
+        if (!xSessionCallback(true)) {
+            xSyncPending = true;
+        }
+    }
+
+    configASSERT(!xSyncPending);
+}
+
+uint64_t ullSimBrokerDeliver(const char *pcTopic, const char *pcPayload, size_t xPayloadLength) {
+    MQTTContext_t xContext = { 0 };
+    MQTTPacketInfo_t xPacketInfo = { 0 };
+    MQTTPublishInfo_t xPublishInfo = { 0 };
+    MQTTDeserializedInfo_t xDeserialized = { 0 };
+    uint64_t ullStartNs;
+
+    configASSERT(xEventCallback != NULL);
+
+    xPacketInfo.type = MQTT_PACKET_TYPE_PUBLISH | 0x02U;
+    xPublishInfo.qos = MQTTQoS1;
+    xPublishInfo.pTopicName = pcTopic;
+    xPublishInfo.topicNameLength = (uint16_t) strlen(pcTopic);
+    xPublishInfo.pPayload = pcPayload;
+    xPublishInfo.payloadLength = xPayloadLength;
+    xDeserialized.packetIdentifier = 1U;
+    xDeserialized.pPublishInfo = &xPublishInfo;
+
+    ullStartNs = ullSimCpuNs();
+    xEventCallback(&xContext, &xPacketInfo, &xDeserialized);
+
+    return ullSimCpuNs() - ullStartNs;
+}
@@ -0,0 +1,650 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Application level configuration. Every value can be overridden from the
+ * compiler command line. */
+
+#ifndef _APP_CONFIG_H_
+#define _APP_CONFIG_H_
+
+/*-----------------------------------------------------------*/
+/*----                   RTOS objects                    ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Lay out the TCBs, stacks, queues, semaphores, event groups and
+ * timers of the application at link time (see app_rtos.h) instead of taking
+ * them from the heap. Needs CONFIG_SUPPORT_STATIC_ALLOCATION.
+ */
+#ifndef appconfigSTATIC_ALLOCATION
+#define appconfigSTATIC_ALLOCATION                  (1)
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   Logging                         ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Compile-time levels for modules using app_log.h: 0 none, 1 error,
+ * 2 warning, 3 info, 4 debug. The MQTT callback path logs warnings and
+ * errors only, so that no formatting or UART output delays an unlock.
+ */
+#ifndef appconfigLOG_LEVEL_DEFAULT
+#define appconfigLOG_LEVEL_DEFAULT                  (3)
+#endif
+
+#ifndef appconfigLOG_LEVEL_SHADOW
+#define appconfigLOG_LEVEL_SHADOW                   (2)
+#endif
+
+#ifndef appconfigLOG_LEVEL_MQTT_AGENT
+#define appconfigLOG_LEVEL_MQTT_AGENT               (2)
+#endif
+
+/**
+ * @brief Log records waiting for the log task.
+ */
+#ifndef appconfigLOG_QUEUE_LENGTH
+#define appconfigLOG_QUEUE_LENGTH                   (32U)
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   Boot                            ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The task profiler, OTA client and latency metrics start once the
+ * first MQTT session is up, or after this long without one.
+ */
+#ifndef appconfigBOOT_DEFERRED_INIT_TIMEOUT_MS
+#define appconfigBOOT_DEFERRED_INIT_TIMEOUT_MS      (15000U)
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   Power                           ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Low-power operation: frequency scaling and automatic light sleep
+ * (needs CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE), Wi-Fi modem
+ * sleep and a longer MQTT keep-alive. Set to 0 to run at full speed.
+ */
+#ifndef appconfigPOWER_SAVE
+#define appconfigPOWER_SAVE                         (1)
+#endif
+
+/**
+ * @brief CPU frequency range for frequency scaling. The minimum is the
+ * 40 MHz crystal; the maximum is only used while a PowerLockCpuMax is held.
+ */
+#ifndef appconfigPOWER_MAX_CPU_FREQ_MHZ
+#define appconfigPOWER_MAX_CPU_FREQ_MHZ             (160)
+#endif
+
+#ifndef appconfigPOWER_MIN_CPU_FREQ_MHZ
+#define appconfigPOWER_MIN_CPU_FREQ_MHZ             (40)
+#endif
+
+/**
+ * @brief Battery sampling periods: fast while charging, low or changing,
+ * slow while the voltage is stable.
+ */
+#ifndef appconfigPOWER_MONITOR_FAST_PERIOD_MS
+#define appconfigPOWER_MONITOR_FAST_PERIOD_MS       (5000U)
+#endif
+
+#ifndef appconfigPOWER_MONITOR_SLOW_PERIOD_MS
+#define appconfigPOWER_MONITOR_SLOW_PERIOD_MS       (60000U)
+#endif
+
+#ifndef appconfigPOWER_MONITOR_LOW_PERCENT
+#define appconfigPOWER_MONITOR_LOW_PERCENT          (20U)
+#endif
+
+/**
+ * @brief Voltage change that triggers a new reported-shadow update.
+ */
+#ifndef appconfigPOWER_MONITOR_REPORT_HYSTERESIS_MV
+#define appconfigPOWER_MONITOR_REPORT_HYSTERESIS_MV (50U)
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   Network                         ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Associate straight to the access point of the last good connection,
+ * skipping the scan, and fall back to a full scan if that fails. The BSSID
+ * and channel are kept in NVS. The DHCP lease is reused through
+ * CONFIG_LWIP_DHCP_RESTORE_LAST_IP in sdkconfig.
+ */
+#ifndef appconfigWIFI_FAST_CONNECT
+#define appconfigWIFI_FAST_CONNECT                  (1)
+#endif
+
+/**
+ * @brief Static IPv4 configuration in dotted notation. Leave the address
+ * empty to use DHCP.
+ */
+#ifndef appconfigWIFI_STATIC_IP
+#define appconfigWIFI_STATIC_IP                     ""
+#endif
+
+#ifndef appconfigWIFI_STATIC_NETMASK
+#define appconfigWIFI_STATIC_NETMASK                "255.255.255.0"
+#endif
+
+#ifndef appconfigWIFI_STATIC_GATEWAY
+#define appconfigWIFI_STATIC_GATEWAY                ""
+#endif
+
+#ifndef appconfigWIFI_STATIC_DNS
+#define appconfigWIFI_STATIC_DNS                    ""
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   MQTT agent                      ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The coreMQTT network buffer. One buffer serves both directions, but
+ * outgoing packets only serialise their header and topic into it: publish
+ * payloads are sent straight from the agent command. Its size is therefore
+ * set by the largest packet received, the whole document in /get/accepted:
+ * about 600 bytes including the topic and metadata for one compartment and
+ * about 110 more for every further one, with room for a few extra desired
+ * fields from the app backend. A larger packet fails the process loop and
+ * drops the session.
+ *
+ * The TLS records and the Wi-Fi buffers below it are sized in sdkconfig:
+ * CONFIG_MBEDTLS_SSL_IN_CONTENT_LEN / OUT_CONTENT_LEN and the
+ * CONFIG_ESP32_WIFI_*_BUFFER_NUM options.
+ */
+#ifndef appconfigMQTT_NETWORK_BUFFER_SIZE
+#define appconfigMQTT_NETWORK_BUFFER_SIZE           (896U + (128U * appconfigLOCK_COUNT))
+#endif
+
+/**
+ * @brief Number of publish/subscribe commands that can wait for the MQTT agent.
+ */
+#ifndef appconfigMQTT_AGENT_QUEUE_LENGTH
+#define appconfigMQTT_AGENT_QUEUE_LENGTH            (8U)
+#endif
+
+/**
+ * @brief Largest payload that can be queued to the MQTT agent. Payloads are
+ * copied into the command so the caller can reuse its buffer immediately.
+ */
+#ifndef appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH
+#define appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH      (256U)
+#endif
+
+/**
+ * @brief Time MQTT_ProcessLoop may spend receiving before the agent drains
+ * its command queue again. This bounds how long a queued command waits.
+ */
+#ifndef appconfigMQTT_AGENT_PROCESS_LOOP_TIMEOUT_MS
+#define appconfigMQTT_AGENT_PROCESS_LOOP_TIMEOUT_MS (100U)
+#endif
+
+/**
+ * @brief Number of QoS1 publishes that may wait for their PUBACK at once.
+ * Further publishes stay queued until a slot frees up.
+ */
+#ifndef appconfigMQTT_AGENT_MAX_INFLIGHT_PUBLISHES
+#define appconfigMQTT_AGENT_MAX_INFLIGHT_PUBLISHES  (4U)
+#endif
+
+/**
+ * @brief Time after which an unacknowledged publish is reported as lost.
+ */
+#ifndef appconfigMQTT_AGENT_PUBACK_TIMEOUT_MS
+#define appconfigMQTT_AGENT_PUBACK_TIMEOUT_MS       (5000U)
+#endif
+
+/**
+ * @brief Number of topic filters restored after a reconnect: five shadow
+ * topics, the profiler and OTA.
+ */
+#ifndef appconfigMQTT_AGENT_MAX_SUBSCRIPTIONS
+#define appconfigMQTT_AGENT_MAX_SUBSCRIPTIONS       (7U)
+#endif
+
+/**
+ * @brief Reconnect backoff. Each wait is a random value up to base * 2^attempt,
+ * capped at the maximum (at most 65535 ms, the backoff library uses 16 bits).
+ */
+#ifndef appconfigMQTT_RECONNECT_BACKOFF_BASE_MS
+#define appconfigMQTT_RECONNECT_BACKOFF_BASE_MS     (500U)
+#endif
+
+#ifndef appconfigMQTT_RECONNECT_MAX_BACKOFF_MS
+#define appconfigMQTT_RECONNECT_MAX_BACKOFF_MS      (30000U)
+#endif
+
+/**
+ * @brief Connect with cleanSession=false so the broker keeps subscriptions
+ * and queued QoS1 deltas across reconnects. Set to 0 for a clean session.
+ */
+#ifndef appconfigMQTT_PERSISTENT_SESSION
+#define appconfigMQTT_PERSISTENT_SESSION            (1)
+#endif
+
+/**
+ * @brief Every keep-alive wakes the radio out of modem sleep, so the power
+ * save mode pings less often. AWS IoT accepts up to 1200 s.
+ */
+#ifndef appconfigMQTT_KEEP_ALIVE_INTERVAL_S
+#if appconfigPOWER_SAVE
+#define appconfigMQTT_KEEP_ALIVE_INTERVAL_S         (300U)
+#else
+#define appconfigMQTT_KEEP_ALIVE_INTERVAL_S         (60U)
+#endif
+#endif
+
+#ifndef appconfigMQTT_CONNACK_RECV_TIMEOUT_MS
+#define appconfigMQTT_CONNACK_RECV_TIMEOUT_MS       (2000U)
+#endif
+
+/**
+ * @brief Socket timeouts. The receive timeout bounds how long one receive in
+ * MQTT_ProcessLoop blocks while the agent has commands waiting.
+ */
+#ifndef appconfigMQTT_TRANSPORT_SEND_TIMEOUT_MS
+#define appconfigMQTT_TRANSPORT_SEND_TIMEOUT_MS     (500U)
+#endif
+
+#ifndef appconfigMQTT_TRANSPORT_RECV_TIMEOUT_MS
+#define appconfigMQTT_TRANSPORT_RECV_TIMEOUT_MS     (50U)
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   Shadow                          ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Shadow updates whose accepted/rejected response is being waited for.
+ */
+#ifndef appconfigSHADOW_MAX_PENDING_REQUESTS
+#define appconfigSHADOW_MAX_PENDING_REQUESTS        (4U)
+#endif
+
+#ifndef appconfigSHADOW_RESPONSE_TIMEOUT_MS
+#define appconfigSHADOW_RESPONSE_TIMEOUT_MS         (10000U)
+#endif
+
+/**
+ * @brief Deltas arriving within this window after one that was acted on are
+ * folded into a single actuator command and report at the end of the window.
+ */
+#ifndef appconfigSHADOW_DELTA_COALESCE_MS
+#define appconfigSHADOW_DELTA_COALESCE_MS           (250U)
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   Lock                            ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Number of compartments in the box, up to LOCK_STATE_MAX_COUNT.
+ * appconfigLOCK_GPIOS and appconfigLOCK_SENSOR_GPIOS need one entry each.
+ */
+#ifndef appconfigLOCK_COUNT
+#define appconfigLOCK_COUNT                         (1U)
+#endif
+
+/**
+ * @brief Actuator GPIO of every compartment, in shadow "locks" order.
+ */
+#ifndef appconfigLOCK_GPIOS
+#define appconfigLOCK_GPIOS                         { M5STICKC_LOCK_GPIO }
+#endif
+
+/**
+ * @brief How long a compartment stays open before it is closed again.
+ */
+#ifndef appconfigLOCK_OPEN_HOLD_MS
+#define appconfigLOCK_OPEN_HOLD_MS                  (5000U)
+#endif
+
+/**
+ * @brief GPIO of the optional bolt position sensor of every compartment
+ * (high = open), or -1 where there is none. Without a sensor a compartment is
+ * considered open/closed as soon as its actuator has been driven.
+ */
+#ifndef appconfigLOCK_SENSOR_GPIOS
+#define appconfigLOCK_SENSOR_GPIOS                  { -1 }
+#endif
+
+/**
+ * @brief How long after the first edge of a bolt sensor its level is taken.
+ * Edges in between are contact bounce and ignored.
+ */
+#ifndef appconfigLOCK_SENSOR_DEBOUNCE_MS
+#define appconfigLOCK_SENSOR_DEBOUNCE_MS            (20U)
+#endif
+
+/**
+ * @brief How long a bolt may take to reach the driven position before the
+ * sensor is believed instead.
+ */
+#ifndef appconfigLOCK_SENSOR_TIMEOUT_MS
+#define appconfigLOCK_SENSOR_TIMEOUT_MS             (1000U)
+#endif
+
+/**
+ * @brief Longest wait for the lock table, or for room in the timer queue,
+ * before a transition is deferred or refused.
+ */
+#ifndef appconfigLOCK_STATE_WAIT_MS
+#define appconfigLOCK_STATE_WAIT_MS                 (10U)
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   Report journal                  ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Lock reports collected in RAM before they are written to flash as
+ * one NVS blob.
+ */
+#ifndef appconfigJOURNAL_BATCH_ENTRIES
+#define appconfigJOURNAL_BATCH_ENTRIES              (8U)
+#endif
+
+/**
+ * @brief Blobs kept in the storage partition. When all are used the oldest
+ * batch is overwritten.
+ */
+#ifndef appconfigJOURNAL_MAX_BATCHES
+#define appconfigJOURNAL_MAX_BATCHES                (4U)
+#endif
+
+/**
+ * @brief How long a partly filled batch may stay in RAM only.
+ */
+#ifndef appconfigJOURNAL_FLUSH_MS
+#define appconfigJOURNAL_FLUSH_MS                   (30000U)
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   OTA                             ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Bytes of the update stream per data message. A block, its topic
+ * and the 4-byte offset must fit #appconfigMQTT_NETWORK_BUFFER_SIZE.
+ */
+#ifndef appconfigOTA_BLOCK_SIZE
+#define appconfigOTA_BLOCK_SIZE                     (512U)
+#endif
+
+/**
+ * @brief Blocks asked for per request, and buffered between the MQTT task
+ * and the OTA task.
+ */
+#ifndef appconfigOTA_WINDOW_BLOCKS
+#define appconfigOTA_WINDOW_BLOCKS                  (4U)
+#endif
+
+/**
+ * @brief A window not complete after this long is asked for again from the
+ * first missing block. After #appconfigOTA_MAX_RETRIES of these in a row the
+ * transfer pauses until the next offer.
+ */
+#ifndef appconfigOTA_BLOCK_TIMEOUT_MS
+#define appconfigOTA_BLOCK_TIMEOUT_MS               (5000U)
+#endif
+
+#ifndef appconfigOTA_MAX_RETRIES
+#define appconfigOTA_MAX_RETRIES                    (10U)
+#endif
+
+/**
+ * @brief How often the progress is saved to NVS, in bytes written to the
+ * update slot. An interrupted transfer resumes from the last save, so this
+ * is also the most that is downloaded twice. A multiple of the 4 KiB sector.
+ */
+#ifndef appconfigOTA_CHECKPOINT_BYTES
+#define appconfigOTA_CHECKPOINT_BYTES               (32768U)
+#endif
+
+/**
+ * @brief A new image that has not reached the broker this long after boot is
+ * marked invalid, and the previous image is booted again.
+ */
+#ifndef appconfigOTA_VERIFY_TIMEOUT_MS
+#define appconfigOTA_VERIFY_TIMEOUT_MS              (120000U)
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   Flash writer                    ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Flash writes that can wait for the flash writer task: journal
+ * batches, the shadow version cache and the Wi-Fi reset.
+ */
+#ifndef appconfigFLASH_WRITER_QUEUE_LENGTH
+#define appconfigFLASH_WRITER_QUEUE_LENGTH          (8U)
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   Buttons                         ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Compartments a click on the main button opens, as a mask in shadow
+ * "locks" order; 0 disables the local unlock.
+ */
+#ifndef appconfigBUTTON_UNLOCK_MASK
+#define appconfigBUTTON_UNLOCK_MASK                 (0x01U)
+#endif
+
+/**
+ * @brief Events of the same button closer together than this are dropped.
+ */
+#ifndef appconfigBUTTON_DEBOUNCE_MS
+#define appconfigBUTTON_DEBOUNCE_MS                 (250U)
+#endif
+
+/**
+ * @brief Delay between a click on the reset button, or a hold that forgets
+ * the Wi-Fi networks, and the restart.
+ */
+#ifndef appconfigBUTTON_RESTART_DELAY_MS
+#define appconfigBUTTON_RESTART_DELAY_MS            (2000U)
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   I2C bus                         ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Port of the internal bus (SDA 21, SCL 22) shared by the MPU6886 and
+ * the AXP192. Must be the port the BSP installed the I2C driver on.
+ */
+#ifndef appconfigI2C_BUS_PORT
+#define appconfigI2C_BUS_PORT                       (0)
+#endif
+
+/**
+ * @brief Longest wait for the bus, and for one transaction on it. A 14 byte
+ * burst at 400 kHz takes about 0.5 ms.
+ */
+#ifndef appconfigI2C_BUS_LOCK_TIMEOUT_MS
+#define appconfigI2C_BUS_LOCK_TIMEOUT_MS            (20U)
+#endif
+
+#ifndef appconfigI2C_BUS_TIMEOUT_MS
+#define appconfigI2C_BUS_TIMEOUT_MS                 (10U)
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   IMU                             ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief MPU6886 output data rate, derived from its 1 kHz internal rate.
+ */
+#ifndef appconfigIMU_SAMPLE_RATE_HZ
+#define appconfigIMU_SAMPLE_RATE_HZ                 (100U)
+#endif
+
+/**
+ * @brief Interrupt line of the MPU6886: data-ready, and wake-on-motion with
+ * #appconfigPOWER_SAVE.
+ */
+#ifndef appconfigIMU_INT_GPIO
+#define appconfigIMU_INT_GPIO                       (35)
+#endif
+
+/**
+ * @brief Samples buffered between the sampling and telemetry tasks. Must be
+ * a power of two.
+ */
+#ifndef appconfigIMU_RING_LENGTH
+#define appconfigIMU_RING_LENGTH                    (64U)
+#endif
+
+/**
+ * @brief How often the telemetry task drains the ring and runs the tamper
+ * detector. This is the bulk of the alarm latency.
+ */
+#ifndef appconfigIMU_BATCH_PERIOD_MS
+#define appconfigIMU_BATCH_PERIOD_MS                (50U)
+#endif
+
+#ifndef appconfigIMU_SUMMARY_PERIOD_MS
+#define appconfigIMU_SUMMARY_PERIOD_MS              (60000U)
+#endif
+
+/**
+ * @brief With #appconfigPOWER_SAVE, the change of acceleration between two
+ * samples that raises the MPU6886 wake-on-motion interrupt, in 4 mg steps up
+ * to 1020 mg. Only this interrupt wakes the chip while the box is still.
+ */
+#ifndef appconfigIMU_WAKE_THRESHOLD_MG
+#define appconfigIMU_WAKE_THRESHOLD_MG              (60U)
+#endif
+
+/**
+ * @brief With #appconfigPOWER_SAVE, how long sampling goes on after the last
+ * wake-on-motion event before only that interrupt is left enabled.
+ */
+#ifndef appconfigIMU_MOTION_HOLD_MS
+#define appconfigIMU_MOTION_HOLD_MS                 (15000U)
+#endif
+
+/**
+ * @brief Minimum time between two published tamper events. Events detected
+ * meanwhile are merged into the next one.
+ */
+#ifndef appconfigIMU_EVENT_HOLDOFF_MS
+#define appconfigIMU_EVENT_HOLDOFF_MS               (5000U)
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   Tamper detection                ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Samples the vibration RMS is computed over.
+ */
+#ifndef appconfigTAMPER_WINDOW_SAMPLES
+#define appconfigTAMPER_WINDOW_SAMPLES              (32U)
+#endif
+
+#ifndef appconfigTAMPER_VIBRATION_RMS_MG
+#define appconfigTAMPER_VIBRATION_RMS_MG            (250U)
+#endif
+
+/**
+ * @brief Change of acceleration between two samples that counts as a shock.
+ * 100 g/s is 1 g within 10 ms.
+ */
+#ifndef appconfigTAMPER_SHOCK_JERK_G_PER_S
+#define appconfigTAMPER_SHOCK_JERK_G_PER_S          (100U)
+#endif
+
+/**
+ * @brief Rotation away from the resting orientation that counts as a tilt.
+ */
+#ifndef appconfigTAMPER_TILT_DEG
+#define appconfigTAMPER_TILT_DEG                    (20U)
+#endif
+
+/**
+ * @brief After being this still for this long, the current orientation
+ * becomes the new resting orientation.
+ */
+#ifndef appconfigTAMPER_STILL_RMS_MG
+#define appconfigTAMPER_STILL_RMS_MG                (30U)
+#endif
+
+#ifndef appconfigTAMPER_REBASE_MS
+#define appconfigTAMPER_REBASE_MS                   (10000U)
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   Latency probes                  ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Record the hot-path latency histograms (see latency_probe.h).
+ * With 0 the probes compile to nothing.
+ */
+#ifndef appconfigLATENCY_PROBES
+#define appconfigLATENCY_PROBES                     (1)
+#endif
+
+/**
+ * @brief How often the percentiles are published on the metrics topic. The
+ * histograms start over after every publication.
+ */
+#ifndef appconfigLATENCY_PUBLISH_PERIOD_MS
+#define appconfigLATENCY_PUBLISH_PERIOD_MS          (60000U)
+#endif
+
+/**
+ * @brief Longest acceptable unlock span, from a delta reaching the shadow
+ * client to the actuator being driven. A delta folded into the coalescing
+ * window waits for the window, so the budget covers it plus the path
+ * itself. Unlocks over budget are counted and published with the span.
+ */
+#ifndef appconfigLATENCY_UNLOCK_BUDGET_MS
+#define appconfigLATENCY_UNLOCK_BUDGET_MS           (appconfigSHADOW_DELTA_COALESCE_MS + 20U)
+#endif
+
+/*-----------------------------------------------------------*/
+/*----                   Task profiler                   ----*/
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Window over which a profile request measures the CPU share of
+ * every task.
+ */
+#ifndef appconfigPROFILER_WINDOW_MS
+#define appconfigPROFILER_WINDOW_MS                 (2000U)
+#endif
+
+#endif /* ifndef _APP_CONFIG_H_ */
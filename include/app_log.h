@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _APP_LOG_H_
+#define _APP_LOG_H_
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#include "app_config.h"
+
+/*
+ * Logging for the hot paths, with a compile-time level per module and
+ * formatting deferred to a low priority task. A module selects its name and
+ * level before including this header:
+ *
+ *     #define APP_LOG_MODULE    "shadow"
+ *     #define APP_LOG_LEVEL     appconfigLOG_LEVEL_SHADOW
+ *     #include "app_log.h"
+ *
+ *     AppLogInfo("Shadow update %u accepted after %u ms.", ulToken, ulMs);
+ *
+ * Calls below the module level compile to nothing (their arguments are still
+ * type checked). The others only copy the
+ * format pointer and up to four 32-bit arguments into the log queue; the log
+ * task formats and prints them later. So the format must be a string literal,
+ * and every argument an integer or a pointer to a string that outlives the
+ * call (a literal or a constant topic). Floating point and 64-bit values are
+ * not supported. When the queue is full the record is dropped and counted.
+ */
+
+#define APP_LOG_LEVEL_NONE     (0)
+#define APP_LOG_LEVEL_ERROR    (1)
+#define APP_LOG_LEVEL_WARN     (2)
+#define APP_LOG_LEVEL_INFO     (3)
+#define APP_LOG_LEVEL_DEBUG    (4)
+
+#ifndef APP_LOG_MODULE
+#define APP_LOG_MODULE         "app"
+#endif
+
+#ifndef APP_LOG_LEVEL
+#define APP_LOG_LEVEL          appconfigLOG_LEVEL_DEFAULT
+#endif
+
+/**
+ * @brief Start the log task. Records written before go straight to the
+ * AFR logging task.
+ */
+BaseType_t xAppLogInit(void);
+
+/**
+ * @brief Queue one record. Use the AppLog* macros instead. Safe from tasks
+ * and interrupts.
+ */
+void vAppLogRecord(uint8_t ucLevel,
+                   const char *pcModule,
+                   const char *pcFormat,
+                   uint32_t ulArg0,
+                   uint32_t ulArg1,
+                   uint32_t ulArg2,
+                   uint32_t ulArg3);
+
+/**
+ * @brief Records dropped since boot because the log queue was full.
+ */
+uint32_t ulAppLogGetDropped(void);
+
+/*-----------------------------------------------------------*/
+
+#define APP_LOG_ARG(xArg)    ((uint32_t) (uintptr_t) (xArg))
+
+#define APP_LOG_0(ucLevel, pcFormat) \
+    vAppLogRecord(ucLevel, APP_LOG_MODULE, pcFormat, 0U, 0U, 0U, 0U)
+#define APP_LOG_1(ucLevel, pcFormat, a0) \
+    vAppLogRecord(ucLevel, APP_LOG_MODULE, pcFormat, APP_LOG_ARG(a0), 0U, 0U, 0U)
+#define APP_LOG_2(ucLevel, pcFormat, a0, a1) \
+    vAppLogRecord(ucLevel, APP_LOG_MODULE, pcFormat, APP_LOG_ARG(a0), APP_LOG_ARG(a1), 0U, 0U)
+#define APP_LOG_3(ucLevel, pcFormat, a0, a1, a2) \
+    vAppLogRecord(ucLevel, APP_LOG_MODULE, pcFormat, APP_LOG_ARG(a0), APP_LOG_ARG(a1), APP_LOG_ARG(a2), 0U)
+#define APP_LOG_4(ucLevel, pcFormat, a0, a1, a2, a3) \
+    vAppLogRecord(ucLevel, APP_LOG_MODULE, pcFormat, APP_LOG_ARG(a0), APP_LOG_ARG(a1), APP_LOG_ARG(a2), APP_LOG_ARG(a3))
+
+#define APP_LOG_SELECT(_0, _1, _2, _3, _4, xName, ...)    xName
+
+#define APP_LOG(ucLevel, pcFormat, ...) \
+    APP_LOG_SELECT(_0, ##__VA_ARGS__, APP_LOG_4, APP_LOG_3, APP_LOG_2, APP_LOG_1, APP_LOG_0)(ucLevel, pcFormat, ##__VA_ARGS__)
+
+#if (APP_LOG_LEVEL >= APP_LOG_LEVEL_ERROR)
+#define AppLogError(...)   APP_LOG(APP_LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define AppLogError(...)   do { if (0) { APP_LOG(APP_LOG_LEVEL_ERROR, __VA_ARGS__); } } while (0)
+#endif
+
+#if (APP_LOG_LEVEL >= APP_LOG_LEVEL_WARN)
+#define AppLogWarn(...)    APP_LOG(APP_LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define AppLogWarn(...)    do { if (0) { APP_LOG(APP_LOG_LEVEL_WARN, __VA_ARGS__); } } while (0)
+#endif
+
+#if (APP_LOG_LEVEL >= APP_LOG_LEVEL_INFO)
+#define AppLogInfo(...)    APP_LOG(APP_LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define AppLogInfo(...)    do { if (0) { APP_LOG(APP_LOG_LEVEL_INFO, __VA_ARGS__); } } while (0)
+#endif
+
+#if (APP_LOG_LEVEL >= APP_LOG_LEVEL_DEBUG)
+#define AppLogDebug(...)   APP_LOG(APP_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define AppLogDebug(...)   do { if (0) { APP_LOG(APP_LOG_LEVEL_DEBUG, __VA_ARGS__); } } while (0)
+#endif
+
+#endif /* ifndef _APP_LOG_H_ */
@@ -66,3 +66,9 @@ typedef struct appNetworkSetting
 int network_initialize(appMqttContext_t *pContext);
 appNetworkSetting_t getNetworkSetting();
 
+/**
+ * @brief Forget the Wi-Fi networks saved by provisioning and the cached
+ * access point of the fast connect. Writes flash; takes effect on the next
+ * association.
+ */
+void vLabConnectionResetWifiNetworks(void);
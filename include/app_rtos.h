@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _APP_RTOS_H_
+#define _APP_RTOS_H_
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "event_groups.h"
+#include "timers.h"
+
+#include "app_config.h"
+
+/*
+ * Creation of the application's kernel objects, statically or from the heap
+ * depending on #appconfigSTATIC_ALLOCATION. Each object gets a storage
+ * declaration at file scope and is created through the matching macro:
+ *
+ *     APP_TASK_STORAGE(xDisplayTask, DISPLAY_TASK_STACK_SIZE);
+ *     ...
+ *     APP_TASK_CREATE(xDisplayTask, prvDisplayTask, "Display", NULL, DISPLAY_TASK_PRIORITY, NULL);
+ *
+ * APP_TASK_CREATE_PINNED takes a core as well (see app_sched.h); on the
+ * unicore build every core ID is tskNO_AFFINITY.
+ *
+ * Every create macro evaluates to pdPASS or pdFAIL (tasks) or to the handle
+ * (everything else), so call sites look the same in both modes. A storage
+ * declaration only reserves memory in static mode. A static object must be
+ * created at most once; objects that come and go stay on the heap.
+ */
+
+#if appconfigSTATIC_ALLOCATION
+
+#if (configSUPPORT_STATIC_ALLOCATION != 1)
+#error "appconfigSTATIC_ALLOCATION needs CONFIG_SUPPORT_STATIC_ALLOCATION"
+#endif
+
+#define APP_TASK_STORAGE(xName, ulStackDepth)            \
+    enum { xName ## StackDepth = (ulStackDepth) };       \
+    static StackType_t xName ## Stack[ulStackDepth];     \
+    static StaticTask_t xName ## Tcb
+
+#define APP_TASK_BUFFERS(xName)                          xName ## Stack, &xName ## Tcb
+
+#define APP_QUEUE_STORAGE(xName, uxLength, uxItemSize)   \
+    enum { xName ## Length = (uxLength), xName ## ItemSize = (uxItemSize) }; \
+    static uint8_t xName ## Items[(uxLength) * (uxItemSize)]; \
+    static StaticQueue_t xName ## Queue
+
+#define APP_QUEUE_CREATE(xName)                          \
+    xQueueCreateStatic(xName ## Length, xName ## ItemSize, xName ## Items, &xName ## Queue)
+
+#define APP_MUTEX_STORAGE(xName)                         static StaticSemaphore_t xName ## Mutex
+#define APP_MUTEX_CREATE(xName)                          xSemaphoreCreateMutexStatic(&xName ## Mutex)
+
+#define APP_EVENT_GROUP_STORAGE(xName)                   static StaticEventGroup_t xName ## EventGroup
+#define APP_EVENT_GROUP_CREATE(xName)                    xEventGroupCreateStatic(&xName ## EventGroup)
+
+#define APP_TIMER_STORAGE(xName)                         static StaticTimer_t xName ## Timer
+#define APP_TIMER_CREATE(xName, pcName, xPeriod, uxAutoReload, pvTimerID, pxCallback) \
+    xTimerCreateStatic(pcName, xPeriod, uxAutoReload, pvTimerID, pxCallback, &xName ## Timer)
+
+#else /* if appconfigSTATIC_ALLOCATION */
+
+/* The enum keeps the stack depth next to the storage declaration in both
+ * modes; the other declarations are empty struct declarations. */
+#define APP_TASK_STORAGE(xName, ulStackDepth)            enum { xName ## StackDepth = (ulStackDepth) }
+#define APP_TASK_BUFFERS(xName)                          NULL, NULL
+
+#define APP_QUEUE_STORAGE(xName, uxLength, uxItemSize)   \
+    enum { xName ## Length = (uxLength), xName ## ItemSize = (uxItemSize) }
+#define APP_QUEUE_CREATE(xName)                          xQueueCreate(xName ## Length, xName ## ItemSize)
+
+#define APP_MUTEX_STORAGE(xName)                         struct xName ## Mutex
+#define APP_MUTEX_CREATE(xName)                          xSemaphoreCreateMutex()
+
+#define APP_EVENT_GROUP_STORAGE(xName)                   struct xName ## EventGroup
+#define APP_EVENT_GROUP_CREATE(xName)                    xEventGroupCreate()
+
+#define APP_TIMER_STORAGE(xName)                         struct xName ## Timer
+#define APP_TIMER_CREATE(xName, pcName, xPeriod, uxAutoReload, pvTimerID, pxCallback) \
+    xTimerCreate(pcName, xPeriod, uxAutoReload, pvTimerID, pxCallback)
+
+#endif /* if appconfigSTATIC_ALLOCATION */
+
+#define APP_TASK_CREATE(xName, pxTaskCode, pcName, pvParameters, uxPriority, pxCreatedTask) \
+    APP_TASK_CREATE_PINNED(xName, pxTaskCode, pcName, pvParameters, uxPriority, pxCreatedTask, tskNO_AFFINITY)
+
+#define APP_TASK_CREATE_PINNED(xName, pxTaskCode, pcName, pvParameters, uxPriority, pxCreatedTask, xCoreID) \
+    xAppTaskCreate(pxTaskCode, pcName, xName ## StackDepth, pvParameters, uxPriority, pxCreatedTask, \
+                   APP_TASK_BUFFERS(xName), xCoreID)
+
+/**
+ * @brief xTaskCreateStaticPinnedToCore when given buffers,
+ * xTaskCreatePinnedToCore otherwise, with the xTaskCreate return convention.
+ */
+static inline BaseType_t xAppTaskCreate(TaskFunction_t pxTaskCode,
+                                        const char *pcName,
+                                        uint32_t ulStackDepth,
+                                        void *pvParameters,
+                                        UBaseType_t uxPriority,
+                                        TaskHandle_t *pxCreatedTask,
+                                        StackType_t *pxStack,
+                                        StaticTask_t *pxTcb,
+                                        BaseType_t xCoreID) {
+#if appconfigSTATIC_ALLOCATION
+    TaskHandle_t xHandle = xTaskCreateStaticPinnedToCore(pxTaskCode, pcName, ulStackDepth, pvParameters,
+                                                         uxPriority, pxStack, pxTcb, xCoreID);
+
+    if (pxCreatedTask != NULL) {
+        *pxCreatedTask = xHandle;
+    }
+
+    return (xHandle != NULL) ? pdPASS : pdFAIL;
+#else
+    (void) pxStack;
+    (void) pxTcb;
+
+    return xTaskCreatePinnedToCore(pxTaskCode, pcName, ulStackDepth, pvParameters, uxPriority,
+                                   pxCreatedTask, xCoreID);
+#endif
+}
+
+#endif /* ifndef _APP_RTOS_H_ */
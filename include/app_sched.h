@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Scheduling profile: the priority of every task that takes part in, or
+ * competes with, the unlock path. Every value can be overridden from the
+ * compiler command line; the checks at the end keep the order intact. */
+
+#ifndef _APP_SCHED_H_
+#define _APP_SCHED_H_
+
+#include "FreeRTOS.h"
+
+#include "app_config.h"
+
+/*
+ * The unlock path is a single chain: the MQTT task reads the TLS record,
+ * parses the delta and drives the actuator in the same call, without a
+ * queue or task hop in between. Deltas folded into the coalescing window,
+ * hold expiry and door sensor edges run in the timer service task, which
+ * runs above the MQTT task: when the window closes, the coalesced unlock
+ * preempts the receive of whatever arrived meanwhile. Its callbacks are all
+ * short and never block, so they cost the MQTT task little. Both hold a
+ * priority no other task shares, so they are never time-sliced with a task
+ * off the path and are woken by the event itself, not by a tick.
+ *
+ * Off the path, work only reaches the path through non-blocking queue sends
+ * (display, log records, agent commands) and runs below it. The one task
+ * above it is the IMU sampler, whose work per data-ready interrupt is a
+ * single burst read, so that it costs the unlock path a bounded few hundred
+ * microseconds at most.
+ *
+ * Nothing on the path writes to flash. An NVS commit or erase takes
+ * milliseconds with the caches disabled, so the timer service task only
+ * pends flash writes to the flash writer task (flash_writer.h), which runs
+ * below the path. So does the MQTT task for the journal drain after a
+ * reconnect.
+ *
+ * The ESP-IDF system tasks (esp_timer 22, Wi-Fi 23, lwIP 18, event loop 20)
+ * stay above all of these.
+ *
+ * On the dual-core build (CONFIG_FREERTOS_UNICORE unset) the network core
+ * runs Wi-Fi, lwIP, the timer service task, the event loop and the MQTT
+ * task, which is everything on the unlock path. The application core runs
+ * IMU sampling, tamper detection, the display, deferred log records,
+ * flash writes, battery polling and OTA downloads; the vendor logging task
+ * is left unpinned.
+ * The IMU sampler then no longer competes with the unlock path at all. Work
+ * crosses between the cores only through the IMU sample ring (lock-free, see
+ * spsc_ring.h), kernel queues and portMUX spinlocks. GPIO interrupts share
+ * one ISR service on the core that installed it, whichever that is. The
+ * data-ready ISR only notifies the sampler, and the next IMU interrupt is
+ * enabled again on that same core.
+ */
+
+/**
+ * @brief IMU data-ready handling; a short burst read per sample.
+ */
+#ifndef APP_SCHED_PRIORITY_IMU_SAMPLER
+#define APP_SCHED_PRIORITY_IMU_SAMPLER              (6)
+#endif
+
+/**
+ * @brief The timer service task, CONFIG_TIMER_TASK_PRIORITY in sdkconfig:
+ * coalesced deltas, hold expiry and sensor edges. It never writes to flash.
+ */
+#ifndef APP_SCHED_PRIORITY_TIMER
+#define APP_SCHED_PRIORITY_TIMER                    (5)
+#endif
+
+/**
+ * @brief The MQTT task: TLS receive, the agent loop and the shadow callbacks
+ * that drive the actuator.
+ */
+#ifndef APP_SCHED_PRIORITY_MQTT
+#define APP_SCHED_PRIORITY_MQTT                     (4)
+#endif
+
+/**
+ * @brief IMU batches, tamper detection and alarms. An alarm goes out through
+ * the MQTT task anyway, so running above it would not send it sooner.
+ */
+#ifndef APP_SCHED_PRIORITY_IMU_TELEMETRY
+#define APP_SCHED_PRIORITY_IMU_TELEMETRY            (3)
+#endif
+
+/**
+ * @brief The vendor logging task writing to the UART.
+ */
+#ifndef APP_SCHED_PRIORITY_LOGGING
+#define APP_SCHED_PRIORITY_LOGGING                  (2)
+#endif
+
+/**
+ * @brief Deferred log records, the display, the task profiler and OTA
+ * writes to flash.
+ */
+#ifndef APP_SCHED_PRIORITY_APP_LOG
+#define APP_SCHED_PRIORITY_APP_LOG                  (1)
+#endif
+
+#ifndef APP_SCHED_PRIORITY_DISPLAY
+#define APP_SCHED_PRIORITY_DISPLAY                  (1)
+#endif
+
+#ifndef APP_SCHED_PRIORITY_PROFILER
+#define APP_SCHED_PRIORITY_PROFILER                 (1)
+#endif
+
+#ifndef APP_SCHED_PRIORITY_OTA
+#define APP_SCHED_PRIORITY_OTA                      (1)
+#endif
+
+/**
+ * @brief Every NVS write pended by the tasks on the unlock path.
+ */
+#ifndef APP_SCHED_PRIORITY_FLASH_WRITER
+#define APP_SCHED_PRIORITY_FLASH_WRITER             (1)
+#endif
+
+/**
+ * @brief Battery polling.
+ */
+#ifndef APP_SCHED_PRIORITY_POWER_MONITOR
+#define APP_SCHED_PRIORITY_POWER_MONITOR            (0)
+#endif
+
+/*-----------------------------------------------------------*/
+
+#if (portNUM_PROCESSORS > 1)
+#define APP_SCHED_CORE_NETWORK                      (0) /* PRO_CPU_NUM */
+#define APP_SCHED_CORE_APPLICATION                  (1) /* APP_CPU_NUM */
+#else
+#define APP_SCHED_CORE_NETWORK                      tskNO_AFFINITY
+#define APP_SCHED_CORE_APPLICATION                  tskNO_AFFINITY
+#endif
+
+/**
+ * @brief The core of every task created through APP_TASK_CREATE_PINNED.
+ * The system tasks are pinned in sdkconfig: the timer service task and
+ * the default event loop run on core 0, and so do Wi-Fi
+ * (CONFIG_ESP32_WIFI_TASK_PINNED_TO_CORE_0) and lwIP
+ * (CONFIG_TCPIP_TASK_AFFINITY_CPU0).
+ */
+#ifndef APP_SCHED_CORE_MQTT
+#define APP_SCHED_CORE_MQTT                         APP_SCHED_CORE_NETWORK
+#endif
+
+#ifndef APP_SCHED_CORE_IMU_SAMPLER
+#define APP_SCHED_CORE_IMU_SAMPLER                  APP_SCHED_CORE_APPLICATION
+#endif
+
+#ifndef APP_SCHED_CORE_IMU_TELEMETRY
+#define APP_SCHED_CORE_IMU_TELEMETRY                APP_SCHED_CORE_APPLICATION
+#endif
+
+#ifndef APP_SCHED_CORE_APP_LOG
+#define APP_SCHED_CORE_APP_LOG                      APP_SCHED_CORE_APPLICATION
+#endif
+
+#ifndef APP_SCHED_CORE_DISPLAY
+#define APP_SCHED_CORE_DISPLAY                      APP_SCHED_CORE_APPLICATION
+#endif
+
+#ifndef APP_SCHED_CORE_POWER_MONITOR
+#define APP_SCHED_CORE_POWER_MONITOR                APP_SCHED_CORE_APPLICATION
+#endif
+
+#ifndef APP_SCHED_CORE_OTA
+#define APP_SCHED_CORE_OTA                          APP_SCHED_CORE_APPLICATION
+#endif
+
+#ifndef APP_SCHED_CORE_FLASH_WRITER
+#define APP_SCHED_CORE_FLASH_WRITER                 APP_SCHED_CORE_APPLICATION
+#endif
+
+/*-----------------------------------------------------------*/
+
+#if (portNUM_PROCESSORS > 1) && !defined(CONFIG_TCPIP_TASK_AFFINITY_CPU0) && !defined(CONFIG_LWIP_TCPIP_TASK_AFFINITY_CPU0)
+#error "The dual-core build expects the lwIP task on core 0, next to the MQTT task"
+#endif
+
+#if (configTIMER_TASK_PRIORITY != APP_SCHED_PRIORITY_TIMER)
+#error "CONFIG_TIMER_TASK_PRIORITY does not match APP_SCHED_PRIORITY_TIMER"
+#endif
+
+#if (APP_SCHED_PRIORITY_TIMER <= APP_SCHED_PRIORITY_MQTT)
+#error "The timer service task must run above the MQTT task"
+#endif
+
+#if ((APP_SCHED_PRIORITY_MQTT <= APP_SCHED_PRIORITY_IMU_TELEMETRY) || \
+    (APP_SCHED_PRIORITY_MQTT <= APP_SCHED_PRIORITY_LOGGING) ||        \
+    (APP_SCHED_PRIORITY_MQTT <= APP_SCHED_PRIORITY_APP_LOG) ||        \
+    (APP_SCHED_PRIORITY_MQTT <= APP_SCHED_PRIORITY_DISPLAY) ||        \
+    (APP_SCHED_PRIORITY_MQTT <= APP_SCHED_PRIORITY_PROFILER) ||       \
+    (APP_SCHED_PRIORITY_MQTT <= APP_SCHED_PRIORITY_OTA) ||            \
+    (APP_SCHED_PRIORITY_MQTT <= APP_SCHED_PRIORITY_FLASH_WRITER) ||   \
+    (APP_SCHED_PRIORITY_MQTT <= APP_SCHED_PRIORITY_POWER_MONITOR))
+#error "A task off the unlock path shares or exceeds the priority of the path"
+#endif
+
+#if (APP_SCHED_PRIORITY_IMU_SAMPLER >= 18)
+#error "Application tasks must stay below the lwIP and Wi-Fi tasks"
+#endif
+
+/* A coalesced delta is applied on the first tick after the window closes. */
+#if (appconfigLATENCY_UNLOCK_BUDGET_MS < (appconfigSHADOW_DELTA_COALESCE_MS + (1000 / configTICK_RATE_HZ)))
+#error "appconfigLATENCY_UNLOCK_BUDGET_MS is below the coalescing window plus a tick; raise it or CONFIG_FREERTOS_HZ"
+#endif
+
+#endif /* ifndef _APP_SCHED_H_ */
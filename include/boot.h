@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _BOOT_H_
+#define _BOOT_H_
+
+#include "FreeRTOS.h"
+
+/**
+ * @brief Milestones of a cold start, in the order they are normally reached.
+ * Wi-Fi association runs in parallel with the device bring-up, so
+ * #BootPhaseNetwork and #BootPhaseDevice may complete in either order.
+ */
+typedef enum BootPhase
+{
+    BootPhaseSystem = 0, /**< NVS, logging, TCP/IP stack and SYSTEM_Init. */
+    BootPhaseKeys,       /**< Client certificate and key available to PKCS #11. */
+    BootPhaseDevice,     /**< M5StickC, GPIO and display up. */
+    BootPhaseNetwork,    /**< Wi-Fi associated with an IP address. */
+    BootPhaseMqtt,       /**< First MQTT session established. */
+    BootPhaseFirstDelta, /**< First shadow delta handled. */
+    BootPhaseCount
+} BootPhase_t;
+
+/**
+ * @brief Create the phase event group. Called first thing in app_main.
+ */
+BaseType_t xBootInit(void);
+
+/**
+ * @brief Record that a phase has completed. Only the first call per phase
+ * counts; later ones (e.g. after a reconnect) are ignored. The timings are
+ * logged once #BootPhaseMqtt is reached, and again for the first delta.
+ */
+void vBootMark(BootPhase_t ePhase);
+
+/**
+ * @brief Block until a phase has completed.
+ *
+ * @return pdFALSE if it did not complete within xTicksToWait.
+ */
+BaseType_t xBootWait(BootPhase_t ePhase, TickType_t xTicksToWait);
+
+/**
+ * @brief Milliseconds since reset at which a phase completed, or 0 if it has
+ * not completed yet.
+ */
+uint32_t ulBootPhaseDoneMs(BootPhase_t ePhase);
+
+/**
+ * @brief Import the compiled-in client certificate and key into PKCS #11,
+ * unless the very same credentials were imported on a previous boot and the
+ * objects are still there. A CRC of the credentials is kept next to the
+ * objects, in the storage partition, and only written after a successful
+ * import. Marks #BootPhaseKeys.
+ */
+void vBootProvisionKeys(void);
+
+#endif /* ifndef _BOOT_H_ */
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _BUTTON_INPUT_H_
+#define _BUTTON_INPUT_H_
+
+#include "FreeRTOS.h"
+
+/**
+ * @brief Register the button handlers with the device event loop.
+ *
+ * The handlers only debounce and hand the command on, so the event loop
+ * returns straight away:
+ * - a click on the main button opens #appconfigBUTTON_UNLOCK_MASK from the
+ *   timer service task, the task that applies coalesced shadow deltas, and
+ *   the lock table reports the result to the shadow as for a cloud unlock;
+ * - a click on the reset button restarts the box after
+ *   #appconfigBUTTON_RESTART_DELAY_MS;
+ * - holding the reset button forgets the Wi-Fi networks and restarts the
+ *   same way.
+ *
+ * Must be called after eDeviceInit() and xShadowClientInit().
+ */
+BaseType_t xButtonInputInit(void);
+
+#endif /* ifndef _BUTTON_INPUT_H_ */
@@ -47,6 +47,5 @@
 
 esp_err_t eDeviceInit(void);
 esp_err_t eDeviceRegisterButtonCallback(esp_event_base_t base, void (*callback)(void * handler_arg, esp_event_base_t base, int32_t id, void * event_data) );
-esp_err_t eChangeLockState(uint32_t isOpenRequest);
-void runActuatorTask(void *pArgument);
+esp_err_t eChangeLockState(uint32_t ulLock, uint32_t isOpenRequest);
 #endif /* ifndef _DEVICE_H_ */
\ No newline at end of file
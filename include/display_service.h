@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _DISPLAY_SERVICE_H_
+#define _DISPLAY_SERVICE_H_
+
+#include "FreeRTOS.h"
+
+/**
+ * @brief Longest text a region can show; the screen is 160 pixels wide.
+ */
+#define DISPLAY_REGION_TEXT_LENGTH    (20U)
+
+/**
+ * @brief The parts of the status screen that can change independently.
+ */
+typedef enum DisplayRegion
+{
+    DisplayRegionLine1 = 0,
+    DisplayRegionLine2,
+    DisplayRegionLine3,
+    DisplayRegionLine4,
+    DisplayRegionBattery, /**< Left half of the status bar. */
+    DisplayRegionNetwork, /**< Right half of the status bar. */
+    DisplayRegionCount
+} DisplayRegion_t;
+
+/**
+ * @brief Create the display task, which from then on is the only one to draw
+ * on the TFT. Must be called after display_init.
+ */
+BaseType_t xDisplayServiceInit(void);
+
+/**
+ * @brief Ask the display task to show pcText in a region. Does not block.
+ *
+ * The text is copied and truncated to #DISPLAY_REGION_TEXT_LENGTH. Only the
+ * newest text of each region is kept until the display task draws it, so a
+ * burst of requests costs one redraw per region and is never refused.
+ * Requests that arrive together are applied in one pass, and a region is only
+ * redrawn if its text actually changed.
+ *
+ * @return pdFAIL if the display service is not running or the arguments are
+ * invalid.
+ */
+BaseType_t xDisplaySetText(DisplayRegion_t eRegion, const char *pcText);
+
+#endif /* ifndef _DISPLAY_SERVICE_H_ */
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _FLASH_WRITER_H_
+#define _FLASH_WRITER_H_
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+/**
+ * @brief A deferred flash write, with the same shape as a function pended to
+ * the timer service task.
+ */
+typedef void (*FlashWriterFunction_t)(void *pvParameter1, uint32_t ulParameter2);
+
+/**
+ * @brief Start the flash writer task. It runs below everything on the unlock
+ * path, see app_sched.h.
+ */
+BaseType_t xFlashWriterInit(void);
+
+/**
+ * @brief Queue a function that writes to flash (NVS commits, erases) for the
+ * flash writer task. Never blocks, so it is safe from the timer service task.
+ *
+ * @return pdFAIL if the writer is not running or its queue is full; the
+ * caller keeps the data and tries again later.
+ */
+BaseType_t xFlashWriterPend(FlashWriterFunction_t xFunction, void *pvParameter1, uint32_t ulParameter2);
+
+#endif /* ifndef _FLASH_WRITER_H_ */
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _I2C_BUS_H_
+#define _I2C_BUS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#include "esp_err.h"
+
+/**
+ * @brief Worst cases seen since boot, to check that sensors added to the
+ * bus keep access latency bounded.
+ */
+typedef struct I2cBusStats
+{
+    uint32_t ulTransactions;
+    uint32_t ulTimeouts;
+    uint32_t ulMaxWaitUs;     /**< Longest wait for the bus. */
+    uint32_t ulMaxHoldUs;     /**< Longest time the bus was held. */
+} I2cBusStats_t;
+
+/**
+ * @brief Create the bus mutex. The I2C driver itself is installed by the BSP
+ * in M5StickCInit on port #appconfigI2C_BUS_PORT.
+ */
+BaseType_t xI2cBusInit(void);
+
+/**
+ * @brief Write xLength bytes to consecutive registers starting at ucRegister,
+ * in one transaction.
+ */
+esp_err_t eI2cBusWrite(uint8_t ucAddress,
+                       uint8_t ucRegister,
+                       const uint8_t *pucData,
+                       size_t xLength);
+
+/**
+ * @brief Read xLength bytes from consecutive registers starting at
+ * ucRegister, in one burst.
+ */
+esp_err_t eI2cBusRead(uint8_t ucAddress,
+                      uint8_t ucRegister,
+                      uint8_t *pucData,
+                      size_t xLength);
+
+/**
+ * @brief Hold the bus across calls made outside this module, such as the BSP
+ * AXP192 helpers. Keep the section short: the IMU sampler waits behind it.
+ *
+ * @return ESP_ERR_TIMEOUT if the bus was not free within
+ * #appconfigI2C_BUS_LOCK_TIMEOUT_MS.
+ */
+esp_err_t eI2cBusLock(void);
+void vI2cBusUnlock(void);
+
+void vI2cBusGetStats(I2cBusStats_t *pxStats);
+
+#endif /* ifndef _I2C_BUS_H_ */
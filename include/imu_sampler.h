@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _IMU_SAMPLER_H_
+#define _IMU_SAMPLER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+/**
+ * @brief Accelerometer counts per g. The sampler configures the MPU6886 for
+ * a +/-8 g range, so the BSP conversion helpers no longer apply.
+ */
+#define IMU_ACCEL_LSB_PER_G    (4096)
+
+/**
+ * @brief One raw MPU6886 reading as it came off the bus. The gyroscope runs
+ * at +/-2000 dps, 16.4 counts per degree per second.
+ */
+typedef struct ImuSample
+{
+    uint32_t ulTimestampUs;
+    int16_t sAccel[3];
+    int16_t sGyro[3];
+} ImuSample_t;
+
+/**
+ * @brief Configure the MPU6886 to raise its data-ready interrupt at
+ * #appconfigIMU_SAMPLE_RATE_HZ and start the sampling task.
+ *
+ * Each interrupt wakes the sampling task, which reads accelerometer and
+ * gyroscope in one burst and pushes the sample into a lock-free ring.
+ * Must be called after eDeviceInit so the I2C bus is up.
+ *
+ * With #appconfigPOWER_SAVE the data-ready interrupt is disabled once the
+ * box has been still for #appconfigIMU_MOTION_HOLD_MS, and only the
+ * wake-on-motion interrupt (#appconfigIMU_WAKE_THRESHOLD_MG) is left to wake
+ * the chip and start sampling again. A tilt too slow to cross the threshold
+ * between two samples is only seen once the box moves again.
+ */
+BaseType_t xImuSamplerInit(void);
+
+/**
+ * @brief Wait until the sampler is producing samples at the full rate.
+ *
+ * @return false if it was still idle after xTicksToWait.
+ */
+bool xImuSamplerWaitSampling(TickType_t xTicksToWait);
+
+/**
+ * @brief Take the oldest sample. Only one task may consume samples.
+ *
+ * @return false if no sample is waiting.
+ */
+bool xImuSamplerRead(ImuSample_t *pxSample);
+
+/**
+ * @brief Samples lost since the last call, because the consumer fell behind
+ * or a bus read failed.
+ */
+uint32_t ulImuSamplerTakeDropped(void);
+
+#endif /* ifndef _IMU_SAMPLER_H_ */
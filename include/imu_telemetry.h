@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _IMU_TELEMETRY_H_
+#define _IMU_TELEMETRY_H_
+
+#include "FreeRTOS.h"
+
+/**
+ * @brief Start the task that drains the IMU samples in batches, runs them
+ * through the tamper detector and publishes tamper events and periodic
+ * summaries through the MQTT agent.
+ *
+ * Samples are never published: every #appconfigIMU_BATCH_PERIOD_MS the ring
+ * is drained, a tamper event is published if the detector fired, and the
+ * samples are folded into the running summary, which goes out every
+ * #appconfigIMU_SUMMARY_PERIOD_MS.
+ */
+BaseType_t xImuTelemetryInit(void);
+
+#endif /* ifndef _IMU_TELEMETRY_H_ */
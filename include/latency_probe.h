@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LATENCY_PROBE_H_
+#define _LATENCY_PROBE_H_
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#include "app_config.h"
+
+/**
+ * @brief The measured stretches of the unlock path, from the TLS read of a
+ * delta to the broker acknowledging the lock state report.
+ */
+typedef enum LatencySpan
+{
+    /**
+     * One transport read that returned data, from the call until it returns.
+     * This includes the time spent blocked waiting for the peer, up to the
+     * socket receive timeout, so it bounds the read rather than measuring
+     * decryption alone.
+     */
+    LatencySpanTlsWaitRead = 0,
+    LatencySpanDeltaParse, /**< Parsing a delta document. */
+    LatencySpanUnlock,     /**< Delta handed to the shadow client until the actuator has been driven. */
+    LatencySpanAgentQueue, /**< MQTT agent command queued until the agent task executes it. */
+    LatencySpanPuback,     /**< QoS1 PUBLISH sent until its PUBACK. */
+    LatencySpanShadowAck,  /**< Shadow update requested until /update/accepted or /rejected. */
+    LatencySpanCount
+} LatencySpan_t;
+
+#if appconfigLATENCY_PROBES
+
+/**
+ * @brief Timestamp in microseconds to pass to #vLatencyProbeRecord. Wraps
+ * after about 71 minutes, which is harmless for the differences taken.
+ */
+uint32_t ulLatencyProbeNow(void);
+
+/**
+ * @brief Add the time elapsed since ulStartUs to a span's histogram. Safe
+ * from any task; costs a timestamp and a short critical section.
+ */
+void vLatencyProbeRecord(LatencySpan_t eSpan, uint32_t ulStartUs);
+
+/**
+ * @brief Start publishing the percentiles of every span, and the boot phase
+ * timings once, every #appconfigLATENCY_PUBLISH_PERIOD_MS. Spans are
+ * recorded whether or not this was called.
+ */
+BaseType_t xLatencyProbeInit(void);
+
+#else /* if appconfigLATENCY_PROBES */
+
+#define ulLatencyProbeNow()                      (0U)
+#define vLatencyProbeRecord(eSpan, ulStartUs)    do { (void) (eSpan); (void) (ulStartUs); } while (0)
+#define xLatencyProbeInit()                      (pdPASS)
+
+#endif /* if appconfigLATENCY_PROBES */
+
+#endif /* ifndef _LATENCY_PROBE_H_ */
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LOCK_STATE_H_
+#define _LOCK_STATE_H_
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#include "app_config.h"
+
+/**
+ * @brief Upper bound for #appconfigLOCK_COUNT, set by the lock report
+ * templates in shadow_client.c.
+ */
+#define LOCK_STATE_MAX_COUNT    (8U)
+
+/**
+ * @brief Mask with a bit set for every configured compartment.
+ */
+#define LOCK_STATE_ALL_MASK     ((uint32_t) ((1UL << appconfigLOCK_COUNT) - 1UL))
+
+typedef enum LockState
+{
+    LockStateClosed = 0,
+    LockStateOpening,
+    LockStateOpen,
+    LockStateClosing
+} LockState_t;
+
+/**
+ * @brief Called whenever compartments settle in #LockStateOpen or
+ * #LockStateClosed. Every compartment that settles as a result of the same
+ * request, sensor edge or hold expiry is reported in one call.
+ *
+ * It runs in the context of the task that caused the transition (the
+ * requester or the timer service task), with the lock table held so reports
+ * go out in order, and must not block.
+ *
+ * @param[in] ulOpenMask Bit i set for every compartment that is open now.
+ * @param[in] ulChangedMask Bit i set for every compartment that just settled.
+ */
+typedef void (*LockStateCallback_t)(uint32_t ulOpenMask, uint32_t ulChangedMask);
+
+/**
+ * @brief Create the hold timer and, if configured, the bolt sensor interrupts.
+ *
+ * With a sensor, a compartment that has not reached the driven position
+ * within appconfigLOCK_SENSOR_TIMEOUT_MS is reported as the sensor shows it:
+ * closed if it never opened, open (and retried after a hold) if it never
+ * closed.
+ */
+BaseType_t xLockStateInit(LockStateCallback_t xCallback);
+
+/**
+ * @brief Open the compartments in ulLockMask, or extend the hold time of the
+ * ones that are already open. The actuators are driven from the calling task
+ * so the unlock does not wait for the timer service task.
+ *
+ * @return pdFAIL if ulLockMask is empty, or the lock table stayed busy for
+ * appconfigLOCK_STATE_WAIT_MS.
+ */
+BaseType_t xLockStateRequestOpen(uint32_t ulLockMask);
+
+LockState_t eLockStateGet(uint32_t ulLock);
+
+/**
+ * @brief Report the current state again through the callback, serialised
+ * with the state machine, e.g. after reports were lost during an outage.
+ *
+ * @param[in] ulChangedMask Passed on as the changed mask.
+ *
+ * @return pdFAIL if the lock table stayed busy for appconfigLOCK_STATE_WAIT_MS.
+ */
+BaseType_t xLockStateResync(uint32_t ulChangedMask);
+
+#endif /* ifndef _LOCK_STATE_H_ */
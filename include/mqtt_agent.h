@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _MQTT_AGENT_H_
+#define _MQTT_AGENT_H_
+
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "core_mqtt.h"
+
+typedef enum MqttAgentStatus
+{
+    MqttAgentSuccess = 0,
+    MqttAgentBadParameter,
+    MqttAgentQueueFull,
+    MqttAgentSendFailed,
+    MqttAgentAckTimeout,
+    MqttAgentDisconnected,
+    MqttAgentPending
+} MqttAgentStatus_t;
+
+/**
+ * @brief Where the agent reports how a QoS1 publish ended; see
+ * #eMqttAgentPublishNotify.
+ *
+ * eStatus reads #MqttAgentPending until the agent knows the outcome. It then
+ * writes #MqttAgentSuccess once the PUBACK arrives, #MqttAgentAckTimeout if
+ * none arrived within #appconfigMQTT_AGENT_PUBACK_TIMEOUT_MS, or
+ * #MqttAgentDisconnected if the broker dropped the session with the publish
+ * in it. After writing it, the agent notifies xNotifyTask, if set, by
+ * setting ulNotifyBits with eSetBits. Several completions can therefore
+ * share a task, each with its own bits.
+ */
+typedef struct MqttAgentCompletion
+{
+    TaskHandle_t xNotifyTask;
+    uint32_t ulNotifyBits;
+    volatile MqttAgentStatus_t eStatus;
+} MqttAgentCompletion_t;
+
+/**
+ * @brief Called from the agent task once a session is up, with every
+ * subscription restored and the commands left over from the last session
+ * sent, and once when it is gone. It may queue publishes with xTicksToWait
+ * 0; they go out on the next pass over the command queue.
+ *
+ * While the session is up, the callback is called again on every pass that
+ * leaves the command queue empty for as long as it returns false, and after
+ * #vMqttAgentRequestSync. The return value is ignored when xUp is false.
+ *
+ * @return true once everything the session needs has been queued.
+ */
+typedef bool (*MqttAgentSessionCallback_t)(bool xUp);
+
+/**
+ * @brief Create the command queue. Must be called before any other task
+ * queues a command.
+ */
+BaseType_t xMqttAgentInit(void);
+
+/**
+ * @brief Connect to the broker and run the agent loop in the calling task.
+ *
+ * The calling task becomes the only owner of the MQTT context: it runs
+ * MQTT_ProcessLoop and, between iterations, executes every queued command.
+ * xEventCallback is invoked from this task for every incoming packet.
+ *
+ * When the session drops, queued commands are kept and the agent reconnects
+ * with jittered exponential backoff once the network is up. If the broker
+ * kept the session, publishes still waiting for their PUBACK are resent with
+ * DUP set; otherwise they fail with #MqttAgentDisconnected and every
+ * subscription made so far is restored. Does not return.
+ */
+BaseType_t xMqttAgentRun(MQTTEventCallback_t xEventCallback);
+
+/**
+ * @brief Tell the agent whether a network is available. Hook this to the
+ * network manager connected/disconnected callbacks.
+ */
+void vMqttAgentSetNetworkState(bool xConnected);
+
+/**
+ * @brief Register the callback for session changes. Call before
+ * #xMqttAgentRun.
+ */
+void vMqttAgentSetSessionCallback(MqttAgentSessionCallback_t xCallback);
+
+/**
+ * @brief Have the session callback called again once the command queue is
+ * empty, e.g. after a report had to be journaled while connected. Safe from
+ * any task; does nothing without a session.
+ */
+void vMqttAgentRequestSync(void);
+
+/**
+ * @brief Whether an MQTT session is up right now.
+ */
+bool xMqttAgentIsConnected(void);
+
+/**
+ * @brief Queue a QoS1 publish.
+ *
+ * Without a session the publish is refused with #MqttAgentDisconnected
+ * rather than queued, so stale telemetry does not fill the queue ahead of
+ * what the next session sends first; callers that must not lose a message
+ * keep it themselves. Publishes already queued when a session drops are kept.
+ *
+ * The payload is copied, so the caller may reuse its buffer on return.
+ * xTicksToWait only bounds the wait for room in the command queue; success
+ * means the publish was queued, not that it was acknowledged. Use
+ * #eMqttAgentPublishNotify to learn that.
+ *
+ * @param[in] pcTopic Topic name. Must stay valid until the PUBACK arrives,
+ * since the publish may be resent after a reconnect.
+ */
+MqttAgentStatus_t eMqttAgentPublish(const char *pcTopic,
+                                    uint16_t usTopicLength,
+                                    const char *pcPayload,
+                                    size_t xPayloadLength,
+                                    TickType_t xTicksToWait);
+
+/**
+ * @brief #eMqttAgentPublish, with its outcome reported through pxCompletion.
+ *
+ * pxCompletion is owned by the agent from a successful return until its
+ * eStatus stops reading #MqttAgentPending, and must stay valid until then.
+ * When the call returns anything but #MqttAgentSuccess, the publish was not
+ * queued: eStatus holds the returned status and the task is not notified.
+ *
+ * @param[in] pxCompletion NULL behaves as #eMqttAgentPublish.
+ */
+MqttAgentStatus_t eMqttAgentPublishNotify(const char *pcTopic,
+                                          uint16_t usTopicLength,
+                                          const char *pcPayload,
+                                          size_t xPayloadLength,
+                                          TickType_t xTicksToWait,
+                                          MqttAgentCompletion_t *pxCompletion);
+
+/**
+ * @brief Queue a subscribe. See #eMqttAgentPublish for xTicksToWait.
+ *
+ * @param[in] pcTopicFilter Topic filter. Must stay valid until the command executes.
+ */
+MqttAgentStatus_t eMqttAgentSubscribe(const char *pcTopicFilter,
+                                      uint16_t usTopicFilterLength,
+                                      TickType_t xTicksToWait);
+
+#endif /* ifndef _MQTT_AGENT_H_ */
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _OTA_CLIENT_H_
+#define _OTA_CLIENT_H_
+
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+
+#include "core_mqtt.h"
+
+/**
+ * @brief Subscribe to cmd/personalbox/<thing>/ota/+ and start the OTA task.
+ *
+ * An offer on .../ota/offer names a job, the image size and SHA-256 and the
+ * size of the stream that produces it: the image itself, or a delta
+ * against the running image when it carries baseSha256. The task asks for
+ * the stream a window at a time on dt/personalbox/<thing>/ota/request and
+ * writes it straight into the inactive OTA slot, sector by sector. Progress
+ * is saved to NVS, so a transfer interrupted by a disconnect or a reset
+ * carries on where it stopped. A complete image is verified, made the boot
+ * image, and booted.
+ *
+ * A new image stays pending until it has reached the broker; if it does not
+ * within #appconfigOTA_VERIFY_TIMEOUT_MS, or it resets before, the
+ * bootloader goes back to the previous one. Job states are published on
+ * dt/personalbox/<thing>/ota.
+ */
+BaseType_t xOtaClientInit(void);
+
+/**
+ * @brief Called by the MQTT event callback for every incoming publish. Only
+ * copies the payload for the OTA task, so it is cheap on the MQTT task.
+ *
+ * @return true if the publish was on an OTA topic.
+ */
+bool xOtaClientHandlePublish(const MQTTPublishInfo_t *pxPublishInfo);
+
+#endif /* ifndef _OTA_CLIENT_H_ */
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _POWER_MANAGER_H_
+#define _POWER_MANAGER_H_
+
+#include "FreeRTOS.h"
+
+/**
+ * @brief Reasons to keep the chip out of its lowest power state.
+ */
+typedef enum PowerLock
+{
+    PowerLockCpuMax = 0, /**< Run at the maximum frequency, e.g. for a TLS handshake. */
+    PowerLockAwake,      /**< Stay out of light sleep, e.g. while the lock is driven. */
+    PowerLockCount
+} PowerLock_t;
+
+/**
+ * @brief Enable frequency scaling and automatic light sleep when
+ * #appconfigPOWER_SAVE is set and the build has CONFIG_PM_ENABLE. Otherwise
+ * every call in this header does nothing.
+ */
+BaseType_t xPowerManagerInit(void);
+
+/**
+ * @brief Take or give back a power lock. Locks are counted, so every acquire
+ * needs a matching release; both may be called from any task.
+ */
+void vPowerLockAcquire(PowerLock_t eLock);
+void vPowerLockRelease(PowerLock_t eLock);
+
+/**
+ * @brief Put the Wi-Fi radio in modem sleep. Call once the station is
+ * connected, since the driver resets the mode on every connect.
+ */
+void vPowerManagerNetworkUp(void);
+
+#endif /* ifndef _POWER_MANAGER_H_ */
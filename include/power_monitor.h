@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _POWER_MONITOR_H_
+#define _POWER_MONITOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+/**
+ * @brief The latest AXP192 reading, converted to integer units.
+ */
+typedef struct PowerReading
+{
+    uint16_t usBatteryMv;
+    uint16_t usInputMv;   /**< APS voltage, USB or battery whichever is higher. */
+    uint8_t ucPercent;
+    bool xCharging;
+    TickType_t xTakenAt;
+} PowerReading_t;
+
+/**
+ * @brief Start the task that samples the AXP192, refreshes the status bar and
+ * reports the battery to the device shadow.
+ *
+ * The sampling period is #appconfigPOWER_MONITOR_FAST_PERIOD_MS while
+ * charging, low or changing, and #appconfigPOWER_MONITOR_SLOW_PERIOD_MS
+ * otherwise. The shadow is only updated when the voltage has moved by
+ * #appconfigPOWER_MONITOR_REPORT_HYSTERESIS_MV or charging started or stopped.
+ */
+BaseType_t xPowerMonitorInit(void);
+
+/**
+ * @brief Copy the cached reading without touching the bus. Lock-free, may be
+ * called from any task.
+ *
+ * @return false until the first reading has been taken.
+ */
+bool xPowerMonitorGet(PowerReading_t *pxReading);
+
+#endif /* ifndef _POWER_MONITOR_H_ */
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _REPORT_JOURNAL_H_
+#define _REPORT_JOURNAL_H_
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+/**
+ * @brief Open the journal in the storage NVS partition and start the flush
+ * timer. Batches left over from before a reboot are kept for the next drain.
+ */
+BaseType_t xReportJournalInit(void);
+
+/**
+ * @brief Record a lock report that could not be published. Does not block:
+ * the entry goes to a RAM batch, which the flash writer task writes to flash
+ * once it is full or #appconfigJOURNAL_FLUSH_MS after its first entry.
+ */
+void vReportJournalAppend(uint32_t ulOpenMask, uint32_t ulChangedMask);
+
+/**
+ * @brief Have the flash writer task publish every journaled batch as one
+ * history document each. Each batch is erased only once its PUBACK is in.
+ * Does not block. Call from the MQTT agent session callback.
+ *
+ * Batches that could not be queued, or whose publish failed, stay in flash.
+ * The drain then asks the agent for another session callback pass.
+ *
+ * @param[out] pulChangedMask The union of the changed masks journaled since
+ * the last call, for the caller to report the current state of.
+ *
+ * @return pdFAIL if the flash writer queue is full; try again later.
+ */
+BaseType_t xReportJournalDrain(uint32_t *pulChangedMask);
+
+#endif /* ifndef _REPORT_JOURNAL_H_ */
@@ -25,9 +25,21 @@ int RunDeviceShadowClient(bool awsIotMqttMode,
                         const char *pIdentifier,
                         void *pNetworkServerInfo,
                         void *pNetworkCredentialInfo,
-                        const void *pNetworkInterface,
-                        TaskHandle_t *pHandle);
+                        const void *pNetworkInterface);
 
-void publishCurrentStateTask(void *pArgument);
+/**
+ * @brief Create the MQTT agent queue and the lock state machine. Must be
+ * called before the subscribe task is started.
+ */
+BaseType_t xShadowClientInit(void);
+
+/**
+ * @brief Queue a reported-state update with the battery voltage and whether
+ * the box is charging. Does not block.
+ *
+ * @return pdPASS if the update was queued; pdFAIL without a session or
+ * when the MQTT agent queue is full.
+ */
+BaseType_t xShadowClientReportPower(uint32_t ulBatteryMv, bool xCharging);
 
 void subscribeUpdateTask(void *pArgument);
\ No newline at end of file
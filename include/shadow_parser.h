@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _SHADOW_PARSER_H_
+#define _SHADOW_PARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Bits set in ShadowDeltaDocument_t.ulFieldsPresent for every key
+ * that was found in the document.
+ */
+#define SHADOW_DELTA_FIELD_VERSION         (1UL << 0)
+#define SHADOW_DELTA_FIELD_LOCK_STATE      (1UL << 1)
+#define SHADOW_DELTA_FIELD_CLIENT_TOKEN    (1UL << 2)
+#define SHADOW_DELTA_FIELD_CODE            (1UL << 3)
+#define SHADOW_DELTA_FIELD_LOCKS           (1UL << 4)
+
+/**
+ * @brief Maximum nesting depth accepted by the parser. Shadow delta documents
+ * are at most four levels deep ("metadata.<key>.timestamp"), so this leaves
+ * room for nested desired values without allowing unbounded recursion.
+ */
+#define SHADOW_PARSER_MAX_DEPTH            (8U)
+
+/**
+ * @brief Number of "state.locks" elements that fit in the element masks of
+ * ShadowDeltaDocument_t.
+ */
+#define SHADOW_PARSER_MAX_LOCKS            (32U)
+
+typedef enum ShadowParserStatus
+{
+    ShadowParserSuccess = 0,
+    ShadowParserBadParameter,
+    ShadowParserInvalidJson,
+    ShadowParserMaxDepthExceeded,
+    ShadowParserInvalidValue
+} ShadowParserStatus_t;
+
+/**
+ * @brief The values extracted from a shadow document.
+ *
+ * String values point straight into the payload that was parsed and are not
+ * NUL-terminated; use the accompanying length.
+ */
+typedef struct ShadowDeltaDocument
+{
+    uint32_t ulFieldsPresent;
+    uint32_t ulVersion;
+    uint32_t ulLockState;
+    uint32_t ulCode;
+    uint32_t ulLocksPresent; /**< Bit i set if "state.locks[i]" is a number. */
+    uint32_t ulLocksOpen;    /**< Bit i set if "state.locks[i]" is 1. */
+    const char *pcClientToken;
+    size_t xClientTokenLength;
+} ShadowDeltaDocument_t;
+
+/**
+ * @brief Validate a shadow document and extract its known fields in a single pass.
+ *
+ * The whole payload is checked to be one well-formed JSON object. Keys are
+ * matched while walking the document, so "version", "clientToken",
+ * "state.lockState", the elements of "state.locks" and the "code" of a
+ * rejected response are picked up without rescanning; keys under any other
+ * path (e.g. "metadata.lockState") are validated and skipped. In a
+ * /get/accepted document the lock keys are taken from "state.delta".
+ *
+ * A known key whose value has the wrong type, such as "lockState":"1",
+ * "lockState":null or a "version" that does not fit in uint32_t, fails the
+ * whole document with #ShadowParserInvalidValue rather than being treated as
+ * absent, so a malformed desired state is never partly applied. The same
+ * goes for a "state.locks" element that is not a number or lies beyond
+ * #SHADOW_PARSER_MAX_LOCKS. pxDocument must not be used unless the call
+ * succeeds.
+ *
+ * @param[in] pcPayload The document, not necessarily NUL-terminated.
+ * @param[in] xPayloadLength The length of the document.
+ * @param[out] pxDocument Filled in with the extracted values.
+ *
+ * @return #ShadowParserSuccess if the document is valid and every known field
+ * that was present had a value of the expected type.
+ */
+ShadowParserStatus_t eShadowParseDocument(const char *pcPayload,
+                                          size_t xPayloadLength,
+                                          ShadowDeltaDocument_t *pxDocument);
+
+/**
+ * @brief Convert a run of decimal digits, such as a clientToken, to uint32_t.
+ *
+ * @return #ShadowParserInvalidValue if the text is empty, holds anything but
+ * digits or does not fit.
+ */
+ShadowParserStatus_t eShadowParseUint32(const char *pcDigits,
+                                        size_t xLength,
+                                        uint32_t *pulValue);
+
+#endif /* ifndef _SHADOW_PARSER_H_ */
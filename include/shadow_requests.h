@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _SHADOW_REQUESTS_H_
+#define _SHADOW_REQUESTS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+/**
+ * @brief Allocate the clientToken for a new shadow update and remember when
+ * it was sent.
+ *
+ * Tokens come from a per-boot counter seeded with a random base, so no two
+ * updates of one boot share a token however close together they are sent,
+ * and updates from different boots are very unlikely to collide.
+ */
+uint32_t ulShadowRequestBegin(void);
+
+/**
+ * @brief Match an /update/accepted or /update/rejected response to its request.
+ *
+ * @param[out] pxLatency Ticks between ulShadowRequestBegin and now.
+ *
+ * @return false if no pending request carries this token (already expired
+ * or sent by someone else).
+ */
+bool xShadowRequestComplete(uint32_t ulClientToken, TickType_t *pxLatency);
+
+/**
+ * @brief Drop and log requests that have not been answered within
+ * #appconfigSHADOW_RESPONSE_TIMEOUT_MS.
+ */
+void vShadowRequestExpire(void);
+
+#endif /* ifndef _SHADOW_REQUESTS_H_ */
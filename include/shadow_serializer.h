@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _SHADOW_SERIALIZER_H_
+#define _SHADOW_SERIALIZER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A shadow document template is described once as a list of literal pieces
+ * and fixed-width decimal fields:
+ *
+ *     #define MY_DOCUMENT(LITERAL, FIELD)                 \
+ *         LITERAL("{\"state\":{\"reported\":{\"lockState\":") \
+ *         FIELD(MY_FIELD_LOCK_STATE, "0")                  \
+ *         LITERAL("}}}")
+ *
+ * The placeholder string of a field sets its width. From that description
+ * the macros below produce, at compile time, the complete document text with
+ * placeholders in place (SHADOW_TEMPLATE_TEXT), its exact length
+ * (SHADOW_TEMPLATE_LENGTH) and the segment table used to patch in the field
+ * digits (SHADOW_TEMPLATE_SEGMENTS). Serializing is then a matter of writing
+ * the digits of each field; the constant text is never copied or formatted.
+ */
+
+/**
+ * @brief Segment marker for literal text.
+ */
+#define SHADOW_TEMPLATE_NO_FIELD    (0xFFU)
+
+typedef struct ShadowTemplateSegment
+{
+    uint16_t usLength;
+    uint8_t ucField;
+} ShadowTemplateSegment_t;
+
+typedef struct ShadowTemplate
+{
+    const ShadowTemplateSegment_t *pxSegments;
+    size_t xSegmentCount;
+    size_t xLength;
+} ShadowTemplate_t;
+
+#define SHADOW_TEMPLATE_LITERAL_LENGTH_(pcLiteral)             + (sizeof(pcLiteral) - 1U)
+#define SHADOW_TEMPLATE_FIELD_LENGTH_(ucField, pcPlaceholder)  + (sizeof(pcPlaceholder) - 1U)
+
+#define SHADOW_TEMPLATE_LITERAL_TEXT_(pcLiteral)               pcLiteral
+#define SHADOW_TEMPLATE_FIELD_TEXT_(ucField, pcPlaceholder)    pcPlaceholder
+
+#define SHADOW_TEMPLATE_LITERAL_SEGMENT_(pcLiteral) \
+    { (uint16_t) (sizeof(pcLiteral) - 1U), SHADOW_TEMPLATE_NO_FIELD },
+#define SHADOW_TEMPLATE_FIELD_SEGMENT_(ucField, pcPlaceholder) \
+    { (uint16_t) (sizeof(pcPlaceholder) - 1U), (uint8_t) (ucField) },
+
+/**
+ * @brief Length of the serialized document, excluding a terminator.
+ */
+#define SHADOW_TEMPLATE_LENGTH(DOCUMENT) \
+    (0U DOCUMENT(SHADOW_TEMPLATE_LITERAL_LENGTH_, SHADOW_TEMPLATE_FIELD_LENGTH_))
+
+/**
+ * @brief The document as a string literal, field placeholders included.
+ */
+#define SHADOW_TEMPLATE_TEXT(DOCUMENT) \
+    DOCUMENT(SHADOW_TEMPLATE_LITERAL_TEXT_, SHADOW_TEMPLATE_FIELD_TEXT_)
+
+/**
+ * @brief Initializer for the ShadowTemplateSegment_t array of the document.
+ */
+#define SHADOW_TEMPLATE_SEGMENTS(DOCUMENT) \
+    { DOCUMENT(SHADOW_TEMPLATE_LITERAL_SEGMENT_, SHADOW_TEMPLATE_FIELD_SEGMENT_) }
+
+/**
+ * @brief Define the segment table and ShadowTemplate_t for a document.
+ */
+#define SHADOW_TEMPLATE_DEFINE(xName, DOCUMENT)                                              \
+    static const ShadowTemplateSegment_t xName##Segments[] = SHADOW_TEMPLATE_SEGMENTS(DOCUMENT); \
+    static const ShadowTemplate_t xName =                                                    \
+    {                                                                                        \
+        xName##Segments,                                                                     \
+        sizeof(xName##Segments) / sizeof(xName##Segments[0]),                                \
+        SHADOW_TEMPLATE_LENGTH(DOCUMENT)                                                     \
+    }
+
+/**
+ * @brief Write the field values into a document buffer.
+ *
+ * pcDocument must already hold the template text (e.g. a static buffer
+ * initialized with SHADOW_TEMPLATE_TEXT). Only the field digits are written:
+ * each value is printed zero-padded to its placeholder width, keeping the
+ * lowest digits if it is wider.
+ *
+ * @param[in] pulValues Field values indexed by the field ids used in the
+ * template description.
+ */
+void vShadowTemplateSerialize(const ShadowTemplate_t *pxTemplate,
+                              char *pcDocument,
+                              const uint32_t *pulValues);
+
+#endif /* ifndef _SHADOW_SERIALIZER_H_ */
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _SPSC_RING_H_
+#define _SPSC_RING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief A fixed-size ring of equally sized items shared by exactly one
+ * producer task and one consumer task.
+ *
+ * Neither side takes a lock or enters a critical section: the producer only
+ * writes ulHead, the consumer only writes ulTail, and each publishes its index
+ * with release ordering after the item has been copied, which is enough on
+ * both ESP32 cores.
+ */
+typedef struct SpscRing
+{
+    uint8_t *pucStorage;
+    size_t xItemSize;
+    uint32_t ulMask;
+    volatile uint32_t ulHead;
+    volatile uint32_t ulTail;
+    volatile uint32_t ulDropped;
+} SpscRing_t;
+
+/**
+ * @param[in] pvStorage Room for ulCapacity items of xItemSize bytes.
+ * @param[in] ulCapacity Number of items; must be a power of two.
+ */
+void vSpscRingInit(SpscRing_t *pxRing,
+                   void *pvStorage,
+                   size_t xItemSize,
+                   uint32_t ulCapacity);
+
+/**
+ * @brief Copy an item in. Producer side only.
+ *
+ * @return false, and count the item as dropped, if the ring is full.
+ */
+bool xSpscRingPush(SpscRing_t *pxRing, const void *pvItem);
+
+/**
+ * @brief Copy the oldest item out. Consumer side only.
+ *
+ * @return false if the ring is empty.
+ */
+bool xSpscRingPop(SpscRing_t *pxRing, void *pvItem);
+
+/**
+ * @brief Items dropped because the ring was full since the last call.
+ * Consumer side only.
+ */
+uint32_t ulSpscRingTakeDropped(SpscRing_t *pxRing);
+
+#endif /* ifndef _SPSC_RING_H_ */
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TAMPER_DETECTOR_H_
+#define _TAMPER_DETECTOR_H_
+
+#include <stdint.h>
+
+#include "app_config.h"
+#include "imu_sampler.h"
+
+/**
+ * @brief Bits returned by #ulTamperDetectorUpdate.
+ */
+#define TAMPER_EVENT_VIBRATION    (1UL << 0) /**< Windowed RMS over threshold. */
+#define TAMPER_EVENT_SHOCK        (1UL << 1) /**< Jerk over threshold. */
+#define TAMPER_EVENT_TILT         (1UL << 2) /**< Gravity moved away from the resting orientation. */
+
+/**
+ * @brief Features of the latest sample, all in integer units.
+ */
+typedef struct TamperFeatures
+{
+    uint32_t ulMagnitudeMg;     /**< Length of the acceleration vector. */
+    uint32_t ulRmsMg;           /**< RMS of the non-gravity acceleration over the window. */
+    uint32_t ulJerkGPerS;       /**< Change of acceleration since the previous sample. */
+    int32_t lTiltCosMilli;      /**< Cosine of the angle to the resting orientation, times 1000. */
+} TamperFeatures_t;
+
+/**
+ * @brief Detector state. Only integer arithmetic is used per sample.
+ */
+typedef struct TamperDetector
+{
+    int32_t lGravityQ8[3];      /**< Low-passed acceleration in mg, 8 fractional bits. */
+    int32_t lReferenceMg[3];    /**< Gravity direction the box is resting in. */
+    int32_t lPreviousMg[3];
+    uint32_t ulSquares[appconfigTAMPER_WINDOW_SAMPLES];
+    uint64_t ullSquareSum;
+    uint32_t ulSamples;
+    uint32_t ulStillSamples;
+    uint32_t ulArmed;
+    int32_t lTiltCosThresholdMilli;
+} TamperDetector_t;
+
+void vTamperDetectorInit(TamperDetector_t *pxDetector);
+
+/**
+ * @brief Feed one sample and update the windowed features.
+ *
+ * An event fires once when its feature crosses the threshold and re-arms only
+ * after the feature has dropped back by a quarter (hysteresis), so a long
+ * shake produces a single event rather than one per sample.
+ *
+ * @param[out] pxFeatures Features of this sample, may be NULL.
+ *
+ * @return The TAMPER_EVENT_ bits that fired on this sample.
+ */
+uint32_t ulTamperDetectorUpdate(TamperDetector_t *pxDetector,
+                                const ImuSample_t *pxSample,
+                                TamperFeatures_t *pxFeatures);
+
+#endif /* ifndef _TAMPER_DETECTOR_H_ */
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TASK_PROFILER_H_
+#define _TASK_PROFILER_H_
+
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+
+#include "core_mqtt.h"
+
+/**
+ * @brief Subscribe to the profile request topic,
+ * cmd/personalbox/<thing>/profile.
+ */
+BaseType_t xTaskProfilerInit(void);
+
+/**
+ * @brief Called by the MQTT event callback for every incoming publish.
+ *
+ * If it is a profile request, a short-lived task is started that measures
+ * every task's CPU share over #appconfigPROFILER_WINDOW_MS, then publishes
+ * the stack high water marks, CPU shares and heap figures on
+ * dt/personalbox/<thing>/profile and deletes itself. Requests arriving while
+ * a profile is being taken are ignored. The payload is not looked at.
+ *
+ * @return true if the publish was a profile request.
+ */
+bool xTaskProfilerHandlePublish(const MQTTPublishInfo_t *pxPublishInfo);
+
+#endif /* ifndef _TASK_PROFILER_H_ */
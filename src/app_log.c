@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "iot_logging_task.h"
+
+#include "app_config.h"
+#include "app_rtos.h"
+#include "app_sched.h"
+#include "app_log.h"
+
+/*-----------------------------------------------------------*/
+
+#define APP_LOG_TASK_STACK_SIZE    (2560U)
+
+/* Below every task that logs, so printing never delays one of them. */
+#define APP_LOG_TASK_PRIORITY      (tskIDLE_PRIORITY + APP_SCHED_PRIORITY_APP_LOG)
+
+#define APP_LOG_LINE_LENGTH        (160U)
+
+/**
+ * @brief What a log call leaves in the queue: no formatting has happened yet.
+ */
+typedef struct AppLogRecord
+{
+    TickType_t xTick;
+    const char *pcModule;
+    const char *pcFormat;
+    uint32_t ulArgs[4];
+    uint8_t ucLevel;
+} AppLogRecord_t;
+
+/*-----------------------------------------------------------*/
+
+static const char cLevelTags[] = { '-', 'E', 'W', 'I', 'D' };
+
+static QueueHandle_t xLogQueue = NULL;
+APP_QUEUE_STORAGE(xLogQueue, appconfigLOG_QUEUE_LENGTH, sizeof(AppLogRecord_t));
+
+APP_TASK_STORAGE(xLogTask, APP_LOG_TASK_STACK_SIZE);
+
+static uint32_t ulDropped = 0U;
+
+/*-----------------------------------------------------------*/
+
+static void prvFormat(const AppLogRecord_t *pxRecord, char *pcLine, size_t xLineLength) {
+    int lPrefix;
+
+    lPrefix = snprintf(pcLine, xLineLength, "%u %c %s: ",
+                       (unsigned) pxRecord->xTick,
+                       cLevelTags[pxRecord->ucLevel],
+                       pxRecord->pcModule);
+
+    if ((lPrefix > 0) && ((size_t) lPrefix < xLineLength)) {
+        /* The format decides which of the arguments it consumes. */
+        (void) snprintf(&pcLine[lPrefix], xLineLength - (size_t) lPrefix,
+                        pxRecord->pcFormat,
+                        pxRecord->ulArgs[0],
+                        pxRecord->ulArgs[1],
+                        pxRecord->ulArgs[2],
+                        pxRecord->ulArgs[3]);
+    }
+}
+
+/**
+ * @brief Format and print in the caller, before the log task exists. Kept
+ * out of line so the queueing path does not carry the line buffer on the
+ * stack of every caller.
+ */
+static void __attribute__((noinline)) prvLogNow(const AppLogRecord_t *pxRecord) {
+    char cLine[APP_LOG_LINE_LENGTH];
+
+    prvFormat(pxRecord, cLine, sizeof(cLine));
+    vLoggingPrintf("%s\r\n", cLine);
+}
+
+static void prvLogTask(void *pvParameters) {
+    char cLine[APP_LOG_LINE_LENGTH];
+    AppLogRecord_t xRecord;
+    uint32_t ulReported = 0U;
+    uint32_t ulNow;
+
+    (void) pvParameters;
+
+    for (;;) {
+        if (xQueueReceive(xLogQueue, &xRecord, portMAX_DELAY) == pdTRUE) {
+            prvFormat(&xRecord, cLine, sizeof(cLine));
+            printf("%s\r\n", cLine);
+        }
+
+        ulNow = __atomic_load_n(&ulDropped, __ATOMIC_RELAXED);
+
+        if (ulNow != ulReported) {
+            printf("%u log record(s) dropped, the log queue was full\r\n", (unsigned) (ulNow - ulReported));
+            ulReported = ulNow;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xAppLogInit(void) {
+    xLogQueue = APP_QUEUE_CREATE(xLogQueue);
+
+    if ((xLogQueue == NULL) ||
+        (APP_TASK_CREATE_PINNED(xLogTask, prvLogTask, "AppLog", NULL, APP_LOG_TASK_PRIORITY, NULL,
+                                APP_SCHED_CORE_APP_LOG) != pdPASS)) {
+        xLogQueue = NULL;
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+void vAppLogRecord(uint8_t ucLevel,
+                   const char *pcModule,
+                   const char *pcFormat,
+                   uint32_t ulArg0,
+                   uint32_t ulArg1,
+                   uint32_t ulArg2,
+                   uint32_t ulArg3) {
+    AppLogRecord_t xRecord;
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    BaseType_t xQueued;
+
+    xRecord.ucLevel = (ucLevel < sizeof(cLevelTags)) ? ucLevel : APP_LOG_LEVEL_NONE;
+    xRecord.pcModule = pcModule;
+    xRecord.pcFormat = pcFormat;
+    xRecord.ulArgs[0] = ulArg0;
+    xRecord.ulArgs[1] = ulArg1;
+    xRecord.ulArgs[2] = ulArg2;
+    xRecord.ulArgs[3] = ulArg3;
+
+    if (xPortInIsrContext()) {
+        xRecord.xTick = xTaskGetTickCountFromISR();
+
+        /* Nothing to fall back on in an interrupt. */
+        xQueued = (xLogQueue != NULL) ? xQueueSendToBackFromISR(xLogQueue, &xRecord, &xHigherPriorityTaskWoken) : pdFALSE;
+
+        if (xHigherPriorityTaskWoken == pdTRUE) {
+            portYIELD_FROM_ISR();
+        }
+    } else if (xLogQueue == NULL) {
+        /* Before xAppLogInit, e.g. during boot: hand it to the AFR logging task. */
+        xRecord.xTick = xTaskGetTickCount();
+        prvLogNow(&xRecord);
+        xQueued = pdTRUE;
+    } else {
+        xRecord.xTick = xTaskGetTickCount();
+        xQueued = xQueueSendToBack(xLogQueue, &xRecord, 0U);
+    }
+
+    if (xQueued != pdTRUE) {
+        (void) __atomic_fetch_add(&ulDropped, 1U, __ATOMIC_RELAXED);
+    }
+}
+
+uint32_t ulAppLogGetDropped(void) {
+    return __atomic_load_n(&ulDropped, __ATOMIC_RELAXED);
+}
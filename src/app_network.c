@@ -31,6 +31,14 @@
 #include "iot_demo_logging.h"
 #include "iot_init.h"
 
+#include "esp_event.h"
+#include "esp_wifi.h"
+#include "iot_wifi.h"
+#include "nvs.h"
+#include "tcpip_adapter.h"
+#include "lwip/ip4_addr.h"
+
+#include "app_config.h"
 #include "app_network.h"
 
 /*-----------------------------------------------------------*/
@@ -43,6 +51,31 @@ static IotSemaphore_t demoNetworkSemaphore;
 /* Variable used to indicate the connected network. */
 static uint32_t demoConnectedNetwork = AWSIOT_NETWORK_TYPE_NONE;
 
+#define WIFI_NVS_NAMESPACE    "wifi"
+#define WIFI_NVS_AP           "ap"
+
+#define WIFI_STATIC_IP_ENABLED    (sizeof(appconfigWIFI_STATIC_IP) > 1U)
+
+/**
+ * @brief The access point of the last good connection.
+ */
+typedef struct WifiApHint
+{
+    uint8_t ucSsid[32];
+    uint8_t ucBssid[6];
+    uint8_t ucChannel;
+    uint8_t ucReserved;
+} WifiApHint_t;
+
+/* Only valid while it has not failed to associate in this boot. */
+static WifiApHint_t xApHint;
+static bool xApHintValid = false;
+
+/* Set while an association is being attempted with the hint. */
+static bool xApHintInUse = false;
+
+static portMUX_TYPE xApHintLock = portMUX_INITIALIZER_UNLOCKED;
+
 
 /*-----------------------------------------------------------*/
 
@@ -73,6 +106,177 @@ static uint32_t _waitForDemoNetworkConnection(appMqttContext_t *pAppMqttContext)
 
 /*-----------------------------------------------------------*/
 
+/* SSIDs are NUL-padded only when shorter than 32 bytes. */
+static bool _isHintSsid(const uint8_t *pSsid)
+{
+    size_t length = strnlen((const char *) pSsid, sizeof(xApHint.ucSsid));
+
+    return (length == strnlen((const char *) xApHint.ucSsid, sizeof(xApHint.ucSsid))) &&
+           (memcmp(pSsid, xApHint.ucSsid, length) == 0);
+}
+
+esp_err_t __real_esp_wifi_set_config(wifi_interface_t interface,
+                                     wifi_config_t *conf);
+
+/**
+ * @brief Linked in place of esp_wifi_set_config (see CMakeLists.txt), since
+ * the Wi-Fi port fills in the station config itself and leaves the BSSID
+ * and channel unset, which makes every association start with a scan.
+ */
+esp_err_t __wrap_esp_wifi_set_config(wifi_interface_t interface,
+                                     wifi_config_t *conf)
+{
+    if ((interface == ESP_IF_WIFI_STA) && (conf != NULL) && (conf->sta.bssid_set == 0))
+    {
+        portENTER_CRITICAL(&xApHintLock);
+
+        xApHintInUse = xApHintValid && _isHintSsid(conf->sta.ssid);
+
+        if (xApHintInUse)
+        {
+            memcpy(conf->sta.bssid, xApHint.ucBssid, sizeof(conf->sta.bssid));
+            conf->sta.bssid_set = 1;
+            conf->sta.channel = xApHint.ucChannel;
+        }
+
+        portEXIT_CRITICAL(&xApHintLock);
+    }
+
+    return __real_esp_wifi_set_config(interface, conf);
+}
+
+/*-----------------------------------------------------------*/
+
+static void _applyStaticIp(void)
+{
+    tcpip_adapter_ip_info_t ipInfo = { 0 };
+    tcpip_adapter_dns_info_t dnsInfo = { 0 };
+
+    ipInfo.ip.addr = ipaddr_addr(appconfigWIFI_STATIC_IP);
+    ipInfo.netmask.addr = ipaddr_addr(appconfigWIFI_STATIC_NETMASK);
+    ipInfo.gw.addr = ipaddr_addr(appconfigWIFI_STATIC_GATEWAY);
+
+    /* Stopping the DHCP client may fail if it already is; the address is
+     * what matters. Once it is set the stack reports GOT_IP by itself. */
+    (void) tcpip_adapter_dhcpc_stop(TCPIP_ADAPTER_IF_STA);
+
+    if (tcpip_adapter_set_ip_info(TCPIP_ADAPTER_IF_STA, &ipInfo) != ESP_OK)
+    {
+        IotLogError("Failed to set the static IP address " appconfigWIFI_STATIC_IP ".");
+    }
+
+    if (sizeof(appconfigWIFI_STATIC_DNS) > 1U)
+    {
+        dnsInfo.ip.type = IPADDR_TYPE_V4;
+        dnsInfo.ip.u_addr.ip4.addr = ipaddr_addr(appconfigWIFI_STATIC_DNS);
+        (void) tcpip_adapter_set_dns_info(TCPIP_ADAPTER_IF_STA, TCPIP_ADAPTER_DNS_MAIN, &dnsInfo);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void _onWifiEvent(void *pArg,
+                         esp_event_base_t eventBase,
+                         int32_t eventId,
+                         void *pEventData)
+{
+    (void) pArg;
+    (void) eventBase;
+    (void) pEventData;
+
+    if (eventId == WIFI_EVENT_STA_CONNECTED)
+    {
+        portENTER_CRITICAL(&xApHintLock);
+        xApHintInUse = false;
+        portEXIT_CRITICAL(&xApHintLock);
+
+        if (WIFI_STATIC_IP_ENABLED)
+        {
+            _applyStaticIp();
+        }
+    }
+    else if (eventId == WIFI_EVENT_STA_DISCONNECTED)
+    {
+        bool hintFailed;
+
+        /* The access point has moved or gone: the network manager retries,
+         * this time with a full scan. */
+        portENTER_CRITICAL(&xApHintLock);
+        hintFailed = xApHintInUse;
+        xApHintInUse = false;
+        xApHintValid = xApHintValid && !hintFailed;
+        portEXIT_CRITICAL(&xApHintLock);
+
+        if (hintFailed)
+        {
+            IotLogWarn("Cached access point not reachable, falling back to a full scan.");
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void _loadApHint(void)
+{
+    nvs_handle handle;
+    size_t length = sizeof(xApHint);
+
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK)
+    {
+        if ((nvs_get_blob(handle, WIFI_NVS_AP, &xApHint, &length) == ESP_OK) &&
+            (length == sizeof(xApHint)))
+        {
+            xApHintValid = true;
+            IotLogInfo("Fast connect to %02x:%02x:%02x:%02x:%02x:%02x on channel %u.",
+                       xApHint.ucBssid[0], xApHint.ucBssid[1], xApHint.ucBssid[2],
+                       xApHint.ucBssid[3], xApHint.ucBssid[4], xApHint.ucBssid[5],
+                       (unsigned) xApHint.ucChannel);
+        }
+
+        nvs_close(handle);
+    }
+}
+
+/**
+ * @brief Remember the access point just associated with. Flash is only
+ * written when it differs from the cached one.
+ */
+static void _storeApHint(void)
+{
+    wifi_ap_record_t apInfo;
+    WifiApHint_t hint = { 0 };
+    nvs_handle handle;
+    bool changed;
+
+    if (esp_wifi_sta_get_ap_info(&apInfo) != ESP_OK)
+    {
+        return;
+    }
+
+    memcpy(hint.ucSsid, apInfo.ssid, strnlen((const char *) apInfo.ssid, sizeof(hint.ucSsid)));
+    memcpy(hint.ucBssid, apInfo.bssid, sizeof(hint.ucBssid));
+    hint.ucChannel = apInfo.primary;
+
+    portENTER_CRITICAL(&xApHintLock);
+    changed = !xApHintValid || (memcmp(&hint, &xApHint, sizeof(hint)) != 0);
+    xApHint = hint;
+    xApHintValid = true;
+    portEXIT_CRITICAL(&xApHintLock);
+
+    if (changed && (nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK))
+    {
+        if ((nvs_set_blob(handle, WIFI_NVS_AP, &hint, sizeof(hint)) != ESP_OK) ||
+            (nvs_commit(handle) != ESP_OK))
+        {
+            IotLogWarn("Failed to cache the access point.");
+        }
+
+        nvs_close(handle);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 static void _onNetworkStateChangeCallback(uint32_t network,
                                           AwsIotNetworkState_t state,
                                           void *pContext)
@@ -88,6 +292,11 @@ static void _onNetworkStateChangeCallback(uint32_t network,
         demoConnectedNetwork = network;
         IotSemaphore_Post(&demoNetworkSemaphore);
 
+        if (appconfigWIFI_FAST_CONNECT && (network == AWSIOT_NETWORK_TYPE_WIFI))
+        {
+            _storeApHint();
+        }
+
         /* Disable the disconnected networks to save power and reclaim any unused memory. */
         disconnectedNetworks = configENABLED_NETWORKS & (~demoConnectedNetwork);
 
@@ -210,6 +419,29 @@ int network_initialize(appMqttContext_t *pContext)
         }
     }
 
+    if (status == EXIT_SUCCESS)
+    {
+        esp_err_t err;
+
+        if (appconfigWIFI_FAST_CONNECT)
+        {
+            _loadApHint();
+        }
+
+        /* The Wi-Fi port creates the default loop as well and accepts that
+         * it already exists. */
+        err = esp_event_loop_create_default();
+
+        if (((err != ESP_OK) && (err != ESP_ERR_INVALID_STATE)) ||
+            (esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, _onWifiEvent, NULL) != ESP_OK))
+        {
+            /* Only the fallback from a stale access point and the static
+             * address depend on it. */
+            IotLogWarn("Failed to register the Wi-Fi event handler.");
+            xApHintValid = false;
+        }
+    }
+
     IotLogInfo("AwsIotNetworkManager_EnableNetwork");
     /* Initialize all the  networks configured for the device. */
     if (status == EXIT_SUCCESS)
@@ -261,4 +493,32 @@ appNetworkSetting_t getNetworkSetting()
         .pCredentials = AwsIotNetworkManager_GetCredentials(demoConnectedNetwork),
     };
     return setting;
-}
\ No newline at end of file
+}
+
+void vLabConnectionResetWifiNetworks(void)
+{
+    WIFINetworkProfile_t profile;
+    nvs_handle handle;
+    uint16_t deleted = 0;
+
+    /* Deleting a profile moves the ones after it down. */
+    while ((deleted < wificonfigMAX_NETWORK_PROFILES) &&
+           (WIFI_NetworkGet(&profile, 0) == eWiFiSuccess) &&
+           (WIFI_NetworkDelete(0) == eWiFiSuccess))
+    {
+        deleted++;
+    }
+
+    portENTER_CRITICAL(&xApHintLock);
+    xApHintValid = false;
+    portEXIT_CRITICAL(&xApHintLock);
+
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK)
+    {
+        (void) nvs_erase_key(handle, WIFI_NVS_AP);
+        (void) nvs_commit(handle);
+        nvs_close(handle);
+    }
+
+    IotLogInfo("Forgot %u Wi-Fi networks and the cached access point.", (unsigned) deleted);
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "event_groups.h"
+
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "rom/crc.h"
+
+#include "aws_dev_mode_key_provisioning.h"
+#include "aws_clientcredential_keys.h"
+#include "core_pkcs11.h"
+#include "core_pkcs11_config.h"
+#include "iot_demo_logging.h"
+
+#include "app_rtos.h"
+#include "boot.h"
+
+/*-----------------------------------------------------------*/
+
+#define BOOT_NVS_NAMESPACE    "boot"
+#define BOOT_NVS_KEYS_CRC     "keysCrc"
+
+/* Where the PKCS #11 objects are, so the CRC is erased and restored with
+ * them. */
+#define BOOT_KEYS_PARTITION   "storage"
+
+static const char *const pcPhaseNames[BootPhaseCount] =
+        {
+                [BootPhaseSystem] = "system",
+                [BootPhaseKeys] = "keys",
+                [BootPhaseDevice] = "device",
+                [BootPhaseNetwork] = "network",
+                [BootPhaseMqtt] = "mqtt",
+                [BootPhaseFirstDelta] = "first delta"
+        };
+
+static EventGroupHandle_t xBootEvents = NULL;
+APP_EVENT_GROUP_STORAGE(xBootEvents);
+
+/**
+ * @brief Microseconds since reset at which each phase completed, 0 if not yet.
+ */
+static int64_t llPhaseDoneAt[BootPhaseCount];
+
+/**
+ * @brief Free internal RAM when each phase completed, the measured side of
+ * the buffer sizes in app_config.h and sdkconfig.
+ */
+static uint32_t ulPhaseFreeRam[BootPhaseCount];
+
+/*-----------------------------------------------------------*/
+
+static void prvLogTimings(void) {
+    size_t i;
+
+    for (i = 0; i < BootPhaseCount; i++) {
+        if (llPhaseDoneAt[i] != 0) {
+            IotLogInfo("boot: %-12s at %6u ms, %6u bytes free",
+                       pcPhaseNames[i],
+                       (unsigned) (llPhaseDoneAt[i] / 1000),
+                       (unsigned) ulPhaseFreeRam[i]);
+        }
+    }
+
+    /* The low water mark so far includes the TLS handshake, the peak of the
+     * whole run. */
+    IotLogInfo("boot: internal RAM minimum free %u bytes, largest block %u bytes",
+               (unsigned) heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL),
+               (unsigned) heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+}
+
+BaseType_t xBootInit(void) {
+    xBootEvents = APP_EVENT_GROUP_CREATE(xBootEvents);
+
+    return (xBootEvents != NULL) ? pdPASS : pdFAIL;
+}
+
+void vBootMark(BootPhase_t ePhase) {
+    EventBits_t xBit = (EventBits_t) (1UL << ePhase);
+
+    configASSERT(ePhase < BootPhaseCount);
+
+    if ((xBootEvents == NULL) || ((xEventGroupGetBits(xBootEvents) & xBit) != 0U)) {
+        return;
+    }
+
+    llPhaseDoneAt[ePhase] = esp_timer_get_time();
+    ulPhaseFreeRam[ePhase] = (uint32_t) heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    (void) xEventGroupSetBits(xBootEvents, xBit);
+
+    if (ePhase == BootPhaseMqtt) {
+        prvLogTimings();
+    } else if (ePhase == BootPhaseFirstDelta) {
+        IotLogInfo("boot: time to first delta %u ms", (unsigned) (llPhaseDoneAt[ePhase] / 1000));
+    }
+}
+
+BaseType_t xBootWait(BootPhase_t ePhase, TickType_t xTicksToWait) {
+    EventBits_t xBit = (EventBits_t) (1UL << ePhase);
+
+    configASSERT((ePhase < BootPhaseCount) && (xBootEvents != NULL));
+
+    return ((xEventGroupWaitBits(xBootEvents, xBit, pdFALSE, pdTRUE, xTicksToWait) & xBit) != 0U) ? pdTRUE : pdFALSE;
+}
+
+uint32_t ulBootPhaseDoneMs(BootPhase_t ePhase) {
+    configASSERT(ePhase < BootPhaseCount);
+
+    return (uint32_t) (llPhaseDoneAt[ePhase] / 1000);
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief CRC of the compiled-in credentials, so that flashing a firmware
+ * with new credentials imports them again. 0 if there are none.
+ */
+static uint32_t prvCredentialsCrc(void) {
+    const char *pcCertificate = keyCLIENT_CERTIFICATE_PEM;
+    const char *pcPrivateKey = keyCLIENT_PRIVATE_KEY_PEM;
+    uint32_t ulCrc;
+
+    if ((pcCertificate == NULL) || (pcPrivateKey == NULL) ||
+        (pcCertificate[0] == '\0') || (pcPrivateKey[0] == '\0')) {
+        return 0U;
+    }
+
+    ulCrc = crc32_le(0U, (const uint8_t *) pcCertificate, strlen(pcCertificate));
+    ulCrc = crc32_le(ulCrc, (const uint8_t *) pcPrivateKey, strlen(pcPrivateKey));
+
+    /* Keep 0 for "no credentials". */
+    return (ulCrc == 0U) ? 1U : ulCrc;
+}
+
+static bool prvObjectExists(CK_SESSION_HANDLE xSession, const char *pcLabel, CK_OBJECT_CLASS xClass) {
+    CK_OBJECT_HANDLE xObject = CK_INVALID_HANDLE;
+
+    return (xFindObjectWithLabelAndClass(xSession, (char *) pcLabel, strlen(pcLabel), xClass, &xObject) == CKR_OK) &&
+           (xObject != CK_INVALID_HANDLE);
+}
+
+/**
+ * @brief What vDevModeKeyProvisioning does, but with the result.
+ */
+static CK_RV prvImportCredentials(CK_SESSION_HANDLE xSession) {
+    const char *pcJitpCertificate = keyJITR_DEVICE_CERTIFICATE_AUTHORITY_PEM;
+    ProvisioningParams_t xParams;
+
+    (void) memset(&xParams, 0x00, sizeof(xParams));
+    xParams.pucClientPrivateKey = (uint8_t *) keyCLIENT_PRIVATE_KEY_PEM;
+    xParams.ulClientPrivateKeyLength = 1U + strlen(keyCLIENT_PRIVATE_KEY_PEM);
+    xParams.pucClientCertificate = (uint8_t *) keyCLIENT_CERTIFICATE_PEM;
+    xParams.ulClientCertificateLength = 1U + strlen(keyCLIENT_CERTIFICATE_PEM);
+
+    if ((pcJitpCertificate != NULL) && (pcJitpCertificate[0] != '\0')) {
+        xParams.pucJITPCertificate = (uint8_t *) pcJitpCertificate;
+        xParams.ulJITPCertificateLength = 1U + strlen(pcJitpCertificate);
+    }
+
+    return xProvisionDevice(xSession, &xParams);
+}
+
+void vBootProvisionKeys(void) {
+    CK_FUNCTION_LIST_PTR pxFunctionList = NULL;
+    CK_SESSION_HANDLE xSession = CK_INVALID_HANDLE;
+    uint32_t ulCrc = prvCredentialsCrc();
+    uint32_t ulStoredCrc = 0U;
+    nvs_handle xHandle = 0;
+    bool xStore;
+    CK_RV xResult;
+
+    if ((ulCrc == 0U) ||
+        (C_GetFunctionList(&pxFunctionList) != CKR_OK) ||
+        (xInitializePkcs11Session(&xSession) != CKR_OK)) {
+        /* Nothing compiled in to compare with, or no way to look. */
+        vDevModeKeyProvisioning();
+        vBootMark(BootPhaseKeys);
+        return;
+    }
+
+    xStore = (nvs_flash_init_partition(BOOT_KEYS_PARTITION) == ESP_OK) &&
+             (nvs_open_from_partition(BOOT_KEYS_PARTITION, BOOT_NVS_NAMESPACE, NVS_READWRITE, &xHandle) == ESP_OK);
+
+    /* The CRC only says which credentials were imported; the objects may
+     * have gone since, with an erase of the partition. */
+    if (xStore &&
+        (nvs_get_u32(xHandle, BOOT_NVS_KEYS_CRC, &ulStoredCrc) == ESP_OK) &&
+        (ulStoredCrc == ulCrc) &&
+        prvObjectExists(xSession, pkcs11configLABEL_DEVICE_CERTIFICATE_FOR_TLS, CKO_CERTIFICATE) &&
+        prvObjectExists(xSession, pkcs11configLABEL_DEVICE_PRIVATE_KEY_FOR_TLS, CKO_PRIVATE_KEY)) {
+        IotLogInfo("boot: credentials already provisioned");
+    } else {
+        /* The import rewrites the PKCS #11 objects in flash, which is why it
+         * is worth skipping. */
+        xResult = prvImportCredentials(xSession);
+
+        if (xResult != CKR_OK) {
+            IotLogError("boot: importing the credentials failed: 0x%lx", (unsigned long) xResult);
+        } else if (xStore && (nvs_set_u32(xHandle, BOOT_NVS_KEYS_CRC, ulCrc) == ESP_OK)) {
+            (void) nvs_commit(xHandle);
+        }
+    }
+
+    if (xStore) {
+        nvs_close(xHandle);
+    }
+
+    (void) pxFunctionList->C_CloseSession(xSession);
+    vBootMark(BootPhaseKeys);
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+#include "esp_event.h"
+#include "esp_system.h"
+
+#include "iot_demo_logging.h"
+
+#include "app_config.h"
+#include "app_network.h"
+#include "app_rtos.h"
+#include "device.h"
+#include "flash_writer.h"
+#include "lock_state.h"
+#include "button_input.h"
+
+#define APP_LOG_MODULE    "button"
+#include "app_log.h"
+
+/*-----------------------------------------------------------*/
+
+#define BUTTON_UNLOCK_MASK    (appconfigBUTTON_UNLOCK_MASK & LOCK_STATE_ALL_MASK)
+
+/**
+ * @brief Last accepted event of each button, only touched by the event loop
+ * task.
+ */
+typedef struct ButtonDebounce
+{
+    TickType_t xLast;
+    bool xSeen;
+} ButtonDebounce_t;
+
+static ButtonDebounce_t xMainButton;
+static ButtonDebounce_t xResetButton;
+
+APP_TIMER_STORAGE(xRestartTimer);
+static TimerHandle_t xRestartTimer = NULL;
+
+/* Set before the restart timer is started, read by its callback. */
+static volatile bool xForgetWifi = false;
+
+/*-----------------------------------------------------------*/
+
+static bool prvDebounce(ButtonDebounce_t *pxButton) {
+    TickType_t xNow = xTaskGetTickCount();
+
+    if (pxButton->xSeen && ((xNow - pxButton->xLast) < pdMS_TO_TICKS(appconfigBUTTON_DEBOUNCE_MS))) {
+        return false;
+    }
+
+    pxButton->xLast = xNow;
+    pxButton->xSeen = true;
+
+    return true;
+}
+
+/**
+ * @brief Runs on the timer service task, like a coalesced shadow delta.
+ */
+static void prvLocalUnlock(void *pvParameter1, uint32_t ulParameter2) {
+    (void) pvParameter1;
+    (void) ulParameter2;
+
+    if (xLockStateRequestOpen(BUTTON_UNLOCK_MASK) == pdPASS) {
+        AppLogInfo("Local unlock of 0x%02x.", BUTTON_UNLOCK_MASK);
+    }
+}
+
+static void prvForgetWifiAndRestart(void *pvParameter1, uint32_t ulParameter2) {
+    (void) pvParameter1;
+    (void) ulParameter2;
+
+    vLabConnectionResetWifiNetworks();
+    esp_restart();
+}
+
+static void prvRestartTimerCallback(TimerHandle_t xTimer) {
+    (void) xTimer;
+
+    /* Erasing the networks writes to flash, which the timer service task
+     * leaves to the flash writer; the box is going down either way. */
+    if (xForgetWifi && (xFlashWriterPend(prvForgetWifiAndRestart, NULL, 0U) == pdPASS)) {
+        return;
+    }
+
+    if (xForgetWifi) {
+        vLabConnectionResetWifiNetworks();
+    }
+
+    esp_restart();
+}
+
+static void prvScheduleRestart(bool xResetWifi) {
+    if (xResetWifi) {
+        xForgetWifi = true;
+    }
+
+    /* Restarting a running timer only moves its expiry. */
+    if (xTimerReset(xRestartTimer, 0U) != pdPASS) {
+        AppLogWarn("Timer queue full, restart dropped.");
+        return;
+    }
+
+    AppLogInfo("Restarting in %u ms%s.",
+               appconfigBUTTON_RESTART_DELAY_MS,
+               xForgetWifi ? ", forgetting the Wi-Fi networks" : "");
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvMainButtonHandler(void *pvHandlerArg, esp_event_base_t xBase, int32_t lId, void *pvEventData) {
+    (void) pvHandlerArg;
+    (void) pvEventData;
+
+    if ((xBase != BUTTON_MAIN_EVENT_BASE) || !prvDebounce(&xMainButton)) {
+        return;
+    }
+
+    if ((lId == BUTTON_CLICK) && (BUTTON_UNLOCK_MASK != 0U)) {
+        /* Not from here: the lock table mutex may be held by an unlock in
+         * progress, and the event loop must not wait for it. */
+        if (xTimerPendFunctionCall(prvLocalUnlock, NULL, 0U, 0U) != pdPASS) {
+            AppLogWarn("Timer queue full, local unlock dropped.");
+        }
+    }
+}
+
+static void prvResetButtonHandler(void *pvHandlerArg, esp_event_base_t xBase, int32_t lId, void *pvEventData) {
+    (void) pvHandlerArg;
+    (void) pvEventData;
+
+    if ((xBase != BUTTON_RESET_EVENT_BASE) || !prvDebounce(&xResetButton)) {
+        return;
+    }
+
+    if (lId == BUTTON_CLICK) {
+        prvScheduleRestart(false);
+    } else if (lId == BUTTON_HOLD) {
+        prvScheduleRestart(true);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xButtonInputInit(void) {
+    BaseType_t xResult = pdPASS;
+
+    xRestartTimer = APP_TIMER_CREATE(xRestartTimer,
+                                     "restart",
+                                     pdMS_TO_TICKS(appconfigBUTTON_RESTART_DELAY_MS),
+                                     pdFALSE,
+                                     NULL,
+                                     prvRestartTimerCallback);
+
+    if (xRestartTimer == NULL) {
+        IotLogError("xButtonInputInit: failed to create the restart timer");
+        return pdFAIL;
+    }
+
+    if (eDeviceRegisterButtonCallback(BUTTON_MAIN_EVENT_BASE, prvMainButtonHandler) != ESP_OK) {
+        IotLogError("xButtonInputInit: register main button ... failed");
+        xResult = pdFAIL;
+    }
+
+    if (eDeviceRegisterButtonCallback(BUTTON_RESET_EVENT_BASE, prvResetButtonHandler) != ESP_OK) {
+        IotLogError("xButtonInputInit: register reset button ... failed");
+        xResult = pdFAIL;
+    }
+
+    return xResult;
+}
@@ -20,8 +20,6 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
-#define democonfigNETWORK_BUFFER_SIZE (1024U)
-
 /* The config header is always included first. */
 #include "iot_config.h"
 
@@ -38,83 +36,103 @@
 #include "platform/iot_threads.h"
 
 #include "semphr.h"
-#include "esp_log.h"
 #include "esp_event.h"
 
+#include "app_config.h"
+#include "app_rtos.h"
+#include "app_sched.h"
+#include "boot.h"
 #include "device.h"
 #include "controller.h"
 #include "shadow_client.h"
+#include "power_manager.h"
+#include "power_monitor.h"
+#include "imu_sampler.h"
+#include "imu_telemetry.h"
+#include "latency_probe.h"
+#include "task_profiler.h"
+#include "ota_client.h"
+#include "button_input.h"
+#include "flash_writer.h"
 
 
-static const char *TAG = "project";
+APP_TASK_STORAGE(xSubscribeTask, configMINIMAL_STACK_SIZE * 8);
 
-void _mainButtonEventHandler(void *handler_arg, esp_event_base_t base, int32_t id, void *event_data) {
-    if (base == BUTTON_MAIN_EVENT_BASE) {
-        if (id == BUTTON_CLICK) {
-            ESP_LOGI(TAG, "Main Button Pressed");
-        }
-        if (id == BUTTON_HOLD) {
-            ESP_LOGI(TAG, "Main Button Held");
-        }
+esp_err_t eControllerRun(void) {
+    esp_err_t res = ESP_FAIL;
+
+    if (xPowerManagerInit() != pdPASS) {
+        IotLogError("eControllerRun: power management init ... failed");
     }
-}
 
-void _resetButtonEventHandler(void *handler_arg, esp_event_base_t base, int32_t id, void *event_data) {
-    if (base == BUTTON_RESET_EVENT_BASE) {
-        if (id == BUTTON_HOLD) {
-            ESP_LOGI(TAG, "Reset Button Held");
-            ESP_LOGI(TAG, "Reseting Wifi Networks");
-            //vLabConnectionResetWifiNetworks();
-        }
-        if (id == BUTTON_CLICK) {
-            ESP_LOGI(TAG, "Reset Button Clicked");
-            ESP_LOGI(TAG, "Restarting in 2secs");
-            vTaskDelay(pdMS_TO_TICKS(2000));
-            esp_restart();
-        }
+    /* Before the shadow client, whose journal and version cache use it. */
+    if (xFlashWriterInit() != pdPASS) {
+        IotLogError("eControllerRun: flash writer init ... failed");
     }
-}
 
-esp_err_t eControllerRun(void) {
-    esp_err_t res = ESP_FAIL;
+    if (xShadowClientInit() != pdPASS) {
+        IotLogError("eControllerRun: shadow client init ... failed");
+        return ESP_FAIL;
+    }
 
-    res = eDeviceInit();
+    /* Start Wi-Fi association first: it takes longest and mostly waits on
+     * the radio, so the device bring-up below runs while it is going on. */
+    static TaskHandle_t xCoreMqttTask = NULL;
 
-    if (res == ESP_OK) {
+    BaseType_t xReturned;
+    xReturned = APP_TASK_CREATE_PINNED(xSubscribeTask, subscribeUpdateTask, "subscribe", NULL,
+                                       tskIDLE_PRIORITY + APP_SCHED_PRIORITY_MQTT, &xCoreMqttTask,
+                                       APP_SCHED_CORE_MQTT);
+    if (xReturned != pdPASS) {
+        IotLogError("error while creating subscribeUpdateTask");
+        return ESP_FAIL;
+    }
 
-        res = eDeviceRegisterButtonCallback(BUTTON_MAIN_EVENT_BASE, _mainButtonEventHandler);
-        if (res != ESP_OK) {
-            IotLogError("eControllerRun: Register main button ... failed");
-        }
+    res = eDeviceInit();
 
-        res = eDeviceRegisterButtonCallback(BUTTON_RESET_EVENT_BASE, _resetButtonEventHandler);
-        if (res != ESP_OK) {
-            IotLogError("eControllerRun: Register reset button ... failed");
+    if (res == ESP_OK) {
+        if (xButtonInputInit() != pdPASS) {
+            IotLogError("eControllerRun: button input init ... failed");
         }
     } else {
         IotLogError("eControllerRun: eControllerRun ... failed");
     }
 
-    static TaskHandle_t xCoreMqttTask = NULL, xActuatorTask = NULL, xPublishTask = NULL;
+    /* The shadow client waits for this before it handles any delta. */
+    vBootMark(BootPhaseDevice);
 
-    BaseType_t xReturned;
-    xReturned = xTaskCreate(publishCurrentStateTask, "publish", configMINIMAL_STACK_SIZE * 8, (void *) NULL,
-                            tskIDLE_PRIORITY + 4, &xPublishTask);
+    /* Tamper detection and battery monitoring guard the box itself, so they
+     * start now rather than after the network, which may never come up.
+     * Telemetry only queues publishes, so it does not depend on the session
+     * either; the IMU interrupt load during the TLS handshake is the price. */
+#if defined(DEVICE_HAS_ACCELEROMETER)
+    if ((xImuSamplerInit() != pdPASS) || (xImuTelemetryInit() != pdPASS)) {
+        IotLogError("eControllerRun: IMU telemetry init ... failed");
+    }
+#endif
 
-    if (xReturned != pdPASS) {
-        IotLogError("error while creating publishCurrentStateTask");
+#if defined(DEVICE_HAS_BATTERY)
+    if (xPowerMonitorInit() != pdPASS) {
+        IotLogError("eControllerRun: power monitor init ... failed");
     }
+#endif
 
-    xReturned = xTaskCreate(runActuatorTask, "actuator", configMINIMAL_STACK_SIZE * 8, &xPublishTask,
-                            tskIDLE_PRIORITY + 4, &xActuatorTask);
-    if (xReturned != pdPASS) {
-        IotLogError("error while creating runActuatorTask");
+    /* The rest only serves the connection, so keep it out of the way of the
+     * TLS handshake. */
+    if (xBootWait(BootPhaseMqtt, pdMS_TO_TICKS(appconfigBOOT_DEFERRED_INIT_TIMEOUT_MS)) != pdTRUE) {
+        IotLogWarn("eControllerRun: no MQTT session yet, starting the remaining services anyway");
     }
 
-    xReturned = xTaskCreate(subscribeUpdateTask, "subscribe", configMINIMAL_STACK_SIZE * 8, &xActuatorTask,
-                            tskIDLE_PRIORITY + 5, &xCoreMqttTask);
-    if (xReturned != pdPASS) {
-        IotLogError("error while creating subscribeUpdateTask");
+    if (xTaskProfilerInit() != pdPASS) {
+        IotLogError("eControllerRun: task profiler init ... failed");
+    }
+
+    if (xOtaClientInit() != pdPASS) {
+        IotLogError("eControllerRun: OTA client init ... failed");
+    }
+
+    if (xLatencyProbeInit() != pdPASS) {
+        IotLogError("eControllerRun: latency metrics init ... failed");
     }
 
     return res;
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "iot_demo_logging.h"
+
+#include "app_config.h"
+#include "app_rtos.h"
+#include "app_sched.h"
+#include "device.h"
+#include "display_service.h"
+
+/*-----------------------------------------------------------*/
+
+#define SCREEN_OFFSET              (2)
+#define SCREEN_LINE_HEIGHT         (14)
+#define SCREEN_LINE(n)             (SCREEN_OFFSET + ((n) - 1) * SCREEN_LINE_HEIGHT)
+#define SCREEN_STATUS_LINE         (DISPLAY_HEIGHT - 13)
+
+#define DISPLAY_TASK_STACK_SIZE    (3072U)
+#define DISPLAY_TASK_PRIORITY      (tskIDLE_PRIORITY + APP_SCHED_PRIORITY_DISPLAY)
+
+/**
+ * @brief Where a region sits on the screen and what it shows.
+ */
+typedef struct DisplayRegionModel
+{
+    int lX;              /**< Text position, or CENTER/RIGHT. */
+    int lY;
+    int lClearX;         /**< Area to blank before drawing the new text. */
+    int lClearWidth;
+    bool xDirty;
+    char cText[DISPLAY_REGION_TEXT_LENGTH + 1];
+} DisplayRegionModel_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The screen as last drawn, plus pending changes. Only the display
+ * task touches it.
+ */
+static DisplayRegionModel_t xScreen[DisplayRegionCount] =
+        {
+                [DisplayRegionLine1] = {CENTER, SCREEN_LINE(1), 0, DISPLAY_WIDTH, true, "FreeRTOS"},
+                [DisplayRegionLine2] = {CENTER, SCREEN_LINE(2), 0, DISPLAY_WIDTH, true, "PERSONAL BOX"},
+                [DisplayRegionLine3] = {CENTER, SCREEN_LINE(3), 0, DISPLAY_WIDTH, true, "LOCKED"},
+                [DisplayRegionLine4] = {CENTER, SCREEN_LINE(4), 0, DISPLAY_WIDTH, true, "DEMO"},
+                [DisplayRegionBattery] = {1, SCREEN_STATUS_LINE, 0, DISPLAY_WIDTH / 2, false, ""},
+                [DisplayRegionNetwork] = {RIGHT, SCREEN_STATUS_LINE, DISPLAY_WIDTH / 2, DISPLAY_WIDTH / 2, true, "OFFLINE"}
+        };
+
+/**
+ * @brief The newest text asked for in each region since the display task
+ * last looked, with a bit per region in ulPendingMask. A later request
+ * replaces an earlier one, so the newest state always wins and a request
+ * never has to wait for room.
+ */
+static char cPendingText[DisplayRegionCount][DISPLAY_REGION_TEXT_LENGTH + 1];
+static uint32_t ulPendingMask = 0U;
+
+static portMUX_TYPE xPendingLock = portMUX_INITIALIZER_UNLOCKED;
+
+static TaskHandle_t xDisplayTaskHandle = NULL;
+
+APP_TASK_STORAGE(xDisplayTask, DISPLAY_TASK_STACK_SIZE);
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Take over the pending texts. A region is only marked for redrawing
+ * if its text actually changed.
+ */
+static void prvApplyPending(void) {
+    char cText[DISPLAY_REGION_TEXT_LENGTH + 1];
+    DisplayRegionModel_t *pxRegion;
+    uint32_t ulMask;
+    size_t i;
+
+    for (i = 0; i < DisplayRegionCount; i++) {
+        portENTER_CRITICAL(&xPendingLock);
+        ulMask = ulPendingMask & (1UL << i);
+        if (ulMask != 0U) {
+            (void) memcpy(cText, cPendingText[i], sizeof(cText));
+            ulPendingMask &= ~ulMask;
+        }
+        portEXIT_CRITICAL(&xPendingLock);
+
+        pxRegion = &xScreen[i];
+
+        if ((ulMask != 0U) && (strcmp(pxRegion->cText, cText) != 0)) {
+            (void) strcpy(pxRegion->cText, cText);
+            pxRegion->xDirty = true;
+        }
+    }
+}
+
+static void prvFlush(void) {
+    DisplayRegionModel_t *pxRegion;
+    size_t i;
+
+    for (i = 0; i < DisplayRegionCount; i++) {
+        pxRegion = &xScreen[i];
+
+        if (pxRegion->xDirty) {
+            TFT_fillRect(pxRegion->lClearX, pxRegion->lY, pxRegion->lClearWidth, SCREEN_LINE_HEIGHT - 1,
+                         TFT_FONT_BACKGROUND);
+            TFT_print(pxRegion->cText, pxRegion->lX, pxRegion->lY);
+            pxRegion->xDirty = false;
+        }
+    }
+}
+
+static void prvDisplayTask(void *pvParameters) {
+    (void) pvParameters;
+
+    for (;;) {
+        prvFlush();
+
+        /* Everything asked for meanwhile is folded in, so each region is
+         * drawn once, with its newest text. */
+        (void) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        prvApplyPending();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xDisplayServiceInit(void) {
+    if (APP_TASK_CREATE_PINNED(xDisplayTask,
+                               prvDisplayTask,
+                               "Display",
+                               NULL,
+                               DISPLAY_TASK_PRIORITY,
+                               &xDisplayTaskHandle,
+                               APP_SCHED_CORE_DISPLAY) != pdPASS) {
+        IotLogError("xDisplayServiceInit: failed to create the display task");
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+BaseType_t xDisplaySetText(DisplayRegion_t eRegion, const char *pcText) {
+    char cText[DISPLAY_REGION_TEXT_LENGTH + 1];
+
+    if ((xDisplayTaskHandle == NULL) || (eRegion >= DisplayRegionCount) || (pcText == NULL)) {
+        return pdFAIL;
+    }
+
+    /* Copied outside the critical section, which then only covers a fixed
+     * size copy. */
+    (void) strncpy(cText, pcText, DISPLAY_REGION_TEXT_LENGTH);
+    cText[DISPLAY_REGION_TEXT_LENGTH] = '\0';
+
+    portENTER_CRITICAL(&xPendingLock);
+    (void) memcpy(cPendingText[eRegion], cText, sizeof(cText));
+    ulPendingMask |= 1UL << eRegion;
+    portEXIT_CRITICAL(&xPendingLock);
+
+    (void) xTaskNotifyGive(xDisplayTaskHandle);
+
+    return pdPASS;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "iot_demo_logging.h"
+
+#include "app_config.h"
+#include "app_rtos.h"
+#include "app_sched.h"
+#include "flash_writer.h"
+
+/*-----------------------------------------------------------*/
+
+#define FLASH_WRITER_TASK_STACK_SIZE    (3072U)
+
+#define FLASH_WRITER_TASK_PRIORITY      (tskIDLE_PRIORITY + APP_SCHED_PRIORITY_FLASH_WRITER)
+
+typedef struct FlashWriterJob
+{
+    FlashWriterFunction_t xFunction;
+    void *pvParameter1;
+    uint32_t ulParameter2;
+} FlashWriterJob_t;
+
+/*-----------------------------------------------------------*/
+
+static QueueHandle_t xJobQueue = NULL;
+APP_QUEUE_STORAGE(xJobQueue, appconfigFLASH_WRITER_QUEUE_LENGTH, sizeof(FlashWriterJob_t));
+
+APP_TASK_STORAGE(xWriterTask, FLASH_WRITER_TASK_STACK_SIZE);
+
+/*-----------------------------------------------------------*/
+
+static void prvFlashWriterTask(void *pvParameters) {
+    FlashWriterJob_t xJob;
+
+    (void) pvParameters;
+
+    for (;;) {
+        if (xQueueReceive(xJobQueue, &xJob, portMAX_DELAY) == pdTRUE) {
+            xJob.xFunction(xJob.pvParameter1, xJob.ulParameter2);
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xFlashWriterInit(void) {
+    xJobQueue = APP_QUEUE_CREATE(xJobQueue);
+
+    if ((xJobQueue == NULL) ||
+        (APP_TASK_CREATE_PINNED(xWriterTask, prvFlashWriterTask, "FlashWriter", NULL, FLASH_WRITER_TASK_PRIORITY, NULL,
+                                APP_SCHED_CORE_FLASH_WRITER) != pdPASS)) {
+        IotLogError("xFlashWriterInit: failed to create the flash writer task");
+        xJobQueue = NULL;
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+BaseType_t xFlashWriterPend(FlashWriterFunction_t xFunction, void *pvParameter1, uint32_t ulParameter2) {
+    FlashWriterJob_t xJob = { xFunction, pvParameter1, ulParameter2 };
+
+    if (xJobQueue == NULL) {
+        return pdFAIL;
+    }
+
+    return xQueueSendToBack(xJobQueue, &xJob, 0U);
+}
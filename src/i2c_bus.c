@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include "driver/i2c.h"
+#include "esp_idf_version.h"
+#include "esp_timer.h"
+
+#include "iot_demo_logging.h"
+
+#include "app_config.h"
+#include "app_rtos.h"
+#include "i2c_bus.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Serialises every transaction on the bus. A mutex rather than a
+ * binary semaphore, so a low priority holder inherits the priority of the
+ * IMU sampler waiting behind it.
+ */
+static SemaphoreHandle_t xBusMutex = NULL;
+APP_MUTEX_STORAGE(xBusMutex);
+
+static I2cBusStats_t xStats;
+
+static int64_t llLockedAt;
+
+/* From ESP-IDF v4.4 a command link can be built in a caller's buffer; before
+ * that every queued operation is allocated from the heap. */
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 4, 0)
+#define I2C_BUS_STATIC_LINK    1
+
+/**
+ * @brief Command link storage, big enough for a register read (a write then
+ * a read). Only used with the bus mutex held.
+ */
+static uint8_t ucLinkBuffer[I2C_LINK_RECOMMENDED_SIZE(2)];
+#else
+#define I2C_BUS_STATIC_LINK    0
+#endif
+
+/*-----------------------------------------------------------*/
+
+esp_err_t eI2cBusLock(void) {
+    int64_t llStart = esp_timer_get_time();
+    uint32_t ulWaitUs;
+
+    if (xBusMutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (xSemaphoreTake(xBusMutex, pdMS_TO_TICKS(appconfigI2C_BUS_LOCK_TIMEOUT_MS)) != pdTRUE) {
+        /* Not protected by the mutex; an approximate count is good enough. */
+        xStats.ulTimeouts++;
+        return ESP_ERR_TIMEOUT;
+    }
+
+    llLockedAt = esp_timer_get_time();
+    ulWaitUs = (uint32_t) (llLockedAt - llStart);
+
+    xStats.ulTransactions++;
+
+    if (ulWaitUs > xStats.ulMaxWaitUs) {
+        xStats.ulMaxWaitUs = ulWaitUs;
+    }
+
+    return ESP_OK;
+}
+
+void vI2cBusUnlock(void) {
+    uint32_t ulHoldUs = (uint32_t) (esp_timer_get_time() - llLockedAt);
+
+    if (ulHoldUs > xStats.ulMaxHoldUs) {
+        xStats.ulMaxHoldUs = ulHoldUs;
+    }
+
+    (void) xSemaphoreGive(xBusMutex);
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Take the bus and start a command link. The static link buffer is
+ * shared, so the link is only built once the bus is held.
+ */
+static esp_err_t prvBegin(i2c_cmd_handle_t *pxCmd) {
+    esp_err_t e = eI2cBusLock();
+
+    if (e != ESP_OK) {
+        return e;
+    }
+
+#if I2C_BUS_STATIC_LINK
+    *pxCmd = i2c_cmd_link_create_static(ucLinkBuffer, sizeof(ucLinkBuffer));
+#else
+    *pxCmd = i2c_cmd_link_create();
+#endif
+
+    if (*pxCmd == NULL) {
+        vI2cBusUnlock();
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Run a link started by prvBegin, free it and release the bus.
+ */
+static esp_err_t prvExecute(i2c_cmd_handle_t xCmd) {
+    esp_err_t e = i2c_master_cmd_begin((i2c_port_t) appconfigI2C_BUS_PORT, xCmd,
+                                       pdMS_TO_TICKS(appconfigI2C_BUS_TIMEOUT_MS));
+
+#if I2C_BUS_STATIC_LINK
+    i2c_cmd_link_delete_static(xCmd);
+#else
+    i2c_cmd_link_delete(xCmd);
+#endif
+    vI2cBusUnlock();
+
+    return e;
+}
+
+esp_err_t eI2cBusWrite(uint8_t ucAddress,
+                       uint8_t ucRegister,
+                       const uint8_t *pucData,
+                       size_t xLength) {
+    i2c_cmd_handle_t xCmd;
+    esp_err_t e = prvBegin(&xCmd);
+
+    if (e != ESP_OK) {
+        return e;
+    }
+
+    (void) i2c_master_start(xCmd);
+    (void) i2c_master_write_byte(xCmd, (ucAddress << 1) | I2C_MASTER_WRITE, true);
+    (void) i2c_master_write_byte(xCmd, ucRegister, true);
+    (void) i2c_master_write(xCmd, (uint8_t *) pucData, xLength, true);
+    (void) i2c_master_stop(xCmd);
+
+    return prvExecute(xCmd);
+}
+
+esp_err_t eI2cBusRead(uint8_t ucAddress,
+                      uint8_t ucRegister,
+                      uint8_t *pucData,
+                      size_t xLength) {
+    i2c_cmd_handle_t xCmd;
+    esp_err_t e;
+
+    if (xLength == 0U) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    e = prvBegin(&xCmd);
+
+    if (e != ESP_OK) {
+        return e;
+    }
+
+    (void) i2c_master_start(xCmd);
+    (void) i2c_master_write_byte(xCmd, (ucAddress << 1) | I2C_MASTER_WRITE, true);
+    (void) i2c_master_write_byte(xCmd, ucRegister, true);
+    (void) i2c_master_start(xCmd);
+    (void) i2c_master_write_byte(xCmd, (ucAddress << 1) | I2C_MASTER_READ, true);
+    (void) i2c_master_read(xCmd, pucData, xLength, I2C_MASTER_LAST_NACK);
+    (void) i2c_master_stop(xCmd);
+
+    return prvExecute(xCmd);
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xI2cBusInit(void) {
+    if (xBusMutex == NULL) {
+        xBusMutex = APP_MUTEX_CREATE(xBusMutex);
+    }
+
+    if (xBusMutex == NULL) {
+        IotLogError("xI2cBusInit: failed to create the bus mutex");
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+void vI2cBusGetStats(I2cBusStats_t *pxStats) {
+    *pxStats = xStats;
+}
@@ -0,0 +1,356 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "event_groups.h"
+
+#include "driver/gpio.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+
+#include "iot_demo_logging.h"
+
+#include "app_config.h"
+#include "app_rtos.h"
+#include "app_sched.h"
+#include "i2c_bus.h"
+#include "spsc_ring.h"
+#include "imu_sampler.h"
+
+/*-----------------------------------------------------------*/
+
+#define IMU_MPU6886_ADDRESS          (0x68U)
+
+#define IMU_REG_SMPLRT_DIV           (0x19U)
+#define IMU_REG_CONFIG               (0x1AU)
+#define IMU_REG_GYRO_CONFIG          (0x1BU)
+#define IMU_REG_ACCEL_CONFIG         (0x1CU)
+#define IMU_REG_ACCEL_CONFIG2        (0x1DU)
+#define IMU_REG_ACCEL_WOM_X_THR      (0x20U)
+#define IMU_REG_ACCEL_WOM_Y_THR      (0x21U)
+#define IMU_REG_ACCEL_WOM_Z_THR      (0x22U)
+#define IMU_REG_INT_PIN_CFG          (0x37U)
+#define IMU_REG_INT_ENABLE           (0x38U)
+#define IMU_REG_INT_STATUS           (0x3AU)
+#define IMU_REG_ACCEL_INTEL_CTRL     (0x69U)
+
+/* The interrupt status, then the accelerometer, temperature and gyroscope
+ * output registers, back to back. */
+#define IMU_BURST_LENGTH             (15U)
+
+/* Active high push-pull, held until any register is read. */
+#define IMU_INT_PIN_CFG_LATCHED      (0x30U)
+#define IMU_INT_ENABLE_DATA_RDY      (0x01U)
+#define IMU_INT_ENABLE_WOM           (0xE0U) /* X, Y and Z; also their INT_STATUS bits. */
+
+/* Wake-on-motion on, comparing every sample with the previous one. */
+#define IMU_ACCEL_INTEL_WOM_PREVIOUS (0xC0U)
+
+/* Gyro and accelerometer low-pass filters on, so the internal rate is 1 kHz
+ * and SMPLRT_DIV applies. */
+#define IMU_CONFIG_DLPF_176HZ        (0x01U)
+#define IMU_ACCEL_CONFIG2_DLPF_218HZ (0x00U)
+#define IMU_GYRO_CONFIG_2000DPS      (0x18U)
+#define IMU_ACCEL_CONFIG_8G          (0x10U)
+
+#define IMU_SAMPLER_TASK_STACK_SIZE  (2048U)
+#define IMU_SAMPLER_TASK_PRIORITY    (tskIDLE_PRIORITY + APP_SCHED_PRIORITY_IMU_SAMPLER)
+
+/**
+ * @brief How long the sampling task waits for a data-ready interrupt before
+ * it reads anyway, in case the sensor lost its configuration.
+ */
+#define IMU_DATA_READY_TIMEOUT_MS    ((4U * 1000U) / appconfigIMU_SAMPLE_RATE_HZ)
+
+/**
+ * @brief The same check while only wake-on-motion is enabled; rare, so it
+ * does not undo the point of waiting for motion.
+ */
+#define IMU_STILL_TIMEOUT_MS         (60000U)
+
+#define IMU_EVENT_SAMPLING           (1U << 0)
+
+_Static_assert((appconfigIMU_SAMPLE_RATE_HZ >= 4U) && (appconfigIMU_SAMPLE_RATE_HZ <= 1000U),
+               "appconfigIMU_SAMPLE_RATE_HZ must be derived from the 1 kHz internal rate");
+_Static_assert(appconfigIMU_RING_LENGTH >=
+               (2U * appconfigIMU_SAMPLE_RATE_HZ * appconfigIMU_BATCH_PERIOD_MS) / 1000U,
+               "appconfigIMU_RING_LENGTH must hold two batch periods of samples");
+
+#if appconfigPOWER_SAVE
+_Static_assert((appconfigIMU_WAKE_THRESHOLD_MG >= 4U) && (appconfigIMU_WAKE_THRESHOLD_MG <= 1020U),
+               "appconfigIMU_WAKE_THRESHOLD_MG must fit the 4 mg wake-on-motion threshold register");
+_Static_assert(appconfigIMU_MOTION_HOLD_MS > appconfigTAMPER_REBASE_MS,
+               "appconfigIMU_MOTION_HOLD_MS must let the tamper detector take the new resting orientation");
+#endif
+
+/*-----------------------------------------------------------*/
+
+static TaskHandle_t xSamplerTaskHandle = NULL;
+APP_TASK_STORAGE(xSamplerTask, IMU_SAMPLER_TASK_STACK_SIZE);
+
+static ImuSample_t xSampleStorage[appconfigIMU_RING_LENGTH];
+
+static SpscRing_t xSampleRing;
+
+/**
+ * @brief #IMU_EVENT_SAMPLING is set while data-ready is enabled.
+ */
+static EventGroupHandle_t xSamplerEvents = NULL;
+APP_EVENT_GROUP_STORAGE(xSamplerEvents);
+
+/**
+ * @brief Failed bus reads. Written by the sampling task only.
+ */
+static volatile uint32_t ulReadErrors = 0U;
+
+/*-----------------------------------------------------------*/
+
+static esp_err_t prvRegisterWrite(uint8_t ucRegister, uint8_t ucValue) {
+    return eI2cBusWrite(IMU_MPU6886_ADDRESS, ucRegister, &ucValue, 1U);
+}
+
+static esp_err_t prvConfigureSensor(void) {
+    static const uint8_t ucConfig[][2] =
+            {
+                    {IMU_REG_CONFIG,        IMU_CONFIG_DLPF_176HZ},
+                    {IMU_REG_ACCEL_CONFIG2, IMU_ACCEL_CONFIG2_DLPF_218HZ},
+                    {IMU_REG_GYRO_CONFIG,   IMU_GYRO_CONFIG_2000DPS},
+                    {IMU_REG_ACCEL_CONFIG,  IMU_ACCEL_CONFIG_8G},
+                    {IMU_REG_SMPLRT_DIV,    (uint8_t) ((1000U / appconfigIMU_SAMPLE_RATE_HZ) - 1U)},
+                    {IMU_REG_INT_PIN_CFG,   IMU_INT_PIN_CFG_LATCHED},
+#if appconfigPOWER_SAVE
+                    {IMU_REG_ACCEL_WOM_X_THR, (uint8_t) (appconfigIMU_WAKE_THRESHOLD_MG / 4U)},
+                    {IMU_REG_ACCEL_WOM_Y_THR, (uint8_t) (appconfigIMU_WAKE_THRESHOLD_MG / 4U)},
+                    {IMU_REG_ACCEL_WOM_Z_THR, (uint8_t) (appconfigIMU_WAKE_THRESHOLD_MG / 4U)},
+                    {IMU_REG_ACCEL_INTEL_CTRL, IMU_ACCEL_INTEL_WOM_PREVIOUS},
+                    {IMU_REG_INT_ENABLE,    IMU_INT_ENABLE_DATA_RDY | IMU_INT_ENABLE_WOM}
+#else
+                    {IMU_REG_INT_ENABLE,    IMU_INT_ENABLE_DATA_RDY}
+#endif
+            };
+    esp_err_t e = ESP_OK;
+    size_t i;
+
+    for (i = 0; (i < (sizeof(ucConfig) / sizeof(ucConfig[0]))) && (e == ESP_OK); i++) {
+        e = prvRegisterWrite(ucConfig[i][0], ucConfig[i][1]);
+    }
+
+    return e;
+}
+
+#if appconfigPOWER_SAVE
+
+/**
+ * @brief Enable the data-ready interrupt while the box moves, and only the
+ * wake-on-motion interrupt once it is still, so light sleep is not cut
+ * short every sample period.
+ */
+static bool prvSetSampling(bool xSampling) {
+    uint8_t ucEnable = IMU_INT_ENABLE_WOM | (xSampling ? IMU_INT_ENABLE_DATA_RDY : 0U);
+
+    /* On a failed write the mode is left as it is and tried again with the
+     * next reading. */
+    if (prvRegisterWrite(IMU_REG_INT_ENABLE, ucEnable) != ESP_OK) {
+        return false;
+    }
+
+    if (xSampling) {
+        (void) xEventGroupSetBits(xSamplerEvents, IMU_EVENT_SAMPLING);
+    } else {
+        (void) xEventGroupClearBits(xSamplerEvents, IMU_EVENT_SAMPLING);
+    }
+
+    return true;
+}
+
+#endif /* if appconfigPOWER_SAVE */
+
+/*-----------------------------------------------------------*/
+
+static void IRAM_ATTR prvDataReadyIsr(void *pvArg) {
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    (void) pvArg;
+
+    /* The line stays high until the sampling task has read the sample, so
+     * mask the level interrupt until then. */
+    (void) gpio_intr_disable(appconfigIMU_INT_GPIO);
+    vTaskNotifyGiveFromISR(xSamplerTaskHandle, &xHigherPriorityTaskWoken);
+
+    if (xHigherPriorityTaskWoken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static esp_err_t prvSetupInterrupt(void) {
+    gpio_config_t io_conf;
+    esp_err_t e;
+
+    /* Level rather than edge triggered: only a level can wake the chip from
+     * light sleep, and a level cannot be missed. */
+    io_conf.intr_type = GPIO_PIN_INTR_HILEVEL;
+    io_conf.mode = GPIO_MODE_INPUT;
+    io_conf.pin_bit_mask = (1ULL << appconfigIMU_INT_GPIO);
+    io_conf.pull_down_en = 0;
+    io_conf.pull_up_en = 0;
+    e = gpio_config(&io_conf);
+
+    if (e == ESP_OK) {
+        /* The ISR service may already have been installed by the BSP. */
+        e = gpio_install_isr_service(0);
+
+        if (e == ESP_ERR_INVALID_STATE) {
+            e = ESP_OK;
+        }
+    }
+
+    if (e == ESP_OK) {
+        e = gpio_isr_handler_add(appconfigIMU_INT_GPIO, prvDataReadyIsr, NULL);
+    }
+
+#if appconfigPOWER_SAVE
+    if (e == ESP_OK) {
+        e = gpio_wakeup_enable(appconfigIMU_INT_GPIO, GPIO_INTR_HIGH_LEVEL);
+    }
+
+    if (e == ESP_OK) {
+        e = esp_sleep_enable_gpio_wakeup();
+    }
+#endif
+
+    return e;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvImuSamplerTask(void *pvParameters) {
+    uint8_t ucRaw[IMU_BURST_LENGTH];
+    ImuSample_t xSample;
+    bool xSampling = true;
+#if appconfigPOWER_SAVE
+    TickType_t xLastMotion = xTaskGetTickCount();
+#endif
+
+    (void) pvParameters;
+
+    for (;;) {
+        (void) ulTaskNotifyTake(pdTRUE,
+                                pdMS_TO_TICKS(xSampling ? IMU_DATA_READY_TIMEOUT_MS : IMU_STILL_TIMEOUT_MS) + 1U);
+
+        /* Reading releases the latched interrupt line. After a failed read
+         * the interrupt stays masked and the timeout paces the retries. */
+        if (eI2cBusRead(IMU_MPU6886_ADDRESS, IMU_REG_INT_STATUS, ucRaw, sizeof(ucRaw)) != ESP_OK) {
+            ulReadErrors++;
+            continue;
+        }
+
+        (void) gpio_intr_enable(appconfigIMU_INT_GPIO);
+
+#if appconfigPOWER_SAVE
+        if ((ucRaw[0] & IMU_INT_ENABLE_WOM) != 0U) {
+            xLastMotion = xTaskGetTickCount();
+
+            if (!xSampling) {
+                xSampling = prvSetSampling(true);
+            }
+        } else if (xSampling && ((xTaskGetTickCount() - xLastMotion) >= pdMS_TO_TICKS(appconfigIMU_MOTION_HOLD_MS))) {
+            xSampling = !prvSetSampling(false);
+        }
+#endif
+
+        xSample.ulTimestampUs = (uint32_t) esp_timer_get_time();
+        xSample.sAccel[0] = (int16_t) ((ucRaw[1] << 8) | ucRaw[2]);
+        xSample.sAccel[1] = (int16_t) ((ucRaw[3] << 8) | ucRaw[4]);
+        xSample.sAccel[2] = (int16_t) ((ucRaw[5] << 8) | ucRaw[6]);
+        /* ucRaw[7..8] is the die temperature. */
+        xSample.sGyro[0] = (int16_t) ((ucRaw[9] << 8) | ucRaw[10]);
+        xSample.sGyro[1] = (int16_t) ((ucRaw[11] << 8) | ucRaw[12]);
+        xSample.sGyro[2] = (int16_t) ((ucRaw[13] << 8) | ucRaw[14]);
+
+        (void) xSpscRingPush(&xSampleRing, &xSample);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xImuSamplerInit(void) {
+    vSpscRingInit(&xSampleRing, xSampleStorage, sizeof(xSampleStorage[0]), appconfigIMU_RING_LENGTH);
+
+    xSamplerEvents = APP_EVENT_GROUP_CREATE(xSamplerEvents);
+
+    if (xSamplerEvents == NULL) {
+        IotLogError("xImuSamplerInit: failed to create the sampler events");
+        return pdFAIL;
+    }
+
+    /* The sensor starts out sampling. */
+    (void) xEventGroupSetBits(xSamplerEvents, IMU_EVENT_SAMPLING);
+
+    if (prvConfigureSensor() != ESP_OK) {
+        IotLogError("xImuSamplerInit: failed to configure the MPU6886");
+        return pdFAIL;
+    }
+
+    /* The task must exist before the first interrupt can notify it. */
+    if (APP_TASK_CREATE_PINNED(xSamplerTask,
+                               prvImuSamplerTask,
+                               "ImuSampler",
+                               NULL,
+                               IMU_SAMPLER_TASK_PRIORITY,
+                               &xSamplerTaskHandle,
+                               APP_SCHED_CORE_IMU_SAMPLER) != pdPASS) {
+        IotLogError("xImuSamplerInit: failed to create the sampling task");
+        return pdFAIL;
+    }
+
+    if (prvSetupInterrupt() != ESP_OK) {
+        IotLogError("xImuSamplerInit: failed to set up the data-ready interrupt");
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+bool xImuSamplerWaitSampling(TickType_t xTicksToWait) {
+    if (xSamplerEvents == NULL) {
+        return false;
+    }
+
+    return (xEventGroupWaitBits(xSamplerEvents, IMU_EVENT_SAMPLING, pdFALSE, pdTRUE, xTicksToWait) &
+            IMU_EVENT_SAMPLING) != 0U;
+}
+
+bool xImuSamplerRead(ImuSample_t *pxSample) {
+    return xSpscRingPop(&xSampleRing, pxSample);
+}
+
+uint32_t ulImuSamplerTakeDropped(void) {
+    static uint32_t ulReportedReadErrors = 0U;
+    uint32_t ulReadErrorsNow = ulReadErrors;
+    uint32_t ulDropped = ulSpscRingTakeDropped(&xSampleRing) + (ulReadErrorsNow - ulReportedReadErrors);
+
+    ulReportedReadErrors = ulReadErrorsNow;
+
+    return ulDropped;
+}
@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Standard includes. */
+#include <math.h>
+#include <stdio.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "aws_clientcredential.h"
+#include "iot_demo_logging.h"
+
+#include "app_config.h"
+#include "app_rtos.h"
+#include "app_sched.h"
+#include "mqtt_agent.h"
+#include "i2c_bus.h"
+#include "imu_sampler.h"
+#include "tamper_detector.h"
+#include "imu_telemetry.h"
+
+/*-----------------------------------------------------------*/
+
+#define IMU_TELEMETRY_TOPIC           "dt/personalbox/" clientcredentialIOT_THING_NAME "/imu"
+#define IMU_TELEMETRY_TOPIC_LENGTH    ((uint16_t) (sizeof(IMU_TELEMETRY_TOPIC) - 1U))
+
+#define IMU_TELEMETRY_TASK_STACK_SIZE (3072U)
+
+#define IMU_TELEMETRY_TASK_PRIORITY   (tskIDLE_PRIORITY + APP_SCHED_PRIORITY_IMU_TELEMETRY)
+
+APP_TASK_STORAGE(xTelemetryTask, IMU_TELEMETRY_TASK_STACK_SIZE);
+
+/**
+ * @brief Statistics of the acceleration magnitude over one summary period,
+ * in milli-g.
+ */
+typedef struct ImuSummary
+{
+    uint32_t ulSamples;
+    uint32_t ulDropped;
+    uint32_t ulMinMg;
+    uint32_t ulMaxMg;
+    uint64_t ullSumMg;
+    uint32_t ulTampers;
+} ImuSummary_t;
+
+/**
+ * @brief A tamper event, or the events folded together during a hold-off.
+ */
+typedef struct ImuTamper
+{
+    uint32_t ulEvents;
+    uint32_t ulTimestampUs;
+    uint32_t ulPeakRmsMg;
+    uint32_t ulPeakJerkGPerS;
+    int32_t lMinTiltCosMilli;
+} ImuTamper_t;
+
+/*-----------------------------------------------------------*/
+
+static void prvResetSummary(ImuSummary_t *pxSummary) {
+    pxSummary->ulSamples = 0U;
+    pxSummary->ulDropped = 0U;
+    pxSummary->ulMinMg = UINT32_MAX;
+    pxSummary->ulMaxMg = 0U;
+    pxSummary->ullSumMg = 0U;
+    pxSummary->ulTampers = 0U;
+}
+
+static void prvAccumulate(ImuSummary_t *pxSummary, const TamperFeatures_t *pxFeatures) {
+    pxSummary->ulSamples++;
+    pxSummary->ullSumMg += pxFeatures->ulMagnitudeMg;
+
+    if (pxFeatures->ulMagnitudeMg < pxSummary->ulMinMg) {
+        pxSummary->ulMinMg = pxFeatures->ulMagnitudeMg;
+    }
+
+    if (pxFeatures->ulMagnitudeMg > pxSummary->ulMaxMg) {
+        pxSummary->ulMaxMg = pxFeatures->ulMagnitudeMg;
+    }
+}
+
+static void prvMergeTamper(ImuTamper_t *pxTamper,
+                           uint32_t ulEvents,
+                           uint32_t ulTimestampUs,
+                           const TamperFeatures_t *pxFeatures) {
+    if (pxTamper->ulEvents == 0U) {
+        pxTamper->ulTimestampUs = ulTimestampUs;
+        pxTamper->ulPeakRmsMg = 0U;
+        pxTamper->ulPeakJerkGPerS = 0U;
+        pxTamper->lMinTiltCosMilli = 1000;
+    }
+
+    pxTamper->ulEvents |= ulEvents;
+
+    if (pxFeatures->ulRmsMg > pxTamper->ulPeakRmsMg) {
+        pxTamper->ulPeakRmsMg = pxFeatures->ulRmsMg;
+    }
+
+    if (pxFeatures->ulJerkGPerS > pxTamper->ulPeakJerkGPerS) {
+        pxTamper->ulPeakJerkGPerS = pxFeatures->ulJerkGPerS;
+    }
+
+    if (pxFeatures->lTiltCosMilli < pxTamper->lMinTiltCosMilli) {
+        pxTamper->lMinTiltCosMilli = pxFeatures->lTiltCosMilli;
+    }
+}
+
+static void prvPublish(const char *pcPayload, int lLength) {
+    if ((lLength < 0) || (lLength >= (int) appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH)) {
+        IotLogError("prvPublish: IMU telemetry does not fit in an MQTT agent command");
+        return;
+    }
+
+    /* Without a session the sample is simply not sent. */
+    if (eMqttAgentPublish(IMU_TELEMETRY_TOPIC,
+                          IMU_TELEMETRY_TOPIC_LENGTH,
+                          pcPayload,
+                          (size_t) lLength,
+                          0U) == MqttAgentQueueFull) {
+        IotLogWarn("prvPublish: dropped IMU telemetry, the MQTT agent queue is full");
+    }
+}
+
+static void prvPublishTamper(const ImuTamper_t *pxTamper) {
+    char cPayload[appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH];
+    int32_t lCos = pxTamper->lMinTiltCosMilli;
+    int lLength;
+
+    if (lCos > 1000) {
+        lCos = 1000;
+    } else if (lCos < -1000) {
+        lCos = -1000;
+    }
+
+    lLength = snprintf(cPayload, sizeof(cPayload),
+                       "{\"type\":\"tamper\",\"ts\":%u,\"ev\":%u,\"rmsMg\":%u,\"jerkGps\":%u,\"tiltDeg\":%u}",
+                       (unsigned) (pxTamper->ulTimestampUs / 1000U),
+                       (unsigned) pxTamper->ulEvents,
+                       (unsigned) pxTamper->ulPeakRmsMg,
+                       (unsigned) pxTamper->ulPeakJerkGPerS,
+                       (unsigned) (acosf((float) lCos / 1000.0f) * 180.0f / (float) M_PI));
+
+    prvPublish(cPayload, lLength);
+}
+
+static void prvPublishSummary(const ImuSummary_t *pxSummary) {
+    char cPayload[appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH];
+    I2cBusStats_t xBusStats;
+    uint32_t ulMeanMg = 0U;
+    int lLength;
+
+    if (pxSummary->ulSamples > 0U) {
+        ulMeanMg = (uint32_t) (pxSummary->ullSumMg / pxSummary->ulSamples);
+    }
+
+    vI2cBusGetStats(&xBusStats);
+
+    lLength = snprintf(cPayload, sizeof(cPayload),
+                       "{\"type\":\"summary\",\"periodS\":%u,\"samples\":%u,\"dropped\":%u,"
+                       "\"minMg\":%u,\"maxMg\":%u,\"meanMg\":%u,\"tampers\":%u,"
+                       "\"busWaitUs\":%u,\"busHoldUs\":%u}",
+                       (unsigned) (appconfigIMU_SUMMARY_PERIOD_MS / 1000U),
+                       (unsigned) pxSummary->ulSamples,
+                       (unsigned) pxSummary->ulDropped,
+                       (unsigned) ((pxSummary->ulSamples > 0U) ? pxSummary->ulMinMg : 0U),
+                       (unsigned) pxSummary->ulMaxMg,
+                       (unsigned) ulMeanMg,
+                       (unsigned) pxSummary->ulTampers,
+                       (unsigned) xBusStats.ulMaxWaitUs,
+                       (unsigned) xBusStats.ulMaxHoldUs);
+
+    prvPublish(cPayload, lLength);
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvImuTelemetryTask(void *pvParameters) {
+    static TamperDetector_t xDetector;
+    TamperFeatures_t xFeatures;
+    ImuSummary_t xSummary;
+    ImuTamper_t xTamper = {0};
+    ImuSample_t xSample;
+    uint32_t ulEvents;
+    TickType_t xLastWakeTime = xTaskGetTickCount();
+    TickType_t xSummaryStart = xLastWakeTime;
+    TickType_t xLastTamper = xLastWakeTime - pdMS_TO_TICKS(appconfigIMU_EVENT_HOLDOFF_MS);
+
+    (void) pvParameters;
+
+    vTamperDetectorInit(&xDetector);
+    prvResetSummary(&xSummary);
+
+    for (;;) {
+        vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(appconfigIMU_BATCH_PERIOD_MS));
+
+        while (xImuSamplerRead(&xSample)) {
+            ulEvents = ulTamperDetectorUpdate(&xDetector, &xSample, &xFeatures);
+            prvAccumulate(&xSummary, &xFeatures);
+
+            /* Keep the peaks of an ongoing event even once it has fired. */
+            if ((ulEvents != 0U) || (xTamper.ulEvents != 0U)) {
+                prvMergeTamper(&xTamper, ulEvents, xSample.ulTimestampUs, &xFeatures);
+            }
+        }
+
+        xSummary.ulDropped += ulImuSamplerTakeDropped();
+
+        /* The first event goes out at the end of the batch that detected it;
+         * anything detected during the hold-off is folded into one follow-up. */
+        if ((xTamper.ulEvents != 0U) &&
+            ((xTaskGetTickCount() - xLastTamper) >= pdMS_TO_TICKS(appconfigIMU_EVENT_HOLDOFF_MS))) {
+            prvPublishTamper(&xTamper);
+            xSummary.ulTampers++;
+            xLastTamper = xTaskGetTickCount();
+            xTamper.ulEvents = 0U;
+        }
+
+        if ((xLastWakeTime - xSummaryStart) >= pdMS_TO_TICKS(appconfigIMU_SUMMARY_PERIOD_MS)) {
+            prvPublishSummary(&xSummary);
+            prvResetSummary(&xSummary);
+            xSummaryStart = xLastWakeTime;
+        }
+
+#if appconfigPOWER_SAVE
+        /* While the sampler waits for motion there is nothing to batch, so
+         * sleep until it samples again or the summary is due instead of
+         * waking every batch period. */
+        if ((xTamper.ulEvents == 0U) && !xImuSamplerWaitSampling(0U)) {
+            TickType_t xElapsed = xTaskGetTickCount() - xSummaryStart;
+            TickType_t xPeriod = pdMS_TO_TICKS(appconfigIMU_SUMMARY_PERIOD_MS);
+
+            (void) xImuSamplerWaitSampling((xElapsed < xPeriod) ? (xPeriod - xElapsed) : 0U);
+            xLastWakeTime = xTaskGetTickCount();
+        }
+#endif
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xImuTelemetryInit(void) {
+    if (APP_TASK_CREATE_PINNED(xTelemetryTask,
+                               prvImuTelemetryTask,
+                               "ImuTelemetry",
+                               NULL,
+                               IMU_TELEMETRY_TASK_PRIORITY,
+                               NULL,
+                               APP_SCHED_CORE_IMU_TELEMETRY) != pdPASS) {
+        IotLogError("xImuTelemetryInit: failed to create the telemetry task");
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
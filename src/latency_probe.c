@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+#include "esp_timer.h"
+
+#include "aws_clientcredential.h"
+#include "iot_demo_logging.h"
+
+#include "app_config.h"
+#include "app_rtos.h"
+#include "boot.h"
+#include "mqtt_agent.h"
+#include "latency_probe.h"
+
+#if appconfigLATENCY_PROBES
+
+/*-----------------------------------------------------------*/
+
+#define LATENCY_TOPIC           "dt/personalbox/" clientcredentialIOT_THING_NAME "/metrics"
+#define LATENCY_TOPIC_LENGTH    ((uint16_t) (sizeof(LATENCY_TOPIC) - 1U))
+
+/**
+ * @brief Log-linear buckets: every power of two is split into four, so a
+ * percentile is never more than 25 % above the true value. Durations from
+ * 2^LATENCY_RESOLVED_BITS us (about 16 s) on all land in the last bucket.
+ */
+#define LATENCY_SUB_BUCKET_BITS    (2U)
+#define LATENCY_SUB_BUCKETS        (1U << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_RESOLVED_BITS      (24U)
+#define LATENCY_BUCKET_COUNT       ((LATENCY_RESOLVED_BITS - 1U) * LATENCY_SUB_BUCKETS)
+
+typedef struct LatencyHistogram
+{
+    uint32_t ulCount;
+    uint32_t ulMaxUs;
+    uint32_t ulOverBudget;
+    uint16_t usBuckets[LATENCY_BUCKET_COUNT]; /* Saturating. */
+} LatencyHistogram_t;
+
+/*-----------------------------------------------------------*/
+
+static const char *const pcSpanNames[LatencySpanCount] =
+        {
+                [LatencySpanTlsWaitRead] = "tlsWaitRead",
+                [LatencySpanDeltaParse] = "parse",
+                [LatencySpanUnlock] = "unlock",
+                [LatencySpanAgentQueue] = "queue",
+                [LatencySpanPuback] = "puback",
+                [LatencySpanShadowAck] = "shadowAck"
+        };
+
+/**
+ * @brief Spans with a latency budget; 0 for none.
+ */
+static const uint32_t ulSpanBudgetUs[LatencySpanCount] =
+        {
+                [LatencySpanUnlock] = appconfigLATENCY_UNLOCK_BUDGET_MS * 1000U
+        };
+
+static LatencyHistogram_t xHistograms[LatencySpanCount];
+
+static portMUX_TYPE xHistogramLock = portMUX_INITIALIZER_UNLOCKED;
+
+static TimerHandle_t xPublishTimer = NULL;
+APP_TIMER_STORAGE(xPublishTimer);
+
+/**
+ * @brief The metrics document being built. Only the timer service task
+ * touches it; the agent copies the payload when it is queued.
+ */
+static char cPayload[appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH];
+static size_t xPayloadLength = 0U;
+static size_t xHeaderLength = 0U;
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvBucketIndex(uint32_t ulUs) {
+    uint32_t ulMsb;
+
+    if (ulUs < LATENCY_SUB_BUCKETS) {
+        return ulUs;
+    }
+
+    ulMsb = 31U - (uint32_t) __builtin_clz(ulUs);
+
+    if (ulMsb >= LATENCY_RESOLVED_BITS) {
+        return LATENCY_BUCKET_COUNT - 1U;
+    }
+
+    return ((ulMsb - 1U) * LATENCY_SUB_BUCKETS) +
+           ((ulUs >> (ulMsb - LATENCY_SUB_BUCKET_BITS)) & (LATENCY_SUB_BUCKETS - 1U));
+}
+
+/**
+ * @brief The largest duration that falls into a bucket.
+ */
+static uint32_t prvBucketUpperUs(uint32_t ulIndex) {
+    uint32_t ulShift;
+    uint32_t ulSub;
+
+    if (ulIndex < LATENCY_SUB_BUCKETS) {
+        return ulIndex;
+    }
+
+    ulShift = (ulIndex / LATENCY_SUB_BUCKETS) + 1U - LATENCY_SUB_BUCKET_BITS;
+    ulSub = ulIndex % LATENCY_SUB_BUCKETS;
+
+    return ((LATENCY_SUB_BUCKETS + ulSub + 1U) << ulShift) - 1U;
+}
+
+static uint32_t prvPercentileUs(const LatencyHistogram_t *pxHistogram, uint32_t ulPercent) {
+    uint32_t ulRank = ((pxHistogram->ulCount * ulPercent) + 99U) / 100U;
+    uint32_t ulSeen = 0U;
+    uint32_t ulUpper;
+    uint32_t i;
+
+    for (i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+        ulSeen += pxHistogram->usBuckets[i];
+
+        if (ulSeen >= ulRank) {
+            break;
+        }
+    }
+
+    /* The last bucket is open ended, and saturated buckets may leave the
+     * rank unreached; the max is the best answer in both cases. */
+    ulUpper = (i < (LATENCY_BUCKET_COUNT - 1U)) ? prvBucketUpperUs(i) : pxHistogram->ulMaxUs;
+
+    return (ulUpper < pxHistogram->ulMaxUs) ? ulUpper : pxHistogram->ulMaxUs;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvOpenDocument(void) {
+    int lLength = snprintf(cPayload, sizeof(cPayload),
+                           "{\"type\":\"latency\",\"periodS\":%u",
+                           (unsigned) (appconfigLATENCY_PUBLISH_PERIOD_MS / 1000U));
+
+    xHeaderLength = (size_t) lLength;
+    xPayloadLength = xHeaderLength;
+}
+
+static void prvFlushDocument(void) {
+    if (xPayloadLength == xHeaderLength) {
+        return;
+    }
+
+    cPayload[xPayloadLength++] = '}';
+
+    if (eMqttAgentPublish(LATENCY_TOPIC,
+                          LATENCY_TOPIC_LENGTH,
+                          cPayload,
+                          xPayloadLength,
+                          0U) == MqttAgentQueueFull) {
+        IotLogWarn("prvFlushDocument: dropped latency metrics, the MQTT agent queue is full");
+    }
+
+    prvOpenDocument();
+}
+
+/**
+ * @brief Add a field to the document, sending the document first if the
+ * field would not fit. Splits are rare: all spans normally fit in one.
+ */
+static void prvAppendField(const char *pcField, int lLength) {
+    if ((lLength <= 0) || ((size_t) lLength >= (sizeof(cPayload) - xHeaderLength - 1U))) {
+        return;
+    }
+
+    if ((xPayloadLength + (size_t) lLength + 1U) > sizeof(cPayload)) {
+        prvFlushDocument();
+    }
+
+    (void) memcpy(&cPayload[xPayloadLength], pcField, (size_t) lLength);
+    xPayloadLength += (size_t) lLength;
+}
+
+static void prvAppendBootTimings(void) {
+    static bool xBootReported = false;
+    char cField[96];
+    int lLength;
+
+    if (xBootReported || (xBootWait(BootPhaseFirstDelta, 0U) != pdTRUE)) {
+        return;
+    }
+
+    lLength = snprintf(cField, sizeof(cField),
+                       ",\"bootMs\":[%u,%u,%u,%u,%u,%u]",
+                       (unsigned) ulBootPhaseDoneMs(BootPhaseSystem),
+                       (unsigned) ulBootPhaseDoneMs(BootPhaseKeys),
+                       (unsigned) ulBootPhaseDoneMs(BootPhaseDevice),
+                       (unsigned) ulBootPhaseDoneMs(BootPhaseNetwork),
+                       (unsigned) ulBootPhaseDoneMs(BootPhaseMqtt),
+                       (unsigned) ulBootPhaseDoneMs(BootPhaseFirstDelta));
+
+    prvAppendField(cField, lLength);
+    xBootReported = true;
+}
+
+/**
+ * @brief Publish "<span>":[count,p50,p90,p99,max] for every span that saw
+ * traffic, in microseconds, and start the histograms over. Spans with a
+ * budget carry the number of samples over it as a sixth element.
+ */
+static void prvPublishTimerCallback(TimerHandle_t xTimer) {
+    LatencyHistogram_t xSnapshot;
+    char cField[96];
+    int lLength;
+    size_t i;
+
+    (void) xTimer;
+
+    prvOpenDocument();
+
+    for (i = 0; i < LatencySpanCount; i++) {
+        portENTER_CRITICAL(&xHistogramLock);
+        xSnapshot = xHistograms[i];
+        (void) memset(&xHistograms[i], 0x00, sizeof(xHistograms[i]));
+        portEXIT_CRITICAL(&xHistogramLock);
+
+        if (xSnapshot.ulCount == 0U) {
+            continue;
+        }
+
+        lLength = snprintf(cField, sizeof(cField),
+                           ",\"%s\":[%u,%u,%u,%u,%u",
+                           pcSpanNames[i],
+                           (unsigned) xSnapshot.ulCount,
+                           (unsigned) prvPercentileUs(&xSnapshot, 50U),
+                           (unsigned) prvPercentileUs(&xSnapshot, 90U),
+                           (unsigned) prvPercentileUs(&xSnapshot, 99U),
+                           (unsigned) xSnapshot.ulMaxUs);
+
+        if ((lLength > 0) && ((size_t) lLength < sizeof(cField))) {
+            lLength += (ulSpanBudgetUs[i] != 0U) ?
+                       snprintf(&cField[lLength], sizeof(cField) - (size_t) lLength,
+                                ",%u]", (unsigned) xSnapshot.ulOverBudget) :
+                       snprintf(&cField[lLength], sizeof(cField) - (size_t) lLength, "]");
+        }
+
+        prvAppendField(cField, lLength);
+
+        if (xSnapshot.ulOverBudget != 0U) {
+            IotLogWarn("prvPublishTimerCallback: %u %s sample(s) over the %u us budget, max %u us",
+                       (unsigned) xSnapshot.ulOverBudget,
+                       pcSpanNames[i],
+                       (unsigned) ulSpanBudgetUs[i],
+                       (unsigned) xSnapshot.ulMaxUs);
+        }
+    }
+
+    prvAppendBootTimings();
+    prvFlushDocument();
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t ulLatencyProbeNow(void) {
+    /* esp_timer rather than the CCOUNT cycle counter: with dynamic frequency
+     * scaling the cycle rate changes under the measurement. */
+    return (uint32_t) esp_timer_get_time();
+}
+
+void vLatencyProbeRecord(LatencySpan_t eSpan, uint32_t ulStartUs) {
+    uint32_t ulElapsedUs = ulLatencyProbeNow() - ulStartUs;
+    uint32_t ulIndex = prvBucketIndex(ulElapsedUs);
+    LatencyHistogram_t *pxHistogram;
+
+    configASSERT(eSpan < LatencySpanCount);
+    pxHistogram = &xHistograms[eSpan];
+
+    portENTER_CRITICAL(&xHistogramLock);
+
+    pxHistogram->ulCount++;
+
+    if (ulElapsedUs > pxHistogram->ulMaxUs) {
+        pxHistogram->ulMaxUs = ulElapsedUs;
+    }
+
+    if ((ulSpanBudgetUs[eSpan] != 0U) && (ulElapsedUs > ulSpanBudgetUs[eSpan])) {
+        pxHistogram->ulOverBudget++;
+    }
+
+    if (pxHistogram->usBuckets[ulIndex] < UINT16_MAX) {
+        pxHistogram->usBuckets[ulIndex]++;
+    }
+
+    portEXIT_CRITICAL(&xHistogramLock);
+}
+
+BaseType_t xLatencyProbeInit(void) {
+    xPublishTimer = APP_TIMER_CREATE(xPublishTimer,
+                                     "latency",
+                                     pdMS_TO_TICKS(appconfigLATENCY_PUBLISH_PERIOD_MS),
+                                     pdTRUE,
+                                     NULL,
+                                     prvPublishTimerCallback);
+
+    if ((xPublishTimer == NULL) || (xTimerStart(xPublishTimer, 0U) != pdPASS)) {
+        IotLogError("xLatencyProbeInit: failed to start the metrics timer");
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+#endif /* if appconfigLATENCY_PROBES */
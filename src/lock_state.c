@@ -0,0 +1,559 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "semphr.h"
+
+#include "iot_demo_logging.h"
+
+#include "app_config.h"
+#include "app_rtos.h"
+#include "device.h"
+#include "display_service.h"
+#include "power_manager.h"
+#include "lock_state.h"
+
+/*-----------------------------------------------------------*/
+
+_Static_assert((appconfigLOCK_COUNT >= 1U) && (appconfigLOCK_COUNT <= LOCK_STATE_MAX_COUNT),
+               "appconfigLOCK_COUNT must be between 1 and LOCK_STATE_MAX_COUNT");
+
+#define LOCK_STATE_WAIT_TICKS    pdMS_TO_TICKS(appconfigLOCK_STATE_WAIT_MS)
+
+typedef enum LockEvent
+{
+    LockEventOpenRequest,
+    LockEventOpened,
+    LockEventHoldExpired,
+    LockEventClosed,
+    LockEventSensorTimeout
+} LockEvent_t;
+
+/**
+ * @brief One entry of the lock table.
+ */
+typedef struct LockCompartment
+{
+    volatile LockState_t eState;
+    TickType_t xDeadline; /**< End of the hold period while #LockStateOpen,
+                           *   of the sensor timeout while #LockStateOpening
+                           *   or #LockStateClosing. */
+    TickType_t xSampleAt; /**< When to read the sensor after an edge. */
+    bool xSampling;       /**< Whether xSampleAt is set. */
+} LockCompartment_t;
+
+/*-----------------------------------------------------------*/
+
+static LockCompartment_t xCompartments[appconfigLOCK_COUNT];
+
+static const int32_t lSensorGpios[appconfigLOCK_COUNT] = appconfigLOCK_SENSOR_GPIOS;
+
+/**
+ * @brief Set by the sensor ISR on the first edge of a burst and cleared once
+ * the level has been read, so a bouncing contact pends one call per
+ * appconfigLOCK_SENSOR_DEBOUNCE_MS rather than one per edge.
+ */
+static volatile bool xEdgePending[appconfigLOCK_COUNT];
+
+static LockStateCallback_t xStateCallback = NULL;
+
+/**
+ * @brief One timer for the whole table, armed for the earliest deadline, so
+ * compartments opened together also close and report together.
+ *
+ * It auto-reloads: if a command to move it is lost because the timer queue is
+ * full, it keeps firing at its previous period and the callback polls the
+ * deadlines until a command gets through.
+ */
+static TimerHandle_t xHoldTimer = NULL;
+APP_TIMER_STORAGE(xHoldTimer);
+
+/**
+ * @brief Serialises transitions between the requesting task and the timer
+ * service task, including the actuator side effects. It is only ever taken
+ * with a bounded wait, so a slow holder cannot stall the other timers.
+ */
+static SemaphoreHandle_t xStateMutex = NULL;
+APP_MUTEX_STORAGE(xStateMutex);
+
+/**
+ * @brief Compartments that are not closed. PowerLockAwake is held while any
+ * bit is set.
+ */
+static uint32_t ulActiveMask = 0U;
+
+/**
+ * @brief Compartments whose actuator is driven open. The status LED is on
+ * while any bit is set.
+ */
+static uint32_t ulDrivenMask = 0U;
+
+/**
+ * @brief Compartments that settled during the current batch of events.
+ */
+static uint32_t ulSettledMask = 0U;
+
+/*-----------------------------------------------------------*/
+
+static void prvDispatch(uint32_t ulLock, LockEvent_t eEvent);
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Whether xAt has been reached, robust to tick count wrap-around.
+ */
+static bool prvIsDue(TickType_t xNow, TickType_t xAt) {
+    return ((TickType_t) (xNow - xAt) < (portMAX_DELAY / 2U));
+}
+
+/**
+ * @brief How long a timer or mutex command may block. The timer service task
+ * must not block on its own queue, so it only ever polls.
+ */
+static TickType_t prvCommandWait(void) {
+    return (xTaskGetCurrentTaskHandle() == xTimerGetTimerDaemonTaskHandle()) ? 0U : LOCK_STATE_WAIT_TICKS;
+}
+
+static void prvDrive(uint32_t ulLock, bool xOpen) {
+    (void) eChangeLockState(ulLock, xOpen ? 1U : 0U);
+
+    if (xOpen) {
+        ulDrivenMask |= (1UL << ulLock);
+        STATUS_LED_ON();
+    } else {
+        ulDrivenMask &= ~(1UL << ulLock);
+
+        if (ulDrivenMask == 0U) {
+            STATUS_LED_OFF();
+        }
+    }
+}
+
+static void prvEnterState(uint32_t ulLock, LockState_t eState) {
+    LockCompartment_t *pxCompartment = &xCompartments[ulLock];
+
+    pxCompartment->eState = eState;
+
+    switch (eState) {
+        case LockStateOpening:
+            /* Stay awake until every bolt is back, so the hold timer and the
+             * sensor interrupts are not delayed by light sleep. Opening again
+             * while closing keeps the lock already held. */
+            if (ulActiveMask == 0U) {
+                vPowerLockAcquire(PowerLockAwake);
+            }
+            ulActiveMask |= (1UL << ulLock);
+            prvDrive(ulLock, true);
+            if (lSensorGpios[ulLock] < 0) {
+                prvDispatch(ulLock, LockEventOpened);
+            } else {
+                pxCompartment->xDeadline = xTaskGetTickCount() + pdMS_TO_TICKS(appconfigLOCK_SENSOR_TIMEOUT_MS);
+            }
+            break;
+
+        case LockStateOpen:
+            pxCompartment->xDeadline = xTaskGetTickCount() + pdMS_TO_TICKS(appconfigLOCK_OPEN_HOLD_MS);
+            ulSettledMask |= (1UL << ulLock);
+            break;
+
+        case LockStateClosing:
+            prvDrive(ulLock, false);
+            if (lSensorGpios[ulLock] < 0) {
+                prvDispatch(ulLock, LockEventClosed);
+            } else {
+                pxCompartment->xDeadline = xTaskGetTickCount() + pdMS_TO_TICKS(appconfigLOCK_SENSOR_TIMEOUT_MS);
+            }
+            break;
+
+        case LockStateClosed:
+            ulActiveMask &= ~(1UL << ulLock);
+            if (ulActiveMask == 0U) {
+                vPowerLockRelease(PowerLockAwake);
+            }
+            ulSettledMask |= (1UL << ulLock);
+            break;
+    }
+}
+
+/**
+ * @brief Apply one event to a compartment. Called with xStateMutex held.
+ */
+static void prvDispatch(uint32_t ulLock, LockEvent_t eEvent) {
+    LockState_t eState = xCompartments[ulLock].eState;
+
+    switch (eEvent) {
+        case LockEventOpenRequest:
+            if ((eState == LockStateClosed) || (eState == LockStateClosing)) {
+                prvEnterState(ulLock, LockStateOpening);
+            } else if (eState == LockStateOpen) {
+                /* Already open: keep it open for another full hold period. */
+                xCompartments[ulLock].xDeadline = xTaskGetTickCount() + pdMS_TO_TICKS(appconfigLOCK_OPEN_HOLD_MS);
+            }
+            break;
+
+        case LockEventOpened:
+            if (eState == LockStateOpening) {
+                prvEnterState(ulLock, LockStateOpen);
+            }
+            break;
+
+        case LockEventHoldExpired:
+            if (eState == LockStateOpen) {
+                prvEnterState(ulLock, LockStateClosing);
+            }
+            break;
+
+        case LockEventClosed:
+            /* The bolt may also be pushed home by hand before the hold expires. */
+            if ((eState == LockStateClosing) || (eState == LockStateOpen)) {
+                if (eState == LockStateOpen) {
+                    prvDrive(ulLock, false);
+                }
+
+                prvEnterState(ulLock, LockStateClosed);
+            }
+            break;
+
+        case LockEventSensorTimeout:
+            if (eState == LockStateOpening) {
+                /* The bolt never came back: release the actuator and report
+                 * the compartment as it still is, locked. */
+                IotLogWarn("prvDispatch: compartment %u did not open", (unsigned) ulLock);
+                prvDrive(ulLock, false);
+                prvEnterState(ulLock, LockStateClosed);
+            } else if (eState == LockStateClosing) {
+                /* The bolt did not shoot home: report it open, and try again
+                 * when the new hold period runs out. */
+                IotLogWarn("prvDispatch: compartment %u did not close", (unsigned) ulLock);
+                prvEnterState(ulLock, LockStateOpen);
+            }
+            break;
+    }
+}
+
+/**
+ * @brief Read a sensor whose bolt has settled, or that timed out waiting for
+ * an edge that may have been lost, and apply what it shows.
+ */
+static void prvSampleSensor(uint32_t ulLock, bool xTimedOut) {
+    LockState_t eState = xCompartments[ulLock].eState;
+    bool xOpen;
+
+    /* Cleared first, so an edge from here on starts another sample. */
+    xCompartments[ulLock].xSampling = false;
+    xEdgePending[ulLock] = false;
+    xOpen = (gpio_get_level((gpio_num_t) lSensorGpios[ulLock]) != 0);
+
+    if (xTimedOut && (xOpen != (eState == LockStateOpening))) {
+        prvDispatch(ulLock, LockEventSensorTimeout);
+    } else {
+        prvDispatch(ulLock, xOpen ? LockEventOpened : LockEventClosed);
+    }
+}
+
+/**
+ * @brief Act on every deadline that has been reached: hold periods, sensor
+ * samples and sensor timeouts.
+ */
+static void prvRunDeadlines(void) {
+    TickType_t xNow = xTaskGetTickCount();
+    LockCompartment_t *pxCompartment;
+    uint32_t i;
+
+    for (i = 0; i < appconfigLOCK_COUNT; i++) {
+        pxCompartment = &xCompartments[i];
+
+        if (pxCompartment->xSampling && prvIsDue(xNow, pxCompartment->xSampleAt)) {
+            prvSampleSensor(i, false);
+        }
+
+        if (!prvIsDue(xNow, pxCompartment->xDeadline)) {
+            continue;
+        }
+
+        if (pxCompartment->eState == LockStateOpen) {
+            prvDispatch(i, LockEventHoldExpired);
+        } else if ((lSensorGpios[i] >= 0) &&
+                   ((pxCompartment->eState == LockStateOpening) ||
+                    (pxCompartment->eState == LockStateClosing))) {
+            prvSampleSensor(i, true);
+        }
+    }
+}
+
+/**
+ * @brief Point the hold timer at the earliest deadline of the table, or stop
+ * it when there is none. A command that does not get through leaves the
+ * timer polling; every later event tries again.
+ */
+static void prvArmHoldTimer(void) {
+    TickType_t xNow = xTaskGetTickCount();
+    TickType_t xWait = portMAX_DELAY;
+    TickType_t xRemaining;
+    BaseType_t xResult;
+    uint32_t i;
+
+    for (i = 0; i < appconfigLOCK_COUNT; i++) {
+        LockState_t eState = xCompartments[i].eState;
+
+        if ((eState == LockStateOpen) ||
+            ((lSensorGpios[i] >= 0) && ((eState == LockStateOpening) || (eState == LockStateClosing)))) {
+            xRemaining = prvIsDue(xNow, xCompartments[i].xDeadline) ? 0U : (xCompartments[i].xDeadline - xNow);
+
+            if (xRemaining < xWait) {
+                xWait = xRemaining;
+            }
+        }
+
+        if (xCompartments[i].xSampling) {
+            xRemaining = prvIsDue(xNow, xCompartments[i].xSampleAt) ? 0U : (xCompartments[i].xSampleAt - xNow);
+
+            if (xRemaining < xWait) {
+                xWait = xRemaining;
+            }
+        }
+    }
+
+    if (xWait == portMAX_DELAY) {
+        xResult = xTimerStop(xHoldTimer, prvCommandWait());
+    } else {
+        xResult = xTimerChangePeriod(xHoldTimer, (xWait > 0U) ? xWait : 1U, prvCommandWait());
+    }
+
+    if (xResult != pdPASS) {
+        IotLogWarn("prvArmHoldTimer: the timer queue is full, polling the lock deadlines");
+    }
+}
+
+static uint32_t prvOpenMask(void) {
+    uint32_t ulMask = 0U;
+    uint32_t i;
+
+    for (i = 0; i < appconfigLOCK_COUNT; i++) {
+        if (xCompartments[i].eState == LockStateOpen) {
+            ulMask |= (1UL << i);
+        }
+    }
+
+    return ulMask;
+}
+
+/**
+ * @brief Apply an event to every compartment in ulLockMask and report the
+ * ones that settled in a single callback. #LockEventHoldExpired runs every
+ * deadline that is due instead.
+ *
+ * @return pdFAIL if the table stayed busy for appconfigLOCK_STATE_WAIT_MS;
+ * nothing was changed then.
+ */
+static BaseType_t prvPostEvent(LockEvent_t eEvent, uint32_t ulLockMask) {
+    uint32_t ulOpenMask = 0U;
+    uint32_t i;
+
+    if (xSemaphoreTake(xStateMutex, LOCK_STATE_WAIT_TICKS) != pdTRUE) {
+        return pdFAIL;
+    }
+
+    if (eEvent == LockEventHoldExpired) {
+        prvRunDeadlines();
+    } else {
+        for (i = 0; i < appconfigLOCK_COUNT; i++) {
+            if ((ulLockMask & (1UL << i)) != 0U) {
+                prvDispatch(i, eEvent);
+            }
+        }
+    }
+
+    prvArmHoldTimer();
+
+    if (ulSettledMask != 0U) {
+        ulOpenMask = prvOpenMask();
+        (void) xDisplaySetText(DisplayRegionLine3, (ulOpenMask != 0U) ? "UNLOCKED" : "LOCKED");
+        xStateCallback(ulOpenMask, ulSettledMask);
+        ulSettledMask = 0U;
+    }
+
+    (void) xSemaphoreGive(xStateMutex);
+
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvDeferredDeadlines(void *pvParameter1, uint32_t ulParameter2) {
+    (void) pvParameter1;
+    (void) ulParameter2;
+
+    /* Behind whatever the other timers queued meanwhile. If that does not
+     * fit either, the auto-reloading hold timer comes back to it. */
+    if (prvPostEvent(LockEventHoldExpired, LOCK_STATE_ALL_MASK) != pdPASS) {
+        (void) xTimerPendFunctionCall(prvDeferredDeadlines, NULL, 0U, 0U);
+    }
+}
+
+static void prvHoldTimerCallback(TimerHandle_t xTimer) {
+    (void) xTimer;
+
+    prvDeferredDeadlines(NULL, 0U);
+}
+
+/**
+ * @brief Start the debounce interval of the sensor that raised an edge; the
+ * level is read once it has run out.
+ */
+static void prvSensorEdge(void *pvParameter1, uint32_t ulParameter2) {
+    uint32_t ulLock = (uint32_t) (uintptr_t) pvParameter1;
+
+    (void) ulParameter2;
+
+    if (xSemaphoreTake(xStateMutex, LOCK_STATE_WAIT_TICKS) != pdTRUE) {
+        if (xTimerPendFunctionCall(prvSensorEdge, pvParameter1, 0U, 0U) != pdPASS) {
+            /* Any later edge, or the sensor timeout, reads it again. */
+            xEdgePending[ulLock] = false;
+        }
+
+        return;
+    }
+
+    xCompartments[ulLock].xSampleAt = xTaskGetTickCount() + pdMS_TO_TICKS(appconfigLOCK_SENSOR_DEBOUNCE_MS);
+    xCompartments[ulLock].xSampling = true;
+    prvArmHoldTimer();
+
+    (void) xSemaphoreGive(xStateMutex);
+}
+
+static void IRAM_ATTR prvSensorIsr(void *pvArg) {
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    uint32_t ulLock = (uint32_t) (uintptr_t) pvArg;
+
+    /* The rest of a bounce burst is absorbed by the pending sample. */
+    if (xEdgePending[ulLock]) {
+        return;
+    }
+
+    xEdgePending[ulLock] = true;
+
+    if (xTimerPendFunctionCallFromISR(prvSensorEdge, pvArg, 0U, &xHigherPriorityTaskWoken) != pdPASS) {
+        xEdgePending[ulLock] = false;
+    }
+
+    if (xHigherPriorityTaskWoken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static esp_err_t prvSetupSensors(void) {
+    gpio_config_t io_conf;
+    uint64_t ullPins = 0U;
+    esp_err_t e = ESP_OK;
+    uint32_t i;
+
+    for (i = 0; i < appconfigLOCK_COUNT; i++) {
+        if (lSensorGpios[i] >= 0) {
+            ullPins |= (1ULL << lSensorGpios[i]);
+        }
+    }
+
+    if (ullPins == 0U) {
+        return ESP_OK;
+    }
+
+    io_conf.intr_type = GPIO_PIN_INTR_ANYEDGE;
+    io_conf.mode = GPIO_MODE_INPUT;
+    io_conf.pin_bit_mask = ullPins;
+    io_conf.pull_down_en = 1;
+    io_conf.pull_up_en = 0;
+    e = gpio_config(&io_conf);
+
+    if (e == ESP_OK) {
+        /* The ISR service may already have been installed by the BSP. */
+        e = gpio_install_isr_service(0);
+
+        if (e == ESP_ERR_INVALID_STATE) {
+            e = ESP_OK;
+        }
+    }
+
+    for (i = 0; (i < appconfigLOCK_COUNT) && (e == ESP_OK); i++) {
+        if (lSensorGpios[i] >= 0) {
+            e = gpio_isr_handler_add((gpio_num_t) lSensorGpios[i], prvSensorIsr, (void *) (uintptr_t) i);
+        }
+    }
+
+    return e;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xLockStateInit(LockStateCallback_t xCallback) {
+    configASSERT(xCallback != NULL);
+
+    xStateCallback = xCallback;
+    xStateMutex = APP_MUTEX_CREATE(xStateMutex);
+    xHoldTimer = APP_TIMER_CREATE(xHoldTimer,
+                                  "lockHold",
+                                  pdMS_TO_TICKS(appconfigLOCK_OPEN_HOLD_MS),
+                                  pdTRUE,
+                                  NULL,
+                                  prvHoldTimerCallback);
+
+    if ((xStateMutex == NULL) || (xHoldTimer == NULL)) {
+        IotLogError("xLockStateInit: failed to create the lock timer");
+        return pdFAIL;
+    }
+
+    if (prvSetupSensors() != ESP_OK) {
+        IotLogError("xLockStateInit: failed to set up the bolt sensors");
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+BaseType_t xLockStateRequestOpen(uint32_t ulLockMask) {
+    if ((xStateMutex == NULL) || ((ulLockMask & LOCK_STATE_ALL_MASK) == 0U)) {
+        return pdFAIL;
+    }
+
+    return prvPostEvent(LockEventOpenRequest, ulLockMask & LOCK_STATE_ALL_MASK);
+}
+
+BaseType_t xLockStateResync(uint32_t ulChangedMask) {
+    if ((xStateMutex == NULL) || (xSemaphoreTake(xStateMutex, LOCK_STATE_WAIT_TICKS) != pdTRUE)) {
+        return pdFAIL;
+    }
+
+    xStateCallback(prvOpenMask(), ulChangedMask & LOCK_STATE_ALL_MASK);
+    (void) xSemaphoreGive(xStateMutex);
+
+    return pdPASS;
+}
+
+LockState_t eLockStateGet(uint32_t ulLock) {
+    return (ulLock < appconfigLOCK_COUNT) ? xCompartments[ulLock].eState : LockStateClosed;
+}
@@ -59,6 +59,9 @@
 
 #include "iot_network_manager_private.h"
 
+#include "app_log.h"
+#include "app_sched.h"
+#include "boot.h"
 #include "controller.h"
 
 /* Logging Task Defines. */
@@ -139,15 +142,19 @@ int app_main( void )
     /* Perform any hardware initialization that does not require the RTOS to be
      * running.  */
 
+    ( void ) xBootInit();
+
     prvMiscInitialization();
 
     if( SYSTEM_Init() == pdPASS )
     {
+        vBootMark( BootPhaseSystem );
 
         /* A simple example to demonstrate key and certificate provisioning in
          * microcontroller flash using PKCS#11 interface. This should be replaced
-         * by production ready key provisioning mechanism. */
-        vDevModeKeyProvisioning();
+         * by production ready key provisioning mechanism. Skipped when the
+         * same credentials were already provisioned on a previous boot. */
+        vBootProvisionKeys();
 
         ESP_ERROR_CHECK( esp_bt_controller_mem_release( ESP_BT_MODE_CLASSIC_BT ) );
         ESP_ERROR_CHECK( esp_bt_controller_mem_release( ESP_BT_MODE_BLE ) );
@@ -167,6 +174,8 @@ int app_main( void )
 
 static void prvMiscInitialization( void )
 {
+    BaseType_t xAppLogStatus;
+
     /* Initialize NVS */
     esp_err_t ret = nvs_flash_init();
 
@@ -179,10 +188,17 @@ static void prvMiscInitialization( void )
     ESP_ERROR_CHECK( ret );
 
     /* Create tasks that are not dependent on the WiFi being initialized. */
+    /* Below the unlock path, see app_sched.h. */
     xLoggingTaskInitialize( mainLOGGING_TASK_STACK_SIZE,
-                            tskIDLE_PRIORITY + 5,
+                            tskIDLE_PRIORITY + APP_SCHED_PRIORITY_LOGGING,
                             mainLOGGING_MESSAGE_QUEUE_LENGTH );
 
+    /* Deferred records for the hot paths, see app_log.h. Called outside the
+     * assertion so it still runs when configASSERT() compiles to nothing. */
+    xAppLogStatus = xAppLogInit();
+    configASSERT( xAppLogStatus == pdPASS );
+    ( void ) xAppLogStatus;
+
 #if AFR_ESP_LWIP
     configPRINTF( ("Initializing lwIP TCP stack\r\n") );
     tcpip_adapter_init();
@@ -0,0 +1,827 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+#include "aws_demo.h"
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "event_groups.h"
+
+#include "esp_system.h"
+
+/* Retry utilities include. */
+#include "backoff_algorithm.h"
+
+/* MQTT demo helpers header. */
+#include "mqtt_demo_helpers.h"
+
+/* Transport interface implementation include header for TLS. */
+#include "transport_secure_sockets.h"
+
+/* coreMQTT publish records, cleared when a PUBACK is given up on. */
+#include "core_mqtt_state.h"
+
+#include "aws_clientcredential.h"
+
+#include "app_config.h"
+#include "app_rtos.h"
+#include "boot.h"
+#include "latency_probe.h"
+#include "mqtt_agent.h"
+#include "power_manager.h"
+
+#define APP_LOG_MODULE    "mqtt"
+#define APP_LOG_LEVEL     appconfigLOG_LEVEL_MQTT_AGENT
+#include "app_log.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Set in xAgentEvents while the network manager reports a connected network.
+ */
+#define mqttagentNETWORK_UP_BIT    (1UL << 0)
+
+/**
+ * @brief Set in xAgentEvents while an MQTT session is up.
+ */
+#define mqttagentSESSION_UP_BIT    (1UL << 1)
+
+typedef enum MqttAgentCommandType
+{
+    MqttAgentCommandPublish,
+    MqttAgentCommandSubscribe
+} MqttAgentCommandType_t;
+
+/**
+ * @brief A command queued by another task for execution in the agent task.
+ */
+typedef struct MqttAgentCommand
+{
+    MqttAgentCommandType_t eType;
+    const char *pcTopic;
+    uint16_t usTopicLength;
+    uint16_t usPayloadLength;
+    uint32_t ulQueuedAtUs;
+    MqttAgentCompletion_t *pxCompletion;
+    char cPayload[appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH];
+} MqttAgentCommand_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The MQTT context used for MQTT operation. Only the agent task touches it.
+ */
+static MQTTContext_t xMqttContext;
+
+/**
+ * @brief The network context used for Openssl operation.
+ */
+static NetworkContext_t xNetworkContext;
+
+/**
+ * @brief Static buffer used to hold MQTT messages being sent and received.
+ */
+static uint8_t ucSharedBuffer[appconfigMQTT_NETWORK_BUFFER_SIZE];
+
+/**
+ * @brief Static buffer used to hold MQTT messages being sent and received.
+ */
+static MQTTFixedBuffer_t xBuffer =
+        {
+                .pBuffer = ucSharedBuffer,
+                .size = appconfigMQTT_NETWORK_BUFFER_SIZE};
+
+/**
+ * @brief Commands waiting for the agent task.
+ */
+static QueueHandle_t xCommandQueue = NULL;
+APP_QUEUE_STORAGE(xCommandQueue, appconfigMQTT_AGENT_QUEUE_LENGTH, sizeof(MqttAgentCommand_t));
+
+/**
+ * @brief A QoS1 publish waiting for its PUBACK. A zero packet identifier
+ * marks a free slot, since MQTT never assigns identifier 0. The command is
+ * kept so the publish can be sent again if the session survives a
+ * reconnect.
+ */
+typedef struct MqttAgentInFlight
+{
+    uint16_t usPacketId;
+    uint32_t ulSequence; /**< Send order, for resending in the same order. */
+    TickType_t xSentAt;
+    uint32_t ulSentAtUs;
+    MqttAgentCommand_t xCommand;
+} MqttAgentInFlight_t;
+
+/**
+ * @brief In-flight publishes keyed by packet identifier.
+ */
+static MqttAgentInFlight_t xInFlight[appconfigMQTT_AGENT_MAX_INFLIGHT_PUBLISHES];
+
+static uint32_t ulNextSequence = 0U;
+
+/**
+ * @brief The application callback incoming packets are forwarded to.
+ */
+static MQTTEventCallback_t xApplicationCallback = NULL;
+
+/**
+ * @brief Told about every session that comes up or goes away.
+ */
+static MqttAgentSessionCallback_t xSessionCallback = NULL;
+
+/**
+ * @brief Set while the session callback still has work for this session.
+ */
+static volatile bool xSyncPending = false;
+
+/**
+ * @brief Network availability, driven by the network manager callbacks.
+ */
+static EventGroupHandle_t xAgentEvents = NULL;
+APP_EVENT_GROUP_STORAGE(xAgentEvents);
+
+/**
+ * @brief Topic filters subscribed so far, replayed after every reconnect.
+ */
+typedef struct MqttAgentSubscription
+{
+    const char *pcTopicFilter;
+    uint16_t usTopicFilterLength;
+} MqttAgentSubscription_t;
+
+static MqttAgentSubscription_t xSubscriptions[appconfigMQTT_AGENT_MAX_SUBSCRIPTIONS];
+
+/*-----------------------------------------------------------*/
+
+static MqttAgentStatus_t prvSendCommand(MqttAgentCommand_t *pxCommand, TickType_t xTicksToWait) {
+    if (xCommandQueue == NULL) {
+        return MqttAgentBadParameter;
+    }
+
+    pxCommand->ulQueuedAtUs = ulLatencyProbeNow();
+
+    return (xQueueSendToBack(xCommandQueue, pxCommand, xTicksToWait) == pdTRUE) ? MqttAgentSuccess : MqttAgentQueueFull;
+}
+
+static MqttAgentInFlight_t *prvFindInFlight(uint16_t usPacketId) {
+    MqttAgentInFlight_t *pxEntry = NULL;
+    size_t i;
+
+    for (i = 0; i < appconfigMQTT_AGENT_MAX_INFLIGHT_PUBLISHES; i++) {
+        if (xInFlight[i].usPacketId == usPacketId) {
+            pxEntry = &xInFlight[i];
+            break;
+        }
+    }
+
+    return pxEntry;
+}
+
+/**
+ * @brief Tell the owner of a command how it ended, if it asked to know.
+ */
+static void prvCompleteCommand(const MqttAgentCommand_t *pxCommand, MqttAgentStatus_t eStatus) {
+    MqttAgentCompletion_t *pxCompletion = pxCommand->pxCompletion;
+
+    if (pxCompletion != NULL) {
+        pxCompletion->eStatus = eStatus;
+
+        if (pxCompletion->xNotifyTask != NULL) {
+            (void) xTaskNotify(pxCompletion->xNotifyTask, pxCompletion->ulNotifyBits, eSetBits);
+        }
+    }
+}
+
+static void prvReleaseInFlight(MqttAgentInFlight_t *pxEntry, MqttAgentStatus_t eStatus) {
+    pxEntry->usPacketId = 0U;
+    prvCompleteCommand(&pxEntry->xCommand, eStatus);
+}
+
+/**
+ * @brief Fail every publish that has waited longer than
+ * #appconfigMQTT_AGENT_PUBACK_TIMEOUT_MS for its PUBACK.
+ *
+ * coreMQTT keeps a record of every unacknowledged publish and refuses new
+ * ones with MQTTNoMemory once they are all taken, so the record is cleared
+ * as if the PUBACK had arrived. The owner is told and decides whether to
+ * publish again.
+ */
+static void prvExpireInFlight(void) {
+    TickType_t xNow = xTaskGetTickCount();
+    MQTTPublishState_t eState;
+    size_t i;
+
+    for (i = 0; i < appconfigMQTT_AGENT_MAX_INFLIGHT_PUBLISHES; i++) {
+        if ((xInFlight[i].usPacketId != 0U) &&
+            ((xNow - xInFlight[i].xSentAt) >= pdMS_TO_TICKS(appconfigMQTT_AGENT_PUBACK_TIMEOUT_MS))) {
+            AppLogError("PUBACK for packet %u not received within %u ms.",
+                        (unsigned) xInFlight[i].usPacketId,
+                        (unsigned) appconfigMQTT_AGENT_PUBACK_TIMEOUT_MS);
+            (void) MQTT_UpdateStateAck(&xMqttContext, xInFlight[i].usPacketId, MQTTPuback, MQTT_RECEIVE, &eState);
+            prvReleaseInFlight(&xInFlight[i], MqttAgentAckTimeout);
+        }
+    }
+}
+
+/**
+ * @brief Fail every in-flight publish; on a new session their PUBACKs will
+ * never arrive.
+ */
+static void prvFailAllInFlight(void) {
+    size_t i;
+
+    for (i = 0; i < appconfigMQTT_AGENT_MAX_INFLIGHT_PUBLISHES; i++) {
+        if (xInFlight[i].usPacketId != 0U) {
+            AppLogWarn("Packet %u lost with the MQTT session.", (unsigned) xInFlight[i].usPacketId);
+            prvReleaseInFlight(&xInFlight[i], MqttAgentDisconnected);
+        }
+    }
+}
+
+/**
+ * @brief Send every in-flight publish again, with DUP set and its packet
+ * identifier, in the order they were first sent. Used when the broker kept
+ * the session, which still expects their PUBACKs.
+ *
+ * @return pdFAIL if the connection failed; what was not resent is kept for
+ * the next session.
+ */
+static BaseType_t prvResendInFlight(void) {
+    MQTTPublishInfo_t xPublishInfo;
+    MqttAgentInFlight_t *pxEntry;
+    MQTTStatus_t eMqttStatus;
+    uint32_t ulLastSequence = 0U;
+    bool xFirst = true;
+    size_t i;
+
+    for (;;) {
+        pxEntry = NULL;
+
+        for (i = 0; i < appconfigMQTT_AGENT_MAX_INFLIGHT_PUBLISHES; i++) {
+            if ((xInFlight[i].usPacketId != 0U) &&
+                (xFirst || ((int32_t) (xInFlight[i].ulSequence - ulLastSequence) > 0)) &&
+                ((pxEntry == NULL) || ((int32_t) (xInFlight[i].ulSequence - pxEntry->ulSequence) < 0))) {
+                pxEntry = &xInFlight[i];
+            }
+        }
+
+        if (pxEntry == NULL) {
+            return pdPASS;
+        }
+
+        xFirst = false;
+        ulLastSequence = pxEntry->ulSequence;
+
+        (void) memset(&xPublishInfo, 0x00, sizeof(xPublishInfo));
+        xPublishInfo.qos = MQTTQoS1;
+        xPublishInfo.dup = true;
+        xPublishInfo.pTopicName = pxEntry->xCommand.pcTopic;
+        xPublishInfo.topicNameLength = pxEntry->xCommand.usTopicLength;
+        xPublishInfo.pPayload = pxEntry->xCommand.cPayload;
+        xPublishInfo.payloadLength = pxEntry->xCommand.usPayloadLength;
+
+        eMqttStatus = MQTT_Publish(&xMqttContext, &xPublishInfo, pxEntry->usPacketId);
+
+        if (eMqttStatus == MQTTSendFailed) {
+            return pdFAIL;
+        }
+
+        if (eMqttStatus != MQTTSuccess) {
+            AppLogError("Failed to resend packet %u, error = %s.",
+                        (unsigned) pxEntry->usPacketId,
+                        MQTT_Status_strerror(eMqttStatus));
+            prvReleaseInFlight(pxEntry, MqttAgentSendFailed);
+        } else {
+            pxEntry->xSentAt = xTaskGetTickCount();
+        }
+    }
+}
+
+/**
+ * @brief Runs in the agent task for every incoming packet. PUBACKs are
+ * matched to their in-flight entry here, which completes the publish;
+ * everything is then passed on to the application callback.
+ */
+static void prvAgentEventCallback(MQTTContext_t *pxMqttContext,
+                                  MQTTPacketInfo_t *pxPacketInfo,
+                                  MQTTDeserializedInfo_t *pxDeserializedInfo) {
+    MqttAgentInFlight_t *pxEntry;
+    uint16_t usPacketId;
+
+    if (pxPacketInfo->type == MQTT_PACKET_TYPE_PUBACK) {
+        usPacketId = pxDeserializedInfo->packetIdentifier;
+        pxEntry = (usPacketId != 0U) ? prvFindInFlight(usPacketId) : NULL;
+
+        if (pxEntry != NULL) {
+            AppLogDebug("PUBACK for packet %u after %u ticks.",
+                        (unsigned) usPacketId,
+                        (unsigned) (xTaskGetTickCount() - pxEntry->xSentAt));
+            vLatencyProbeRecord(LatencySpanPuback, pxEntry->ulSentAtUs);
+            prvReleaseInFlight(pxEntry, MqttAgentSuccess);
+        } else {
+            AppLogWarn("Late or unknown PUBACK for packet %u.", (unsigned) usPacketId);
+        }
+    }
+
+    if (xApplicationCallback != NULL) {
+        xApplicationCallback(pxMqttContext, pxPacketInfo, pxDeserializedInfo);
+    }
+}
+
+/**
+ * @brief Send a QoS1 publish and record it in the in-flight table. The caller
+ * has already checked that a slot is free.
+ *
+ * @return The MQTT_Publish status; the command is only recorded on success.
+ */
+static MQTTStatus_t prvExecutePublish(const MqttAgentCommand_t *pxCommand) {
+    MQTTPublishInfo_t xPublishInfo;
+    MqttAgentInFlight_t *pxEntry;
+    MQTTStatus_t eMqttStatus;
+    uint16_t usPacketId;
+
+    (void) memset(&xPublishInfo, 0x00, sizeof(xPublishInfo));
+    xPublishInfo.qos = MQTTQoS1;
+    xPublishInfo.pTopicName = pxCommand->pcTopic;
+    xPublishInfo.topicNameLength = pxCommand->usTopicLength;
+    xPublishInfo.pPayload = pxCommand->cPayload;
+    xPublishInfo.payloadLength = pxCommand->usPayloadLength;
+
+    /* MQTT_Init restarts the identifiers on every connect, but publishes
+     * resent into a resumed session still hold theirs. */
+    do {
+        usPacketId = MQTT_GetPacketId(&xMqttContext);
+    } while (prvFindInFlight(usPacketId) != NULL);
+
+    eMqttStatus = MQTT_Publish(&xMqttContext, &xPublishInfo, usPacketId);
+
+    if (eMqttStatus != MQTTSuccess) {
+        AppLogError("Failed to publish to %.*s, error = %s.",
+                    (int) pxCommand->usTopicLength,
+                    pxCommand->pcTopic,
+                    MQTT_Status_strerror(eMqttStatus));
+        return eMqttStatus;
+    }
+
+    pxEntry = prvFindInFlight(0U);
+    assert(pxEntry != NULL);
+    pxEntry->usPacketId = usPacketId;
+    pxEntry->ulSequence = ulNextSequence++;
+    pxEntry->xSentAt = xTaskGetTickCount();
+    pxEntry->ulSentAtUs = ulLatencyProbeNow();
+    pxEntry->xCommand = *pxCommand;
+
+    return MQTTSuccess;
+}
+
+static void prvRecordSubscription(const char *pcTopicFilter, uint16_t usTopicFilterLength) {
+    MqttAgentSubscription_t *pxFree = NULL;
+    size_t i;
+
+    for (i = 0; i < appconfigMQTT_AGENT_MAX_SUBSCRIPTIONS; i++) {
+        if ((xSubscriptions[i].pcTopicFilter == pcTopicFilter) &&
+            (xSubscriptions[i].usTopicFilterLength == usTopicFilterLength)) {
+            return;
+        }
+
+        if ((pxFree == NULL) && (xSubscriptions[i].pcTopicFilter == NULL)) {
+            pxFree = &xSubscriptions[i];
+        }
+    }
+
+    if (pxFree != NULL) {
+        pxFree->pcTopicFilter = pcTopicFilter;
+        pxFree->usTopicFilterLength = usTopicFilterLength;
+    } else {
+        AppLogWarn("No room to remember %.*s; it will not be restored after a reconnect.",
+                   (int) usTopicFilterLength,
+                   pcTopicFilter);
+    }
+}
+
+/**
+ * @brief SecureSocketsTransport_Recv, timed for #LatencySpanTlsWaitRead.
+ *
+ * The secure sockets transport does not say when data arrived, so the span
+ * starts at the call and includes the wait for the peer.
+ */
+static int32_t prvTransportRecv(NetworkContext_t *pxNetworkContext, void *pvBuffer, size_t xBytesToRecv) {
+    uint32_t ulStartUs = ulLatencyProbeNow();
+    int32_t lReceived = SecureSocketsTransport_Recv(pxNetworkContext, pvBuffer, xBytesToRecv);
+
+    if (lReceived > 0) {
+        vLatencyProbeRecord(LatencySpanTlsWaitRead, ulStartUs);
+    }
+
+    return lReceived;
+}
+
+/**
+ * @brief MQTT_Init time source.
+ */
+static uint32_t prvGetTimeMs(void) {
+    return (uint32_t) (xTaskGetTickCount() * portTICK_PERIOD_MS);
+}
+
+/**
+ * @brief Open the TLS connection and send CONNECT.
+ *
+ * With #appconfigMQTT_PERSISTENT_SESSION the broker keeps our subscriptions
+ * and queues QoS1 messages while we are away, and reports that through
+ * pxSessionPresent so the caller can skip resubscribing.
+ */
+static BaseType_t prvEstablishSession(bool *pxSessionPresent) {
+    ServerInfo_t xServerInfo;
+    SocketsConfig_t xSocketsConfig;
+    TransportInterface_t xTransport;
+    MQTTConnectInfo_t xConnectInfo;
+    TransportSocketStatus_t eNetworkStatus;
+    MQTTStatus_t eMqttStatus;
+
+    (void) memset(&xServerInfo, 0x00, sizeof(xServerInfo));
+    xServerInfo.pHostName = clientcredentialMQTT_BROKER_ENDPOINT;
+    xServerInfo.hostNameLength = sizeof(clientcredentialMQTT_BROKER_ENDPOINT) - 1U;
+    xServerInfo.port = clientcredentialMQTT_BROKER_PORT;
+
+    (void) memset(&xSocketsConfig, 0x00, sizeof(xSocketsConfig));
+    xSocketsConfig.enableTls = true;
+#ifdef democonfigROOT_CA_PEM
+    xSocketsConfig.pRootCa = democonfigROOT_CA_PEM;
+    xSocketsConfig.rootCaSize = sizeof(democonfigROOT_CA_PEM);
+#endif
+    xSocketsConfig.sendTimeoutMs = appconfigMQTT_TRANSPORT_SEND_TIMEOUT_MS;
+    xSocketsConfig.recvTimeoutMs = appconfigMQTT_TRANSPORT_RECV_TIMEOUT_MS;
+
+    /* The handshake is the only CPU heavy part of the session; everything
+     * after it can run at the scaled down frequency. It is a full handshake
+     * every time: the secure-sockets transport cannot resume a TLS session. */
+    vPowerLockAcquire(PowerLockCpuMax);
+    eNetworkStatus = SecureSocketsTransport_Connect(&xNetworkContext, &xServerInfo, &xSocketsConfig);
+    vPowerLockRelease(PowerLockCpuMax);
+
+    if (eNetworkStatus != TRANSPORT_SOCKET_STATUS_SUCCESS) {
+        AppLogError("TLS connection to %s failed, status = %d.",
+                    clientcredentialMQTT_BROKER_ENDPOINT,
+                    (int) eNetworkStatus);
+        return pdFAIL;
+    }
+
+    xTransport.pNetworkContext = &xNetworkContext;
+    xTransport.send = SecureSocketsTransport_Send;
+    xTransport.recv = prvTransportRecv;
+
+    eMqttStatus = MQTT_Init(&xMqttContext, &xTransport, prvGetTimeMs, prvAgentEventCallback, &xBuffer);
+
+    if (eMqttStatus == MQTTSuccess) {
+        (void) memset(&xConnectInfo, 0x00, sizeof(xConnectInfo));
+        xConnectInfo.cleanSession = (appconfigMQTT_PERSISTENT_SESSION == 0);
+        xConnectInfo.pClientIdentifier = democonfigCLIENT_IDENTIFIER;
+        xConnectInfo.clientIdentifierLength = (uint16_t) (sizeof(democonfigCLIENT_IDENTIFIER) - 1U);
+        xConnectInfo.keepAliveIntervalSec = appconfigMQTT_KEEP_ALIVE_INTERVAL_S;
+
+        eMqttStatus = MQTT_Connect(&xMqttContext,
+                                   &xConnectInfo,
+                                   NULL,
+                                   appconfigMQTT_CONNACK_RECV_TIMEOUT_MS,
+                                   pxSessionPresent);
+    }
+
+    if (eMqttStatus != MQTTSuccess) {
+        AppLogError("MQTT CONNECT failed, error = %s.", MQTT_Status_strerror(eMqttStatus));
+        (void) SecureSocketsTransport_Disconnect(&xNetworkContext);
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+/**
+ * @brief Restore every subscription on a fresh session.
+ */
+static BaseType_t prvResubscribe(void) {
+    BaseType_t xStatus = pdPASS;
+    size_t i;
+
+    for (i = 0; (i < appconfigMQTT_AGENT_MAX_SUBSCRIPTIONS) && (xStatus == pdPASS); i++) {
+        if (xSubscriptions[i].pcTopicFilter != NULL) {
+            xStatus = SubscribeToTopic(&xMqttContext,
+                                       xSubscriptions[i].pcTopicFilter,
+                                       xSubscriptions[i].usTopicFilterLength);
+        }
+    }
+
+    return xStatus;
+}
+
+/**
+ * @brief Execute every command that is queued right now, so that publishes
+ * queued while the process loop was receiving go out back to back. Draining
+ * stops early when every in-flight slot is taken; the remaining commands
+ * wait for the PUBACKs that free a slot.
+ *
+ * @return pdFAIL if the connection failed. A publish that hit the failure,
+ * or found coreMQTT out of publish records, is put back at the front of the
+ * queue so it is retried after reconnecting or once PUBACKs have come in.
+ */
+static BaseType_t prvDrainCommandQueue(void) {
+    MqttAgentCommand_t xCommand;
+    MQTTStatus_t eMqttStatus;
+    BaseType_t xConnected = pdPASS;
+    bool xRetry = false;
+
+    while ((xConnected == pdPASS) && !xRetry && (xQueuePeek(xCommandQueue, &xCommand, 0U) == pdTRUE)) {
+        if ((xCommand.eType == MqttAgentCommandPublish) && (prvFindInFlight(0U) == NULL)) {
+            break;
+        }
+
+        (void) xQueueReceive(xCommandQueue, &xCommand, 0U);
+        vLatencyProbeRecord(LatencySpanAgentQueue, xCommand.ulQueuedAtUs);
+
+        if (xCommand.eType == MqttAgentCommandSubscribe) {
+            if (SubscribeToTopic(&xMqttContext, xCommand.pcTopic, xCommand.usTopicLength) == pdPASS) {
+                prvRecordSubscription(xCommand.pcTopic, xCommand.usTopicLength);
+            } else {
+                AppLogError("Failed to subscribe to %.*s.",
+                            (int) xCommand.usTopicLength,
+                            xCommand.pcTopic);
+            }
+
+            continue;
+        }
+
+        eMqttStatus = prvExecutePublish(&xCommand);
+
+        if (eMqttStatus == MQTTSendFailed) {
+            xConnected = pdFAIL;
+            xRetry = true;
+        } else if (eMqttStatus == MQTTNoMemory) {
+            /* Every coreMQTT record is taken; PUBACKs or expiry free them. */
+            xRetry = true;
+        } else if (eMqttStatus != MQTTSuccess) {
+            prvCompleteCommand(&xCommand, MqttAgentBadParameter);
+        }
+
+        /* Successful publishes complete when their PUBACK arrives. */
+        if (xRetry && (xQueueSendToFront(xCommandQueue, &xCommand, 0U) != pdTRUE)) {
+            AppLogWarn("Publish to %.*s dropped, the command queue refilled.",
+                       (int) xCommand.usTopicLength,
+                       xCommand.pcTopic);
+            prvCompleteCommand(&xCommand, MqttAgentQueueFull);
+        }
+    }
+
+    return xConnected;
+}
+
+/**
+ * @brief Wait for a network, then connect with jittered exponential backoff
+ * until a session is up.
+ *
+ * @param[in] xBackoffFirst Delay the first attempt too. Used after a session
+ * drop, so that a fleet which lost the broker at the same moment does not
+ * reconnect at the same moment.
+ */
+static void prvConnectWithBackoff(bool xBackoffFirst) {
+    BackoffAlgorithmContext_t xReconnectParams;
+    uint16_t usNextBackoffMs = 0U;
+    BaseType_t xConnected = pdFAIL;
+    bool xSessionPresent = false;
+
+    BackoffAlgorithm_InitializeParams(&xReconnectParams,
+                                      appconfigMQTT_RECONNECT_BACKOFF_BASE_MS,
+                                      appconfigMQTT_RECONNECT_MAX_BACKOFF_MS,
+                                      BACKOFF_ALGORITHM_RETRY_FOREVER);
+
+    while (xConnected == pdFAIL) {
+        if (xBackoffFirst) {
+            (void) BackoffAlgorithm_GetNextBackoff(&xReconnectParams, esp_random(), &usNextBackoffMs);
+            AppLogInfo("Reconnecting to the MQTT broker in %u ms.", (unsigned) usNextBackoffMs);
+            vTaskDelay(pdMS_TO_TICKS(usNextBackoffMs));
+        }
+
+        xBackoffFirst = true;
+
+        (void) xEventGroupWaitBits(xAgentEvents, mqttagentNETWORK_UP_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+
+        xConnected = prvEstablishSession(&xSessionPresent);
+
+        if (xConnected == pdPASS) {
+            vBootMark(BootPhaseMqtt);
+        }
+
+        if ((xConnected == pdPASS) && xSessionPresent) {
+            AppLogInfo("Resumed the persistent MQTT session; subscriptions are still in place.");
+            xConnected = prvResendInFlight();
+
+            if (xConnected == pdFAIL) {
+                AppLogError("Failed to resend the unacknowledged publishes.");
+                (void) DisconnectMqttSession(&xMqttContext, &xNetworkContext);
+            }
+        } else if (xConnected == pdPASS) {
+            prvFailAllInFlight();
+            xConnected = prvResubscribe();
+
+            if (xConnected == pdFAIL) {
+                AppLogError("Failed to restore subscriptions.");
+                (void) DisconnectMqttSession(&xMqttContext, &xNetworkContext);
+            }
+        } else {
+            /* Log error to indicate connection failure. */
+            AppLogError("Failed to connect to MQTT broker.");
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xMqttAgentInit(void) {
+    if (xCommandQueue == NULL) {
+        xCommandQueue = APP_QUEUE_CREATE(xCommandQueue);
+    }
+
+    if (xAgentEvents == NULL) {
+        xAgentEvents = APP_EVENT_GROUP_CREATE(xAgentEvents);
+    }
+
+    return ((xCommandQueue != NULL) && (xAgentEvents != NULL)) ? pdPASS : pdFAIL;
+}
+
+BaseType_t xMqttAgentRun(MQTTEventCallback_t xEventCallback) {
+    MQTTStatus_t eMqttStatus = MQTTSuccess;
+    bool xReconnecting = false;
+
+    assert(xCommandQueue != NULL);
+
+    xApplicationCallback = xEventCallback;
+
+    for (;;) {
+        prvConnectWithBackoff(xReconnecting);
+        xReconnecting = true;
+        AppLogInfo("MQTT session established.");
+
+        (void) xEventGroupSetBits(xAgentEvents, mqttagentSESSION_UP_BIT);
+        xSyncPending = true;
+
+        while (true) {
+            if (prvDrainCommandQueue() == pdFAIL) {
+                break;
+            }
+
+            /* Only with an empty queue, so that what the callback queues is
+             * not refused behind commands left over from the last session.
+             * At most once per pass, so a callback that cannot finish yet
+             * waits for the process loop in between. */
+            if (xSyncPending && (uxQueueMessagesWaiting(xCommandQueue) == 0U)) {
+                xSyncPending = false;
+
+                if ((xSessionCallback != NULL) && !xSessionCallback(true)) {
+                    xSyncPending = true;
+                }
+
+                if (prvDrainCommandQueue() == pdFAIL) {
+                    break;
+                }
+            }
+
+            eMqttStatus = MQTT_ProcessLoop(&xMqttContext, appconfigMQTT_AGENT_PROCESS_LOOP_TIMEOUT_MS);
+
+            if (eMqttStatus != MQTTSuccess) {
+                AppLogWarn("MQTT_ProcessLoop returned with status = %s.",
+                           MQTT_Status_strerror(eMqttStatus));
+                break;
+            }
+
+            prvExpireInFlight();
+
+            if ((xEventGroupGetBits(xAgentEvents) & mqttagentNETWORK_UP_BIT) == 0U) {
+                AppLogWarn("Network lost.");
+                break;
+            }
+        }
+
+        /* The connection is gone. In-flight publishes are kept until the
+         * reconnect shows whether the broker kept the session. */
+        (void) xEventGroupClearBits(xAgentEvents, mqttagentSESSION_UP_BIT);
+        xSyncPending = false;
+        (void) DisconnectMqttSession(&xMqttContext, &xNetworkContext);
+
+        if (xSessionCallback != NULL) {
+            (void) xSessionCallback(false);
+        }
+    }
+
+    return pdFAIL;
+}
+
+void vMqttAgentSetNetworkState(bool xConnected) {
+    if (xAgentEvents != NULL) {
+        if (xConnected) {
+            (void) xEventGroupSetBits(xAgentEvents, mqttagentNETWORK_UP_BIT);
+        } else {
+            (void) xEventGroupClearBits(xAgentEvents, mqttagentNETWORK_UP_BIT);
+        }
+    }
+}
+
+void vMqttAgentSetSessionCallback(MqttAgentSessionCallback_t xCallback) {
+    xSessionCallback = xCallback;
+}
+
+void vMqttAgentRequestSync(void) {
+    if (xMqttAgentIsConnected()) {
+        xSyncPending = true;
+    }
+}
+
+bool xMqttAgentIsConnected(void) {
+    return (xAgentEvents != NULL) && ((xEventGroupGetBits(xAgentEvents) & mqttagentSESSION_UP_BIT) != 0U);
+}
+
+/*-----------------------------------------------------------*/
+
+MqttAgentStatus_t eMqttAgentPublish(const char *pcTopic,
+                                    uint16_t usTopicLength,
+                                    const char *pcPayload,
+                                    size_t xPayloadLength,
+                                    TickType_t xTicksToWait) {
+    return eMqttAgentPublishNotify(pcTopic, usTopicLength, pcPayload, xPayloadLength, xTicksToWait, NULL);
+}
+
+MqttAgentStatus_t eMqttAgentPublishNotify(const char *pcTopic,
+                                          uint16_t usTopicLength,
+                                          const char *pcPayload,
+                                          size_t xPayloadLength,
+                                          TickType_t xTicksToWait,
+                                          MqttAgentCompletion_t *pxCompletion) {
+    MqttAgentCommand_t xCommand;
+    MqttAgentStatus_t eStatus;
+
+    if ((pcTopic == NULL) || (pcPayload == NULL) || (xPayloadLength > sizeof(xCommand.cPayload))) {
+        eStatus = MqttAgentBadParameter;
+    } else if (!xMqttAgentIsConnected()) {
+        eStatus = MqttAgentDisconnected;
+    } else {
+        xCommand.eType = MqttAgentCommandPublish;
+        xCommand.pcTopic = pcTopic;
+        xCommand.usTopicLength = usTopicLength;
+        xCommand.usPayloadLength = (uint16_t) xPayloadLength;
+        xCommand.pxCompletion = pxCompletion;
+        (void) memcpy(xCommand.cPayload, pcPayload, xPayloadLength);
+
+        if (pxCompletion != NULL) {
+            /* Before queueing: the agent may complete it before we return. */
+            pxCompletion->eStatus = MqttAgentPending;
+        }
+
+        eStatus = prvSendCommand(&xCommand, xTicksToWait);
+    }
+
+    if ((eStatus != MqttAgentSuccess) && (pxCompletion != NULL)) {
+        pxCompletion->eStatus = eStatus;
+    }
+
+    return eStatus;
+}
+
+MqttAgentStatus_t eMqttAgentSubscribe(const char *pcTopicFilter,
+                                      uint16_t usTopicFilterLength,
+                                      TickType_t xTicksToWait) {
+    MqttAgentCommand_t xCommand;
+
+    if (pcTopicFilter == NULL) {
+        return MqttAgentBadParameter;
+    }
+
+    xCommand.eType = MqttAgentCommandSubscribe;
+    xCommand.pcTopic = pcTopicFilter;
+    xCommand.usTopicLength = usTopicFilterLength;
+    xCommand.usPayloadLength = 0U;
+    xCommand.pxCompletion = NULL;
+
+    return prvSendCommand(&xCommand, xTicksToWait);
+}
@@ -0,0 +1,840 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "nvs.h"
+
+#include "aws_clientcredential.h"
+#include "iot_demo_logging.h"
+#include "core_json.h"
+
+#include "app_config.h"
+#include "app_rtos.h"
+#include "app_sched.h"
+#include "boot.h"
+#include "mqtt_agent.h"
+#include "power_manager.h"
+#include "shadow_parser.h"
+#include "ota_client.h"
+
+/*-----------------------------------------------------------*/
+
+#define OTA_TOPIC_PREFIX            "cmd/personalbox/" clientcredentialIOT_THING_NAME "/ota/"
+#define OTA_TOPIC_PREFIX_LENGTH     ((uint16_t) (sizeof(OTA_TOPIC_PREFIX) - 1U))
+
+#define OTA_TOPIC_FILTER            OTA_TOPIC_PREFIX "+"
+#define OTA_TOPIC_FILTER_LENGTH     ((uint16_t) (sizeof(OTA_TOPIC_FILTER) - 1U))
+
+#define OTA_OFFER_TOPIC             OTA_TOPIC_PREFIX "offer"
+#define OTA_OFFER_TOPIC_LENGTH      ((uint16_t) (sizeof(OTA_OFFER_TOPIC) - 1U))
+
+#define OTA_DATA_TOPIC              OTA_TOPIC_PREFIX "data"
+#define OTA_DATA_TOPIC_LENGTH       ((uint16_t) (sizeof(OTA_DATA_TOPIC) - 1U))
+
+#define OTA_REQUEST_TOPIC           "dt/personalbox/" clientcredentialIOT_THING_NAME "/ota/request"
+#define OTA_REQUEST_TOPIC_LENGTH    ((uint16_t) (sizeof(OTA_REQUEST_TOPIC) - 1U))
+
+#define OTA_STATUS_TOPIC            "dt/personalbox/" clientcredentialIOT_THING_NAME "/ota"
+#define OTA_STATUS_TOPIC_LENGTH     ((uint16_t) (sizeof(OTA_STATUS_TOPIC) - 1U))
+
+/* A data message is the stream offset, big endian, then the block. */
+#define OTA_DATA_HEADER_LENGTH      (4U)
+
+/* Delta instructions: an opcode, then two little-endian words. A copy takes
+ * the source offset in the running image and the length, an insert a zero
+ * and the length of the literal bytes that follow. */
+#define OTA_OP_HEADER_LENGTH        (9U)
+#define OTA_OP_NONE                 (0U)
+#define OTA_OP_COPY                 ((uint8_t) 'C')
+#define OTA_OP_INSERT               ((uint8_t) 'I')
+
+#define OTA_SHA256_LENGTH           (32U)
+#define OTA_JOB_ID_LENGTH           (32U)
+
+/* SPI_FLASH_SEC_SIZE */
+#define OTA_SECTOR_SIZE             (4096U)
+
+#define OTA_NVS_NAMESPACE           "ota"
+#define OTA_NVS_PROGRESS            "progress"
+#define OTA_NVS_PENDING             "pending"
+
+#define OTA_TASK_STACK_SIZE         (4096U)
+#define OTA_TASK_PRIORITY           (tskIDLE_PRIORITY + APP_SCHED_PRIORITY_OTA)
+
+/* Time for the last status to leave before the restart. */
+#define OTA_RESTART_DELAY_MS        (1000U)
+
+/* Fixed header, remaining length, topic length and packet identifier. */
+_Static_assert((8U + OTA_DATA_TOPIC_LENGTH + OTA_DATA_HEADER_LENGTH + appconfigOTA_BLOCK_SIZE) <=
+               appconfigMQTT_NETWORK_BUFFER_SIZE,
+               "appconfigOTA_BLOCK_SIZE does not fit the MQTT network buffer");
+_Static_assert((appconfigOTA_CHECKPOINT_BYTES % OTA_SECTOR_SIZE) == 0U,
+               "appconfigOTA_CHECKPOINT_BYTES must be a multiple of the flash sector");
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief What an offer asks for. Stored with the progress, so that a
+ * transfer can carry on after a reset without the offer being sent again.
+ */
+typedef struct OtaJob
+{
+    char cId[OTA_JOB_ID_LENGTH];
+    uint8_t ucSha256[OTA_SHA256_LENGTH];     /**< Of the new image. */
+    uint8_t ucBaseSha256[OTA_SHA256_LENGTH]; /**< Of the image the delta applies to. */
+    uint32_t ulImageSize;
+    uint32_t ulStreamSize;
+    uint8_t ucDelta;
+    uint8_t ucReserved[3];
+} OtaJob_t;
+
+/**
+ * @brief Where the stream and the image are. Only saved when the image
+ * offset is on a checkpoint, so the sector after it has not been touched.
+ */
+typedef struct OtaProgress
+{
+    OtaJob_t xJob;
+    uint32_t ulStreamOffset;
+    uint32_t ulImageOffset;
+    uint32_t ulOpSource;
+    uint32_t ulOpRemaining;
+    uint8_t ucOp;
+    uint8_t ucReserved[3];
+} OtaProgress_t;
+
+typedef enum OtaMessageType
+{
+    OtaMessageOffer = 0,
+    OtaMessageBlock
+} OtaMessageType_t;
+
+typedef struct OtaMessage
+{
+    OtaMessageType_t eType;
+    union
+    {
+        OtaJob_t xOffer;
+        struct
+        {
+            uint32_t ulOffset;
+            uint32_t ulLength;
+            uint8_t ucData[appconfigOTA_BLOCK_SIZE];
+        } xBlock;
+    } u;
+} OtaMessage_t;
+
+/*-----------------------------------------------------------*/
+
+static QueueHandle_t xMessageQueue = NULL;
+APP_QUEUE_STORAGE(xMessageQueue, appconfigOTA_WINDOW_BLOCKS, sizeof(OtaMessage_t));
+
+APP_TASK_STORAGE(xOtaTask, OTA_TASK_STACK_SIZE);
+
+/*
+ * The transfer state below belongs to the OTA task.
+ */
+
+static const esp_partition_t *pxRunning = NULL;
+static const esp_partition_t *pxTarget = NULL;
+
+static uint8_t ucRunningSha256[OTA_SHA256_LENGTH];
+
+static OtaProgress_t xProgress;
+static bool xActive = false;
+static bool xPaused = false;
+
+/**
+ * @brief End of the window last asked for.
+ */
+static uint32_t ulWindowEnd = 0U;
+static uint32_t ulRetries = 0U;
+
+/**
+ * @brief An instruction split across two blocks.
+ */
+static uint8_t ucOpHeader[OTA_OP_HEADER_LENGTH];
+static size_t xOpHeaderLength = 0U;
+
+static uint8_t ucCopyBuffer[appconfigOTA_BLOCK_SIZE];
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvReadLe32(const uint8_t *pucBytes) {
+    return (uint32_t) pucBytes[0] | ((uint32_t) pucBytes[1] << 8) |
+           ((uint32_t) pucBytes[2] << 16) | ((uint32_t) pucBytes[3] << 24);
+}
+
+static uint32_t prvReadBe32(const uint8_t *pucBytes) {
+    return ((uint32_t) pucBytes[0] << 24) | ((uint32_t) pucBytes[1] << 16) |
+           ((uint32_t) pucBytes[2] << 8) | (uint32_t) pucBytes[3];
+}
+
+static void prvHexEncode(char *pcHex, const uint8_t *pucBytes, size_t xLength) {
+    static const char cDigits[] = "0123456789abcdef";
+    size_t i;
+
+    for (i = 0; i < xLength; i++) {
+        pcHex[2U * i] = cDigits[pucBytes[i] >> 4];
+        pcHex[(2U * i) + 1U] = cDigits[pucBytes[i] & 0x0FU];
+    }
+
+    pcHex[2U * xLength] = '\0';
+}
+
+static bool prvHexDecode(uint8_t *pucBytes, const char *pcHex, size_t xHexLength) {
+    uint8_t ucNibble;
+    size_t i;
+
+    if (xHexLength != (2U * OTA_SHA256_LENGTH)) {
+        return false;
+    }
+
+    for (i = 0; i < xHexLength; i++) {
+        if ((pcHex[i] >= '0') && (pcHex[i] <= '9')) {
+            ucNibble = (uint8_t) (pcHex[i] - '0');
+        } else if ((pcHex[i] >= 'a') && (pcHex[i] <= 'f')) {
+            ucNibble = (uint8_t) (pcHex[i] - 'a' + 10);
+        } else if ((pcHex[i] >= 'A') && (pcHex[i] <= 'F')) {
+            ucNibble = (uint8_t) (pcHex[i] - 'A' + 10);
+        } else {
+            return false;
+        }
+
+        pucBytes[i / 2U] = (uint8_t) (((i % 2U) == 0U) ? (ucNibble << 4) : (pucBytes[i / 2U] | ucNibble));
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPublish(const char *pcTopic, uint16_t usTopicLength, const char *pcPayload, int lLength) {
+    if ((lLength <= 0) || ((size_t) lLength >= appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH)) {
+        return;
+    }
+
+    if (eMqttAgentPublish(pcTopic, usTopicLength, pcPayload, (size_t) lLength, 0U) == MqttAgentQueueFull) {
+        IotLogWarn("prvPublish: the MQTT agent queue is full");
+    }
+}
+
+static void prvReportState(const char *pcJob, const char *pcState, const char *pcReason) {
+    char cPayload[160];
+    int lLength = snprintf(cPayload, sizeof(cPayload),
+                           "{\"job\":\"%s\",\"state\":\"%s\",\"offset\":%u,\"streamSize\":%u%s%s%s}",
+                           pcJob,
+                           pcState,
+                           (unsigned) xProgress.ulStreamOffset,
+                           (unsigned) xProgress.xJob.ulStreamSize,
+                           (pcReason != NULL) ? ",\"reason\":\"" : "",
+                           (pcReason != NULL) ? pcReason : "",
+                           (pcReason != NULL) ? "\"" : "");
+
+    IotLogInfo("OTA job %s: %s%s%s", pcJob, pcState, (pcReason != NULL) ? ", " : "", (pcReason != NULL) ? pcReason : "");
+    prvPublish(OTA_STATUS_TOPIC, OTA_STATUS_TOPIC_LENGTH, cPayload, lLength);
+}
+
+/**
+ * @brief Announce the running image, which is what a delta is made against.
+ */
+static void prvReportIdle(void) {
+    char cSha256[(2U * OTA_SHA256_LENGTH) + 1U];
+    char cPayload[160];
+    int lLength;
+
+    prvHexEncode(cSha256, ucRunningSha256, OTA_SHA256_LENGTH);
+    lLength = snprintf(cPayload, sizeof(cPayload),
+                       "{\"state\":\"idle\",\"version\":\"%.32s\",\"sha256\":\"%s\",\"slot\":\"%s\"}",
+                       esp_ota_get_app_description()->version,
+                       cSha256,
+                       pxRunning->label);
+
+    prvPublish(OTA_STATUS_TOPIC, OTA_STATUS_TOPIC_LENGTH, cPayload, lLength);
+}
+
+static void prvRequestWindow(void) {
+    char cPayload[96];
+    uint32_t ulLength = xProgress.xJob.ulStreamSize - xProgress.ulStreamOffset;
+    int lLength;
+
+    if (ulLength > (appconfigOTA_WINDOW_BLOCKS * appconfigOTA_BLOCK_SIZE)) {
+        ulLength = appconfigOTA_WINDOW_BLOCKS * appconfigOTA_BLOCK_SIZE;
+    }
+
+    ulWindowEnd = xProgress.ulStreamOffset + ulLength;
+
+    lLength = snprintf(cPayload, sizeof(cPayload),
+                       "{\"job\":\"%s\",\"offset\":%u,\"length\":%u,\"blockSize\":%u}",
+                       xProgress.xJob.cId,
+                       (unsigned) xProgress.ulStreamOffset,
+                       (unsigned) ulLength,
+                       (unsigned) appconfigOTA_BLOCK_SIZE);
+
+    prvPublish(OTA_REQUEST_TOPIC, OTA_REQUEST_TOPIC_LENGTH, cPayload, lLength);
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvStore(const char *pcKey, const void *pvValue, size_t xLength) {
+    nvs_handle xHandle;
+    esp_err_t e = nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &xHandle);
+
+    if (e == ESP_OK) {
+        e = (pvValue != NULL) ? nvs_set_blob(xHandle, pcKey, pvValue, xLength) : nvs_erase_key(xHandle, pcKey);
+
+        if ((e == ESP_OK) || (e == ESP_ERR_NVS_NOT_FOUND)) {
+            e = nvs_commit(xHandle);
+        }
+
+        nvs_close(xHandle);
+    }
+
+    if (e != ESP_OK) {
+        IotLogWarn("prvStore: failed to write %s: %d", pcKey, (int) e);
+    }
+}
+
+static bool prvLoad(const char *pcKey, void *pvValue, size_t xLength) {
+    size_t xStored = xLength;
+    nvs_handle xHandle;
+    bool xFound = false;
+
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READONLY, &xHandle) == ESP_OK) {
+        xFound = (nvs_get_blob(xHandle, pcKey, pvValue, &xStored) == ESP_OK) && (xStored == xLength);
+        nvs_close(xHandle);
+    }
+
+    return xFound;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvStopJob(void) {
+    if (xActive) {
+        vPowerLockRelease(PowerLockAwake);
+    }
+
+    xActive = false;
+    xPaused = false;
+    xOpHeaderLength = 0U;
+    prvStore(OTA_NVS_PROGRESS, NULL, 0U);
+}
+
+static void prvFailJob(const char *pcReason) {
+    prvReportState(xProgress.xJob.cId, "failed", pcReason);
+    prvStopJob();
+}
+
+/**
+ * @brief Write into the update slot. Never crosses a sector boundary; the
+ * sector is erased when its first byte is written, so nothing is erased
+ * ahead of the data and a resumed transfer erases again what it rewrites.
+ */
+static bool prvImageWrite(const uint8_t *pucData, uint32_t ulLength) {
+    esp_err_t e = ESP_OK;
+
+    if ((xProgress.ulImageOffset % OTA_SECTOR_SIZE) == 0U) {
+        e = esp_partition_erase_range(pxTarget, xProgress.ulImageOffset, OTA_SECTOR_SIZE);
+    }
+
+    if (e == ESP_OK) {
+        e = esp_partition_write(pxTarget, xProgress.ulImageOffset, pucData, ulLength);
+    }
+
+    if (e != ESP_OK) {
+        IotLogError("prvImageWrite: flash write at %u failed: %d", (unsigned) xProgress.ulImageOffset, (int) e);
+        return false;
+    }
+
+    xProgress.ulImageOffset += ulLength;
+
+    return true;
+}
+
+static bool prvDecodeOp(const char **ppcError) {
+    uint8_t ucOp = ucOpHeader[0];
+    uint32_t ulSource = prvReadLe32(&ucOpHeader[1]);
+    uint32_t ulLength = prvReadLe32(&ucOpHeader[5]);
+
+    xOpHeaderLength = 0U;
+
+    if ((ucOp != OTA_OP_COPY) && (ucOp != OTA_OP_INSERT)) {
+        *ppcError = "bad instruction";
+        return false;
+    }
+
+    if (ulLength > (xProgress.xJob.ulImageSize - xProgress.ulImageOffset)) {
+        *ppcError = "delta overruns image";
+        return false;
+    }
+
+    if ((ucOp == OTA_OP_COPY) && ((ulSource > pxRunning->size) || (ulLength > (pxRunning->size - ulSource)))) {
+        *ppcError = "copy outside base";
+        return false;
+    }
+
+    xProgress.ucOp = (ulLength > 0U) ? ucOp : OTA_OP_NONE;
+    xProgress.ulOpSource = ulSource;
+    xProgress.ulOpRemaining = ulLength;
+
+    return true;
+}
+
+/**
+ * @brief Run a block of the stream: a full image is one insert of the
+ * whole image, a delta a series of copies from the running image and
+ * inserts of new bytes.
+ */
+static bool prvConsume(const uint8_t *pucData, uint32_t ulLength, const char **ppcError) {
+    uint32_t ulRoom;
+    uint32_t ulStep;
+
+    while ((ulLength > 0U) || (xProgress.ucOp == OTA_OP_COPY)) {
+        if (xProgress.ucOp == OTA_OP_NONE) {
+            if (xProgress.xJob.ucDelta == 0U) {
+                *ppcError = "stream longer than image";
+                return false;
+            }
+
+            ulStep = OTA_OP_HEADER_LENGTH - xOpHeaderLength;
+            ulStep = (ulStep < ulLength) ? ulStep : ulLength;
+            (void) memcpy(&ucOpHeader[xOpHeaderLength], pucData, ulStep);
+            xOpHeaderLength += ulStep;
+            xProgress.ulStreamOffset += ulStep;
+            pucData += ulStep;
+            ulLength -= ulStep;
+
+            if ((xOpHeaderLength == OTA_OP_HEADER_LENGTH) && !prvDecodeOp(ppcError)) {
+                return false;
+            }
+
+            continue;
+        }
+
+        ulRoom = OTA_SECTOR_SIZE - (xProgress.ulImageOffset % OTA_SECTOR_SIZE);
+        ulStep = (xProgress.ulOpRemaining < ulRoom) ? xProgress.ulOpRemaining : ulRoom;
+
+        if (xProgress.ucOp == OTA_OP_INSERT) {
+            ulStep = (ulStep < ulLength) ? ulStep : ulLength;
+
+            if (!prvImageWrite(pucData, ulStep)) {
+                *ppcError = "flash write";
+                return false;
+            }
+
+            xProgress.ulStreamOffset += ulStep;
+            pucData += ulStep;
+            ulLength -= ulStep;
+        } else {
+            ulStep = (ulStep < sizeof(ucCopyBuffer)) ? ulStep : sizeof(ucCopyBuffer);
+
+            if ((esp_partition_read(pxRunning, xProgress.ulOpSource, ucCopyBuffer, ulStep) != ESP_OK) ||
+                !prvImageWrite(ucCopyBuffer, ulStep)) {
+                *ppcError = "flash copy";
+                return false;
+            }
+
+            xProgress.ulOpSource += ulStep;
+        }
+
+        xProgress.ulOpRemaining -= ulStep;
+
+        if (xProgress.ulOpRemaining == 0U) {
+            xProgress.ucOp = OTA_OP_NONE;
+        }
+
+        /* Writes stop at every sector boundary, so the image offset lands
+         * on each checkpoint exactly, with the stream and the instruction
+         * state it was reached with. */
+        if ((xProgress.ulImageOffset % appconfigOTA_CHECKPOINT_BYTES) == 0U) {
+            prvStore(OTA_NVS_PROGRESS, &xProgress, sizeof(xProgress));
+            prvReportState(xProgress.xJob.cId, "downloading", NULL);
+        }
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvFinishJob(void) {
+    uint8_t ucSha256[OTA_SHA256_LENGTH];
+    esp_err_t e;
+
+    if ((xProgress.ucOp != OTA_OP_NONE) || (xOpHeaderLength != 0U) ||
+        (xProgress.ulImageOffset != xProgress.xJob.ulImageSize)) {
+        prvFailJob("stream ended early");
+        return;
+    }
+
+    prvReportState(xProgress.xJob.cId, "verifying", NULL);
+
+    /* Walks and checks the whole image, including its appended digest. */
+    e = esp_partition_get_sha256(pxTarget, ucSha256);
+
+    if ((e != ESP_OK) || (memcmp(ucSha256, xProgress.xJob.ucSha256, OTA_SHA256_LENGTH) != 0)) {
+        prvFailJob("image digest mismatch");
+        return;
+    }
+
+    e = esp_ota_set_boot_partition(pxTarget);
+
+    if (e != ESP_OK) {
+        IotLogError("prvFinishJob: esp_ota_set_boot_partition failed: %d", (int) e);
+        prvFailJob("set boot partition");
+        return;
+    }
+
+    /* The next boot reports the outcome from this. */
+    prvStore(OTA_NVS_PENDING, &xProgress.xJob, sizeof(xProgress.xJob));
+    prvReportState(xProgress.xJob.cId, "rebooting", NULL);
+    prvStopJob();
+
+    vTaskDelay(pdMS_TO_TICKS(OTA_RESTART_DELAY_MS));
+    esp_restart();
+}
+
+static void prvStartJob(const OtaJob_t *pxOffer) {
+    if (xActive && (strcmp(pxOffer->cId, xProgress.xJob.cId) == 0) &&
+        (memcmp(pxOffer->ucSha256, xProgress.xJob.ucSha256, OTA_SHA256_LENGTH) == 0)) {
+        /* The same job again: carry on from where the transfer is. */
+        xPaused = false;
+        ulRetries = 0U;
+        prvRequestWindow();
+        return;
+    }
+
+    if (xActive) {
+        prvReportState(xProgress.xJob.cId, "cancelled", "superseded");
+        prvStopJob();
+    }
+
+    (void) memset(&xProgress, 0x00, sizeof(xProgress));
+    xProgress.xJob = *pxOffer;
+
+    if (memcmp(pxOffer->ucSha256, ucRunningSha256, OTA_SHA256_LENGTH) == 0) {
+        prvReportState(pxOffer->cId, "succeeded", "already running");
+        return;
+    }
+
+    if ((pxTarget == NULL) || (pxOffer->ulImageSize == 0U) || (pxOffer->ulImageSize > pxTarget->size) ||
+        (pxOffer->ulStreamSize == 0U)) {
+        prvReportState(pxOffer->cId, "rejected", "size");
+        return;
+    }
+
+    if (pxOffer->ucDelta != 0U) {
+        if (memcmp(pxOffer->ucBaseSha256, ucRunningSha256, OTA_SHA256_LENGTH) != 0) {
+            prvReportState(pxOffer->cId, "rejected", "base image");
+            return;
+        }
+
+        xProgress.ucOp = OTA_OP_NONE;
+    } else {
+        if (pxOffer->ulStreamSize != pxOffer->ulImageSize) {
+            prvReportState(pxOffer->cId, "rejected", "size");
+            return;
+        }
+
+        xProgress.ucOp = OTA_OP_INSERT;
+        xProgress.ulOpRemaining = pxOffer->ulImageSize;
+    }
+
+    /* Saved at offset 0 too, so a reset right away still resumes. */
+    prvStore(OTA_NVS_PROGRESS, &xProgress, sizeof(xProgress));
+
+    vPowerLockAcquire(PowerLockAwake);
+    xActive = true;
+    xPaused = false;
+    ulRetries = 0U;
+
+    prvReportState(pxOffer->cId, "downloading", (pxOffer->ucDelta != 0U) ? "delta" : NULL);
+    prvRequestWindow();
+}
+
+static void prvHandleBlock(uint32_t ulOffset, const uint8_t *pucData, uint32_t ulLength) {
+    const char *pcError = NULL;
+
+    /* Duplicates and blocks after a lost one are dropped; the window is
+     * asked for again from the first missing byte. */
+    if (!xActive || xPaused || (ulOffset != xProgress.ulStreamOffset)) {
+        return;
+    }
+
+    if ((ulLength > (xProgress.xJob.ulStreamSize - ulOffset)) || !prvConsume(pucData, ulLength, &pcError)) {
+        prvFailJob((pcError != NULL) ? pcError : "stream overrun");
+        return;
+    }
+
+    ulRetries = 0U;
+
+    if (xProgress.ulStreamOffset == xProgress.xJob.ulStreamSize) {
+        prvFinishJob();
+    } else if (xProgress.ulStreamOffset >= ulWindowEnd) {
+        prvRequestWindow();
+    }
+}
+
+static void prvHandleTimeout(void) {
+    if (!xActive || xPaused || !xMqttAgentIsConnected()) {
+        return;
+    }
+
+    if (++ulRetries > appconfigOTA_MAX_RETRIES) {
+        /* Kept, in RAM and in NVS, for the next offer of this job. */
+        xPaused = true;
+        prvReportState(xProgress.xJob.cId, "paused", "no data");
+        return;
+    }
+
+    prvRequestWindow();
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Confirm or roll back a freshly installed image, and report how the
+ * last job ended.
+ */
+static void prvCheckRunningImage(void) {
+    esp_ota_img_states_t eState;
+    TickType_t xElapsed = xTaskGetTickCount();
+    TickType_t xTimeout = pdMS_TO_TICKS(appconfigOTA_VERIFY_TIMEOUT_MS);
+    OtaJob_t xPending;
+
+    if ((esp_ota_get_state_partition(pxRunning, &eState) == ESP_OK) && (eState == ESP_OTA_IMG_PENDING_VERIFY)) {
+        if (xBootWait(BootPhaseMqtt, (xElapsed < xTimeout) ? (xTimeout - xElapsed) : 0U) != pdTRUE) {
+            IotLogError("prvCheckRunningImage: the new image did not reach the broker, rolling back");
+            (void) esp_ota_mark_app_invalid_rollback_and_reboot();
+        } else {
+            (void) esp_ota_mark_app_valid_cancel_rollback();
+            IotLogInfo("prvCheckRunningImage: new image confirmed");
+        }
+    }
+
+    if (prvLoad(OTA_NVS_PENDING, &xPending, sizeof(xPending))) {
+        xPending.cId[OTA_JOB_ID_LENGTH - 1U] = '\0';
+        (void) memset(&xProgress, 0x00, sizeof(xProgress));
+        prvReportState(xPending.cId,
+                       (memcmp(xPending.ucSha256, ucRunningSha256, OTA_SHA256_LENGTH) == 0) ? "succeeded" : "failed",
+                       (memcmp(xPending.ucSha256, ucRunningSha256, OTA_SHA256_LENGTH) == 0) ? NULL : "rolled back");
+        prvStore(OTA_NVS_PENDING, NULL, 0U);
+    }
+}
+
+static void prvResumeSavedJob(void) {
+    if (!prvLoad(OTA_NVS_PROGRESS, &xProgress, sizeof(xProgress))) {
+        return;
+    }
+
+    xProgress.xJob.cId[OTA_JOB_ID_LENGTH - 1U] = '\0';
+
+    /* A delta only applies to the image it was made against. */
+    if ((pxTarget == NULL) ||
+        ((xProgress.xJob.ucDelta != 0U) &&
+         (memcmp(xProgress.xJob.ucBaseSha256, ucRunningSha256, OTA_SHA256_LENGTH) != 0))) {
+        prvStore(OTA_NVS_PROGRESS, NULL, 0U);
+        return;
+    }
+
+    vPowerLockAcquire(PowerLockAwake);
+    xActive = true;
+    ulRetries = 0U;
+
+    /* The first timeout asks for the next window once a session is up. */
+    ulWindowEnd = xProgress.ulStreamOffset;
+    prvReportState(xProgress.xJob.cId, "resuming", NULL);
+}
+
+static void prvOtaTask(void *pvParameters) {
+    static OtaMessage_t xMessage;
+
+    (void) pvParameters;
+
+    pxRunning = esp_ota_get_running_partition();
+    pxTarget = esp_ota_get_next_update_partition(NULL);
+
+    if (esp_partition_get_sha256(pxRunning, ucRunningSha256) != ESP_OK) {
+        IotLogWarn("prvOtaTask: cannot hash the running image, deltas will be rejected");
+    }
+
+    prvCheckRunningImage();
+    prvReportIdle();
+    prvResumeSavedJob();
+
+    for (;;) {
+        if (xQueueReceive(xMessageQueue,
+                          &xMessage,
+                          xActive ? pdMS_TO_TICKS(appconfigOTA_BLOCK_TIMEOUT_MS) : portMAX_DELAY) != pdTRUE) {
+            prvHandleTimeout();
+        } else if (xMessage.eType == OtaMessageOffer) {
+            prvStartJob(&xMessage.u.xOffer);
+        } else {
+            prvHandleBlock(xMessage.u.xBlock.ulOffset, xMessage.u.xBlock.ucData, xMessage.u.xBlock.ulLength);
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvSearch(const MQTTPublishInfo_t *pxPublishInfo,
+                      const char *pcKey,
+                      const char **ppcValue,
+                      size_t *pxLength) {
+    char *pcValue = NULL;
+    size_t xLength = 0U;
+
+    if (JSON_Search((char *) pxPublishInfo->pPayload, pxPublishInfo->payloadLength,
+                    pcKey, strlen(pcKey), &pcValue, &xLength) != JSONSuccess) {
+        return false;
+    }
+
+    if ((xLength >= 2U) && (pcValue[0] == '"')) {
+        pcValue++;
+        xLength -= 2U;
+    }
+
+    *ppcValue = pcValue;
+    *pxLength = xLength;
+
+    return true;
+}
+
+/**
+ * @brief {"job":"<id>","size":<image bytes>,"sha256":"<hex>",
+ * "streamSize":<bytes>,"baseSha256":"<hex>"}; baseSha256 only for a delta.
+ */
+static bool prvParseOffer(const MQTTPublishInfo_t *pxPublishInfo, OtaJob_t *pxOffer) {
+    const char *pcValue;
+    size_t xLength;
+
+    (void) memset(pxOffer, 0x00, sizeof(*pxOffer));
+
+    if (JSON_Validate((const char *) pxPublishInfo->pPayload, pxPublishInfo->payloadLength) != JSONSuccess) {
+        return false;
+    }
+
+    if (!prvSearch(pxPublishInfo, "job", &pcValue, &xLength) ||
+        (xLength == 0U) || (xLength >= OTA_JOB_ID_LENGTH) || (memchr(pcValue, '"', xLength) != NULL)) {
+        return false;
+    }
+
+    (void) memcpy(pxOffer->cId, pcValue, xLength);
+
+    if (!prvSearch(pxPublishInfo, "size", &pcValue, &xLength) ||
+        (eShadowParseUint32(pcValue, xLength, &pxOffer->ulImageSize) != ShadowParserSuccess) ||
+        !prvSearch(pxPublishInfo, "sha256", &pcValue, &xLength) ||
+        !prvHexDecode(pxOffer->ucSha256, pcValue, xLength)) {
+        return false;
+    }
+
+    pxOffer->ulStreamSize = pxOffer->ulImageSize;
+
+    if (prvSearch(pxPublishInfo, "streamSize", &pcValue, &xLength) &&
+        (eShadowParseUint32(pcValue, xLength, &pxOffer->ulStreamSize) != ShadowParserSuccess)) {
+        return false;
+    }
+
+    if (prvSearch(pxPublishInfo, "baseSha256", &pcValue, &xLength)) {
+        if (!prvHexDecode(pxOffer->ucBaseSha256, pcValue, xLength)) {
+            return false;
+        }
+
+        pxOffer->ucDelta = 1U;
+    }
+
+    return true;
+}
+
+BaseType_t xOtaClientInit(void) {
+    xMessageQueue = APP_QUEUE_CREATE(xMessageQueue);
+
+    if ((xMessageQueue == NULL) ||
+        (APP_TASK_CREATE_PINNED(xOtaTask, prvOtaTask, "ota", NULL, OTA_TASK_PRIORITY, NULL,
+                                APP_SCHED_CORE_OTA) != pdPASS)) {
+        IotLogError("xOtaClientInit: failed to create the OTA task");
+        return pdFAIL;
+    }
+
+    return (eMqttAgentSubscribe(OTA_TOPIC_FILTER,
+                                OTA_TOPIC_FILTER_LENGTH,
+                                0U) == MqttAgentSuccess) ? pdPASS : pdFAIL;
+}
+
+bool xOtaClientHandlePublish(const MQTTPublishInfo_t *pxPublishInfo) {
+    /* Only the MQTT agent task calls this. */
+    static OtaMessage_t xMessage;
+
+    if ((pxPublishInfo->topicNameLength <= OTA_TOPIC_PREFIX_LENGTH) ||
+        (memcmp(pxPublishInfo->pTopicName, OTA_TOPIC_PREFIX, OTA_TOPIC_PREFIX_LENGTH) != 0)) {
+        return false;
+    }
+
+    if (xMessageQueue == NULL) {
+        return true;
+    }
+
+    if ((pxPublishInfo->topicNameLength == OTA_DATA_TOPIC_LENGTH) &&
+        (memcmp(pxPublishInfo->pTopicName, OTA_DATA_TOPIC, OTA_DATA_TOPIC_LENGTH) == 0)) {
+        if ((pxPublishInfo->payloadLength <= OTA_DATA_HEADER_LENGTH) ||
+            (pxPublishInfo->payloadLength > (OTA_DATA_HEADER_LENGTH + appconfigOTA_BLOCK_SIZE))) {
+            IotLogWarn("xOtaClientHandlePublish: data block of %u bytes", (unsigned) pxPublishInfo->payloadLength);
+            return true;
+        }
+
+        xMessage.eType = OtaMessageBlock;
+        xMessage.u.xBlock.ulOffset = prvReadBe32((const uint8_t *) pxPublishInfo->pPayload);
+        xMessage.u.xBlock.ulLength = (uint32_t) (pxPublishInfo->payloadLength - OTA_DATA_HEADER_LENGTH);
+        (void) memcpy(xMessage.u.xBlock.ucData,
+                      (const uint8_t *) pxPublishInfo->pPayload + OTA_DATA_HEADER_LENGTH,
+                      xMessage.u.xBlock.ulLength);
+    } else if ((pxPublishInfo->topicNameLength == OTA_OFFER_TOPIC_LENGTH) &&
+               (memcmp(pxPublishInfo->pTopicName, OTA_OFFER_TOPIC, OTA_OFFER_TOPIC_LENGTH) == 0)) {
+        if (!prvParseOffer(pxPublishInfo, &xMessage.u.xOffer)) {
+            IotLogWarn("xOtaClientHandlePublish: invalid offer");
+            return true;
+        }
+
+        xMessage.eType = OtaMessageOffer;
+    } else {
+        return true;
+    }
+
+    /* A block that does not fit is asked for again after the timeout. */
+    if (xQueueSendToBack(xMessageQueue, &xMessage, 0U) != pdTRUE) {
+        IotLogDebug("xOtaClientHandlePublish: OTA queue full");
+    }
+
+    return true;
+}
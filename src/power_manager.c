@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+#include "sdkconfig.h"
+#include "esp_pm.h"
+#include "iot_wifi.h"
+#include "iot_demo_logging.h"
+
+#include "app_config.h"
+#include "power_manager.h"
+
+/*-----------------------------------------------------------*/
+
+#if appconfigPOWER_SAVE && defined(CONFIG_PM_ENABLE)
+#define POWER_MANAGEMENT_ENABLED    (1)
+#else
+#define POWER_MANAGEMENT_ENABLED    (0)
+#endif
+
+#if POWER_MANAGEMENT_ENABLED
+
+static esp_pm_lock_handle_t xLocks[PowerLockCount];
+
+#endif
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xPowerManagerInit(void) {
+#if POWER_MANAGEMENT_ENABLED
+    esp_pm_config_esp32_t xConfig =
+            {
+                    .max_freq_mhz = appconfigPOWER_MAX_CPU_FREQ_MHZ,
+                    .min_freq_mhz = appconfigPOWER_MIN_CPU_FREQ_MHZ,
+                    .light_sleep_enable = true
+            };
+    esp_err_t e;
+
+    e = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "cpuMax", &xLocks[PowerLockCpuMax]);
+
+    if (e == ESP_OK) {
+        e = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "awake", &xLocks[PowerLockAwake]);
+    }
+
+    if (e == ESP_OK) {
+        e = esp_pm_configure(&xConfig);
+    }
+
+    if (e != ESP_OK) {
+        IotLogError("xPowerManagerInit: failed to configure power management: %d", (int) e);
+        return pdFAIL;
+    }
+
+    IotLogInfo("xPowerManagerInit: %u-%u MHz with automatic light sleep",
+               (unsigned) appconfigPOWER_MIN_CPU_FREQ_MHZ,
+               (unsigned) appconfigPOWER_MAX_CPU_FREQ_MHZ);
+#endif /* if POWER_MANAGEMENT_ENABLED */
+
+    return pdPASS;
+}
+
+void vPowerLockAcquire(PowerLock_t eLock) {
+#if POWER_MANAGEMENT_ENABLED
+    configASSERT(eLock < PowerLockCount);
+
+    if (xLocks[eLock] != NULL) {
+        (void) esp_pm_lock_acquire(xLocks[eLock]);
+    }
+#else
+    (void) eLock;
+#endif
+}
+
+void vPowerLockRelease(PowerLock_t eLock) {
+#if POWER_MANAGEMENT_ENABLED
+    configASSERT(eLock < PowerLockCount);
+
+    if (xLocks[eLock] != NULL) {
+        (void) esp_pm_lock_release(xLocks[eLock]);
+    }
+#else
+    (void) eLock;
+#endif
+}
+
+void vPowerManagerNetworkUp(void) {
+#if appconfigPOWER_SAVE
+    if (WIFI_SetPMMode(eWiFiPMModem, NULL) != eWiFiSuccess) {
+        IotLogWarn("vPowerManagerNetworkUp: failed to enable Wi-Fi modem sleep");
+    }
+#endif
+}
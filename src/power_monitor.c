@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "iot_demo_logging.h"
+
+#include "app_config.h"
+#include "app_rtos.h"
+#include "app_sched.h"
+#include "device.h"
+#include "display_service.h"
+#include "i2c_bus.h"
+#include "shadow_client.h"
+#include "power_monitor.h"
+
+/*-----------------------------------------------------------*/
+
+/* AXP192 ADC steps: 1.1 mV for the battery, 1.4 mV for APS. */
+#define POWER_BATTERY_MV(usRaw)         ((uint16_t) (((uint32_t) (usRaw) * 11U) / 10U))
+#define POWER_INPUT_MV(usRaw)           ((uint16_t) (((uint32_t) (usRaw) * 14U) / 10U))
+
+/* Empty at 3.0 V, 1% every 12 mV. */
+#define POWER_EMPTY_MV                  (3000U)
+#define POWER_MV_PER_PERCENT            (12U)
+
+/* APS above 4.5 V means USB is connected. */
+#define POWER_CHARGING_INPUT_MV         (4500U)
+
+#define POWER_MONITOR_TASK_STACK_SIZE   (2048U)
+#define POWER_MONITOR_TASK_PRIORITY     (tskIDLE_PRIORITY + APP_SCHED_PRIORITY_POWER_MONITOR)
+
+APP_TASK_STORAGE(xPowerMonitorTask, POWER_MONITOR_TASK_STACK_SIZE);
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The cached reading, double buffered. The writer fills the slot
+ * readers are not using and then bumps ulPublished, which selects it. A
+ * reader retries only if a publish completed while it was copying, so it can
+ * never spin on a writer it has preempted half way through.
+ */
+static PowerReading_t xCachedReadings[2];
+static volatile uint32_t ulPublished = 0U;
+
+/*-----------------------------------------------------------*/
+
+static void prvPublishReading(const PowerReading_t *pxReading) {
+    uint32_t ulNext = ulPublished + 1U;
+
+    xCachedReadings[ulNext & 1U] = *pxReading;
+    __atomic_store_n(&ulPublished, ulNext, __ATOMIC_RELEASE);
+}
+
+bool xPowerMonitorGet(PowerReading_t *pxReading) {
+    uint32_t ulBefore;
+    uint32_t ulAfter;
+
+    do {
+        ulBefore = __atomic_load_n(&ulPublished, __ATOMIC_ACQUIRE);
+        *pxReading = xCachedReadings[ulBefore & 1U];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        ulAfter = __atomic_load_n(&ulPublished, __ATOMIC_RELAXED);
+    } while (ulBefore != ulAfter);
+
+    return (ulBefore != 0U);
+}
+
+/*-----------------------------------------------------------*/
+
+static esp_err_t prvTakeReading(PowerReading_t *pxReading) {
+    uint16_t usVbat = 0U;
+    uint16_t usVaps = 0U;
+    uint32_t ulPercent = 0U;
+    esp_err_t res;
+
+    /* Both registers in one hold of the bus, so the IMU sampler waits at
+     * most once behind them. */
+    res = eI2cBusLock();
+
+    if (res != ESP_OK) {
+        return res;
+    }
+
+    res = M5StickCPowerGetVbat(&usVbat);
+
+    if (res == ESP_OK) {
+        res = M5StickCPowerGetVaps(&usVaps);
+    }
+
+    vI2cBusUnlock();
+
+    if (res != ESP_OK) {
+        return res;
+    }
+
+    pxReading->usBatteryMv = POWER_BATTERY_MV(usVbat);
+    pxReading->usInputMv = POWER_INPUT_MV(usVaps);
+    pxReading->xCharging = (pxReading->usInputMv >= POWER_CHARGING_INPUT_MV);
+    pxReading->xTakenAt = xTaskGetTickCount();
+
+    if (pxReading->usBatteryMv > POWER_EMPTY_MV) {
+        ulPercent = (pxReading->usBatteryMv - POWER_EMPTY_MV) / POWER_MV_PER_PERCENT;
+    }
+
+    /* No need to support 100% :) */
+    pxReading->ucPercent = (uint8_t) ((ulPercent > 99U) ? 99U : ulPercent);
+
+    return ESP_OK;
+}
+
+static void prvShowReading(const PowerReading_t *pxReading) {
+    char cText[DISPLAY_REGION_TEXT_LENGTH + 1];
+
+    (void) snprintf(cText, sizeof(cText), "%s: %02u%%",
+                    pxReading->xCharging ? "CHG" : "BAT",
+                    (unsigned) pxReading->ucPercent);
+    (void) xDisplaySetText(DisplayRegionBattery, cText);
+}
+
+static void prvPowerMonitorTask(void *pvParameters) {
+    PowerReading_t xReading;
+    PowerReading_t xPrevious = {0};
+    PowerReading_t xReported = {0};
+    bool xHaveReading = false;
+    bool xHaveReport = false;
+    TickType_t xPeriod = pdMS_TO_TICKS(appconfigPOWER_MONITOR_FAST_PERIOD_MS);
+
+    (void) pvParameters;
+
+    for (;;) {
+        if (prvTakeReading(&xReading) != ESP_OK) {
+            IotLogWarn("prvPowerMonitorTask: failed to read the AXP192");
+            vTaskDelay(xPeriod);
+            continue;
+        }
+
+        prvPublishReading(&xReading);
+
+        if (!xHaveReading ||
+            (xReading.ucPercent != xPrevious.ucPercent) ||
+            (xReading.xCharging != xPrevious.xCharging)) {
+            prvShowReading(&xReading);
+        }
+
+        if ((!xHaveReport ||
+             (xReading.xCharging != xReported.xCharging) ||
+             ((uint32_t) abs((int32_t) xReading.usBatteryMv - (int32_t) xReported.usBatteryMv) >=
+              appconfigPOWER_MONITOR_REPORT_HYSTERESIS_MV)) &&
+            (xShadowClientReportPower(xReading.usBatteryMv, xReading.xCharging) == pdPASS)) {
+            /* A report that was not queued is retried on the next reading. */
+            xReported = xReading;
+            xHaveReport = true;
+        }
+
+        /* Sample often while something is happening, rarely otherwise. */
+        if (xReading.xCharging ||
+            (xReading.ucPercent <= appconfigPOWER_MONITOR_LOW_PERCENT) ||
+            (xHaveReading &&
+             ((uint32_t) abs((int32_t) xReading.usBatteryMv - (int32_t) xPrevious.usBatteryMv) >=
+              (appconfigPOWER_MONITOR_REPORT_HYSTERESIS_MV / 2U)))) {
+            xPeriod = pdMS_TO_TICKS(appconfigPOWER_MONITOR_FAST_PERIOD_MS);
+        } else {
+            xPeriod = pdMS_TO_TICKS(appconfigPOWER_MONITOR_SLOW_PERIOD_MS);
+        }
+
+        xPrevious = xReading;
+        xHaveReading = true;
+
+        vTaskDelay(xPeriod);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xPowerMonitorInit(void) {
+    if (APP_TASK_CREATE_PINNED(xPowerMonitorTask,
+                               prvPowerMonitorTask,
+                               "PowerMonitor",
+                               NULL,
+                               POWER_MONITOR_TASK_PRIORITY,
+                               NULL,
+                               APP_SCHED_CORE_POWER_MONITOR) != pdPASS) {
+        IotLogError("xPowerMonitorInit: failed to create the power monitor task");
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
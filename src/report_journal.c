@@ -0,0 +1,531 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include "aws_clientcredential.h"
+#include "iot_demo_logging.h"
+
+#include "app_config.h"
+#include "app_rtos.h"
+#include "flash_writer.h"
+#include "mqtt_agent.h"
+#include "report_journal.h"
+
+/*-----------------------------------------------------------*/
+
+#define JOURNAL_PARTITION       "storage"
+#define JOURNAL_NAMESPACE       "journal"
+#define JOURNAL_KEY_BOOT        "boot"
+
+#define JOURNAL_TOPIC           "dt/personalbox/" clientcredentialIOT_THING_NAME "/locks"
+#define JOURNAL_TOPIC_LENGTH    ((uint16_t) (sizeof(JOURNAL_TOPIC) - 1U))
+
+#define JOURNAL_DOCUMENT_HEADER       "{\"type\":\"lockHistory\",\"events\":["
+#define JOURNAL_EVENT_MAX_LENGTH      (sizeof("[65535,4294967295,255,255],") - 1U)
+
+/**
+ * @brief Set in the flash writer's notification value by the agent when a
+ * batch publish completes.
+ */
+#define JOURNAL_NOTIFY_BIT            (1UL << 0)
+
+/**
+ * @brief How long the drain waits for the PUBACKs of the batches it sent.
+ * Whatever is still unanswered by then is settled by a later drain.
+ */
+#define JOURNAL_ACK_WAIT_TICKS        pdMS_TO_TICKS(appconfigMQTT_AGENT_PUBACK_TIMEOUT_MS + appconfigMQTT_AGENT_PROCESS_LOOP_TIMEOUT_MS)
+
+/**
+ * @brief One lock report. The boot count and uptime order the entries
+ * without a wall clock.
+ */
+typedef struct JournalEntry
+{
+    uint32_t ulUptimeS;
+    uint16_t usBoot;
+    uint8_t ucOpenMask;
+    uint8_t ucChangedMask;
+} JournalEntry_t;
+
+/**
+ * @brief The NVS blob of one batch; only the used entries are stored.
+ */
+typedef struct JournalBatch
+{
+    uint32_t ulSeq;
+    JournalEntry_t xEntries[appconfigJOURNAL_BATCH_ENTRIES];
+} JournalBatch_t;
+
+#define JOURNAL_BATCH_SIZE(xCount)    (offsetof(JournalBatch_t, xEntries) + ((xCount) * sizeof(JournalEntry_t)))
+
+/* One batch goes out as one document, so its PUBACK accounts for it whole. */
+_Static_assert((sizeof(JOURNAL_DOCUMENT_HEADER) - 1U) + (appconfigJOURNAL_BATCH_ENTRIES * JOURNAL_EVENT_MAX_LENGTH) + 1U <=
+               appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH,
+               "a full journal batch does not fit in one MQTT agent publish");
+
+/*-----------------------------------------------------------*/
+
+static nvs_handle xJournalHandle;
+static bool xJournalOpen = false;
+
+/**
+ * @brief This boot's number, written to flash with its first batch only, so
+ * boots without an outage cost no flash write.
+ */
+static uint16_t usBootCount = 0U;
+static bool xBootCountStored = false;
+
+/**
+ * @brief Sequence number of the batch held by every slot, 0 when empty.
+ * Only the flash writer task touches the slots once the journal is open.
+ */
+static uint32_t ulSlotSeq[appconfigJOURNAL_MAX_BATCHES];
+static uint32_t ulNextSeq = 1U;
+
+/**
+ * @brief The last publish of every slot and the batch it carried. A slot is
+ * erased only once that publish is acknowledged and the slot still holds the
+ * same batch.
+ */
+static MqttAgentCompletion_t xSlotCompletion[appconfigJOURNAL_MAX_BATCHES];
+static uint32_t ulSlotSentSeq[appconfigJOURNAL_MAX_BATCHES];
+
+/**
+ * @brief Set while a drain is queued or running on the flash writer.
+ */
+static volatile bool xDrainQueued = false;
+
+/**
+ * @brief The batch being filled. Appends only take xRamLock, so the lock
+ * table callback never waits for a flash write.
+ */
+static JournalBatch_t xRamBatch;
+static size_t xRamCount = 0U;
+static uint32_t ulDropped = 0U;
+
+/**
+ * @brief Union of the changed masks journaled since the last drain was
+ * requested, in flash or in RAM.
+ */
+static uint32_t ulChangedSinceDrain = 0U;
+static portMUX_TYPE xRamLock = portMUX_INITIALIZER_UNLOCKED;
+
+static TimerHandle_t xFlushTimer = NULL;
+APP_TIMER_STORAGE(xFlushTimer);
+
+/**
+ * @brief The history document being built by the drain.
+ */
+static char cPayload[appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH];
+
+/*-----------------------------------------------------------*/
+
+static void prvSlotKey(size_t xSlot, char *pcKey, size_t xKeyLength) {
+    (void) snprintf(pcKey, xKeyLength, "b%u", (unsigned) xSlot);
+}
+
+/**
+ * @brief Move the RAM batch to a free slot, or over the oldest batch when the
+ * journal is full. Runs on the flash writer task.
+ */
+static BaseType_t prvWriteBatch(void) {
+    JournalBatch_t xBatch;
+    size_t xCount;
+    size_t xSlot = 0U;
+    char cKey[8];
+    size_t i;
+
+    portENTER_CRITICAL(&xRamLock);
+    xCount = xRamCount;
+    (void) memcpy(xBatch.xEntries, xRamBatch.xEntries, xCount * sizeof(JournalEntry_t));
+    xRamCount = 0U;
+    portEXIT_CRITICAL(&xRamLock);
+
+    if (xCount == 0U) {
+        return pdPASS;
+    }
+
+    if (!xJournalOpen) {
+        IotLogWarn("prvWriteBatch: no storage partition, dropped %u lock reports", (unsigned) xCount);
+        return pdFAIL;
+    }
+
+    for (i = 1U; i < appconfigJOURNAL_MAX_BATCHES; i++) {
+        if ((ulSlotSeq[xSlot] != 0U) && ((ulSlotSeq[i] == 0U) || (ulSlotSeq[i] < ulSlotSeq[xSlot]))) {
+            xSlot = i;
+        }
+    }
+
+    if (ulSlotSeq[xSlot] != 0U) {
+        IotLogWarn("prvWriteBatch: journal full, overwriting the oldest batch");
+    }
+
+    xBatch.ulSeq = ulNextSeq++;
+    prvSlotKey(xSlot, cKey, sizeof(cKey));
+
+    if ((!xBootCountStored && (nvs_set_u16(xJournalHandle, JOURNAL_KEY_BOOT, usBootCount) != ESP_OK)) ||
+        (nvs_set_blob(xJournalHandle, cKey, &xBatch, JOURNAL_BATCH_SIZE(xCount)) != ESP_OK) ||
+        (nvs_commit(xJournalHandle) != ESP_OK)) {
+        IotLogError("prvWriteBatch: failed to write %u lock reports", (unsigned) xCount);
+        return pdFAIL;
+    }
+
+    xBootCountStored = true;
+    ulSlotSeq[xSlot] = xBatch.ulSeq;
+
+    return pdPASS;
+}
+
+static void prvFlushBatch(void *pvParameter1, uint32_t ulParameter2) {
+    (void) pvParameter1;
+    (void) ulParameter2;
+
+    (void) prvWriteBatch();
+}
+
+/**
+ * @brief Runs on the timer service task, which must not write to flash
+ * itself, see app_sched.h.
+ */
+static void prvFlushTimerCallback(TimerHandle_t xTimer) {
+    if (xFlashWriterPend(prvFlushBatch, NULL, 0U) != pdPASS) {
+        /* The batch stays in RAM until the next try. */
+        (void) xTimerReset(xTimer, 0U);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Publish the batch in xSlot as one history document.
+ */
+static MqttAgentStatus_t prvPublishSlot(size_t xSlot) {
+    JournalBatch_t xBatch;
+    MqttAgentCompletion_t *pxCompletion = &xSlotCompletion[xSlot];
+    size_t xPayloadLength;
+    size_t xCount;
+    char cKey[8];
+    size_t xLength = sizeof(xBatch);
+    size_t i;
+
+    prvSlotKey(xSlot, cKey, sizeof(cKey));
+
+    if ((nvs_get_blob(xJournalHandle, cKey, &xBatch, &xLength) != ESP_OK) ||
+        (xLength < JOURNAL_BATCH_SIZE(1U))) {
+        IotLogWarn("prvPublishSlot: batch %s is unreadable, dropping it", cKey);
+        (void) nvs_erase_key(xJournalHandle, cKey);
+        (void) nvs_commit(xJournalHandle);
+        ulSlotSeq[xSlot] = 0U;
+        return MqttAgentSuccess;
+    }
+
+    xCount = (xLength - offsetof(JournalBatch_t, xEntries)) / sizeof(JournalEntry_t);
+    xPayloadLength = (size_t) snprintf(cPayload, sizeof(cPayload), JOURNAL_DOCUMENT_HEADER);
+
+    for (i = 0; i < xCount; i++) {
+        xPayloadLength += (size_t) snprintf(&cPayload[xPayloadLength], sizeof(cPayload) - xPayloadLength,
+                                            "[%u,%lu,%u,%u],",
+                                            (unsigned) xBatch.xEntries[i].usBoot,
+                                            (unsigned long) xBatch.xEntries[i].ulUptimeS,
+                                            (unsigned) xBatch.xEntries[i].ucOpenMask,
+                                            (unsigned) xBatch.xEntries[i].ucChangedMask);
+    }
+
+    /* Replace the trailing comma. */
+    cPayload[xPayloadLength - 1U] = ']';
+    cPayload[xPayloadLength++] = '}';
+
+    pxCompletion->xNotifyTask = xTaskGetCurrentTaskHandle();
+    pxCompletion->ulNotifyBits = JOURNAL_NOTIFY_BIT;
+    ulSlotSentSeq[xSlot] = ulSlotSeq[xSlot];
+
+    return eMqttAgentPublishNotify(JOURNAL_TOPIC,
+                                   JOURNAL_TOPIC_LENGTH,
+                                   cPayload,
+                                   xPayloadLength,
+                                   0U,
+                                   pxCompletion);
+}
+
+static bool prvAnyPending(void) {
+    size_t i;
+
+    for (i = 0; i < appconfigJOURNAL_MAX_BATCHES; i++) {
+        if (xSlotCompletion[i].eStatus == MqttAgentPending) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Erase every batch whose publish has been acknowledged.
+ *
+ * @return pdFAIL if a publish failed and its batch needs sending again.
+ */
+static BaseType_t prvEraseAcknowledged(void) {
+    BaseType_t xSettled = pdPASS;
+    bool xErased = false;
+    char cKey[8];
+    size_t i;
+
+    for (i = 0; i < appconfigJOURNAL_MAX_BATCHES; i++) {
+        if ((ulSlotSeq[i] == 0U) || (ulSlotSentSeq[i] != ulSlotSeq[i])) {
+            continue;
+        }
+
+        if (xSlotCompletion[i].eStatus == MqttAgentSuccess) {
+            prvSlotKey(i, cKey, sizeof(cKey));
+            (void) nvs_erase_key(xJournalHandle, cKey);
+            ulSlotSeq[i] = 0U;
+            xErased = true;
+        } else if (xSlotCompletion[i].eStatus != MqttAgentPending) {
+            xSettled = pdFAIL;
+        }
+    }
+
+    if (xErased) {
+        (void) nvs_commit(xJournalHandle);
+    }
+
+    return xSettled;
+}
+
+/**
+ * @brief Publish every journaled batch, oldest first, and erase each once its
+ * PUBACK is in. Runs on the flash writer task, which blocks here for at most
+ * #JOURNAL_ACK_WAIT_TICKS.
+ *
+ * A batch left in flash is sent again in full by a later drain; the receiver
+ * orders and dedups the events by boot and uptime. A batch whose publish the
+ * agent still holds is not sent again until its outcome is known.
+ */
+static void prvDrain(void *pvParameter1, uint32_t ulParameter2) {
+    MqttAgentStatus_t eStatus = MqttAgentSuccess;
+    TickType_t xStart;
+    TickType_t xElapsed;
+    uint32_t ulLastSeq = 0U;
+    uint32_t ulDroppedNow;
+    size_t xSlot;
+    BaseType_t xSettled;
+    size_t i;
+
+    (void) pvParameter1;
+    (void) ulParameter2;
+
+    /* Everything goes out from flash, in sequence order. */
+    (void) prvWriteBatch();
+    (void) xTimerStop(xFlushTimer, 0U);
+
+    portENTER_CRITICAL(&xRamLock);
+    ulDroppedNow = ulDropped;
+    ulDropped = 0U;
+    portEXIT_CRITICAL(&xRamLock);
+
+    if (ulDroppedNow != 0U) {
+        IotLogWarn("prvDrain: %lu lock reports did not fit in the journal", (unsigned long) ulDroppedNow);
+    }
+
+    /* Settle what earlier drains left with the agent. */
+    (void) prvEraseAcknowledged();
+    (void) xTaskNotifyWait(0U, JOURNAL_NOTIFY_BIT, NULL, 0U);
+
+    while (eStatus == MqttAgentSuccess) {
+        xSlot = appconfigJOURNAL_MAX_BATCHES;
+
+        for (i = 0; i < appconfigJOURNAL_MAX_BATCHES; i++) {
+            if ((ulSlotSeq[i] > ulLastSeq) &&
+                ((xSlot == appconfigJOURNAL_MAX_BATCHES) || (ulSlotSeq[i] < ulSlotSeq[xSlot]))) {
+                xSlot = i;
+            }
+        }
+
+        if (xSlot == appconfigJOURNAL_MAX_BATCHES) {
+            break;
+        }
+
+        ulLastSeq = ulSlotSeq[xSlot];
+
+        if (xSlotCompletion[xSlot].eStatus != MqttAgentPending) {
+            eStatus = prvPublishSlot(xSlot);
+        }
+    }
+
+    if (eStatus != MqttAgentSuccess) {
+        IotLogWarn("prvDrain: could not queue the whole journal, keeping the rest");
+    }
+
+    xStart = xTaskGetTickCount();
+    xElapsed = 0U;
+
+    while (prvAnyPending() && (xElapsed < JOURNAL_ACK_WAIT_TICKS) &&
+           (xTaskNotifyWait(0U, JOURNAL_NOTIFY_BIT, NULL, JOURNAL_ACK_WAIT_TICKS - xElapsed) == pdTRUE)) {
+        xElapsed = xTaskGetTickCount() - xStart;
+    }
+
+    xSettled = prvEraseAcknowledged();
+    xDrainQueued = false;
+
+    if ((xSettled == pdFAIL) || (eStatus == MqttAgentQueueFull)) {
+        /* Still connected, most likely: try again on a later agent pass
+         * rather than only after the next reconnect. */
+        vMqttAgentRequestSync();
+    }
+}
+
+static uint32_t prvBatchChanged(const JournalBatch_t *pxBatch, size_t xLength) {
+    size_t xCount = (xLength - offsetof(JournalBatch_t, xEntries)) / sizeof(JournalEntry_t);
+    uint32_t ulChanged = 0U;
+    size_t i;
+
+    for (i = 0; i < xCount; i++) {
+        ulChanged |= pxBatch->xEntries[i].ucChangedMask;
+    }
+
+    return ulChanged;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xReportJournalInit(void) {
+    JournalBatch_t xBatch;
+    uint16_t usStoredBoot = 0U;
+    char cKey[8];
+    size_t xLength;
+    size_t i;
+
+    xFlushTimer = APP_TIMER_CREATE(xFlushTimer,
+                                   "journal",
+                                   pdMS_TO_TICKS(appconfigJOURNAL_FLUSH_MS),
+                                   pdFALSE,
+                                   NULL,
+                                   prvFlushTimerCallback);
+
+    if (xFlushTimer == NULL) {
+        IotLogError("xReportJournalInit: failed to create the flush timer");
+        return pdFAIL;
+    }
+
+    /* The partition is shared with the PKCS #11 objects, so it is never
+     * erased here, whatever state it is in. */
+    if ((nvs_flash_init_partition(JOURNAL_PARTITION) != ESP_OK) ||
+        (nvs_open_from_partition(JOURNAL_PARTITION, JOURNAL_NAMESPACE, NVS_READWRITE, &xJournalHandle) != ESP_OK)) {
+        IotLogError("xReportJournalInit: the %s partition is not usable", JOURNAL_PARTITION);
+        return pdFAIL;
+    }
+
+    xJournalOpen = true;
+
+    (void) nvs_get_u16(xJournalHandle, JOURNAL_KEY_BOOT, &usStoredBoot);
+    usBootCount = (uint16_t) (usStoredBoot + 1U);
+
+    for (i = 0; i < appconfigJOURNAL_MAX_BATCHES; i++) {
+        prvSlotKey(i, cKey, sizeof(cKey));
+        xLength = sizeof(xBatch);
+
+        if ((nvs_get_blob(xJournalHandle, cKey, &xBatch, &xLength) == ESP_OK) &&
+            (xLength >= JOURNAL_BATCH_SIZE(1U))) {
+            ulSlotSeq[i] = xBatch.ulSeq;
+            ulChangedSinceDrain |= prvBatchChanged(&xBatch, xLength);
+
+            if (xBatch.ulSeq >= ulNextSeq) {
+                ulNextSeq = xBatch.ulSeq + 1U;
+            }
+        }
+    }
+
+    return pdPASS;
+}
+
+void vReportJournalAppend(uint32_t ulOpenMask, uint32_t ulChangedMask) {
+    JournalEntry_t xEntry;
+    size_t xCount;
+
+    xEntry.ulUptimeS = (uint32_t) (xTaskGetTickCount() / configTICK_RATE_HZ);
+    xEntry.usBoot = usBootCount;
+    xEntry.ucOpenMask = (uint8_t) ulOpenMask;
+    xEntry.ucChangedMask = (uint8_t) ulChangedMask;
+
+    portENTER_CRITICAL(&xRamLock);
+    xCount = xRamCount;
+    if (xCount < appconfigJOURNAL_BATCH_ENTRIES) {
+        xRamBatch.xEntries[xRamCount++] = xEntry;
+    } else {
+        ulDropped++;
+    }
+    ulChangedSinceDrain |= ulChangedMask;
+    portEXIT_CRITICAL(&xRamLock);
+
+    if (xFlushTimer == NULL) {
+        return;
+    }
+
+    if (xCount == 0U) {
+        /* First entry of a batch: give it FLUSH_MS to fill up. */
+        (void) xTimerChangePeriod(xFlushTimer, pdMS_TO_TICKS(appconfigJOURNAL_FLUSH_MS), 0U);
+    } else if ((xCount + 1U) >= appconfigJOURNAL_BATCH_ENTRIES) {
+        /* Full, or a burst outran the flush: write it out right away. */
+        (void) xTimerChangePeriod(xFlushTimer, 1U, 0U);
+    }
+}
+
+BaseType_t xReportJournalDrain(uint32_t *pulChangedMask) {
+    uint32_t ulChanged;
+
+    *pulChangedMask = 0U;
+
+    if (xFlushTimer == NULL) {
+        return pdPASS;
+    }
+
+    if (!xDrainQueued) {
+        xDrainQueued = true;
+
+        if (xFlashWriterPend(prvDrain, NULL, 0U) != pdPASS) {
+            xDrainQueued = false;
+            return pdFAIL;
+        }
+    }
+
+    portENTER_CRITICAL(&xRamLock);
+    ulChanged = ulChangedSinceDrain;
+    ulChangedSinceDrain = 0U;
+    portEXIT_CRITICAL(&xRamLock);
+
+    *pulChangedMask = ulChanged;
+
+    return pdPASS;
+}
@@ -22,82 +22,217 @@
 
 /* Standard includes. */
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "aws_demo.h"
 
+#include "nvs.h"
+
 /* Kernel includes. */
 #include "FreeRTOS.h"
 #include "task.h"
-#include "semphr.h"
+#include "timers.h"
 
 /* SHADOW API header. */
 #include "shadow.h"
 
-/* JSON library includes. */
-#include "core_json.h"
+/* Single-pass shadow document parser and template serializer. */
+#include "shadow_parser.h"
+#include "shadow_serializer.h"
+#include "shadow_requests.h"
 
 /* shadow demo helpers header. */
 #include "mqtt_demo_helpers.h"
 
+#include "app_config.h"
+#include "app_rtos.h"
 #include "shadow_client.h"
+#include "mqtt_agent.h"
+#include "lock_state.h"
 #include "device.h"
+#include "display_service.h"
+#include "power_manager.h"
 #include "app_network.h"
+#include "boot.h"
+#include "latency_probe.h"
+#include "report_journal.h"
+#include "flash_writer.h"
+#include "task_profiler.h"
+#include "ota_client.h"
 #include "iot_demo_logging.h"
 
+#define APP_LOG_MODULE    "shadow"
+#define APP_LOG_LEVEL     appconfigLOG_LEVEL_SHADOW
+#include "app_log.h"
+
 #define LOCK_STATE_OPEN (1)
 #define LOCK_STATE_CLOSE (0)
 
-#define LOCK_MQTT_PUBACK_WAIT_MS (5000)
-
-#define SHADOW_DESIRED_JSON     \
-    "{"                         \
-    "\"state\":{"               \
-    "\"desired\":{"             \
-    "\"lockState\":%01d"        \
-    "},"                        \
-    "\"reported\":{"            \
-    "\"lockState\":%01d"        \
-    "}"                         \
-    "},"                        \
-    "\"clientToken\":\"%06lu\"" \
-    "}"
+/**
+ * @brief Field ids used in the shadow document templates below.
+ */
+enum {
+    SHADOW_FIELD_LOCK_STATE = 0,
+    SHADOW_FIELD_CLIENT_TOKEN,
+    SHADOW_FIELD_BATTERY_MV,
+    SHADOW_FIELD_CHARGING,
+    SHADOW_FIELD_LOCK_FIRST,
+    SHADOW_FIELD_COUNT = SHADOW_FIELD_LOCK_FIRST + appconfigLOCK_COUNT
+};
 
 /**
- * @brief The expected size of #SHADOW_DESIRED_JSON.
- *
- * Because all the format specifiers in #SHADOW_DESIRED_JSON include a length,
- * its full actual size is known by pre-calculation, here's the formula why
- * the length need to minus 3:
- * 1. The length of "%01d" is 4.
- * 2. The length of %06lu is 5.
- * 3. The actual length we will use in case 1. is 1 ( for the state of powerOn ).
- * 4. The actual length we will use in case 2. is 6 ( for the clientToken length ).
- * 5. Thus the additional size 3 = 4 + 5 - 1 - 6 + 1 (termination character).
+ * @brief The elements of the "locks" array, one field per compartment.
+ * Spelled out per count since templates are fixed at compile time.
+ */
+#define SHADOW_LOCKS_1_(LITERAL, FIELD)    FIELD(SHADOW_FIELD_LOCK_FIRST, "0")
+#define SHADOW_LOCKS_2_(LITERAL, FIELD)    SHADOW_LOCKS_1_(LITERAL, FIELD) LITERAL(",") FIELD(SHADOW_FIELD_LOCK_FIRST + 1, "0")
+#define SHADOW_LOCKS_3_(LITERAL, FIELD)    SHADOW_LOCKS_2_(LITERAL, FIELD) LITERAL(",") FIELD(SHADOW_FIELD_LOCK_FIRST + 2, "0")
+#define SHADOW_LOCKS_4_(LITERAL, FIELD)    SHADOW_LOCKS_3_(LITERAL, FIELD) LITERAL(",") FIELD(SHADOW_FIELD_LOCK_FIRST + 3, "0")
+#define SHADOW_LOCKS_5_(LITERAL, FIELD)    SHADOW_LOCKS_4_(LITERAL, FIELD) LITERAL(",") FIELD(SHADOW_FIELD_LOCK_FIRST + 4, "0")
+#define SHADOW_LOCKS_6_(LITERAL, FIELD)    SHADOW_LOCKS_5_(LITERAL, FIELD) LITERAL(",") FIELD(SHADOW_FIELD_LOCK_FIRST + 5, "0")
+#define SHADOW_LOCKS_7_(LITERAL, FIELD)    SHADOW_LOCKS_6_(LITERAL, FIELD) LITERAL(",") FIELD(SHADOW_FIELD_LOCK_FIRST + 6, "0")
+#define SHADOW_LOCKS_8_(LITERAL, FIELD)    SHADOW_LOCKS_7_(LITERAL, FIELD) LITERAL(",") FIELD(SHADOW_FIELD_LOCK_FIRST + 7, "0")
+
+#if appconfigLOCK_COUNT == 1
+#define SHADOW_LOCKS    SHADOW_LOCKS_1_
+#elif appconfigLOCK_COUNT == 2
+#define SHADOW_LOCKS    SHADOW_LOCKS_2_
+#elif appconfigLOCK_COUNT == 3
+#define SHADOW_LOCKS    SHADOW_LOCKS_3_
+#elif appconfigLOCK_COUNT == 4
+#define SHADOW_LOCKS    SHADOW_LOCKS_4_
+#elif appconfigLOCK_COUNT == 5
+#define SHADOW_LOCKS    SHADOW_LOCKS_5_
+#elif appconfigLOCK_COUNT == 6
+#define SHADOW_LOCKS    SHADOW_LOCKS_6_
+#elif appconfigLOCK_COUNT == 7
+#define SHADOW_LOCKS    SHADOW_LOCKS_7_
+#elif appconfigLOCK_COUNT == 8
+#define SHADOW_LOCKS    SHADOW_LOCKS_8_
+#else
+#error "appconfigLOCK_COUNT must be between 1 and LOCK_STATE_MAX_COUNT"
+#endif
+
+/**
+ * @brief Set the desired state of every compartment to the reported one, so
+ * the next open request produces a delta again. "lockState" mirrors
+ * compartment 0 for single-lock backends.
  *
- * In your own application, you could calculate the size of the json doc in this way.
+ * Described as literal pieces and fixed-width fields (see shadow_serializer.h),
+ * so the text, length and field positions are all known at compile time.
  */
-#define SHADOW_DESIRED_JSON_LENGTH (sizeof(SHADOW_DESIRED_JSON) - 6)
+#define SHADOW_DESIRED_DOCUMENT(LITERAL, FIELD)    \
+    LITERAL("{"                                     \
+            "\"state\":{"                           \
+            "\"desired\":{"                         \
+            "\"lockState\":")                       \
+    FIELD(SHADOW_FIELD_LOCK_STATE, "0")             \
+    LITERAL(",\"locks\":[")                        \
+    SHADOW_LOCKS(LITERAL, FIELD)                    \
+    LITERAL("]},"                                   \
+            "\"reported\":{"                        \
+            "\"lockState\":")                       \
+    FIELD(SHADOW_FIELD_LOCK_STATE, "0")             \
+    LITERAL(",\"locks\":[")                        \
+    SHADOW_LOCKS(LITERAL, FIELD)                    \
+    LITERAL("]}"                                    \
+            "},"                                    \
+            "\"clientToken\":\"")                   \
+    FIELD(SHADOW_FIELD_CLIENT_TOKEN, "0000000000")  \
+    LITERAL("\""                                    \
+            "}")
+
+#define SHADOW_DESIRED_JSON_LENGTH SHADOW_TEMPLATE_LENGTH(SHADOW_DESIRED_DOCUMENT)
 
-#define SHADOW_REPORTED_JSON    \
-    "{"                         \
-    "\"state\":{"               \
-    "\"reported\":{"            \
-    "\"lockState\":%01d"        \
-    "}"                         \
-    "},"                        \
-    "\"clientToken\":\"%06lu\"" \
-    "}"
+/**
+ * @brief Report the state of every compartment only.
+ */
+#define SHADOW_REPORTED_DOCUMENT(LITERAL, FIELD)   \
+    LITERAL("{"                                     \
+            "\"state\":{"                           \
+            "\"reported\":{"                        \
+            "\"lockState\":")                       \
+    FIELD(SHADOW_FIELD_LOCK_STATE, "0")             \
+    LITERAL(",\"locks\":[")                        \
+    SHADOW_LOCKS(LITERAL, FIELD)                    \
+    LITERAL("]}"                                    \
+            "},"                                    \
+            "\"clientToken\":\"")                   \
+    FIELD(SHADOW_FIELD_CLIENT_TOKEN, "0000000000")  \
+    LITERAL("\""                                    \
+            "}")
+
+#define SHADOW_REPORTED_JSON_LENGTH SHADOW_TEMPLATE_LENGTH(SHADOW_REPORTED_DOCUMENT)
+
+/**
+ * @brief Report the battery. The voltage always has four digits (it is
+ * clamped to 1000..9999 mV), so the zero padding never shows up as an
+ * invalid leading zero.
+ */
+#define SHADOW_POWER_DOCUMENT(LITERAL, FIELD)      \
+    LITERAL("{"                                     \
+            "\"state\":{"                           \
+            "\"reported\":{"                        \
+            "\"batteryMv\":")                       \
+    FIELD(SHADOW_FIELD_BATTERY_MV, "0000")          \
+    LITERAL(",\"charging\":")                      \
+    FIELD(SHADOW_FIELD_CHARGING, "0")               \
+    LITERAL("}"                                     \
+            "},"                                    \
+            "\"clientToken\":\"")                   \
+    FIELD(SHADOW_FIELD_CLIENT_TOKEN, "0000000000")  \
+    LITERAL("\""                                    \
+            "}")
+
+#define SHADOW_POWER_JSON_LENGTH SHADOW_TEMPLATE_LENGTH(SHADOW_POWER_DOCUMENT)
 
 /**
- * @brief The expected size of #SHADOW_REPORTED_JSON.
+ * @brief Request the whole document on /get.
+ */
+#define SHADOW_GET_DOCUMENT(LITERAL, FIELD)        \
+    LITERAL("{"                                     \
+            "\"clientToken\":\"")                    \
+    FIELD(SHADOW_FIELD_CLIENT_TOKEN, "0000000000")  \
+    LITERAL("\""                                    \
+            "}")
+
+_Static_assert(SHADOW_DESIRED_JSON_LENGTH <= appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH,
+               "SHADOW_DESIRED_DOCUMENT does not fit in an MQTT agent command");
+_Static_assert(SHADOW_REPORTED_JSON_LENGTH <= appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH,
+               "SHADOW_REPORTED_DOCUMENT does not fit in an MQTT agent command");
+_Static_assert(SHADOW_TEMPLATE_LENGTH(SHADOW_GET_DOCUMENT) <= appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH,
+               "SHADOW_GET_DOCUMENT does not fit in an MQTT agent command");
+_Static_assert(SHADOW_POWER_JSON_LENGTH <= appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH,
+               "SHADOW_POWER_DOCUMENT does not fit in an MQTT agent command");
+
+SHADOW_TEMPLATE_DEFINE(xDesiredTemplate, SHADOW_DESIRED_DOCUMENT);
+SHADOW_TEMPLATE_DEFINE(xReportedTemplate, SHADOW_REPORTED_DOCUMENT);
+SHADOW_TEMPLATE_DEFINE(xPowerTemplate, SHADOW_POWER_DOCUMENT);
+SHADOW_TEMPLATE_DEFINE(xGetTemplate, SHADOW_GET_DOCUMENT);
+
+/**
+ * @brief NVS namespace and key of #ShadowVersionCache_t.
+ */
+#define SHADOW_NVS_NAMESPACE    "shadow"
+#define SHADOW_NVS_APPLIED      "applied"
+
+/**
+ * @brief The last delta that opened a compartment, kept across resets so
+ * that a delta which was already applied is not applied again after a
+ * reboot. A stale desired state is answered with the real one, see
+ * #prvGetAcceptedHandler, rather than opening a compartment again.
  *
- * Because all the format specifiers in #SHADOW_REPORTED_JSON include a length,
- * its full size is known at compile-time by pre-calculation. Users could refer to
- * the way how to calculate the actual length in #SHADOW_DESIRED_JSON_LENGTH.
+ * Only a delta that opened something is worth keeping: nothing else is
+ * acted on, so replaying it does nothing. It is written only while the
+ * shadow may still hand it out again, see #prvCacheApplied.
  */
-#define SHADOW_REPORTED_JSON_LENGTH (sizeof(SHADOW_REPORTED_JSON) - 3)
+typedef struct ShadowVersionCache
+{
+    uint32_t ulVersion;
+    uint32_t ulLockState; /**< Compartments opened up to ulVersion. */
+} ShadowVersionCache_t;
 
 #ifndef THING_NAME
 
@@ -114,50 +249,58 @@
  */
 #define THING_NAME_LENGTH ((uint16_t)(sizeof(THING_NAME) - 1))
 
-/**
- * @brief Timeout for MQTT_ProcessLoop in milliseconds.
- */
-#define MQTT_PROCESS_LOOP_TIMEOUT_MS (700U)
-
 /*-----------------------------------------------------------*/
 
 /**
- * @brief The MQTT context used for MQTT operation.
+ * @brief The compartments last reported open to the device shadow.
  */
-static MQTTContext_t xMqttContext;
+static uint32_t ulReportedOpenMask = 0U;
 
 /**
- * @brief The network context used for Openssl operation.
+ * @brief The newest shadow version acted on; older deltas are discarded.
+ * Restored from NVS by #xShadowClientInit.
  */
-static NetworkContext_t xNetworkContext;
+static uint32_t ulCurrentVersion = 0U;
 
 /**
- * @brief Static buffer used to hold MQTT messages being sent and received.
+ * @brief The applied delta that has not reached NVS, while xCacheUnsaved.
+ * ulCacheToken is the clientToken of the first report sent after it, 0
+ * until one is sent.
  */
-static uint8_t ucSharedBuffer[democonfigNETWORK_BUFFER_SIZE];
+static ShadowVersionCache_t xUnsavedCache;
+static bool xCacheUnsaved = false;
+static uint32_t ulCacheToken = 0U;
+
+static portMUX_TYPE xCacheLock = portMUX_INITIALIZER_UNLOCKED;
 
 /**
- * @brief Static buffer used to hold MQTT messages being sent and received.
+ * @brief Compartments the cache restored by #xShadowClientInit had opened.
+ * The reset closed them without a report; the first resync reports them.
  */
-static MQTTFixedBuffer_t xBuffer =
-        {
-                .pBuffer = ucSharedBuffer,
-                .size = democonfigNETWORK_BUFFER_SIZE};
+static uint32_t ulCachedLockState = 0U;
 
 /**
- * @brief The simulated device current power on state.
+ * @brief Ends the coalescing window; see #appconfigSHADOW_DELTA_COALESCE_MS.
  */
-static uint32_t ulCurrentLockState = 0U;
+static TimerHandle_t xCoalesceTimer = NULL;
+APP_TIMER_STORAGE(xCoalesceTimer);
 
 /**
- * @brief The flag to indicate the device current power on state changed.
+ * @brief Deltas folded while the window is open, last writer wins per
+ * compartment. Shared between the agent task and the timer service task.
  */
-static bool stateChanged = false;
+static bool xWindowOpen = false;
+static uint32_t ulPendingPresent = 0U;
+static uint32_t ulPendingDesired = 0U;
+static uint32_t ulPendingVersion = 0U;
+static uint32_t ulPendingReceivedUs = 0U;
+
+static portMUX_TYPE xCoalesceLock = portMUX_INITIALIZER_UNLOCKED;
 
 /**
  * @brief When we send an update to the device shadow, and if we care about
  * the response from cloud (accepted/rejected), remember the clientToken and
- * use it to match with the response.
+ * use it to match with the response. Allocated by #ulShadowRequestBegin.
  */
 static uint32_t ulClientToken = 0U;
 
@@ -166,9 +309,6 @@ static uint32_t ulClientToken = 0U;
  */
 static BaseType_t xUpdateDeltaReturn = pdPASS;
 
-static TaskHandle_t actuatorHandle;
-
-static SemaphoreHandle_t xPubAckWaitLock = NULL;
 
 /*-----------------------------------------------------------*/
 
@@ -189,104 +329,401 @@ static void prvEventCallback(MQTTContext_t *pxMqttContext,
 /**
  * @brief Process payload from /update/delta topic.
  *
- * This handler examines the version number and the powerOn state. If powerOn
- * state has changed, it sets a flag for the main function to take further actions.
+ * This handler examines the version number and the lock states, all extracted
+ * by one pass of #eShadowParseDocument over the payload. Every compartment
+ * asked to open is handed to the lock table in one request, so they settle
+ * and are reported together. Deltas that follow within
+ * #appconfigSHADOW_DELTA_COALESCE_MS are merged and applied once.
  *
  * @param[in] pPublishInfo Deserialized publish info pointer for the incoming
  * packet.
+ * @param[in] ulReceivedUs #ulLatencyProbeNow when the packet was handed over.
+ */
+static void prvUpdateDeltaHandler(MQTTPublishInfo_t *pxPublishInfo, uint32_t ulReceivedUs);
+
+/**
+ * @brief Act on the lock keys of a delta or of the delta part of a
+ * /get/accepted document, unless its version was already acted on.
+ *
+ * @return The compartments the document had a value for, whether or not
+ * they were acted on.
+ */
+static uint32_t prvHandleDesired(const ShadowDeltaDocument_t *pxDelta, uint32_t ulReceivedUs);
+
+/**
+ * @brief Apply a /get/accepted document, as fetched after every connect.
+ */
+static void prvGetAcceptedHandler(MQTTPublishInfo_t *pxPublishInfo, uint32_t ulReceivedUs);
+
+/**
+ * @brief Write #ShadowVersionCache_t. Runs in the flash writer task.
+ *
+ * @param[in] pvParameter1 The lock state of the record.
+ * @param[in] ulVersion The version of the record.
  */
-static void prvUpdateDeltaHandler(MQTTPublishInfo_t *pxPublishInfo);
+static void prvStoreVersionCache(void *pvParameter1, uint32_t ulVersion);
+
+/**
+ * @brief Have the applied delta written to NVS, if it has not been.
+ */
+static void prvSaveVersionCache(void);
+
+/**
+ * @brief Open the compartments a (possibly coalesced) delta asks for.
+ *
+ * @param[in] ulPresent Compartments the delta had a value for.
+ * @param[in] ulDesiredOpen Compartments whose desired value is open.
+ * @param[in] ulVersion Shadow version of the newest folded delta.
+ * @param[in] ulReceivedUs #ulLatencyProbeNow when the first folded delta arrived.
+ */
+static void prvApplyDesired(uint32_t ulPresent, uint32_t ulDesiredOpen, uint32_t ulVersion, uint32_t ulReceivedUs);
 
 /*-----------------------------------------------------------*/
 
-static void prvUpdateDeltaHandler(MQTTPublishInfo_t *pxPublishInfo) {
-    static uint32_t ulCurrentVersion = 0; /* Remember the latestVersion # we've ever received */
-    uint32_t ulVersion = 0U;
-    uint32_t ulNewState = 0U;
-    char *pcOutValue = NULL;
-    uint32_t ulOutValueLength = 0U;
-    JSONStatus_t result = JSONSuccess;
+static void prvUpdateDeltaHandler(MQTTPublishInfo_t *pxPublishInfo, uint32_t ulReceivedUs) {
+    ShadowDeltaDocument_t xDelta;
+    ShadowParserStatus_t eResult;
+    uint32_t ulParseStartUs;
 
     assert(pxPublishInfo != NULL);
     assert(pxPublishInfo->pPayload != NULL);
 
-    LogInfo(("/update/delta json payload:%s.", (const char *) pxPublishInfo->pPayload));
+    /* The payload lives in the network buffer, which is reused before the
+     * log task gets to a record, so only its length is logged. */
+    AppLogDebug("/update/delta of %u bytes.", (unsigned) pxPublishInfo->payloadLength);
 
-    /* Make sure the payload is a valid json document. */
-    result = JSON_Validate(pxPublishInfo->pPayload,
-                           pxPublishInfo->payloadLength);
+    /* Validate the document and pull out version, lockState, locks and
+     * clientToken in a single pass over the payload. */
+    ulParseStartUs = ulLatencyProbeNow();
+    eResult = eShadowParseDocument((const char *) pxPublishInfo->pPayload,
+                                   pxPublishInfo->payloadLength,
+                                   &xDelta);
+    vLatencyProbeRecord(LatencySpanDeltaParse, ulParseStartUs);
 
-    if (result == JSONSuccess) {
-        /* Then we start to get the version value by JSON keyword "version". */
-        result = JSON_Search((char *) pxPublishInfo->pPayload,
-                             pxPublishInfo->payloadLength,
-                             "version",
-                             sizeof("version") - 1,
-                             &pcOutValue,
-                             (size_t * ) & ulOutValueLength);
-    } else {
-        LogError(("The json document is invalid!!"));
+    if (eResult != ShadowParserSuccess) {
+        AppLogError("The json document is invalid!! status=%d", (int) eResult);
+        xUpdateDeltaReturn = pdFAIL;
+        return;
     }
 
-    if (result == JSONSuccess) {
-        LogInfo(("version: %.*s",
-                ulOutValueLength,
-                pcOutValue));
+    /* A delta without a version cannot be ordered against the ones already
+     * acted on, so it is not acted on at all. */
+    if ((xDelta.ulFieldsPresent & SHADOW_DELTA_FIELD_VERSION) == 0U) {
+        AppLogError("No version in json document!!");
+        xUpdateDeltaReturn = pdFAIL;
+        return;
+    }
 
-        /* Convert the extracted value to an unsigned integer value. */
-        ulVersion = (uint32_t) strtoul(pcOutValue, NULL, 10);
-    } else {
-        LogError(("No version in json document!!"));
+    if (prvHandleDesired(&xDelta, ulReceivedUs) == 0U) {
+        AppLogError("No lockState or locks in json document!!");
+        xUpdateDeltaReturn = pdFAIL;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvHandleDesired(const ShadowDeltaDocument_t *pxDelta, uint32_t ulReceivedUs) {
+    uint32_t ulPresent = pxDelta->ulLocksPresent;
+    uint32_t ulDesiredOpen = pxDelta->ulLocksOpen;
+    bool xApplyNow;
+
+    /* "lockState" is the single-lock name of compartment 0. */
+    if ((pxDelta->ulFieldsPresent & SHADOW_DELTA_FIELD_LOCK_STATE) != 0U) {
+        ulPresent |= 1U;
+        ulDesiredOpen = (ulDesiredOpen & ~1U) | ((pxDelta->ulLockState == LOCK_STATE_OPEN) ? 1U : 0U);
+    }
+
+    ulPresent &= LOCK_STATE_ALL_MASK;
+
+    if (ulPresent == 0U) {
+        return 0U;
     }
 
-    LogInfo(("version:%d, ulCurrentVersion:%d \r\n", ulVersion, ulCurrentVersion));
+    AppLogInfo("version:%u, ulCurrentVersion:%u", pxDelta->ulVersion, ulCurrentVersion);
 
     /* When the version is much newer than the on we retained, that means the powerOn
      * state is valid for us. */
-    if (ulVersion > ulCurrentVersion) {
-        /* Set to received version as the current version. */
-        ulCurrentVersion = ulVersion;
-
-        /* Get powerOn state from json documents. */
-        result = JSON_Search((char *) pxPublishInfo->pPayload,
-                             pxPublishInfo->payloadLength,
-                             "state.lockState",
-                             sizeof("state.lockState") - 1,
-                             &pcOutValue,
-                             (size_t * ) & ulOutValueLength);
-    } else {
+    if (pxDelta->ulVersion <= ulCurrentVersion) {
         /* In this demo, we discard the incoming message
          * if the version number is not newer than the latest
          * that we've received before. Your application may use a
          * different approach.
          */
-        LogWarn(("The received version is smaller than current one!!"));
+        AppLogWarn("The received version is smaller than current one!!");
+        return ulPresent;
     }
 
-    if (result == JSONSuccess) {
-        /* Convert the lock state value to an unsigned integer value. */
-        ulNewState = (uint32_t) strtoul(pcOutValue, NULL, 10);
+    /* Set to received version as the current version. */
+    ulCurrentVersion = pxDelta->ulVersion;
 
-        LogInfo(("The new state newState:%d, ulCurrentLockState:%d \r\n",
-                ulNewState, ulCurrentLockState));
+    vBootMark(BootPhaseFirstDelta);
 
-        if (ulNewState != ulCurrentLockState) {
-            ulCurrentLockState = ulNewState;
+    /* The first delta after a quiet period is acted on at once; later ones
+     * are only folded in until the window closes. Versions are increasing
+     * here, so the newer value of a compartment simply replaces the older. */
+    portENTER_CRITICAL(&xCoalesceLock);
+    xApplyNow = !xWindowOpen;
+    if (xApplyNow) {
+        xWindowOpen = true;
+    } else {
+        if (ulPendingPresent == 0U) {
+            ulPendingReceivedUs = ulReceivedUs;
+        }
+        ulPendingDesired = (ulPendingDesired & ~ulPresent) | (ulDesiredOpen & ulPresent);
+        ulPendingPresent |= ulPresent;
+        ulPendingVersion = pxDelta->ulVersion;
+    }
+    portEXIT_CRITICAL(&xCoalesceLock);
 
-            if (ulNewState == LOCK_STATE_OPEN) {
-                xTaskNotifyGive(actuatorHandle);
-            }
+    if (xApplyNow) {
+        (void) xTimerReset(xCoalesceTimer, 0U);
+        prvApplyDesired(ulPresent, ulDesiredOpen, pxDelta->ulVersion, ulReceivedUs);
+    } else {
+        AppLogDebug("Delta folded into the pending window.");
+    }
+
+    return ulPresent;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvGetAcceptedHandler(MQTTPublishInfo_t *pxPublishInfo, uint32_t ulReceivedUs) {
+    ShadowDeltaDocument_t xDocument;
+    uint32_t ulToken = 0U;
+    TickType_t xLatency = 0U;
+    uint32_t ulPresent;
+    bool xStale;
+
+    if (eShadowParseDocument((const char *) pxPublishInfo->pPayload,
+                             pxPublishInfo->payloadLength,
+                             &xDocument) != ShadowParserSuccess) {
+        AppLogError("/get/accepted of %u bytes is invalid.", (unsigned) pxPublishInfo->payloadLength);
+        return;
+    }
+
+    if (((xDocument.ulFieldsPresent & SHADOW_DELTA_FIELD_CLIENT_TOKEN) != 0U) &&
+        (eShadowParseUint32(xDocument.pcClientToken,
+                            xDocument.xClientTokenLength,
+                            &ulToken) == ShadowParserSuccess) &&
+        xShadowRequestComplete(ulToken, &xLatency)) {
+        AppLogInfo("Shadow get %lu answered after %u ms.",
+                   (long unsigned) ulToken,
+                   (unsigned) (xLatency * portTICK_PERIOD_MS));
+    }
+
+    /* Another client's get carries the same document, so it is used either
+     * way; the version check sorts out anything already acted on. */
+    if ((xDocument.ulFieldsPresent & SHADOW_DELTA_FIELD_VERSION) == 0U) {
+        return;
+    }
+
+    xStale = (xDocument.ulVersion <= ulCurrentVersion);
+    ulPresent = prvHandleDesired(&xDocument, ulReceivedUs);
+
+    if ((ulPresent != 0U) && xStale) {
+        /* The desired state differs from the reported one, but was already
+         * acted on before a reset or a lost report: report what the
+         * compartments really are, which also clears the desired values. */
+        if (xLockStateResync(ulPresent) != pdPASS) {
+            AppLogWarn("Lock table busy, stale desired state 0x%02x not cleared.", ulPresent);
+        }
+    }
+
+    vShadowRequestExpire();
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvStoreVersionCache(void *pvParameter1, uint32_t ulVersion) {
+    ShadowVersionCache_t xCache = { ulVersion, (uint32_t) (uintptr_t) pvParameter1 };
+    nvs_handle xHandle;
+
+    if (nvs_open(SHADOW_NVS_NAMESPACE, NVS_READWRITE, &xHandle) == ESP_OK) {
+        if ((nvs_set_blob(xHandle, SHADOW_NVS_APPLIED, &xCache, sizeof(xCache)) != ESP_OK) ||
+            (nvs_commit(xHandle) != ESP_OK)) {
+            AppLogWarn("Failed to cache shadow version %lu.", (long unsigned) ulVersion);
+        }
+
+        nvs_close(xHandle);
+    }
+}
+
+static void prvLoadVersionCache(void) {
+    ShadowVersionCache_t xCache;
+    size_t xLength = sizeof(xCache);
+    nvs_handle xHandle;
+
+    if (nvs_open(SHADOW_NVS_NAMESPACE, NVS_READONLY, &xHandle) == ESP_OK) {
+        if ((nvs_get_blob(xHandle, SHADOW_NVS_APPLIED, &xCache, &xLength) == ESP_OK) &&
+            (xLength == sizeof(xCache))) {
+            ulCurrentVersion = xCache.ulVersion;
+            ulCachedLockState = xCache.ulLockState & LOCK_STATE_ALL_MASK;
+            AppLogInfo("Last applied shadow version %lu opened 0x%02x.",
+                       (long unsigned) xCache.ulVersion,
+                       (unsigned) ulCachedLockState);
+        }
+
+        nvs_close(xHandle);
+    }
+}
+
+static void prvSaveVersionCache(void) {
+    ShadowVersionCache_t xCache;
+    bool xSave;
+
+    portENTER_CRITICAL(&xCacheLock);
+    xSave = xCacheUnsaved;
+    xCache = xUnsavedCache;
+    xCacheUnsaved = false;
+    portEXIT_CRITICAL(&xCacheLock);
+
+    /* Flash writes stall the caches, so the cache is written by the flash
+     * writer task, below the unlock path. */
+    if (xSave &&
+        (xFlashWriterPend(prvStoreVersionCache,
+                          (void *) (uintptr_t) xCache.ulLockState,
+                          xCache.ulVersion) != pdPASS)) {
+        AppLogWarn("Flash writer busy, shadow version %lu not cached.", (long unsigned) xCache.ulVersion);
+    }
+}
+
+/**
+ * @brief Remember that the delta of ulVersion opens ulOpened.
+ *
+ * The record only has to survive a reboot until the shadow moves past
+ * ulVersion: from then on a /get carries a newer version and no longer asks
+ * for what was done, since the open was reported. The shadow moves past it
+ * when the next report is accepted, which normally takes one round trip, so
+ * the record is only written to NVS if that report cannot be sent, is
+ * rejected or gets lost with the session.
+ */
+static void prvCacheApplied(uint32_t ulVersion, uint32_t ulOpened) {
+    portENTER_CRITICAL(&xCacheLock);
+    xUnsavedCache.ulLockState = (xCacheUnsaved ? xUnsavedCache.ulLockState : 0U) | ulOpened;
+    xUnsavedCache.ulVersion = ulVersion;
+    xCacheUnsaved = true;
+    ulCacheToken = 0U;
+    portEXIT_CRITICAL(&xCacheLock);
+}
+
+/**
+ * @brief Note the clientToken of a report sent after the applied delta.
+ */
+static void prvCacheReported(uint32_t ulToken) {
+    portENTER_CRITICAL(&xCacheLock);
+    if (xCacheUnsaved && (ulCacheToken == 0U)) {
+        ulCacheToken = ulToken;
+    }
+    portEXIT_CRITICAL(&xCacheLock);
+}
+
+/**
+ * @brief Settle the applied delta once the report sent after it is answered.
+ */
+static void prvCacheAnswered(uint32_t ulToken, bool xAccepted) {
+    bool xMatched;
+
+    portENTER_CRITICAL(&xCacheLock);
+    xMatched = xCacheUnsaved && (ulCacheToken != 0U) && (ulCacheToken == ulToken);
+    if (xMatched && xAccepted) {
+        xCacheUnsaved = false;
+    }
+    portEXIT_CRITICAL(&xCacheLock);
 
-            /* State change will be handled in main(), where we will publish a "reported"
-             * state to the device shadow. We do not do it here because we are inside of
-             * a callback from the MQTT library, so that we don't re-enter
-             * the MQTT library. */
-            stateChanged = true;
+    if (xMatched && !xAccepted) {
+        prvSaveVersionCache();
+    }
+}
+
+static void prvApplyDesired(uint32_t ulPresent, uint32_t ulDesiredOpen, uint32_t ulVersion, uint32_t ulReceivedUs) {
+    uint32_t ulToOpen = ulDesiredOpen & ulPresent & ~ulReportedOpenMask;
+
+    AppLogInfo("Desired open:0x%02x of 0x%02x, reported open:0x%02x",
+               ulDesiredOpen & ulPresent, ulPresent, ulReportedOpenMask);
+
+    /* Only opening is acted on; compartments close when their hold expires.
+     * The lock table reports the result, so there is nothing to publish here
+     * and the MQTT library is not re-entered from its callback. */
+    if (ulToOpen != 0U) {
+        /* Before the request, as the lock table reports the open from
+         * inside it. Should the table be busy, the record at most rejects
+         * a replay of this delta, which a /get then answers with the real
+         * state. */
+        prvCacheApplied(ulVersion, ulToOpen);
+
+        if (xLockStateRequestOpen(ulToOpen) == pdPASS) {
+            vLatencyProbeRecord(LatencySpanUnlock, ulReceivedUs);
+        } else {
+            AppLogWarn("Lock table busy, open of 0x%02x not applied.", ulToOpen);
         }
+    }
+}
+
+static void prvCoalesceTimerCallback(TimerHandle_t xTimer) {
+    uint32_t ulPresent;
+    uint32_t ulDesiredOpen;
+    uint32_t ulVersion;
+    uint32_t ulReceivedUs;
+
+    /* The version is taken with the masks it belongs to; the agent task may
+     * already be folding a newer delta. */
+    portENTER_CRITICAL(&xCoalesceLock);
+    ulPresent = ulPendingPresent;
+    ulDesiredOpen = ulPendingDesired;
+    ulVersion = ulPendingVersion;
+    ulReceivedUs = ulPendingReceivedUs;
+    ulPendingPresent = 0U;
+    ulPendingDesired = 0U;
+    /* Keep the window open for one more period after acting on a burst. */
+    xWindowOpen = (ulPresent != 0U);
+    portEXIT_CRITICAL(&xCoalesceLock);
+
+    if (ulPresent != 0U) {
+        (void) xTimerReset(xTimer, 0U);
+        prvApplyDesired(ulPresent, ulDesiredOpen, ulVersion, ulReceivedUs);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvUpdateResponseHandler(MQTTPublishInfo_t *pxPublishInfo, const char *pcOperation, bool xAccepted) {
+    ShadowDeltaDocument_t xResponse;
+    uint32_t ulToken = 0U;
+    TickType_t xLatency = 0U;
+
+    if ((eShadowParseDocument((const char *) pxPublishInfo->pPayload,
+                              pxPublishInfo->payloadLength,
+                              &xResponse) != ShadowParserSuccess) ||
+        ((xResponse.ulFieldsPresent & SHADOW_DELTA_FIELD_CLIENT_TOKEN) == 0U) ||
+        (eShadowParseUint32(xResponse.pcClientToken,
+                            xResponse.xClientTokenLength,
+                            &ulToken) != ShadowParserSuccess)) {
+        /* Not one of ours: updates from the app backend carry their own tokens. */
+        AppLogDebug("Ignoring /%s/%s without a device clientToken.", pcOperation, xAccepted ? "accepted" : "rejected");
+    } else if (xShadowRequestComplete(ulToken, &xLatency) == false) {
+        AppLogWarn("/%s/%s for unknown or expired clientToken %lu.",
+                   pcOperation,
+                   xAccepted ? "accepted" : "rejected",
+                   (long unsigned) ulToken);
+    } else if (xAccepted) {
+        AppLogInfo("Shadow %s %lu accepted after %u ms.",
+                   pcOperation,
+                   (long unsigned) ulToken,
+                   (unsigned) (xLatency * portTICK_PERIOD_MS));
     } else {
-        LogError(("No lockState in json document!!"));
-        xUpdateDeltaReturn = pdFAIL;
+        AppLogError("Shadow %s %lu rejected with code %u after %u ms.",
+                    pcOperation,
+                    (long unsigned) ulToken,
+                    (unsigned) xResponse.ulCode,
+                    (unsigned) (xLatency * portTICK_PERIOD_MS));
     }
+
+    /* Late or not, an accepted update has moved the shadow on. */
+    if (ulToken != 0U) {
+        prvCacheAnswered(ulToken, xAccepted);
+    }
+
+    vShadowRequestExpire();
 }
 
 /*-----------------------------------------------------------*/
@@ -299,6 +736,7 @@ static void prvUpdateDeltaHandler(MQTTPublishInfo_t *pxPublishInfo) {
 static void prvEventCallback(MQTTContext_t *pxMqttContext,
                              MQTTPacketInfo_t *pxPacketInfo,
                              MQTTDeserializedInfo_t *pxDeserializedInfo) {
+    uint32_t ulReceivedUs = ulLatencyProbeNow();
     ShadowMessageType_t messageType = ShadowMessageTypeMaxNum;
     const char *pcThingName = NULL;
     uint16_t usThingNameLength = 0U;
@@ -312,16 +750,18 @@ static void prvEventCallback(MQTTContext_t *pxMqttContext,
 
     usPacketIdentifier = pxDeserializedInfo->packetIdentifier;
 
-    LogInfo(("Received a packet."));
+    AppLogDebug("Received a packet of type 0x%02x.", (unsigned) pxPacketInfo->type);
     /* Handle incoming publish. The lower 4 bits of the publish packet
      * type is used for the dup, QoS, and retain flags. Hence masking
      * out the lower bits to check if the packet is publish. */
     if ((pxPacketInfo->type & 0xF0U) == MQTT_PACKET_TYPE_PUBLISH) {
         assert(pxDeserializedInfo->pPublishInfo != NULL);
-        LogInfo(("pPublishInfo->pTopicName:%s.", pxDeserializedInfo->pPublishInfo->pTopicName));
 
-        /* Let the Device Shadow library tell us whether this is a device shadow message. */
-        if (SHADOW_SUCCESS == Shadow_MatchTopic(pxDeserializedInfo->pPublishInfo->pTopicName,
+        if (xTaskProfilerHandlePublish(pxDeserializedInfo->pPublishInfo)) {
+            /* A profile request; the profiler reports on its own topic. */
+        } else if (xOtaClientHandlePublish(pxDeserializedInfo->pPublishInfo)) {
+            /* An OTA offer or block, handled on the OTA task. */
+        } else if (SHADOW_SUCCESS == Shadow_MatchTopic(pxDeserializedInfo->pPublishInfo->pTopicName,
                                                 pxDeserializedInfo->pPublishInfo->topicNameLength,
                                                 &messageType,
                                                 &pcThingName,
@@ -329,95 +769,243 @@ static void prvEventCallback(MQTTContext_t *pxMqttContext,
             /* Upon successful return, the messageType has been filled in. */
             if (messageType == ShadowMessageTypeUpdateDelta) {
                 /* Handler function to process payload. */
-                prvUpdateDeltaHandler(pxDeserializedInfo->pPublishInfo);
+                prvUpdateDeltaHandler(pxDeserializedInfo->pPublishInfo, ulReceivedUs);
+            } else if ((messageType == ShadowMessageTypeUpdateAccepted) ||
+                       (messageType == ShadowMessageTypeUpdateRejected)) {
+                prvUpdateResponseHandler(pxDeserializedInfo->pPublishInfo,
+                                         "update",
+                                         messageType == ShadowMessageTypeUpdateAccepted);
+            } else if (messageType == ShadowMessageTypeGetAccepted) {
+                prvGetAcceptedHandler(pxDeserializedInfo->pPublishInfo, ulReceivedUs);
+            } else if (messageType == ShadowMessageTypeGetRejected) {
+                /* 404 until the first report has created the document. */
+                prvUpdateResponseHandler(pxDeserializedInfo->pPublishInfo, "get", false);
             } else {
-                LogInfo(("Other message type:%d !!", messageType));
+                AppLogInfo("Other message type:%d !!", messageType);
             }
         } else {
-            LogError(
-                    ("Shadow_MatchTopic parse failed:%s !!", (const char *) pxDeserializedInfo->pPublishInfo->pTopicName));
+            AppLogError("Publish on an unexpected topic of %u bytes.",
+                        (unsigned) pxDeserializedInfo->pPublishInfo->topicNameLength);
         }
     } else {
+        /* PUBACKs have already been matched to their publisher by the MQTT agent. */
         vHandleOtherIncomingPacket(pxPacketInfo, usPacketIdentifier);
-        if (pxPacketInfo->type == MQTT_PACKET_TYPE_PUBACK && xPubAckWaitLock != NULL) {
-            xSemaphoreGive(xPubAckWaitLock);
-        }
     }
 }
 
-void publishCurrentStateTask(void *pArgument) {
-    /* A buffer containing the update document. It has static duration to prevent
-     * it from being placed on the call stack. */
-    static char pcUpdateDocument[SHADOW_DESIRED_JSON_LENGTH + 1] = {0};
-    BaseType_t xDemoStatus = pdPASS;
+/*-----------------------------------------------------------*/
 
-    xPubAckWaitLock = xSemaphoreCreateBinary();
+/**
+ * @brief Report settled compartments to the device shadow.
+ *
+ * Called by the lock table once per batch of transitions, so opening several
+ * compartments costs one update. The document is handed to the MQTT agent
+ * without waiting, since this runs in the agent task or the timer service
+ * task. Without a session the report goes to the journal instead, and is
+ * drained by #prvSessionCallback.
+ */
+static void prvReportLockState(uint32_t ulOpenMask, uint32_t ulChangedMask) {
+    /* The documents hold their constant text from compile time on; only the
+     * field digits are rewritten. Reports are serialised by the lock table,
+     * so a single copy of each is enough. */
+    static char pcDesiredDocument[] = SHADOW_TEMPLATE_TEXT(SHADOW_DESIRED_DOCUMENT);
+    static char pcReportedDocument[] = SHADOW_TEMPLATE_TEXT(SHADOW_REPORTED_DOCUMENT);
+    uint32_t ulFields[SHADOW_FIELD_COUNT];
+    const ShadowTemplate_t *pxTemplate;
+    char *pcUpdateDocument;
+    MqttAgentStatus_t eAgentStatus;
+    uint32_t i;
+
+    ulReportedOpenMask = ulOpenMask;
+
+    if (!xMqttAgentIsConnected()) {
+        /* Queued commands survive a reconnect, but not a reboot or a long
+         * outage; the journal survives both without filling the queue. */
+        vReportJournalAppend(ulOpenMask, ulChangedMask);
+        prvSaveVersionCache();
+        return;
+    }
 
-    while (true) {
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-        LogInfo(("ulTaskNotifyTake(pdTRUE, portMAX_DELAY);"));
+    vShadowRequestExpire();
+    ulClientToken = ulShadowRequestBegin();
 
-        LogInfo(("Report to the state change: %d", ulCurrentLockState));
-        (void) memset(pcUpdateDocument,
-                      0x00,
-                      sizeof(pcUpdateDocument));
+    if ((ulChangedMask & ~ulOpenMask) == 0U) {
+        pxTemplate = &xReportedTemplate;
+        pcUpdateDocument = pcReportedDocument;
+    } else {
+        // a compartment closed: reset the desired values to the reported ones.
+        pxTemplate = &xDesiredTemplate;
+        pcUpdateDocument = pcDesiredDocument;
+    }
 
-        ulClientToken = (xTaskGetTickCount() % 1000000);
-        ulCurrentLockState = LOCK_STATE_OPEN;
+    ulFields[SHADOW_FIELD_LOCK_STATE] = ((ulOpenMask & 1U) != 0U) ? LOCK_STATE_OPEN : LOCK_STATE_CLOSE;
+    ulFields[SHADOW_FIELD_CLIENT_TOKEN] = ulClientToken;
+
+    for (i = 0; i < appconfigLOCK_COUNT; i++) {
+        ulFields[SHADOW_FIELD_LOCK_FIRST + i] = ((ulOpenMask & (1UL << i)) != 0U) ? LOCK_STATE_OPEN : LOCK_STATE_CLOSE;
+    }
 
-        snprintf(pcUpdateDocument,
-                 SHADOW_REPORTED_JSON_LENGTH + 1,
-                 SHADOW_REPORTED_JSON,
-                 (int) ulCurrentLockState,
-                 (long unsigned) ulClientToken);
+    vShadowTemplateSerialize(pxTemplate, pcUpdateDocument, ulFields);
 
-        xDemoStatus = PublishToTopic(&xMqttContext,
-                                     SHADOW_TOPIC_STRING_UPDATE(THING_NAME),
+    AppLogInfo("Report to the state change: open 0x%02x, changed 0x%02x", ulOpenMask, ulChangedMask);
+
+    eAgentStatus = eMqttAgentPublish(SHADOW_TOPIC_STRING_UPDATE(THING_NAME),
                                      SHADOW_TOPIC_LENGTH_UPDATE(THING_NAME_LENGTH),
                                      pcUpdateDocument,
-                                     (SHADOW_REPORTED_JSON_LENGTH));
-        if (xDemoStatus == pdFAIL) {
-            /* Log error to indicate connection failure. */
-            LogError(("Failed to publish to MQTT broker."));
-        }
+                                     pxTemplate->xLength,
+                                     0U);
+    if (eAgentStatus != MqttAgentSuccess) {
+        /* Log error to indicate connection failure. */
+        AppLogError("Failed to queue shadow update %lu.", (long unsigned) ulClientToken);
+        vReportJournalAppend(ulOpenMask, ulChangedMask);
+        prvSaveVersionCache();
 
-        if (xSemaphoreTake(xPubAckWaitLock, pdMS_TO_TICKS(LOCK_MQTT_PUBACK_WAIT_MS)) != pdTRUE) {
-            LogError(("Failed to receive puback"));
-        }
+        /* Still connected: drain it once the queue has room again rather
+         * than only after the next reconnect. */
+        vMqttAgentRequestSync();
+    } else {
+        prvCacheReported(ulClientToken);
+    }
+}
+
+/**
+ * @brief Ask for the whole shadow document; see #prvGetAcceptedHandler.
+ *
+ * @return false if the request could not be queued.
+ */
+static bool prvRequestShadow(void) {
+    char pcGetDocument[] = SHADOW_TEMPLATE_TEXT(SHADOW_GET_DOCUMENT);
+    uint32_t ulFields[SHADOW_FIELD_COUNT];
+    uint32_t ulToken;
+
+    vShadowRequestExpire();
+    ulToken = ulShadowRequestBegin();
+
+    ulFields[SHADOW_FIELD_CLIENT_TOKEN] = ulToken;
+    vShadowTemplateSerialize(&xGetTemplate, pcGetDocument, ulFields);
+
+    if (eMqttAgentPublish(SHADOW_TOPIC_STRING_GET(THING_NAME),
+                          SHADOW_TOPIC_LENGTH_GET(THING_NAME_LENGTH),
+                          pcGetDocument,
+                          xGetTemplate.xLength,
+                          0U) != MqttAgentSuccess) {
+        AppLogError("Failed to queue shadow get %lu.", (long unsigned) ulToken);
+        return false;
+    }
 
-        // TODO the following code should be executed after a sensor detects lock closing.
-        // but this demo, there is no sensor we call it soon.
-        vTaskDelay(pdMS_TO_TICKS(5000));
+    return true;
+}
 
-        // remove desired value and change the reported state to CLOSE.
-        ulClientToken = (xTaskGetTickCount() % 1000000);
-        ulCurrentLockState = LOCK_STATE_CLOSE;
+/**
+ * @brief Bring the shadow up to date once a session is back: have the
+ * journaled history published, then report the current state once.
+ *
+ * Reports queued just before a drop may have been lost in flight too, so the
+ * state is re-reported after every reconnect, journal or not. Then the
+ * document is fetched, so the box converges within one round trip. Whatever
+ * does not fit in the agent queue is retried by the agent on a later pass.
+ */
+static bool prvSessionCallback(bool xUp) {
+    static bool xResyncPending = false;
+    static bool xGetPending = true;
+    static uint32_t ulResyncMask = 0U;
+    uint32_t ulChanged = 0U;
+    BaseType_t xDrained;
+
+    if (!xUp) {
+        /* A report still in flight may not be answered now. */
+        prvSaveVersionCache();
+        xResyncPending = true;
+        xGetPending = true;
+        return true;
+    }
 
-        (void) memset(pcUpdateDocument,
-                      0x00,
-                      sizeof(pcUpdateDocument));
+    xDrained = xReportJournalDrain(&ulChanged);
 
-        snprintf(pcUpdateDocument,
-                 SHADOW_DESIRED_JSON_LENGTH + 1,
-                 SHADOW_DESIRED_JSON,
-                 (int) ulCurrentLockState,
-                 (int) ulCurrentLockState,
-                 (long unsigned) ulClientToken);
+    /* Report the compartments the reset closed as changed, which resets
+     * their desired values too. */
+    ulResyncMask |= ulChanged | ulCachedLockState;
+    ulCachedLockState = 0U;
 
-        xDemoStatus = PublishToTopic(&xMqttContext,
-                                     SHADOW_TOPIC_STRING_UPDATE(THING_NAME),
-                                     SHADOW_TOPIC_LENGTH_UPDATE(THING_NAME_LENGTH),
-                                     pcUpdateDocument,
-                                     (SHADOW_DESIRED_JSON_LENGTH));
-        if (xDemoStatus == pdFAIL) {
-            /* Log error to indicate connection failure. */
-            LogError(("Failed to publish to MQTT broker."));
+    if (xResyncPending || (ulResyncMask != 0U)) {
+        /* A report that does not fit is journaled and asks for another
+         * pass, which drains it; so does a busy lock table. */
+        if (xLockStateResync(ulResyncMask) == pdPASS) {
+            xResyncPending = false;
+            ulResyncMask = 0U;
         }
+    }
 
-        if (xSemaphoreTake(xPubAckWaitLock, pdMS_TO_TICKS(LOCK_MQTT_PUBACK_WAIT_MS)) != pdTRUE) {
-            LogError(("Failed to receive puback"));
-        }
+    /* Anything desired while the box was away is picked up from the reply
+     * rather than waiting for the next delta. */
+    if (xGetPending) {
+        xGetPending = !prvRequestShadow();
+    }
+
+    return (xDrained == pdPASS) && !xResyncPending && (ulResyncMask == 0U) && !xGetPending;
+}
+
+BaseType_t xShadowClientReportPower(uint32_t ulBatteryMv, bool xCharging) {
+    char pcPowerDocument[] = SHADOW_TEMPLATE_TEXT(SHADOW_POWER_DOCUMENT);
+    uint32_t ulFields[SHADOW_FIELD_COUNT];
+    uint32_t ulToken;
+
+    if (ulBatteryMv < 1000U) {
+        ulBatteryMv = 1000U;
+    } else if (ulBatteryMv > 9999U) {
+        ulBatteryMv = 9999U;
+    }
+
+    vShadowRequestExpire();
+    ulToken = ulShadowRequestBegin();
+
+    ulFields[SHADOW_FIELD_BATTERY_MV] = ulBatteryMv;
+    ulFields[SHADOW_FIELD_CHARGING] = xCharging ? 1U : 0U;
+    ulFields[SHADOW_FIELD_CLIENT_TOKEN] = ulToken;
+    vShadowTemplateSerialize(&xPowerTemplate, pcPowerDocument, ulFields);
+
+    AppLogInfo("Report battery: %u mV%s", (unsigned) ulBatteryMv, xCharging ? ", charging" : "");
+
+    if (eMqttAgentPublish(SHADOW_TOPIC_STRING_UPDATE(THING_NAME),
+                          SHADOW_TOPIC_LENGTH_UPDATE(THING_NAME_LENGTH),
+                          pcPowerDocument,
+                          xPowerTemplate.xLength,
+                          0U) != MqttAgentSuccess) {
+        AppLogError("Failed to queue shadow update %lu.", (long unsigned) ulToken);
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+BaseType_t xShadowClientInit(void) {
+    BaseType_t xStatus = xMqttAgentInit();
+
+    if (xStatus == pdPASS) {
+        xCoalesceTimer = APP_TIMER_CREATE(xCoalesceTimer,
+                                          "deltaWindow",
+                                          pdMS_TO_TICKS(appconfigSHADOW_DELTA_COALESCE_MS),
+                                          pdFALSE,
+                                          NULL,
+                                          prvCoalesceTimerCallback);
+        xStatus = (xCoalesceTimer != NULL) ? pdPASS : pdFAIL;
+    }
+
+    if (xStatus == pdPASS) {
+        xStatus = xLockStateInit(prvReportLockState);
+    }
+
+    if (xStatus == pdPASS) {
+        prvLoadVersionCache();
     }
+
+    if ((xStatus == pdPASS) && (xReportJournalInit() != pdPASS)) {
+        /* Not fatal: reports made while offline are then only re-sent as
+         * the current state after the reconnect. */
+        AppLogWarn("Lock reports will not be journaled.");
+    }
+
+    return xStatus;
 }
 
 /*-----------------------------------------------------------*/
@@ -426,12 +1014,9 @@ int RunDeviceShadowClient(bool awsIotMqttMode,
                           const char *pIdentifier,
                           void *pNetworkServerInfo,
                           void *pNetworkCredentialInfo,
-                          const void *pNetworkInterface,
-                          TaskHandle_t *pHandle) {
+                          const void *pNetworkInterface) {
     BaseType_t xDemoStatus = pdPASS;
 
-    actuatorHandle = *pHandle;
-
     /* Remove compiler warnings about unused parameters. */
     (void) awsIotMqttMode;
     (void) pIdentifier;
@@ -439,48 +1024,65 @@ int RunDeviceShadowClient(bool awsIotMqttMode,
     (void) pNetworkCredentialInfo;
     (void) pNetworkInterface;
 
-    xDemoStatus = EstablishMqttSession(&xMqttContext,
-                                       &xNetworkContext,
-                                       &xBuffer,
-                                       prvEventCallback);
+    /* The subscribes are queued now and executed by the agent as soon as the
+     * session is up. */
+    (void) eMqttAgentSubscribe(SHADOW_TOPIC_STRING_UPDATE_DELTA(THING_NAME),
+                               SHADOW_TOPIC_LENGTH_UPDATE_DELTA(THING_NAME_LENGTH),
+                               0U);
+    (void) eMqttAgentSubscribe(SHADOW_TOPIC_STRING_UPDATE_ACCEPTED(THING_NAME),
+                               SHADOW_TOPIC_LENGTH_UPDATE_ACCEPTED(THING_NAME_LENGTH),
+                               0U);
+    (void) eMqttAgentSubscribe(SHADOW_TOPIC_STRING_UPDATE_REJECTED(THING_NAME),
+                               SHADOW_TOPIC_LENGTH_UPDATE_REJECTED(THING_NAME_LENGTH),
+                               0U);
+    (void) eMqttAgentSubscribe(SHADOW_TOPIC_STRING_GET_ACCEPTED(THING_NAME),
+                               SHADOW_TOPIC_LENGTH_GET_ACCEPTED(THING_NAME_LENGTH),
+                               0U);
+    (void) eMqttAgentSubscribe(SHADOW_TOPIC_STRING_GET_REJECTED(THING_NAME),
+                               SHADOW_TOPIC_LENGTH_GET_REJECTED(THING_NAME_LENGTH),
+                               0U);
+
+    vMqttAgentSetSessionCallback(prvSessionCallback);
+
+    /* This task becomes the MQTT agent and owns the MQTT context from here on;
+     * other tasks publish through the agent command queue. */
+    xDemoStatus = xMqttAgentRun(prvEventCallback);
 
-    if (xDemoStatus == pdFAIL) {
-        /* Log error to indicate connection failure. */
-        LogError(("Failed to connect to MQTT broker."));
-    } else {
-        if (xDemoStatus == pdPASS) {
-            xDemoStatus = SubscribeToTopic(&xMqttContext,
-                                           SHADOW_TOPIC_STRING_UPDATE_DELTA(THING_NAME),
-                                           SHADOW_TOPIC_LENGTH_UPDATE_DELTA(THING_NAME_LENGTH));
-        }
-
-        if (xDemoStatus == pdPASS) {
+    return ((xDemoStatus == pdPASS) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
 
-            while (true) {
-                MQTTStatus_t eMqttStatus = MQTTSuccess;
+static void prvNetworkConnectedCallback(bool awsIotMqttMode,
+                                        const char *pIdentifier,
+                                        void *pNetworkServerInfo,
+                                        void *pNetworkCredentialInfo,
+                                        const IotNetworkInterface_t *pNetworkInterface) {
+    (void) awsIotMqttMode;
+    (void) pIdentifier;
+    (void) pNetworkServerInfo;
+    (void) pNetworkCredentialInfo;
+    (void) pNetworkInterface;
 
-                xDemoStatus = MQTT_ProcessLoop(&xMqttContext, 500U);
+    (void) xDisplaySetText(DisplayRegionNetwork, "ONLINE");
+    vPowerManagerNetworkUp();
+    vMqttAgentSetNetworkState(true);
+}
 
-                if (eMqttStatus != MQTTSuccess) {
-                    LogWarn(("MQTT_ProcessLoop returned with status = %s.",
-                            MQTT_Status_strerror(eMqttStatus)));
-                }
-            }
-        }
-    }
+static void prvNetworkDisconnectedCallback(const IotNetworkInterface_t *pNetworkInterface) {
+    (void) pNetworkInterface;
 
-    return ((xDemoStatus == pdPASS) ? EXIT_SUCCESS : EXIT_FAILURE);
+    (void) xDisplaySetText(DisplayRegionNetwork, "OFFLINE");
+    vMqttAgentSetNetworkState(false);
 }
 
 void subscribeUpdateTask(void *pArgument) {
 
-    TaskHandle_t *pHandle = (TaskHandle_t *) pArgument;
+    (void) pArgument;
 
     static appMqttContext_t appMqttContext =
             {
                     .networkTypes = AWSIOT_NETWORK_TYPE_WIFI,
-                    .networkConnectedCallback = NULL,
-                    .networkDisconnectedCallback = NULL
+                    .networkConnectedCallback = prvNetworkConnectedCallback,
+                    .networkDisconnectedCallback = prvNetworkDisconnectedCallback
             };
 
     int status;
@@ -492,13 +1094,23 @@ void subscribeUpdateTask(void *pArgument) {
         return;
     }
 
+    /* network_initialize only returns once a network is up. */
+    vBootMark(BootPhaseNetwork);
+
+    /* Association ran in parallel with the device bring-up; the lock must be
+     * drivable before the first delta can be handled. */
+    (void) xBootWait(BootPhaseDevice, portMAX_DELAY);
+
+    (void) xDisplaySetText(DisplayRegionNetwork, "ONLINE");
+    vPowerManagerNetworkUp();
+    vMqttAgentSetNetworkState(true);
+
     appNetworkSetting_t setting = getNetworkSetting();
     // receive command from server.
     RunDeviceShadowClient(true,
                           clientcredentialIOT_THING_NAME,
                           setting.pConnectionParams,
                           setting.pCredentials,
-                          setting.pNetworkInterface,
-                          pHandle);
+                          setting.pNetworkInterface);
 }
 
@@ -0,0 +1,596 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <string.h>
+
+#include "shadow_parser.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A key the parser extracts, addressed by its dotted path from the
+ * root object. With xElements set the key holds an array and its elements
+ * are extracted instead.
+ */
+typedef struct ShadowField
+{
+    const char *pcPath;
+    uint32_t ulFlag;
+    bool xElements;
+} ShadowField_t;
+
+/**
+ * @brief The keys extracted by #eShadowParseDocument. Adding a key here (and
+ * a case in #prvStoreNumber or #prvStoreString) is all it takes to pick up a
+ * new shadow field; the document is still scanned once.
+ */
+static const ShadowField_t xShadowFields[] =
+{
+    { "version",         SHADOW_DELTA_FIELD_VERSION,      false },
+    { "state.lockState", SHADOW_DELTA_FIELD_LOCK_STATE,   false },
+    { "state.locks",     SHADOW_DELTA_FIELD_LOCKS,        true  },
+    /* A /get/accepted document carries the same keys under "state.delta". */
+    { "state.delta.lockState", SHADOW_DELTA_FIELD_LOCK_STATE, false },
+    { "state.delta.locks",     SHADOW_DELTA_FIELD_LOCKS,      true  },
+    { "clientToken",     SHADOW_DELTA_FIELD_CLIENT_TOKEN, false },
+    { "code",            SHADOW_DELTA_FIELD_CODE,         false }
+};
+
+#define SHADOW_FIELD_COUNT    (sizeof(xShadowFields) / sizeof(xShadowFields[0]))
+
+/**
+ * @brief State of one parse. Keys on the current path are kept as pointers
+ * into the payload; array elements push a NULL key, so they only match the
+ * element fields, and record their index.
+ */
+typedef struct ParserContext
+{
+    const char *pcBuffer;
+    size_t xLength;
+    size_t xIndex;
+    uint32_t ulDepth;
+    const char *pcKey[SHADOW_PARSER_MAX_DEPTH];
+    size_t xKeyLength[SHADOW_PARSER_MAX_DEPTH];
+    uint32_t ulElementIndex[SHADOW_PARSER_MAX_DEPTH];
+    ShadowDeltaDocument_t *pxDocument;
+} ParserContext_t;
+
+/*-----------------------------------------------------------*/
+
+static ShadowParserStatus_t prvParseValue(ParserContext_t *pxContext);
+
+/*-----------------------------------------------------------*/
+
+static void prvSkipWhitespace(ParserContext_t *pxContext) {
+    while (pxContext->xIndex < pxContext->xLength) {
+        char c = pxContext->pcBuffer[pxContext->xIndex];
+
+        if ((c != ' ') && (c != '\t') && (c != '\n') && (c != '\r')) {
+            break;
+        }
+
+        pxContext->xIndex++;
+    }
+}
+
+static bool prvConsume(ParserContext_t *pxContext, char c) {
+    bool xResult = false;
+
+    if ((pxContext->xIndex < pxContext->xLength) && (pxContext->pcBuffer[pxContext->xIndex] == c)) {
+        pxContext->xIndex++;
+        xResult = true;
+    }
+
+    return xResult;
+}
+
+static bool prvIsDigit(char c) {
+    return (c >= '0') && (c <= '9');
+}
+
+static bool prvIsHexDigit(char c) {
+    return prvIsDigit(c) || ((c >= 'a') && (c <= 'f')) || ((c >= 'A') && (c <= 'F'));
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Return the flag of the field whose path equals the current key path,
+ * or 0 if the value at this position is not one we extract.
+ */
+static uint32_t prvMatchField(const ParserContext_t *pxContext) {
+    uint32_t ulFlag = 0U;
+    size_t i;
+
+    for (i = 0; (i < SHADOW_FIELD_COUNT) && (ulFlag == 0U); i++) {
+        const char *pcSegment = xShadowFields[i].pcPath;
+        uint32_t ulLevel = 0U;
+        bool xMatch = true;
+
+        while (xMatch && (*pcSegment != '\0')) {
+            const char *pcDot = strchr(pcSegment, '.');
+            size_t xSegmentLength = (pcDot != NULL) ? (size_t) (pcDot - pcSegment) : strlen(pcSegment);
+
+            if ((ulLevel >= pxContext->ulDepth) ||
+                (pxContext->pcKey[ulLevel] == NULL) ||
+                (pxContext->xKeyLength[ulLevel] != xSegmentLength) ||
+                (memcmp(pxContext->pcKey[ulLevel], pcSegment, xSegmentLength) != 0)) {
+                xMatch = false;
+            }
+
+            ulLevel++;
+            pcSegment += xSegmentLength;
+
+            if (*pcSegment == '.') {
+                pcSegment++;
+            }
+        }
+
+        if (xMatch && !xShadowFields[i].xElements && (ulLevel == pxContext->ulDepth)) {
+            ulFlag = xShadowFields[i].ulFlag;
+        } else if (xMatch && xShadowFields[i].xElements && ((ulLevel + 1U) == pxContext->ulDepth) &&
+                   (pxContext->pcKey[ulLevel] == NULL)) {
+            ulFlag = xShadowFields[i].ulFlag;
+        }
+    }
+
+    return ulFlag;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Convert a validated JSON number to uint32_t. Fractions, exponents,
+ * negative values and values that do not fit are rejected.
+ */
+static bool prvNumberToUint32(const char *pcNumber, size_t xLength, uint32_t *pulValue) {
+    uint32_t ulValue = 0U;
+    bool xResult = (xLength > 0U);
+    size_t i;
+
+    for (i = 0; (i < xLength) && xResult; i++) {
+        uint32_t ulDigit;
+
+        if (!prvIsDigit(pcNumber[i])) {
+            xResult = false;
+        } else {
+            ulDigit = (uint32_t) (pcNumber[i] - '0');
+
+            if (ulValue > ((UINT32_MAX - ulDigit) / 10U)) {
+                xResult = false;
+            } else {
+                ulValue = (ulValue * 10U) + ulDigit;
+            }
+        }
+    }
+
+    if (xResult) {
+        *pulValue = ulValue;
+    }
+
+    return xResult;
+}
+
+static ShadowParserStatus_t prvStoreNumber(ParserContext_t *pxContext,
+                                           uint32_t ulFlag,
+                                           const char *pcNumber,
+                                           size_t xLength) {
+    ShadowParserStatus_t eStatus = ShadowParserSuccess;
+    uint32_t *pulTarget = NULL;
+    uint32_t ulElement;
+    uint32_t ulValue;
+
+    switch (ulFlag) {
+        case SHADOW_DELTA_FIELD_VERSION:
+            pulTarget = &pxContext->pxDocument->ulVersion;
+            break;
+
+        case SHADOW_DELTA_FIELD_LOCK_STATE:
+            pulTarget = &pxContext->pxDocument->ulLockState;
+            break;
+
+        case SHADOW_DELTA_FIELD_CODE:
+            pulTarget = &pxContext->pxDocument->ulCode;
+            break;
+
+        case SHADOW_DELTA_FIELD_LOCKS:
+            ulElement = pxContext->ulElementIndex[pxContext->ulDepth - 1U];
+
+            if ((ulElement >= SHADOW_PARSER_MAX_LOCKS) || !prvNumberToUint32(pcNumber, xLength, &ulValue)) {
+                eStatus = ShadowParserInvalidValue;
+            } else {
+                pxContext->pxDocument->ulLocksPresent |= (1UL << ulElement);
+
+                if (ulValue == 1U) {
+                    pxContext->pxDocument->ulLocksOpen |= (1UL << ulElement);
+                }
+
+                pxContext->pxDocument->ulFieldsPresent |= ulFlag;
+            }
+            break;
+
+        default:
+            eStatus = ShadowParserInvalidValue;
+            break;
+    }
+
+    if (pulTarget != NULL) {
+        if (prvNumberToUint32(pcNumber, xLength, pulTarget)) {
+            pxContext->pxDocument->ulFieldsPresent |= ulFlag;
+        } else {
+            eStatus = ShadowParserInvalidValue;
+        }
+    }
+
+    return eStatus;
+}
+
+static ShadowParserStatus_t prvStoreString(ParserContext_t *pxContext,
+                                           uint32_t ulFlag,
+                                           const char *pcString,
+                                           size_t xLength) {
+    ShadowParserStatus_t eStatus = ShadowParserSuccess;
+
+    switch (ulFlag) {
+        case SHADOW_DELTA_FIELD_CLIENT_TOKEN:
+            pxContext->pxDocument->pcClientToken = pcString;
+            pxContext->pxDocument->xClientTokenLength = xLength;
+            pxContext->pxDocument->ulFieldsPresent |= ulFlag;
+            break;
+
+        default:
+            eStatus = ShadowParserInvalidValue;
+            break;
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Validate a string starting at the opening quote. On success the
+ * contents (without quotes, escapes left as-is) are returned through
+ * ppcStart/pxLength.
+ */
+static ShadowParserStatus_t prvParseString(ParserContext_t *pxContext,
+                                           const char **ppcStart,
+                                           size_t *pxLength) {
+    ShadowParserStatus_t eStatus = ShadowParserInvalidJson;
+    size_t xStart;
+
+    if (prvConsume(pxContext, '"')) {
+        xStart = pxContext->xIndex;
+
+        while (pxContext->xIndex < pxContext->xLength) {
+            unsigned char c = (unsigned char) pxContext->pcBuffer[pxContext->xIndex];
+
+            if (c == '"') {
+                *ppcStart = &pxContext->pcBuffer[xStart];
+                *pxLength = pxContext->xIndex - xStart;
+                pxContext->xIndex++;
+                eStatus = ShadowParserSuccess;
+                break;
+            } else if (c < 0x20U) {
+                break;
+            } else if (c == '\\') {
+                pxContext->xIndex++;
+
+                if (pxContext->xIndex >= pxContext->xLength) {
+                    break;
+                }
+
+                c = (unsigned char) pxContext->pcBuffer[pxContext->xIndex];
+
+                if (c == 'u') {
+                    size_t i;
+
+                    if ((pxContext->xLength - pxContext->xIndex) <= 4U) {
+                        break;
+                    }
+
+                    for (i = 1; i <= 4U; i++) {
+                        if (!prvIsHexDigit(pxContext->pcBuffer[pxContext->xIndex + i])) {
+                            break;
+                        }
+                    }
+
+                    if (i <= 4U) {
+                        break;
+                    }
+
+                    pxContext->xIndex += 4U;
+                } else if ((c == '\0') || (strchr("\"\\/bfnrt", (int) c) == NULL)) {
+                    /* strchr also finds the terminator, so '\0' is checked first. */
+                    break;
+                }
+            }
+
+            pxContext->xIndex++;
+        }
+    }
+
+    return eStatus;
+}
+
+/**
+ * @brief Validate a number per the JSON grammar and return its extent.
+ */
+static ShadowParserStatus_t prvParseNumber(ParserContext_t *pxContext,
+                                           const char **ppcStart,
+                                           size_t *pxLength) {
+    const char *pcBuffer = pxContext->pcBuffer;
+    size_t xStart = pxContext->xIndex;
+    size_t xDigits;
+
+    (void) prvConsume(pxContext, '-');
+
+    /* Integer part: a single 0 or a non-zero digit followed by digits. */
+    if (prvConsume(pxContext, '0') == false) {
+        xDigits = pxContext->xIndex;
+
+        while ((pxContext->xIndex < pxContext->xLength) && prvIsDigit(pcBuffer[pxContext->xIndex])) {
+            pxContext->xIndex++;
+        }
+
+        if (pxContext->xIndex == xDigits) {
+            return ShadowParserInvalidJson;
+        }
+    }
+
+    if (prvConsume(pxContext, '.')) {
+        xDigits = pxContext->xIndex;
+
+        while ((pxContext->xIndex < pxContext->xLength) && prvIsDigit(pcBuffer[pxContext->xIndex])) {
+            pxContext->xIndex++;
+        }
+
+        if (pxContext->xIndex == xDigits) {
+            return ShadowParserInvalidJson;
+        }
+    }
+
+    if (prvConsume(pxContext, 'e') || prvConsume(pxContext, 'E')) {
+        if (prvConsume(pxContext, '+') == false) {
+            (void) prvConsume(pxContext, '-');
+        }
+
+        xDigits = pxContext->xIndex;
+
+        while ((pxContext->xIndex < pxContext->xLength) && prvIsDigit(pcBuffer[pxContext->xIndex])) {
+            pxContext->xIndex++;
+        }
+
+        if (pxContext->xIndex == xDigits) {
+            return ShadowParserInvalidJson;
+        }
+    }
+
+    *ppcStart = &pcBuffer[xStart];
+    *pxLength = pxContext->xIndex - xStart;
+
+    return ShadowParserSuccess;
+}
+
+static ShadowParserStatus_t prvParseLiteral(ParserContext_t *pxContext, const char *pcLiteral) {
+    ShadowParserStatus_t eStatus = ShadowParserInvalidJson;
+    size_t xLiteralLength = strlen(pcLiteral);
+
+    if (((pxContext->xLength - pxContext->xIndex) >= xLiteralLength) &&
+        (memcmp(&pxContext->pcBuffer[pxContext->xIndex], pcLiteral, xLiteralLength) == 0)) {
+        pxContext->xIndex += xLiteralLength;
+        eStatus = ShadowParserSuccess;
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static ShadowParserStatus_t prvPushKey(ParserContext_t *pxContext, const char *pcKey, size_t xKeyLength) {
+    ShadowParserStatus_t eStatus = ShadowParserSuccess;
+
+    if (pxContext->ulDepth >= SHADOW_PARSER_MAX_DEPTH) {
+        eStatus = ShadowParserMaxDepthExceeded;
+    } else {
+        pxContext->pcKey[pxContext->ulDepth] = pcKey;
+        pxContext->xKeyLength[pxContext->ulDepth] = xKeyLength;
+        pxContext->ulDepth++;
+    }
+
+    return eStatus;
+}
+
+static ShadowParserStatus_t prvParseObject(ParserContext_t *pxContext) {
+    ShadowParserStatus_t eStatus = ShadowParserSuccess;
+    const char *pcKey = NULL;
+    size_t xKeyLength = 0U;
+
+    (void) prvConsume(pxContext, '{');
+    prvSkipWhitespace(pxContext);
+
+    if (prvConsume(pxContext, '}')) {
+        return ShadowParserSuccess;
+    }
+
+    while (eStatus == ShadowParserSuccess) {
+        prvSkipWhitespace(pxContext);
+        eStatus = prvParseString(pxContext, &pcKey, &xKeyLength);
+
+        if (eStatus == ShadowParserSuccess) {
+            prvSkipWhitespace(pxContext);
+
+            if (prvConsume(pxContext, ':') == false) {
+                eStatus = ShadowParserInvalidJson;
+            }
+        }
+
+        if (eStatus == ShadowParserSuccess) {
+            eStatus = prvPushKey(pxContext, pcKey, xKeyLength);
+        }
+
+        if (eStatus == ShadowParserSuccess) {
+            eStatus = prvParseValue(pxContext);
+            pxContext->ulDepth--;
+        }
+
+        if (eStatus == ShadowParserSuccess) {
+            prvSkipWhitespace(pxContext);
+
+            if (prvConsume(pxContext, '}')) {
+                break;
+            } else if (prvConsume(pxContext, ',') == false) {
+                eStatus = ShadowParserInvalidJson;
+            }
+        }
+    }
+
+    return eStatus;
+}
+
+static ShadowParserStatus_t prvParseArray(ParserContext_t *pxContext) {
+    ShadowParserStatus_t eStatus = ShadowParserSuccess;
+    uint32_t ulElement = 0U;
+
+    (void) prvConsume(pxContext, '[');
+    prvSkipWhitespace(pxContext);
+
+    if (prvConsume(pxContext, ']')) {
+        return ShadowParserSuccess;
+    }
+
+    while (eStatus == ShadowParserSuccess) {
+        eStatus = prvPushKey(pxContext, NULL, 0U);
+
+        if (eStatus == ShadowParserSuccess) {
+            pxContext->ulElementIndex[pxContext->ulDepth - 1U] = ulElement++;
+            eStatus = prvParseValue(pxContext);
+            pxContext->ulDepth--;
+        }
+
+        if (eStatus == ShadowParserSuccess) {
+            prvSkipWhitespace(pxContext);
+
+            if (prvConsume(pxContext, ']')) {
+                break;
+            } else if (prvConsume(pxContext, ',') == false) {
+                eStatus = ShadowParserInvalidJson;
+            }
+        }
+    }
+
+    return eStatus;
+}
+
+static ShadowParserStatus_t prvParseValue(ParserContext_t *pxContext) {
+    ShadowParserStatus_t eStatus = ShadowParserInvalidJson;
+    uint32_t ulFlag = prvMatchField(pxContext);
+    const char *pcValue = NULL;
+    size_t xValueLength = 0U;
+    char c;
+
+    prvSkipWhitespace(pxContext);
+
+    if (pxContext->xIndex >= pxContext->xLength) {
+        return ShadowParserInvalidJson;
+    }
+
+    c = pxContext->pcBuffer[pxContext->xIndex];
+
+    if (c == '{') {
+        eStatus = (ulFlag == 0U) ? prvParseObject(pxContext) : ShadowParserInvalidValue;
+    } else if (c == '[') {
+        eStatus = (ulFlag == 0U) ? prvParseArray(pxContext) : ShadowParserInvalidValue;
+    } else if (c == '"') {
+        eStatus = prvParseString(pxContext, &pcValue, &xValueLength);
+
+        if ((eStatus == ShadowParserSuccess) && (ulFlag != 0U)) {
+            eStatus = prvStoreString(pxContext, ulFlag, pcValue, xValueLength);
+        }
+    } else if ((c == '-') || prvIsDigit(c)) {
+        eStatus = prvParseNumber(pxContext, &pcValue, &xValueLength);
+
+        if ((eStatus == ShadowParserSuccess) && (ulFlag != 0U)) {
+            eStatus = prvStoreNumber(pxContext, ulFlag, pcValue, xValueLength);
+        }
+    } else if ((c == 't') || (c == 'f') || (c == 'n')) {
+        eStatus = prvParseLiteral(pxContext, (c == 't') ? "true" : ((c == 'f') ? "false" : "null"));
+
+        if ((eStatus == ShadowParserSuccess) && (ulFlag != 0U)) {
+            eStatus = ShadowParserInvalidValue;
+        }
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+ShadowParserStatus_t eShadowParseDocument(const char *pcPayload,
+                                          size_t xPayloadLength,
+                                          ShadowDeltaDocument_t *pxDocument) {
+    ShadowParserStatus_t eStatus = ShadowParserSuccess;
+    ParserContext_t xContext;
+
+    if ((pcPayload == NULL) || (pxDocument == NULL) || (xPayloadLength == 0U)) {
+        return ShadowParserBadParameter;
+    }
+
+    (void) memset(pxDocument, 0x00, sizeof(*pxDocument));
+
+    xContext.pcBuffer = pcPayload;
+    xContext.xLength = xPayloadLength;
+    xContext.xIndex = 0U;
+    xContext.ulDepth = 0U;
+    xContext.pxDocument = pxDocument;
+
+    prvSkipWhitespace(&xContext);
+
+    /* A shadow document is always a single object. */
+    if ((xContext.xIndex >= xContext.xLength) || (pcPayload[xContext.xIndex] != '{')) {
+        eStatus = ShadowParserInvalidJson;
+    } else {
+        eStatus = prvParseObject(&xContext);
+    }
+
+    if (eStatus == ShadowParserSuccess) {
+        prvSkipWhitespace(&xContext);
+
+        if (xContext.xIndex != xContext.xLength) {
+            eStatus = ShadowParserInvalidJson;
+        }
+    }
+
+    return eStatus;
+}
+
+ShadowParserStatus_t eShadowParseUint32(const char *pcDigits,
+                                        size_t xLength,
+                                        uint32_t *pulValue) {
+    if ((pcDigits == NULL) || (pulValue == NULL)) {
+        return ShadowParserBadParameter;
+    }
+
+    return prvNumberToUint32(pcDigits, xLength, pulValue) ? ShadowParserSuccess : ShadowParserInvalidValue;
+}
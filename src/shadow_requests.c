@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "esp_system.h"
+#include "iot_demo_logging.h"
+
+#include "app_config.h"
+#include "shadow_requests.h"
+#include "latency_probe.h"
+
+/*-----------------------------------------------------------*/
+
+typedef struct ShadowRequest
+{
+    uint32_t ulClientToken;
+    TickType_t xSentAt;
+    uint32_t ulSentAtUs;
+    bool xPending;
+} ShadowRequest_t;
+
+static ShadowRequest_t xRequests[appconfigSHADOW_MAX_PENDING_REQUESTS];
+
+/**
+ * @brief The next token to hand out; zero until the random base is drawn.
+ */
+static uint32_t ulNextToken = 0U;
+
+static portMUX_TYPE xRequestLock = portMUX_INITIALIZER_UNLOCKED;
+
+/*-----------------------------------------------------------*/
+
+uint32_t ulShadowRequestBegin(void) {
+    ShadowRequest_t *pxSlot = NULL;
+    uint32_t ulToken;
+    size_t i;
+
+    portENTER_CRITICAL(&xRequestLock);
+
+    if (ulNextToken == 0U) {
+        /* Keep the base well below the 10 digit limit of the token field so
+         * the counter has room before it wraps. */
+        ulNextToken = (esp_random() % 1000000000U) + 1U;
+    }
+
+    ulToken = ulNextToken++;
+
+    /* Reuse the oldest slot if all are taken; its response is overdue anyway. */
+    for (i = 0; i < appconfigSHADOW_MAX_PENDING_REQUESTS; i++) {
+        if (!xRequests[i].xPending) {
+            pxSlot = &xRequests[i];
+            break;
+        }
+
+        if ((pxSlot == NULL) || ((int32_t) (xRequests[i].xSentAt - pxSlot->xSentAt) < 0)) {
+            pxSlot = &xRequests[i];
+        }
+    }
+
+    pxSlot->ulClientToken = ulToken;
+    pxSlot->xSentAt = xTaskGetTickCount();
+    pxSlot->ulSentAtUs = ulLatencyProbeNow();
+    pxSlot->xPending = true;
+
+    portEXIT_CRITICAL(&xRequestLock);
+
+    return ulToken;
+}
+
+bool xShadowRequestComplete(uint32_t ulClientToken, TickType_t *pxLatency) {
+    uint32_t ulSentAtUs = 0U;
+    bool xFound = false;
+    size_t i;
+
+    portENTER_CRITICAL(&xRequestLock);
+
+    for (i = 0; i < appconfigSHADOW_MAX_PENDING_REQUESTS; i++) {
+        if (xRequests[i].xPending && (xRequests[i].ulClientToken == ulClientToken)) {
+            *pxLatency = xTaskGetTickCount() - xRequests[i].xSentAt;
+            ulSentAtUs = xRequests[i].ulSentAtUs;
+            xRequests[i].xPending = false;
+            xFound = true;
+            break;
+        }
+    }
+
+    portEXIT_CRITICAL(&xRequestLock);
+
+    if (xFound) {
+        vLatencyProbeRecord(LatencySpanShadowAck, ulSentAtUs);
+    }
+
+    return xFound;
+}
+
+void vShadowRequestExpire(void) {
+    TickType_t xNow = xTaskGetTickCount();
+    uint32_t ulExpired = 0U;
+    size_t i;
+
+    portENTER_CRITICAL(&xRequestLock);
+
+    for (i = 0; i < appconfigSHADOW_MAX_PENDING_REQUESTS; i++) {
+        if (xRequests[i].xPending &&
+            ((xNow - xRequests[i].xSentAt) >= pdMS_TO_TICKS(appconfigSHADOW_RESPONSE_TIMEOUT_MS))) {
+            xRequests[i].xPending = false;
+            ulExpired++;
+        }
+    }
+
+    portEXIT_CRITICAL(&xRequestLock);
+
+    if (ulExpired > 0U) {
+        IotLogWarn("%u shadow update(s) got no accepted/rejected response within %u ms",
+                   (unsigned) ulExpired,
+                   (unsigned) appconfigSHADOW_RESPONSE_TIMEOUT_MS);
+    }
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "shadow_serializer.h"
+
+/*-----------------------------------------------------------*/
+
+void vShadowTemplateSerialize(const ShadowTemplate_t *pxTemplate,
+                              char *pcDocument,
+                              const uint32_t *pulValues) {
+    size_t xOffset = 0U;
+    size_t i;
+
+    for (i = 0; i < pxTemplate->xSegmentCount; i++) {
+        const ShadowTemplateSegment_t *pxSegment = &pxTemplate->pxSegments[i];
+
+        if (pxSegment->ucField != SHADOW_TEMPLATE_NO_FIELD) {
+            uint32_t ulValue = pulValues[pxSegment->ucField];
+            size_t xDigit = pxSegment->usLength;
+
+            /* Fill right to left; leading positions become '0'. */
+            while (xDigit > 0U) {
+                xDigit--;
+                pcDocument[xOffset + xDigit] = (char) ('0' + (ulValue % 10U));
+                ulValue /= 10U;
+            }
+        }
+
+        xOffset += pxSegment->usLength;
+    }
+}
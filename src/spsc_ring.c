@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+#include "spsc_ring.h"
+
+/*-----------------------------------------------------------*/
+
+void vSpscRingInit(SpscRing_t *pxRing,
+                   void *pvStorage,
+                   size_t xItemSize,
+                   uint32_t ulCapacity) {
+    configASSERT((pxRing != NULL) && (pvStorage != NULL) && (xItemSize > 0U));
+    configASSERT((ulCapacity > 0U) && ((ulCapacity & (ulCapacity - 1U)) == 0U));
+
+    pxRing->pucStorage = (uint8_t *) pvStorage;
+    pxRing->xItemSize = xItemSize;
+    pxRing->ulMask = ulCapacity - 1U;
+    pxRing->ulHead = 0U;
+    pxRing->ulTail = 0U;
+    pxRing->ulDropped = 0U;
+}
+
+bool xSpscRingPush(SpscRing_t *pxRing, const void *pvItem) {
+    uint32_t ulHead = pxRing->ulHead;
+    uint32_t ulTail = __atomic_load_n(&pxRing->ulTail, __ATOMIC_ACQUIRE);
+
+    /* The indices run freely and wrap together, so the difference is the
+     * fill level even across the 32-bit wrap. */
+    if ((ulHead - ulTail) > pxRing->ulMask) {
+        __atomic_fetch_add(&pxRing->ulDropped, 1U, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    (void) memcpy(&pxRing->pucStorage[(ulHead & pxRing->ulMask) * pxRing->xItemSize],
+                  pvItem,
+                  pxRing->xItemSize);
+
+    __atomic_store_n(&pxRing->ulHead, ulHead + 1U, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool xSpscRingPop(SpscRing_t *pxRing, void *pvItem) {
+    uint32_t ulTail = pxRing->ulTail;
+    uint32_t ulHead = __atomic_load_n(&pxRing->ulHead, __ATOMIC_ACQUIRE);
+
+    if (ulHead == ulTail) {
+        return false;
+    }
+
+    (void) memcpy(pvItem,
+                  &pxRing->pucStorage[(ulTail & pxRing->ulMask) * pxRing->xItemSize],
+                  pxRing->xItemSize);
+
+    __atomic_store_n(&pxRing->ulTail, ulTail + 1U, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+uint32_t ulSpscRingTakeDropped(SpscRing_t *pxRing) {
+    return __atomic_exchange_n(&pxRing->ulDropped, 0U, __ATOMIC_RELAXED);
+}
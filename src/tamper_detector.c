@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Standard includes. */
+#include <math.h>
+#include <string.h>
+
+#include "app_config.h"
+#include "tamper_detector.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Low-pass coefficient of the gravity estimate, as a shift: each
+ * sample moves it 1/16 of the way, a time constant of 160 ms at 100 Hz.
+ */
+#define TAMPER_GRAVITY_SHIFT          (4)
+
+#define TAMPER_REBASE_SAMPLES         ((appconfigTAMPER_REBASE_MS * appconfigIMU_SAMPLE_RATE_HZ) / 1000U)
+
+#define TAMPER_ALL_EVENTS             (TAMPER_EVENT_VIBRATION | TAMPER_EVENT_SHOCK | TAMPER_EVENT_TILT)
+
+/* Re-arm once the feature is a quarter back below (or, for the tilt cosine,
+ * above) its threshold. */
+#define TAMPER_REARM(ulThreshold)     (((ulThreshold) * 3U) / 4U)
+
+_Static_assert(appconfigTAMPER_WINDOW_SAMPLES > 0U, "appconfigTAMPER_WINDOW_SAMPLES must not be 0");
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvSquareRoot(uint32_t ulValue) {
+    uint32_t ulRoot = 0U;
+    uint32_t ulBit = 1UL << 30;
+
+    while (ulBit > ulValue) {
+        ulBit >>= 2;
+    }
+
+    while (ulBit != 0U) {
+        if (ulValue >= (ulRoot + ulBit)) {
+            ulValue -= ulRoot + ulBit;
+            ulRoot = (ulRoot >> 1) + ulBit;
+        } else {
+            ulRoot >>= 1;
+        }
+
+        ulBit >>= 2;
+    }
+
+    return ulRoot;
+}
+
+/**
+ * @brief Length of a vector in mg. Components stay within +/-16000 mg (the
+ * 8 g range, or the difference of two such readings for jerk), so the sum of
+ * squares fits in 32 bits.
+ */
+static uint32_t prvLength(const int32_t plVector[3]) {
+    return prvSquareRoot((uint32_t) (plVector[0] * plVector[0]) +
+                         (uint32_t) (plVector[1] * plVector[1]) +
+                         (uint32_t) (plVector[2] * plVector[2]));
+}
+
+static int32_t prvCosineMilli(const int32_t plA[3], const int32_t plB[3]) {
+    int64_t llDot = ((int64_t) plA[0] * plB[0]) + ((int64_t) plA[1] * plB[1]) + ((int64_t) plA[2] * plB[2]);
+    int64_t llLengths = (int64_t) prvLength(plA) * prvLength(plB);
+
+    if (llLengths == 0) {
+        return 1000;
+    }
+
+    return (int32_t) ((llDot * 1000) / llLengths);
+}
+
+/*-----------------------------------------------------------*/
+
+void vTamperDetectorInit(TamperDetector_t *pxDetector) {
+    (void) memset(pxDetector, 0, sizeof(*pxDetector));
+
+    pxDetector->ulArmed = TAMPER_ALL_EVENTS;
+
+    /* The only floating point operation, done once. */
+    pxDetector->lTiltCosThresholdMilli =
+            (int32_t) (cosf((float) appconfigTAMPER_TILT_DEG * (float) M_PI / 180.0f) * 1000.0f);
+}
+
+uint32_t ulTamperDetectorUpdate(TamperDetector_t *pxDetector,
+                                const ImuSample_t *pxSample,
+                                TamperFeatures_t *pxFeatures) {
+    TamperFeatures_t xFeatures;
+    int32_t lAccelMg[3];
+    int32_t lGravityMg[3];
+    int32_t lDelta[3];
+    uint32_t ulSquare;
+    uint32_t ulSlot;
+    uint32_t ulFired = 0U;
+    int32_t lTiltRearm;
+    size_t i;
+
+    for (i = 0; i < 3U; i++) {
+        lAccelMg[i] = ((int32_t) pxSample->sAccel[i] * 1000) / IMU_ACCEL_LSB_PER_G;
+
+        if (pxDetector->ulSamples == 0U) {
+            pxDetector->lGravityQ8[i] = lAccelMg[i] * 256;
+            pxDetector->lPreviousMg[i] = lAccelMg[i];
+        }
+
+        pxDetector->lGravityQ8[i] += ((lAccelMg[i] * 256) - pxDetector->lGravityQ8[i]) >> TAMPER_GRAVITY_SHIFT;
+        lGravityMg[i] = pxDetector->lGravityQ8[i] / 256;
+    }
+
+    xFeatures.ulMagnitudeMg = prvLength(lAccelMg);
+
+    /* RMS of what is left once gravity is removed, over a sliding window. */
+    for (i = 0; i < 3U; i++) {
+        lDelta[i] = lAccelMg[i] - lGravityMg[i];
+    }
+
+    ulSquare = (uint32_t) (lDelta[0] * lDelta[0]) + (uint32_t) (lDelta[1] * lDelta[1]) +
+               (uint32_t) (lDelta[2] * lDelta[2]);
+    ulSlot = pxDetector->ulSamples % appconfigTAMPER_WINDOW_SAMPLES;
+    pxDetector->ullSquareSum += (uint64_t) ulSquare - pxDetector->ulSquares[ulSlot];
+    pxDetector->ulSquares[ulSlot] = ulSquare;
+    xFeatures.ulRmsMg = prvSquareRoot((uint32_t) (pxDetector->ullSquareSum / appconfigTAMPER_WINDOW_SAMPLES));
+
+    /* Jerk from consecutive samples. */
+    for (i = 0; i < 3U; i++) {
+        lDelta[i] = lAccelMg[i] - pxDetector->lPreviousMg[i];
+        pxDetector->lPreviousMg[i] = lAccelMg[i];
+    }
+
+    xFeatures.ulJerkGPerS = (prvLength(lDelta) * appconfigIMU_SAMPLE_RATE_HZ) / 1000U;
+
+    if (pxDetector->ulSamples < appconfigTAMPER_WINDOW_SAMPLES) {
+        /* Let the window and the gravity estimate fill before judging. */
+        pxDetector->ulSamples++;
+        (void) memcpy(pxDetector->lReferenceMg, lGravityMg, sizeof(lGravityMg));
+        xFeatures.lTiltCosMilli = 1000;
+
+        if (pxFeatures != NULL) {
+            *pxFeatures = xFeatures;
+        }
+
+        return 0U;
+    }
+
+    pxDetector->ulSamples++;
+
+    /* A box that was moved and then left alone becomes the new resting
+     * orientation. */
+    if (xFeatures.ulRmsMg < appconfigTAMPER_STILL_RMS_MG) {
+        if (++pxDetector->ulStillSamples >= TAMPER_REBASE_SAMPLES) {
+            (void) memcpy(pxDetector->lReferenceMg, lGravityMg, sizeof(lGravityMg));
+            pxDetector->ulStillSamples = 0U;
+            pxDetector->ulArmed |= TAMPER_EVENT_TILT;
+        }
+    } else {
+        pxDetector->ulStillSamples = 0U;
+    }
+
+    xFeatures.lTiltCosMilli = prvCosineMilli(lGravityMg, pxDetector->lReferenceMg);
+
+    if (xFeatures.ulRmsMg >= appconfigTAMPER_VIBRATION_RMS_MG) {
+        ulFired |= TAMPER_EVENT_VIBRATION;
+    } else if (xFeatures.ulRmsMg < TAMPER_REARM(appconfigTAMPER_VIBRATION_RMS_MG)) {
+        pxDetector->ulArmed |= TAMPER_EVENT_VIBRATION;
+    }
+
+    if (xFeatures.ulJerkGPerS >= appconfigTAMPER_SHOCK_JERK_G_PER_S) {
+        ulFired |= TAMPER_EVENT_SHOCK;
+    } else if (xFeatures.ulJerkGPerS < TAMPER_REARM(appconfigTAMPER_SHOCK_JERK_G_PER_S)) {
+        pxDetector->ulArmed |= TAMPER_EVENT_SHOCK;
+    }
+
+    lTiltRearm = pxDetector->lTiltCosThresholdMilli + ((1000 - pxDetector->lTiltCosThresholdMilli) / 4);
+
+    if (xFeatures.lTiltCosMilli <= pxDetector->lTiltCosThresholdMilli) {
+        ulFired |= TAMPER_EVENT_TILT;
+    } else if (xFeatures.lTiltCosMilli > lTiltRearm) {
+        pxDetector->ulArmed |= TAMPER_EVENT_TILT;
+    }
+
+    ulFired &= pxDetector->ulArmed;
+    pxDetector->ulArmed &= ~ulFired;
+
+    if (pxFeatures != NULL) {
+        *pxFeatures = xFeatures;
+    }
+
+    return ulFired;
+}
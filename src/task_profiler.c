@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * SPDX-License-Identifier: MIT-0
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "esp_heap_caps.h"
+
+#include "aws_clientcredential.h"
+#include "iot_demo_logging.h"
+
+#include "app_config.h"
+#include "app_sched.h"
+#include "mqtt_agent.h"
+#include "task_profiler.h"
+
+/*-----------------------------------------------------------*/
+
+#define PROFILER_REQUEST_TOPIC           "cmd/personalbox/" clientcredentialIOT_THING_NAME "/profile"
+#define PROFILER_REQUEST_TOPIC_LENGTH    ((uint16_t) (sizeof(PROFILER_REQUEST_TOPIC) - 1U))
+
+#define PROFILER_REPORT_TOPIC            "dt/personalbox/" clientcredentialIOT_THING_NAME "/profile"
+#define PROFILER_REPORT_TOPIC_LENGTH     ((uint16_t) (sizeof(PROFILER_REPORT_TOPIC) - 1U))
+
+#define PROFILER_TASK_STACK_SIZE         (3072U)
+
+/* Below everything it measures, so that it does not disturb the numbers. */
+#define PROFILER_TASK_PRIORITY           (tskIDLE_PRIORITY + APP_SCHED_PRIORITY_PROFILER)
+
+/**
+ * @brief Room for tasks created while the snapshots are taken.
+ */
+#define PROFILER_SPARE_TASKS             (4U)
+
+#define PROFILER_PUBLISH_ATTEMPTS        (10U)
+#define PROFILER_PUBLISH_RETRY_MS        (100U)
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The profiler task while a profile is being taken.
+ */
+static TaskHandle_t xProfilerTask = NULL;
+
+/*-----------------------------------------------------------*/
+
+static void prvPublish(const char *pcPayload, size_t xLength) {
+    MqttAgentStatus_t eStatus = MqttAgentQueueFull;
+    uint32_t ulAttempt;
+
+    /* Publishes are only queued: waiting for the PUBACK could leave the agent
+     * notifying this task after it has deleted itself. A report of several
+     * documents may find the queue full, so give the agent time to drain. */
+    for (ulAttempt = 0U; (ulAttempt < PROFILER_PUBLISH_ATTEMPTS) && (eStatus == MqttAgentQueueFull); ulAttempt++) {
+        if (ulAttempt > 0U) {
+            vTaskDelay(pdMS_TO_TICKS(PROFILER_PUBLISH_RETRY_MS));
+        }
+
+        eStatus = eMqttAgentPublish(PROFILER_REPORT_TOPIC,
+                                    PROFILER_REPORT_TOPIC_LENGTH,
+                                    pcPayload,
+                                    xLength,
+                                    0U);
+    }
+
+    if (eStatus != MqttAgentSuccess) {
+        IotLogWarn("prvPublish: dropped a part of the task profile");
+    }
+}
+
+/**
+ * @brief The share of the window a task ran for, in permille. Always 0
+ * without configGENERATE_RUN_TIME_STATS.
+ */
+static uint32_t prvCpuPermille(const TaskStatus_t *pxTask,
+                               const TaskStatus_t *pxBefore, UBaseType_t uxBefore,
+                               uint32_t ulWindowRunTime) {
+    uint32_t ulPermille = 0U;
+#if (configGENERATE_RUN_TIME_STATS == 1)
+    uint32_t ulRunTime = pxTask->ulRunTimeCounter;
+    UBaseType_t i;
+
+    /* A task created during the window spent all of its time in it. */
+    for (i = 0; i < uxBefore; i++) {
+        if (pxBefore[i].xTaskNumber == pxTask->xTaskNumber) {
+            ulRunTime -= pxBefore[i].ulRunTimeCounter;
+            break;
+        }
+    }
+
+    if (ulWindowRunTime > 0U) {
+        ulPermille = (uint32_t) (((uint64_t) ulRunTime * 1000U) / ulWindowRunTime);
+    }
+#else
+    (void) pxTask;
+    (void) pxBefore;
+    (void) uxBefore;
+    (void) ulWindowRunTime;
+#endif
+
+    return ulPermille;
+}
+
+/**
+ * @brief Publish {"type":"tasks","windowMs":..,"tasks":[[name,stackFree,cpuPermille],..]},
+ * split over as many documents as it takes. stackFree is the least stack,
+ * in bytes, the task has ever had left.
+ */
+static void prvReportTasks(const TaskStatus_t *pxBefore, UBaseType_t uxBefore,
+                           const TaskStatus_t *pxAfter, UBaseType_t uxAfter,
+                           uint32_t ulWindowRunTime) {
+    char cPayload[appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH];
+    char cEntry[64];
+    size_t xHeaderLength;
+    size_t xLength;
+    UBaseType_t i;
+    int lLength;
+
+    lLength = snprintf(cPayload, sizeof(cPayload),
+                       "{\"type\":\"tasks\",\"windowMs\":%u,\"tasks\":[",
+                       (unsigned) appconfigPROFILER_WINDOW_MS);
+    xHeaderLength = (size_t) lLength;
+    xLength = xHeaderLength;
+
+    for (i = 0; i < uxAfter; i++) {
+        lLength = snprintf(cEntry, sizeof(cEntry),
+                           "%s[\"%s\",%u,%u]",
+                           (xLength == xHeaderLength) ? "" : ",",
+                           pxAfter[i].pcTaskName,
+                           (unsigned) pxAfter[i].usStackHighWaterMark,
+                           (unsigned) prvCpuPermille(&pxAfter[i], pxBefore, uxBefore, ulWindowRunTime));
+
+        if ((lLength <= 0) || ((size_t) lLength >= sizeof(cEntry))) {
+            continue;
+        }
+
+        /* Leave room for the closing "]}". */
+        if ((xLength + (size_t) lLength + 2U) > sizeof(cPayload)) {
+            cPayload[xLength++] = ']';
+            cPayload[xLength++] = '}';
+            prvPublish(cPayload, xLength);
+            xLength = xHeaderLength;
+
+            /* The separator is not wanted at the start of a new document. */
+            (void) memmove(cEntry, &cEntry[1], (size_t) lLength);
+            lLength--;
+        }
+
+        (void) memcpy(&cPayload[xLength], cEntry, (size_t) lLength);
+        xLength += (size_t) lLength;
+    }
+
+    cPayload[xLength++] = ']';
+    cPayload[xLength++] = '}';
+    prvPublish(cPayload, xLength);
+}
+
+/**
+ * @brief Publish the free, minimum ever free and largest free block of the
+ * byte addressable heap. fragPct is how much of the free heap is not
+ * available as one block.
+ */
+static void prvReportHeap(void) {
+    char cPayload[appconfigMQTT_AGENT_MAX_PAYLOAD_LENGTH];
+    size_t xFree = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t xLargest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    int lLength;
+
+    lLength = snprintf(cPayload, sizeof(cPayload),
+                       "{\"type\":\"heap\",\"free\":%u,\"minFree\":%u,\"largest\":%u,\"fragPct\":%u}",
+                       (unsigned) xFree,
+                       (unsigned) heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+                       (unsigned) xLargest,
+                       (unsigned) ((xFree > 0U) ? (100U - ((xLargest * 100U) / xFree)) : 0U));
+
+    prvPublish(cPayload, (size_t) lLength);
+}
+
+static void prvProfilerTask(void *pvParameters) {
+    UBaseType_t uxCapacity = uxTaskGetNumberOfTasks() + PROFILER_SPARE_TASKS;
+    TaskStatus_t *pxBefore;
+    TaskStatus_t *pxAfter;
+    UBaseType_t uxBefore = 0U;
+    UBaseType_t uxAfter = 0U;
+    uint32_t ulTotalBefore = 0U;
+    uint32_t ulTotalAfter = 0U;
+
+    (void) pvParameters;
+
+    pxBefore = pvPortMalloc(2U * uxCapacity * sizeof(TaskStatus_t));
+
+    if (pxBefore == NULL) {
+        IotLogError("prvProfilerTask: no memory for the task snapshots");
+    } else {
+        pxAfter = &pxBefore[uxCapacity];
+
+        uxBefore = uxTaskGetSystemState(pxBefore, uxCapacity, &ulTotalBefore);
+        vTaskDelay(pdMS_TO_TICKS(appconfigPROFILER_WINDOW_MS));
+        uxAfter = uxTaskGetSystemState(pxAfter, uxCapacity, &ulTotalAfter);
+
+        if (uxAfter == 0U) {
+            IotLogWarn("prvProfilerTask: more tasks than snapshot slots");
+        } else {
+            prvReportTasks(pxBefore, uxBefore, pxAfter, uxAfter, ulTotalAfter - ulTotalBefore);
+        }
+
+        vPortFree(pxBefore);
+    }
+
+    prvReportHeap();
+
+    xProfilerTask = NULL;
+    vTaskDelete(NULL);
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTaskProfilerInit(void) {
+    /* Executed by the agent once the session is up, and restored after
+     * every reconnect. */
+    return (eMqttAgentSubscribe(PROFILER_REQUEST_TOPIC,
+                                PROFILER_REQUEST_TOPIC_LENGTH,
+                                0U) == MqttAgentSuccess) ? pdPASS : pdFAIL;
+}
+
+bool xTaskProfilerHandlePublish(const MQTTPublishInfo_t *pxPublishInfo) {
+    if ((pxPublishInfo->topicNameLength != PROFILER_REQUEST_TOPIC_LENGTH) ||
+        (memcmp(pxPublishInfo->pTopicName, PROFILER_REQUEST_TOPIC, PROFILER_REQUEST_TOPIC_LENGTH) != 0)) {
+        return false;
+    }
+
+    /* Only the agent task starts a profile, and the profiler only clears
+     * the handle as it finishes, so a plain store is enough. */
+    if (xProfilerTask != NULL) {
+        IotLogWarn("xTaskProfilerHandlePublish: a profile is already being taken");
+    } else if (xTaskCreate(prvProfilerTask,
+                           "profiler",
+                           PROFILER_TASK_STACK_SIZE,
+                           NULL,
+                           PROFILER_TASK_PRIORITY,
+                           &xProfilerTask) != pdPASS) {
+        IotLogError("xTaskProfilerHandlePublish: failed to create the profiler task");
+        xProfilerTask = NULL;
+    }
+
+    return true;
+}
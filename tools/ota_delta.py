@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+# SPDX-License-Identifier: MIT-0
+#
+"""Build the update stream and the offer for the OTA client (src/ota_client.c).
+
+    ota_delta.py full  new.bin  stream.bin --job <id>
+    ota_delta.py delta base.bin new.bin stream.bin --job <id>
+
+base.bin must be the image the device runs now: the sha256 it reports on
+dt/personalbox/<thing>/ota has to match the baseSha256 printed here. The
+offer is printed as JSON, to be published on cmd/personalbox/<thing>/ota/offer.
+
+A delta is a series of instructions, each an opcode byte and two
+little-endian 32-bit words:
+
+    'C' <source offset> <length>    copy from the running image
+    'I' 0 <length> <bytes>          insert new bytes
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+SHA256_LENGTH = 32
+HASH_APPENDED_OFFSET = 23
+
+KEY_LENGTH = 16
+MIN_COPY = 24
+
+
+def image_sha256(image, name):
+    """The digest ESP-IDF appends to an app image, which is what
+    esp_partition_get_sha256 returns for it."""
+    if len(image) < 24 + SHA256_LENGTH or image[0] != 0xE9 or image[HASH_APPENDED_OFFSET] != 1:
+        sys.exit("%s is not an ESP32 app image with an appended SHA-256" % name)
+    return image[-SHA256_LENGTH:].hex()
+
+
+def common_length(new, i, base, j):
+    length = 0
+    limit = min(len(new) - i, len(base) - j)
+    while length < limit:
+        step = min(64, limit - length)
+        if new[i + length:i + length + step] == base[j + length:j + length + step]:
+            length += step
+            continue
+        while length < limit and new[i + length] == base[j + length]:
+            length += 1
+        break
+    return length
+
+
+def make_delta(base, new):
+    index = {}
+    for j in range(len(base) - KEY_LENGTH, -1, -1):
+        index[base[j:j + KEY_LENGTH]] = j
+
+    out = bytearray()
+    literal_start = 0
+    displacement = 0
+    i = 0
+
+    def flush_literal(end):
+        if end > literal_start:
+            out.extend(struct.pack("<BII", ord("I"), 0, end - literal_start))
+            out.extend(new[literal_start:end])
+
+    while i + KEY_LENGTH <= len(new):
+        # After a small edit the rest usually lines up as it did before.
+        candidates = [i + displacement, index.get(new[i:i + KEY_LENGTH])]
+        best_j, best_length = None, 0
+        for j in candidates:
+            if j is not None and 0 <= j < len(base):
+                length = common_length(new, i, base, j)
+                if length > best_length:
+                    best_j, best_length = j, length
+
+        if best_length >= MIN_COPY:
+            flush_literal(i)
+            out.extend(struct.pack("<BII", ord("C"), best_j, best_length))
+            displacement = best_j - i
+            i += best_length
+            literal_start = i
+        else:
+            i += 1
+
+    flush_literal(len(new))
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("mode", choices=("full", "delta"))
+    parser.add_argument("files", nargs="+", help="[base.bin] new.bin stream.bin")
+    parser.add_argument("--job", required=True, help="job id, at most 31 characters")
+    args = parser.parse_args()
+
+    if len(args.job) > 31 or '"' in args.job:
+        sys.exit("the job id must be at most 31 characters, without quotes")
+
+    if len(args.files) != (3 if args.mode == "delta" else 2):
+        parser.error("wrong number of files")
+
+    images = [open(name, "rb").read() for name in args.files[:-1]]
+    new = images[-1]
+    offer = {"job": args.job, "size": len(new), "sha256": image_sha256(new, args.files[-2])}
+
+    if args.mode == "delta":
+        base = images[0]
+        offer["baseSha256"] = image_sha256(base, args.files[0])
+        stream = make_delta(base, new)
+    else:
+        stream = new
+
+    offer["streamSize"] = len(stream)
+
+    with open(args.files[-1], "wb") as output:
+        output.write(stream)
+
+    print(json.dumps(offer))
+    print("stream: %u bytes, %.1f %% of the image" % (len(stream), 100.0 * len(stream) / len(new)),
+          file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()